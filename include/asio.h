@@ -16,7 +16,10 @@
 #ifndef __MIPI_ASIO__
 #define __MIPI_ASIO__
 
+#include <stdatomic.h>
+
 #include "mipi.h"
+#include "osal.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,47 +43,144 @@ extern "C" {
  * flow in the ASYNC context.
  */
 
-struct async_io_ctx {};
-struct async_awaitable_result {};
+/**
+ * Operations are held in a ring of `ASYNC_IO_MAX_OPS` slots (a power of two)
+ * per context; once it is full, further submissions fail with
+ * `MIPI_ERR_NO_MEM` until completions have been dispatched. Buffers are
+ * copied into the slot, so at most `ASYNC_IO_BUFF_CAP` bytes are moved by an
+ * operation.
+ */
+#ifndef ASYNC_IO_MAX_OPS
+#define ASYNC_IO_MAX_OPS 16
+#endif
+
+#ifndef ASYNC_IO_BUFF_CAP
+#define ASYNC_IO_BUFF_CAP 32
+#endif
+
+#if (ASYNC_IO_MAX_OPS & (ASYNC_IO_MAX_OPS-1))!=0
+# error ASYNC_IO_MAX_OPS must be a power of two
+#endif
+
 typedef void
 (*async_io_read_cb)(
 	mipi_err_T errno,
-	byte_buffer_T out_buff
+	byte_buffer_T out_buff,
+	void * cb_arg
 );
 
 typedef void
 (*async_io_write_cb)(
 	mipi_err_T errno,
-	size_t bytes_written
+	size_t bytes_written,
+	void * cb_arg
+);
+
+enum async_io_op_kind {
+	ASYNC_IO_WRITE,
+	ASYNC_IO_READ,
+	ASYNC_IO_READ_UNTIL
+};
+
+struct async_io_op {
+	enum async_io_op_kind kind;
+	_Bool done;
+	struct mipi_io_ctr * io_ctr;
+	mipi_dcs_cmd_T cmd;
+	uint8_t delim;
+	uint8_t buff[ASYNC_IO_BUFF_CAP];
+	size_t len;
+	byte_buffer_T out_buff; // << the destination of a read, copied on dispatch
+
+	union {
+		async_io_read_cb rd_cb;
+		async_io_write_cb wt_cb;
+	};
+	void * cb_arg;
+
+	mipi_err_T errno;
+	size_t num_bytes;
+};
+
+/**
+ * The OSAL worker which runs the operations, if the platform provides one
+ * (see <<ASIO>> in `osal.h`).
+ */
+struct _osal_asio_worker;
+
+/**
+ * Slots between `tail` and `next` have been run and are waiting for their
+ * completion to be dispatched; those between `next` and `head` are waiting
+ * to be run. Only the executor advances `next`, and only the dispatcher
+ * advances `tail`, so the slots each one works on are never touched by
+ * producers.
+ */
+struct async_io_ctx {
+	mipi_osal_mtx_T mtx;
+	struct async_io_op ops[ASYNC_IO_MAX_OPS];
+	atomic_size_t head, next, tail;
+
+	struct _osal_asio_worker * wkr; // << NULL if run by `async_io_poll`
+	atomic_flag in_dispatch; // << held by `async_io_poll`
+	size_t num_submitted, num_completed, num_rejected;
+};
+
+struct async_awaitable_result {
+	volatile _Bool done;
+	mipi_err_T errno;
+	size_t num_bytes;
+};
+
+/**
+ * Prepares the context for use. Where the OSAL provides a worker, operations
+ * are run on it in the background; otherwise, or if `use_worker` is false,
+ * they are run from within `async_io_poll`.
+ */
+extern mipi_err_T
+async_io_ctx_init (
+	struct async_io_ctx * io_ctx,
+	_Bool use_worker
 );
 
+/**
+ * Stops the worker. Operations which have not yet been dispatched are
+ * dropped without invoking their callbacks.
+ */
+extern void
+async_io_ctx_free (struct async_io_ctx * io_ctx);
+
 /**
  * Given the IO context and the connector, writes at most N bytes across the
  * connector from the provided buffer, where N is the size of this buffer. The
- * write may block to lock the `io_ctx` but should return immediately after
- * enqueuing the operation.
+ * first byte is the command, the rest its parameters; if the buffer is larger
+ * than `ASYNC_IO_BUFF_CAP`, it is truncated, and the callback reports how
+ * many were written. The write may block to lock the `io_ctx` but should
+ * return immediately after enqueuing the operation.
  */
 extern mipi_err_T
 async_io_write_some (
 	struct async_io_ctx * io_ctx,
 	struct mipi_io_ctr * io_ctr,
-	_COPY_FROM_USER byte_buffer_view_T in_buff
+	_COPY_FROM_USER byte_buffer_view_T in_buff,
+	async_io_write_cb cb,
+	void * cb_arg
 );
 
+/**
+ * Reads the parameters of `cmd`, at most as many as `out_buff` holds (and
+ * `ASYNC_IO_BUFF_CAP`). They are copied into `out_buff` on the thread which
+ * dispatches the completion, just before the callback is invoked.
+ */
 extern mipi_err_T
 async_io_read_some (
 	struct async_io_ctx * io_ctx,
 	struct mipi_io_ctr * io_ctr,
-	_COPY_TO_USER byte_buffer_T out_buff
+	mipi_dcs_cmd_T cmd,
+	_COPY_TO_USER byte_buffer_T out_buff,
+	async_io_read_cb cb,
+	void * cb_arg
 );
 
-/**
- * async_io_write (_spi_ctr, MIPI_ASYNC_IO_CTX, _spi_write_hdlr, byte_buffer (
- *	ptl_fmbf,
- *	ptl_fmbf_sz
- * ));
- */
-
  /**
   * To make it easy as possible to both implement support for, and to cater
 	* toward, generic targets of this library, a small abstraction is provided
@@ -94,24 +194,36 @@ async_io_read_some (
 	* bit of timekeeping on their part.
   */
 
-extern mipi_err_T
-async_write ();
-
-extern mipi_err_T
-async_read ();
-
 /**
  * Read all bytes coming across the connector until the delimeter is reached.
  * Note that the callback will not be dispatched until this delimeter is
- * received, even if that requires multiple read operations.
+ * received, even if that requires multiple read operations. Memory reads
+ * (RAMRD) are continued with RAMRDC; any other register is read in full, once.
+ * If `out_buff` fills before the delimeter is found, the callback receives
+ * `MIPI_ERR_NO_MEM` along with what was read.
  */
 extern mipi_err_T
-async_io_read_until ();
+async_io_read_until (
+	struct async_io_ctx * io_ctx,
+	struct mipi_io_ctr * io_ctr,
+	mipi_dcs_cmd_T cmd,
+	uint8_t delim,
+	_COPY_TO_USER byte_buffer_T out_buff,
+	async_io_read_cb cb,
+	void * cb_arg
+);
 
+/**
+ * Reads the parameters of `cmd` into `read_params_buff` and waits for the
+ * result, polling the context meanwhile, so that other completions are still
+ * dispatched (on this thread). Returns `MIPI_ERR_INTERRUPT` if the read did
+ * not complete within `MIPI_MAX_TM`.
+ */
 extern mipi_err_T
 async_io_await_result (
 	struct async_io_ctx * io_ctx,
 	struct mipi_io_ctr * io_ctr,
+	mipi_dcs_cmd_T cmd,
 	_IN byte_buffer_T read_params_buff,
 	_OUT struct async_awaitable_result * result
 );
@@ -119,9 +231,16 @@ async_io_await_result (
 /**
  * In the case that the platform has no system-provided scheduling mechanism,
  * the processing of IO operations requires explicit polling in client code.
+ * Runs the pending operations (if there is no worker), then dispatches the
+ * completions, in the order the operations were submitted, on the calling
+ * thread. Returns the number of callbacks invoked.
+ *
+ * Callbacks may submit further operations, but a call made from within a
+ * callback returns 0 rather than dispatch any; this is what keeps them from
+ * ever running concurrently, or re-entrantly.
  */
-extern void
-async_io_poll (struct mipi_io_ctr * io_ctr);
+extern size_t
+async_io_poll (struct async_io_ctx * io_ctx);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,231 @@
+/**
+ * ========================
+ *        asio_pt.h
+ * ========================
+ *
+ * Protothreads over the async IO context. A panel update is a sequence of
+ * steps which each wait on something: a command to be written, DMA to drain,
+ * TE, a delay. Written as a protothread, the whole sequence is one routine,
+ * which returns to the scheduler at each wait and resumes from it when it is
+ * next run; any number of them may be interleaved on one thread (eg. the
+ * event loop on core 1) without a stack of their own.
+ *
+ * A routine is a function of the form:
+ *
+ * static int
+ * band_update (
+ *	struct async_pt * pt,
+ *	void * arg )
+ * {
+ *	struct band_job * job=arg;
+ *
+ *	ASYNC_PT_BEGIN (pt);
+ *	for (job->row=0; job->row<job->num_rows; job->row+=job->band_rows) {
+ *		ASYNC_PT_WAIT_TE (pt, job->te);
+ *		ASYNC_PT_WRITE (pt, job->io_ctx, job->io, job->caset);
+ *		...
+ *		ASYNC_PT_WAIT_IO_IDLE (pt, job->io);
+ *	}
+ *	ASYNC_PT_END (pt);
+ * }
+ *
+ * Local variables do not survive a wait; state which must, such as `row`
+ * above, is kept in the argument. The resume points are labels (a GNU C
+ * extension), so waits may be made from within `switch` statements.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-18
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_ASIO_PT__
+#define __MIPI_ASIO_PT__
+
+#include "asio.h"
+#include "mipi_te.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+	ASYNC_PT_WAITING,
+	ASYNC_PT_EXITED
+};
+
+struct async_pt;
+
+typedef int
+(*async_pt_fn)(
+	struct async_pt * pt,
+	void * arg
+);
+
+struct async_pt {
+	void * lc;     // << resume point; NULL to start from the top
+	uint32_t mark; // << time or TE count recorded by the last wait
+
+	/**
+	 * Result of the last operation made with `ASYNC_PT_WRITE` or
+	 * `ASYNC_PT_READ`; `io.errno` may be checked once it has returned.
+	 */
+	struct async_awaitable_result io;
+
+	async_pt_fn fn;
+	void * arg;
+	struct async_pt * next;
+};
+
+struct async_pt_sched {
+	struct async_io_ctx * io_ctx;
+	struct async_pt * head;
+	size_t num_pts;
+	size_t num_resumes;
+};
+
+#define _ASYNC_PT_CAT2(a, b) a##b
+#define _ASYNC_PT_CAT(a, b)  _ASYNC_PT_CAT2 (a, b)
+#define _ASYNC_PT_LABEL      _ASYNC_PT_CAT (_async_pt_lc_, __COUNTER__)
+
+#define _ASYNC_PT_WAIT_AT(pt, lbl, cond) \
+	do {                                   \
+		(pt)->lc=&&lbl;                      \
+	lbl:                                   \
+		if (!(cond))                         \
+			return ASYNC_PT_WAITING;           \
+	} while (0)
+
+#define _ASYNC_PT_YIELD_AT(pt, lbl) \
+	do {                              \
+		(pt)->lc=&&lbl;                 \
+		return ASYNC_PT_WAITING;        \
+	lbl:                              \
+		;                               \
+	} while (0)
+
+#define ASYNC_PT_BEGIN(pt) \
+	do {                     \
+		if ((pt)->lc)          \
+			goto *(pt)->lc;      \
+	} while (0)
+
+#define ASYNC_PT_END(pt) \
+	do {                   \
+		(pt)->lc=NULL;       \
+		return ASYNC_PT_EXITED; \
+	} while (0)
+
+#define ASYNC_PT_EXIT(pt) ASYNC_PT_END (pt)
+
+/**
+ * Returns to the scheduler until `cond` holds; it is evaluated each time the
+ * routine is run.
+ */
+#define ASYNC_PT_WAIT_UNTIL(pt, cond) \
+	_ASYNC_PT_WAIT_AT (pt, _ASYNC_PT_LABEL, cond)
+
+/**
+ * Returns to the scheduler once, so that the others may run.
+ */
+#define ASYNC_PT_YIELD(pt) _ASYNC_PT_YIELD_AT (pt, _ASYNC_PT_LABEL)
+
+#define ASYNC_PT_SLEEP_MS(pt, ms)                                    \
+	do {                                                               \
+		(pt)->mark=_osal_get_time_ms ();                                 \
+		ASYNC_PT_WAIT_UNTIL (pt, _osal_get_time_ms ()-(pt)->mark>=(ms)); \
+	} while (0)
+
+/**
+ * Waits for the next rising edge of TE seen by the scheduler `te`.
+ */
+#define ASYNC_PT_WAIT_TE(pt, te)                               \
+	do {                                                         \
+		(pt)->mark=(te)->num_edges;                                \
+		ASYNC_PT_WAIT_UNTIL (pt, (te)->num_edges!=(pt)->mark);     \
+	} while (0)
+
+/**
+ * Waits for the connector to finish any transfer in progress, eg. a chunk of
+ * a framebuffer stream being sent by DMA.
+ */
+#define ASYNC_PT_WAIT_IO_IDLE(pt, io) \
+	ASYNC_PT_WAIT_UNTIL (pt, !(io)->wt_in_prog && !(io)->rd_in_prog)
+
+/**
+ * Writes `in_buff` (command, then parameters) with `async_io_write_some` and
+ * waits for it to complete. While the queue of the context is full, the
+ * write is retried each time the routine is run, so `in_buff` must outlive
+ * the wait.
+ */
+#define ASYNC_PT_WRITE(pt, io_ctx, io_ctr, in_buff)               \
+	do {                                                            \
+		ASYNC_PT_WAIT_UNTIL (                                         \
+			pt,                                                         \
+			async_pt_submit_write (pt, io_ctx, io_ctr, in_buff)         \
+		);                                                            \
+		ASYNC_PT_WAIT_UNTIL (pt, (pt)->io.done);                      \
+	} while (0)
+
+#define ASYNC_PT_READ(pt, io_ctx, io_ctr, cmd, out_buff)          \
+	do {                                                            \
+		ASYNC_PT_WAIT_UNTIL (                                         \
+			pt,                                                         \
+			async_pt_submit_read (pt, io_ctx, io_ctr, cmd, out_buff)    \
+		);                                                            \
+		ASYNC_PT_WAIT_UNTIL (pt, (pt)->io.done);                      \
+	} while (0)
+
+extern void
+async_pt_sched_init (
+	struct async_pt_sched * sched,
+	struct async_io_ctx * io_ctx
+);
+
+/**
+ * Adds `pt` to the scheduler, to run `fn` from the top on the next pass.
+ * `pt` is owned by the scheduler until the routine has exited.
+ */
+extern void
+async_pt_spawn (
+	struct async_pt_sched * sched,
+	struct async_pt * pt,
+	async_pt_fn fn,
+	void * arg
+);
+
+/**
+ * Makes one pass: dispatches the completions of the async IO context, then
+ * runs each routine once, in the order they were spawned. Routines which
+ * exit are removed. Returns the number still running.
+ */
+extern size_t
+async_pt_sched_run (struct async_pt_sched * sched);
+
+/**
+ * Submits the operation of `ASYNC_PT_WRITE`, returning false if the queue
+ * was full. Any other error is reported in `pt->io`, as a completed write.
+ */
+extern _Bool
+async_pt_submit_write (
+	struct async_pt * pt,
+	struct async_io_ctx * io_ctx,
+	struct mipi_io_ctr * io_ctr,
+	_COPY_FROM_USER byte_buffer_view_T in_buff
+);
+
+extern _Bool
+async_pt_submit_read (
+	struct async_pt * pt,
+	struct async_io_ctx * io_ctx,
+	struct mipi_io_ctr * io_ctr,
+	mipi_dcs_cmd_T cmd,
+	_COPY_TO_USER byte_buffer_T out_buff
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_ASIO_PT__
@@ -12,7 +12,12 @@
 #ifndef __MIPI_BYTE_BUFFER__
 #define __MIPI_BYTE_BUFFER__
 
-#include "sep_osal_emb/sysdefs.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osal.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,15 +44,18 @@ byte_buffer (
 	return bb;
 }
 
+/**
+ * The copy is empty if it could not be allocated.
+ */
 static __force_inline byte_buffer_T
-byte_buffer_make_copy (
-	byte_buffer_T byte_buff
-)
+byte_buffer_make_copy (byte_buffer_T byte_buff)
 {
-	const size_t l=byte_buff.size;
-	byte_buffer * r=__osal_thdr_safe_malloc ( l );
-	__osal_thrd_safe_memcpy ( &byte_buff, l );
-	return r;
+	uint8_t * buff=mipi_osal_alloc (byte_buff.buff_sz);
+
+	if (!buff)
+		return byte_buffer (NULL, 0);
+	memcpy (buff, byte_buff.buff, byte_buff.buff_sz);
+	return byte_buffer (buff, byte_buff.buff_sz);
 }
 
 static __force_inline byte_buffer_view_T
@@ -58,7 +66,7 @@ buffer_create_view_from (
 {
 	struct byte_buffer bb=
 	{
-		buff+buff_offset,
+		in_buff.buff+buff_offset,
 		len
 	};
 	return bb;
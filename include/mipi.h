@@ -34,8 +34,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#ifndef MIPI_NATIVE_PF_EN
 #include <pico/stdlib.h>
-#include "_pf_osal/osal.h"
+#endif
+#include "osal.h"
 
 #include "bbuff.h"
 
@@ -45,6 +47,14 @@
  */
 #define MIPI_MAX_TM      500 // << ms
 #define MIPI_CMD_BUFF_SZ 32
+/**
+ * Size of each of the two staging chunks used by `mipi_stream_fmbf`. Should
+ * be a multiple of the IFPF stride; smaller chunks reduce memory, but give
+ * the connector less time to overlap conversion with transmission.
+ */
+#ifndef MIPI_TX_CHUNK_SZ
+#define MIPI_TX_CHUNK_SZ 480 // << bytes
+#endif
 
 /**
  * ========================
@@ -67,6 +77,10 @@ extern "C" {
  *     Macros
  *******************/
 
+#ifndef MIPI_DBG_TAG
+#define MIPI_DBG_TAG "mipi_dbi"
+#endif
+
 #ifdef MIPI_DBG_EN
 #define LOG_BUFF_SZ 512 // << bytes
 /**
@@ -123,6 +137,17 @@ extern "C" {
     }                                               \
   }
 
+#define MIPI_CHK_NOT_NULL_OR_EXIT(_mipi_obj, _set_jmp) \
+  {                                                    \
+    if (!(_mipi_obj)) {                                \
+      _mipi_dbg (                                      \
+        MIPI_DBG_TAG,                                  \
+        #_mipi_obj " is NULL\n"                        \
+      );                                               \
+      goto _set_jmp;                                   \
+    }                                                  \
+  }
+
 /**
  * For object pointers which are returned by a function and require no explicit
  * allocation/deallocation, they should be marked with tag `_OUT` to specify
@@ -163,14 +188,6 @@ extern "C" {
  * Static Prototypes
  *******************/
 
-static size_t
-_mipi_cvt_clr_rgb565 (
-  struct mipi_ifpf * fmt,
-  _IN struct mipi_color clr[],
-  _OUT uint8_t * clr_buff[],
-  size_t buff_sz
-);
-
 /********************
  *      Types
  *******************/
@@ -252,12 +269,19 @@ struct mipi_ifpf {
   enum mipi_color_fmt in_clr_fmt;
   const uint8_t bytes_per_px, stride; // Padding may cause stride to differ.
 
+  /**
+   * Converts `num_px` colors of `in` into `out`, a buffer of `out_sz` bytes
+   * owned by the caller (eg. a chunk of `tx_chunk`, which is DMA-aligned).
+   * Only as many whole pixels as fit are converted; returns the number of
+   * bytes written. This is called on every flush, so must not allocate.
+   */
   size_t
   (*cvt_to_ifpf)(
-    struct mipi_ifpf * self,
-    _IN struct mipi_color clr_arr[],
-    _OUT uint8_t out_clr_buff[],
-    size_t num_clr_elems
+    const struct mipi_ifpf * self,
+    _IN const struct mipi_color in[],
+    size_t num_px,
+    _OUT uint8_t out[],
+    size_t out_sz
   );
 };
 
@@ -281,6 +305,43 @@ typedef struct _mipi_evt mipi_evt_T;
 typedef void
 mipi_tick_cb (uint32_t tick); // TODO
 
+/**
+ * A single command of a transaction (see `write_panel_txn`).
+ */
+struct mipi_io_txn_seg {
+  mipi_dcs_cmd_T cmd;
+  const uint8_t * params;
+  size_t num_params;
+};
+
+/**
+ * Staging for the commands of a transaction, filled by the encoders of
+ * `mipi_dcs.h`: the parameters are packed straight into `params`, and each
+ * segment points into it, so the stage must not be moved while in use.
+ */
+#ifndef MIPI_DCS_STAGE_SEGS
+#define MIPI_DCS_STAGE_SEGS 4
+#endif
+
+struct mipi_dcs_stage {
+  struct mipi_io_txn_seg segs[MIPI_DCS_STAGE_SEGS];
+  uint8_t params[MIPI_CMD_BUFF_SZ];
+  uint8_t num_segs, num_params;
+};
+
+/**
+ * The phases of panel IO which a connector may clock at different rates.
+ * Panels typically accept pixel data much faster than they can be read, and
+ * the init sequence is best sent at a conservative rate, as the panel may not
+ * yet be fully configured.
+ */
+enum mipi_io_phase {
+  MIPI_IO_PHASE_CMD, // << register writes, including the init sequence
+  MIPI_IO_PHASE_RD,
+  MIPI_IO_PHASE_PX,  // << pixel data, and the window commands framed with it
+  MIPI_IO_NUM_PHASES
+};
+
 /**
  * ========================
  *    Panel IO Interface
@@ -294,7 +355,13 @@ mipi_tick_cb (uint32_t tick); // TODO
  * information about valid pin assignments for the connector.
  */
 struct mipi_io_ctr {
-	uint8_t
+	/**
+	 * `rd_in_prog` and `wt_in_prog` remain set for the duration of a transfer
+	 * which was started asynchronously, and are cleared from the completion
+	 * handler. Client code may poll these to learn whether a buffer passed to
+	 * the connector is still in use.
+	 */
+	volatile uint8_t
 	/*BITFIELD*/
 	can_rd     : 1,
 	can_wt     : 1,
@@ -314,6 +381,25 @@ struct mipi_io_ctr {
     size_t num_params
   );
 
+  /**
+   * Writes each of the commands in `segs`, in order, followed by `px_sz`
+   * bytes from `px_data` as the data phase of the last of them, as a single
+   * transaction: the connector is locked and CS asserted only once for the
+   * whole sequence. `px_data` may be `NULL` if there is no trailing data.
+   *
+   * This is the preferred way to update a window of the panel, framing
+   * CASET, RASET and RAMWR together with the pixel data, so that small
+   * updates do not pay the setup cost of a transaction per command.
+   */
+  void
+  (*write_panel_txn)(
+    struct mipi_io_ctr * self,
+    _IN const struct mipi_io_txn_seg segs[],
+    size_t num_segs,
+    _IN const uint8_t px_data[],
+    size_t px_sz
+  );
+
   /**
    * Reads the given panel register into the `params` buffer, assuming one of
 	 * the various `RD*` commands, as defined in the DCS.
@@ -340,12 +426,90 @@ struct mipi_io_ctr {
   void
   (*flush_fmbf)(
     struct mipi_io_ctr * self,
-    _IN uint8_t ptl_fmbf_data[],
+    _IN const uint8_t ptl_fmbf_data[],
     const struct mipi_area fmbf_dest_bds,
     size_t fmbf_sz
   );
+
+  /**
+   * Scatter-gather form of `flush_fmbf`. The pixel data for `fmbf_dest_bds`
+   * is the concatenation of `spans`, in order; typically one per row of a
+   * sub-rectangle of a wider frame buffer, so that it may be sent from where
+   * it lies rather than first being gathered into a contiguous buffer. The
+   * spans must remain valid until the flush has completed.
+   */
+  void
+  (*flush_fmbf_vec)(
+    struct mipi_io_ctr * self,
+    _IN byte_buffer_view_T spans[],
+    size_t num_spans,
+    const struct mipi_area fmbf_dest_bds
+  );
+
+  /**
+   * Streaming flush, for connectors which may transmit a frame in several
+   * pieces. `begin_fmbf_stream` sets the destination window and starts the
+   * memory write, retaining ownership of the connector until the matching
+   * call to `end_fmbf_stream`. In between, `write_fmbf_chunk` may be called
+   * any number of times with consecutive pixel data.
+   *
+   * `write_fmbf_chunk` returns once the previous chunk has been transmitted
+   * and this one has been started; `wt_in_prog` is set for as long as the
+   * chunk is still in use. Any of these may be `NULL` if the connector does
+   * not support streaming.
+   */
+  mipi_err_T
+  (*begin_fmbf_stream)(
+    struct mipi_io_ctr * self,
+    const struct mipi_area fmbf_dest_bds
+  );
+
+  mipi_err_T
+  (*write_fmbf_chunk)(
+    struct mipi_io_ctr * self,
+    _IN const uint8_t chunk[],
+    size_t chunk_sz
+  );
+
+  void
+  (*end_fmbf_stream)(struct mipi_io_ctr * self);
+
+  /**
+   * Sets the clock rate used for transfers in the given phase, taking effect
+   * from the next transaction. Returns the rate actually in use, which may
+   * be lower than the one requested, or `0` if the clock of the connector
+   * cannot be changed. May be `NULL`.
+   */
+  uint32_t
+  (*set_phase_clk)(
+    struct mipi_io_ctr * self,
+    enum mipi_io_phase phase,
+    uint32_t hz
+  );
+
+  /**
+   * Returns the errors raised by the connector since it was last called, and
+   * clears them, so that a caller can tell whether the operation it has just
+   * made failed. Errors of an asynchronous transfer are only known once it
+   * completes, and are passed to its completion handler instead. May be
+   * `NULL`, in which case failures cannot be told apart.
+   */
+  mipi_err_T
+  (*take_err)(struct mipi_io_ctr * self);
 };
 
+/**
+ * Completion handler for connector operations which return before the data
+ * has been transmitted. It may be called from interrupt context, so it must
+ * not block; the most it should do is signal the owner of the buffer.
+ */
+typedef void
+(*mipi_io_done_cb)(
+	struct mipi_io_ctr * io_ctr,
+	mipi_err_T err,
+	void * cb_arg
+);
+
 /**
  * ========================
  *  MIPI DBI Panel Device
@@ -353,6 +517,111 @@ struct mipi_io_ctr {
  *
  * A device conformant with the MIPI DBI standard.
  */
+/**
+ * The address window last programmed into the panel, and the position of the
+ * panel's write pointer within it, in pixels from its first. Window updates
+ * which reuse the column or row range, or which pick up where the previous
+ * write left off, are sent without the commands which would repeat it.
+ */
+struct mipi_dbi_win_cache {
+  _Bool ca_valid, ra_valid, wp_valid;
+  struct mipi_area win;
+  size_t wr_pos;
+};
+
+struct mipi_dbi_win_stats {
+  uint32_t num_writes;
+  uint32_t num_caset_skipped, num_raset_skipped, num_ramwrc;
+  size_t cmd_bytes_saved;
+};
+
+/**
+ * Vertical scrolling state (see `mipi_dbi_set_scroll_area`). The panel shows
+ * its top `tfa` and bottom `bfa` rows in place, and the `vsa` rows between
+ * them starting from GRAM row `vsp`, wrapping around within the scroll area.
+ * `vsa` is 0 while scrolling is not in use.
+ */
+struct mipi_dbi_scroll {
+  uint16_t tfa, vsa, bfa;
+  uint16_t vsp;
+};
+
+/**
+ * Maximum number of windows a screen area maps to in GRAM while scrolled:
+ * the top fixed area, the scroll area on either side of its wrap, and the
+ * bottom fixed area.
+ */
+#define MIPI_DBI_SCROLL_MAX_AREAS 4
+
+/**
+ * Partial display mode (see `mipi_dbi_eval_ptl`). While `on`, only rows `sr`
+ * to `er` of the panel are driven; the rest show the panel's background and
+ * are not refreshed from GRAM, which saves both panel power and, with writes
+ * clipped to the area, bus traffic.
+ */
+struct mipi_dbi_ptl {
+  uint16_t sr, er;
+  _Bool on;
+  /**
+   * The panel enters partial mode once the active rows have spanned at most
+   * `max_rows` for `settle_evals` evaluations in a row; `max_rows` of 0
+   * disables it.
+   */
+  uint16_t max_rows;
+  uint8_t settle_evals, num_small_evals;
+  uint16_t act_y0, act_y1; // << rows noted since the last evaluation
+};
+
+/**
+ * Dithering of colors as they are down-converted to the IFPF of the panel:
+ * RGB565 if it has `cvt_to_ifpf`, and otherwise RGB666 (each component in
+ * the top six bits of its byte). Either mode works on the pixels in the
+ * order they are sent, so a frame may be converted a chunk at a time.
+ *
+ *  - `MIPI_DITHER_BAYER` adds the threshold of a 4x4 Bayer matrix, by the
+ *    position of the pixel on the panel, before truncating.
+ *  - `MIPI_DITHER_FS` diffuses the error of each pixel to its neighbours
+ *    (Floyd-Steinberg), alternating the direction of each row where a whole
+ *    row is converted at once. The errors carried to the next row are kept in
+ *    `err_row`, which is owned by the caller; it must hold `3*(w+2)` entries,
+ *    `w` being the width of the widest area written.
+ */
+enum mipi_dither_mode {
+  MIPI_DITHER_NONE,
+  MIPI_DITHER_BAYER,
+  MIPI_DITHER_FS
+};
+
+struct mipi_dither {
+  enum mipi_dither_mode mode;
+  uint8_t bytes_per_px; // << 2 for RGB565, 3 for RGB666; set on begin
+
+  /**
+   * Origin and width of the area being converted, and the position of the
+   * next pixel within it.
+   */
+  uint16_t x0, y0, w;
+  uint16_t x, y;
+  int8_t dir; // << of the current row, for `MIPI_DITHER_FS`
+
+  int16_t * err_row;
+  size_t err_row_len;
+  int16_t carry[3];                // << error passed to the next pixel
+  int16_t acc_prev[3], acc_cur[3]; // << errors bound for the row below
+};
+
+/**
+ * Time stamps (`_osal_get_time_us`) of the bring-up of the panel. On the
+ * Pico, the counter starts at reset, so they are measured from boot.
+ */
+struct mipi_dbi_boot_stats {
+  uint32_t init_begin_us, init_end_us;
+  uint32_t first_px_us; // << 0 until the first write of pixel data
+  size_t num_init_txns;
+};
+
+struct mipi_init_seq;
+
 struct mipi_dbi_dev {
 	// TODO: Allow for device-independent positioning using a unit system
 	// (precision yet to be specified) based on the physical dimensions of the
@@ -375,6 +644,37 @@ struct mipi_dbi_dev {
    * initialization has completed. (e.g. for gamma correction, etc.)
    */
   const uint8_t * panel_init_seq;
+  /**
+   * The same, framed at compile time (see `mipi_init_seq.h`); written in
+   * place of `panel_init_seq` if set.
+   */
+  const struct mipi_init_seq * init_seq;
+  struct mipi_dbi_boot_stats boot_stats;
+
+  /**
+   * Ping-pong staging for `mipi_stream_fmbf`. While one chunk is on the wire,
+   * the next is converted into the other, so that at most two chunks of the
+   * frame exist in the destination format at any given time.
+   */
+  struct dma_mem tx_chunk[2][MIPI_TX_CHUNK_SZ/sizeof(struct dma_mem)];
+
+  /**
+   * Commands sent by the device itself are encoded here rather than on the
+   * stack, so that any of them may be sent in one transaction.
+   */
+  struct mipi_dcs_stage cmd_stage;
+
+  /**
+   * See `mipi_dbi_write_area`. Anything written to the panel through `io`
+   * directly which moves the window or its write pointer (CASET, RASET,
+   * MADCTL, SWRST, a RAMWR of its own, etc.) must be followed by a call to
+   * `mipi_dbi_invalidate_win`.
+   */
+  struct mipi_dbi_win_cache win_cache;
+  struct mipi_dbi_win_stats win_stats;
+  struct mipi_dbi_scroll scroll;
+  struct mipi_dbi_ptl ptl;
+  struct mipi_dither dither;
 };
 
 
@@ -389,7 +689,7 @@ extern const struct mipi_ifpf MIPI_PANEL_FMT[];
  * fails, a client may catch the reason by interpreting this code.
  */
 extern const char * _MIPI_ERR_STRING[];
-volatile MIPI_OSAL_ATOMIC_INT mipi_err_code;
+extern volatile MIPI_OSAL_ATOMIC_INT mipi_err_code;
 
 
 /********************
@@ -413,6 +713,24 @@ mipi_init_dbi_dev (
 extern mipi_err_T
 mipi_free_dbi_dev (struct mipi_dev_handle_T dev);
 
+extern struct mipi_dbi_dev
+mipi_dbi_dev_create (
+  const char * panel_name,
+  uint width,
+  uint height,
+  enum mipi_color_fmt clr_fmt,
+  _IN const uint8_t panel_init_seq[]
+);
+
+/**
+ * Attaches `dev` to the connector `ctr` and writes its init sequence.
+ */
+extern void
+mipi_dbi_dev_init (
+  struct mipi_dbi_dev * dev,
+  struct mipi_io_ctr * ctr
+);
+
 extern _Bool
 mipi_lock_dev_blocking (
 	mipi_dev_handle_T dev_panel_hdl,
@@ -441,6 +759,319 @@ mipi_set_panel_output_ifpf (
 	enum mipi_color_fmt fmt
 );
 
+/**
+ * Writes `px_sz` bytes of pixel data, already in the output IFPF of the
+ * panel, to the window `bds`, framing the window commands and the data in
+ * one transaction.
+ *
+ * CASET and RASET are left out when they would set the range the panel
+ * already holds, and if `bds` starts on the row following the last pixel
+ * written to the current window (spanning the same columns and not passing
+ * its end), the data is sent with `RAMWRC` so that no window command is sent
+ * at all. The bytes this saves are counted in `dev->win_stats`.
+ *
+ * If the connector reports an error for the transaction, the window is
+ * forgotten (see `mipi_dbi_invalidate_win`) and the error is set in
+ * `mipi_err_code`.
+ */
+extern void
+mipi_dbi_write_area (
+	struct mipi_dbi_dev * dev,
+	const struct mipi_area bds,
+	_IN const uint8_t px_data[],
+	size_t px_sz
+);
+
+/**
+ * Writes the window `bds` from the pixel data in `spans` (see
+ * `flush_fmbf_vec`), without copying it. Errors are handled as for
+ * `mipi_dbi_write_area`.
+ */
+extern void
+mipi_dbi_write_area_vec (
+	struct mipi_dbi_dev * dev,
+	const struct mipi_area bds,
+	_IN byte_buffer_view_T spans[],
+	size_t num_spans
+);
+
+/**
+ * Fills `spans` with a view of each row of `bds` within the frame buffer
+ * `fmbf`, whose rows are `stride` bytes apart, for use with
+ * `mipi_dbi_write_area_vec`. `spans` must have room for `bds.h` views.
+ * Returns the number of spans.
+ */
+extern size_t
+mipi_fmbf_rect_spans (
+	_IN uint8_t fmbf[],
+	size_t stride,
+	size_t bytes_per_px,
+	const struct mipi_area bds,
+	_OUT byte_buffer_T spans[]
+);
+
+#ifndef MIPI_CLK_CAL_PATTERN_SZ
+#define MIPI_CLK_CAL_PATTERN_SZ MIPI_CMD_BUFF_SZ
+#endif
+
+/**
+ * Parameters of `mipi_calibrate_px_clk`. The rates tried are `start_hz`,
+ * `start_hz+step_hz`, ... up to `max_hz`, stopping at the first which fails.
+ *
+ * A rate passes if each of `num_trials` test patterns written to `win` at
+ * that rate reads back intact with RAMRD, which is always clocked at the
+ * rate of `MIPI_IO_PHASE_RD`. The contents of `win` on the panel are lost.
+ * `win` is kept small, as it is read back in a single RAMRD: its area times
+ * either of the sizes of a pixel must not exceed `MIPI_CLK_CAL_PATTERN_SZ`.
+ *
+ * Many panels return more bytes per pixel on RAMRD than they take on RAMWR
+ * (eg. RGB565 written, RGB666 read back). For these, `px_match` compares the
+ * two; otherwise the data read must match that written byte for byte.
+ */
+struct mipi_clk_cal_cfg {
+  uint32_t start_hz, max_hz, step_hz;
+  uint8_t num_trials;
+  /**
+   * Steps to back off from the highest rate which passed, as a margin for
+   * temperature and supply variation.
+   */
+  uint8_t margin_steps;
+  struct mipi_area win;
+  uint8_t wr_bytes_per_px, rd_bytes_per_px;
+
+  _Bool
+  (*px_match)(
+    _IN const uint8_t wr_px[],
+    _IN const uint8_t rd_px[],
+    size_t num_px,
+    void * arg
+  );
+  void * px_match_arg;
+};
+
+struct mipi_clk_cal_result {
+  uint32_t px_hz;       // << rate set for `MIPI_IO_PHASE_PX`, 0 if none passed
+  uint32_t max_pass_hz; // << highest rate which passed, before the margin
+  uint32_t fail_hz;     // << first rate which failed, 0 if none did
+  uint8_t id[3];        // << RDDID, as read before calibrating
+  uint32_t num_rates;
+};
+
+/**
+ * Finds the highest pixel clock at which the panel behind `io` reliably
+ * accepts data, and sets it for `MIPI_IO_PHASE_PX`. RDDID is read before
+ * and after each rate; a change in it is treated as a failure, as the panel
+ * may have taken corrupted data for a command.
+ *
+ * Returns `MIPI_ERR_OP_NOT_IMPL` if the connector cannot set its clock or
+ * read from the panel, and `MIPI_ERR_IO` if no rate passed.
+ */
+extern mipi_err_T
+mipi_calibrate_px_clk (
+	struct mipi_io_ctr * io,
+	_IN const struct mipi_clk_cal_cfg * cfg,
+	_OUT struct mipi_clk_cal_result * res
+);
+
+/**
+ * Reads `px_sz` bytes of the window `bds` back from panel GRAM with RAMRD,
+ * from its first pixel. `mipi_dbi_read_area_cont` continues the same read
+ * with RAMRDC, so that a region may be fetched a few rows at a time, eg. to
+ * blend onto it without keeping a copy of the whole frame in RAM.
+ *
+ * The data comes back in the format the panel reads out in, which is not
+ * necessarily that it is written in; many panels return 3 bytes per pixel
+ * over SPI even when written RGB565.
+ *
+ * Returns `MIPI_ERR_IO` if the window could not be set (it is then
+ * forgotten, see `mipi_dbi_invalidate_win`) or fewer bytes were read.
+ */
+extern mipi_err_T
+mipi_dbi_read_area (
+	struct mipi_dbi_dev * dev,
+	const struct mipi_area bds,
+	_OUT uint8_t px_data[],
+	size_t px_sz
+);
+
+extern mipi_err_T
+mipi_dbi_read_area_cont (
+	struct mipi_dbi_dev * dev,
+	_OUT uint8_t px_data[],
+	size_t px_sz
+);
+
+/**
+ * Forgets the window held by the panel, so that the next update sends it in
+ * full.
+ */
+extern void
+mipi_dbi_invalidate_win (struct mipi_dbi_dev * dev);
+
+/**
+ * Sets up vertical scrolling with VSCRDEF, keeping the top `tfa` and bottom
+ * `bfa` rows of the panel fixed, and resets the scroll position. Passing `0`
+ * for both scrolls the whole panel. Rows are those of the panel's scan, so
+ * with `SWAP_XY` set in MADCTL the panel scrolls horizontally instead.
+ *
+ * Scrolling moves what the panel shows, not GRAM. While scrolled, screen
+ * coordinates must be mapped to GRAM with `mipi_dbi_scroll_map_row` or
+ * `mipi_dbi_scroll_map_area` before being written.
+ */
+extern mipi_err_T
+mipi_dbi_set_scroll_area (
+	struct mipi_dbi_dev * dev,
+	uint16_t tfa,
+	uint16_t bfa
+);
+
+/**
+ * Scrolls the contents of the scroll area up by `rows` (down, if negative)
+ * with VSCRSADD. The rows which scroll into view hold what scrolled out of it
+ * on the other side, and must be redrawn; their bounds, in screen
+ * coordinates, are returned in `exposed` if it is not `NULL`.
+ */
+extern mipi_err_T
+mipi_dbi_scroll (
+	struct mipi_dbi_dev * dev,
+	int rows,
+	_OUT struct mipi_area * exposed
+);
+
+extern uint16_t
+mipi_dbi_scroll_map_row (
+	const struct mipi_dbi_dev * dev,
+	uint16_t y
+);
+
+/**
+ * Maps the screen area `bds` to the windows of GRAM which the panel shows
+ * there, merging those which are adjacent, and returns how many there are.
+ * `out` must have room for `MIPI_DBI_SCROLL_MAX_AREAS`.
+ */
+extern size_t
+mipi_dbi_scroll_map_area (
+	const struct mipi_dbi_dev * dev,
+	const struct mipi_area bds,
+	_OUT struct mipi_area out[]
+);
+
+/**
+ * Drives only rows `sr` to `er` of the panel (PTLAR, PTLON), or all of them
+ * again (NORON). Rows are those of the panel's scan, not of the screen.
+ */
+extern mipi_err_T
+mipi_dbi_set_partial_area (
+	struct mipi_dbi_dev * dev,
+	uint16_t sr,
+	uint16_t er
+);
+
+extern mipi_err_T
+mipi_dbi_set_normal_mode (struct mipi_dbi_dev * dev);
+
+/**
+ * Sets the policy of `mipi_dbi_eval_ptl` (see `struct mipi_dbi_ptl`). If it
+ * is disabled while the panel is in partial mode, the panel is returned to
+ * normal mode at once and `true` is returned; as with
+ * `mipi_dbi_note_active_rows`, the caller must rewrite the whole screen.
+ */
+extern _Bool
+mipi_dbi_set_ptl_policy (
+	struct mipi_dbi_dev * dev,
+	uint16_t max_rows,
+	uint8_t settle_evals
+);
+
+/**
+ * Notes that rows `y` to `y+h-1` hold content to be shown. If the panel is
+ * in partial mode and any of them lie outside of the partial area, it is
+ * returned to normal mode at once and `true` is returned: rows written while
+ * it was partial were clipped (see `mipi_dbi_clip_to_ptl`), so the caller
+ * must rewrite the whole screen.
+ */
+extern _Bool
+mipi_dbi_note_active_rows (
+	struct mipi_dbi_dev * dev,
+	uint16_t y,
+	uint16_t h
+);
+
+/**
+ * Applies the partial mode policy to the rows noted since the last call,
+ * typically once per frame, and forgets them. Returns `true` if the mode or
+ * the partial area changed. The policy is not applied while a scroll area is
+ * set up (see `mipi_dbi_set_scroll_area`).
+ */
+extern _Bool
+mipi_dbi_eval_ptl (struct mipi_dbi_dev * dev);
+
+/**
+ * Clips the rows of `bds` to the partial area, if the panel is in partial
+ * mode. Returns `false` if nothing of `bds` is left to write.
+ */
+extern _Bool
+mipi_dbi_clip_to_ptl (
+	const struct mipi_dbi_dev * dev,
+	_IN _OUT struct mipi_area * bds
+);
+
+/**
+ * Sets the dithering applied by `mipi_stream_fmbf` (see `mipi_dither`);
+ * `err_row` is only needed for `MIPI_DITHER_FS`, and must outlive its use.
+ */
+extern mipi_err_T
+mipi_dbi_set_dither (
+	struct mipi_dbi_dev * dev,
+	enum mipi_dither_mode mode,
+	int16_t err_row[],
+	size_t err_row_len
+);
+
+/**
+ * Starts the conversion of the area `bds` to `ifpf`, that of the panel. If
+ * `bds` lies directly below the area last converted, spanning the same
+ * columns, the errors carried by `MIPI_DITHER_FS` are kept, so a frame sent
+ * as bands of rows is dithered as it would be in one piece.
+ */
+extern mipi_err_T
+mipi_dither_begin (
+	struct mipi_dither * dither,
+	const struct mipi_ifpf * ifpf,
+	const struct mipi_area bds
+);
+
+/**
+ * Converts the next `num_px` pixels of the area, in row-major order, into
+ * `out`. Only as many whole pixels as fit in `out_sz` are converted; returns
+ * the number of bytes written.
+ */
+extern size_t
+mipi_dither_cvt (
+	struct mipi_dither * dither,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz
+);
+
+/**
+ * Converts the colors in `clr_buff` to the output IFPF of the panel and
+ * transmits them to the window `bds`, overlapping the conversion of each
+ * chunk with the transmission of the one before it. `clr_buff` must hold
+ * `bds.w*bds.h` colors in row-major order and must not be modified until
+ * this function returns.
+ *
+ * If the connector does not implement streaming, `MIPI_ERR_OP_NOT_IMPL` is
+ * returned and nothing is sent.
+ */
+extern mipi_err_T
+mipi_stream_fmbf (
+	struct mipi_dbi_dev * dev,
+	_IN const struct mipi_color clr_buff[],
+	const struct mipi_area bds
+);
+
 
 /********************
  * Inline Functions
@@ -448,21 +1079,23 @@ mipi_set_panel_output_ifpf (
 
 static __force_inline size_t
 _ifpf_cvt_rgb565 (
-  struct mipi_ifpf * self,
-  _IN struct mipi_color clr[],
-  _OUT u8 * clr_buff[],
-  size_t buff_sz )
+  const struct mipi_ifpf * self,
+  _IN const struct mipi_color in[],
+  size_t num_px,
+  _OUT uint8_t out[],
+  size_t out_sz )
 {
-	(*clr_buff)=calloc (
-		buff_sz*(self->bytes_per_px),
-		1
-	);
-  for (size_t i=0; i<buff_sz; i++) {
-    struct mipi_color c=clr[i];
-    (*clr_buff)[i]  =(c.b&0xf8)^(c.g>>5);
-    (*clr_buff)[i+1]=((c.g&0x1c)<<3)^(c.r>>3);
+  (void)self;
+  if (num_px>out_sz/2)
+    num_px=out_sz/2;
+
+  for (size_t i=0; i<num_px; i++) {
+    const struct mipi_color c=in[i];
+
+    out[2*i]  =(c.b&0xf8)|(c.g>>5);
+    out[2*i+1]=((c.g&0x1c)<<3)|(c.r>>3);
   }
-  return sizeof(*clr_buff);
+  return 2*num_px;
 }
 
 #ifdef __cplusplus
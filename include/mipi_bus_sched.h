@@ -0,0 +1,119 @@
+/**
+ * ========================
+ *     mipi_bus_sched.h
+ * ========================
+ *
+ * Arbitration of a bus shared by several panels, each with a chip select of
+ * its own (see `mipi_create_spi_ctr_on_bus`). Every panel is fed through a
+ * transaction queue; the scheduler is the drain owner of all of them and
+ * takes turns between the ports, so that a full-screen update of one panel
+ * does not hold the others off the bus for the length of a frame.
+ *
+ * A turn issues at most `quantum` bytes of pixel data. The first turn of a
+ * window sends CASET/RASET/RAMWR with it and each later turn continues with
+ * RAMWRC, which costs a single command byte; the address pointer of a panel
+ * is not disturbed by traffic to the others while its CS is released. If
+ * the connector fails a turn, the rest of the window is dropped and its
+ * callback given the error, rather than continued into a window the panel
+ * may never have accepted.
+ *
+ * There is only one data line, so the transfers themselves never overlap.
+ * What does is the time a panel spends in a delay (eg. the 120 ms after
+ * SLPOUT during its initialisation) and the framing of the next turn on the
+ * CPU, which proceed while another port has the bus.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-13
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_BUS_SCHED__
+#define __MIPI_BUS_SCHED__
+
+#include "mipi.h"
+#include "mipi_txq.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MIPI_BUS_SCHED_MAX_PORTS
+#define MIPI_BUS_SCHED_MAX_PORTS 4
+#endif
+
+struct mipi_bus_port {
+	struct mipi_txq * txq;
+
+	/**
+	 * Window being written over several turns; `cur_off` bytes of its pixel
+	 * data have been sent so far.
+	 */
+	struct mipi_txq_desc cur;
+	size_t cur_off;
+	_Bool has_cur;
+
+	_Bool in_delay;
+	uint32_t resume_at_ms;
+
+	size_t num_turns, num_px_bytes;
+};
+
+struct mipi_bus_sched {
+	struct mipi_bus_port ports[MIPI_BUS_SCHED_MAX_PORTS];
+	uint8_t num_ports;
+	uint8_t next_port, last_port;
+
+	/**
+	 * Pixel bytes issued per turn. Must be a multiple of the size of a pixel
+	 * on every port, as panels discard a partial pixel when CS is released.
+	 */
+	size_t quantum;
+
+	size_t num_turns, num_switches;
+};
+
+extern void
+mipi_bus_sched_init (
+	struct mipi_bus_sched * self,
+	size_t quantum
+);
+
+/**
+ * Adds a port fed by `txq`, returning its index or `-1` if there is no room.
+ * The connector of the queue must be on the shared bus, and the queue must
+ * no longer be drained by anything but the scheduler.
+ */
+extern int
+mipi_bus_sched_add (
+	struct mipi_bus_sched * self,
+	struct mipi_txq * txq
+);
+
+/**
+ * Gives each port which has work, in turn, one command or one quantum of
+ * pixel data, until all are idle or waiting out a delay, or `max_turns`
+ * turns have been issued. Returns the number of turns issued.
+ */
+extern size_t
+mipi_bus_sched_run (
+	struct mipi_bus_sched * self,
+	size_t max_turns
+);
+
+/**
+ * Returns `true`, and the time at which the earliest delay of any port
+ * ends in `at_ms`, if a port is waiting out a delay.
+ */
+extern _Bool
+mipi_bus_sched_next_deadline (
+	const struct mipi_bus_sched * self,
+	_OUT uint32_t * at_ms
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_BUS_SCHED__
@@ -0,0 +1,82 @@
+/**
+ * ========================
+ *        mipi_cvt.h
+ * ========================
+ *
+ * Kernels for the conversion of frame buffer colors to the IFPF of the panel.
+ * Each has the form of `mipi_ifpf::cvt_to_ifpf`, and produces the same bytes
+ * as the scalar reference, `_ifpf_cvt_rgb565`. The fastest available on the
+ * target is chosen by `mipi_cvt_init`:
+ *
+ *  - AVX2, where the CPU supports it at run time (x86 hosts);
+ *  - SSE2, on any x86-64 host;
+ *  - NEON, on ARM hosts built with it;
+ *  - SWAR, two pixels to a 32-bit word, for the Cortex-M0+ and anything
+ *    else little-endian.
+ *
+ * `MIPI_PANEL_FMT` converts to RGB565 through `mipi_cvt_rgb565`, which calls
+ * whichever was chosen.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-21
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_CVT__
+#define __MIPI_CVT__
+
+#include "mipi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef size_t
+(*mipi_cvt_fn)(
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz
+);
+
+struct mipi_cvt_kernel {
+	const char * name;
+	mipi_cvt_fn cvt_rgb565;
+	_Bool (*is_supported)(void); // << NULL if always supported
+};
+
+/**
+ * Chooses the kernel used by `mipi_cvt_rgb565`, and returns it. It is called
+ * by `mipi_dbi_dev_init`, or otherwise by the first conversion.
+ *
+ * With `MIPI_DBG_EN`, the kernel chosen is first checked against the scalar
+ * reference, over lengths which cover each of its tails; one which differs
+ * is reported and passed over.
+ */
+extern const struct mipi_cvt_kernel *
+mipi_cvt_init (void);
+
+/**
+ * Each kernel built for the target, fastest first, and the scalar reference
+ * last; those which the CPU does not support are listed too.
+ */
+extern const struct mipi_cvt_kernel MIPI_CVT_KERNELS[];
+extern const size_t MIPI_NUM_CVT_KERNELS;
+
+extern size_t
+mipi_cvt_rgb565 (
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_CVT__
@@ -0,0 +1,174 @@
+/**
+ * ========================
+ *      mipi_dbi_i80.h
+ * ========================
+ *
+ * MIPI DBI type B device, Intel 8080-series parallel interface, with an 8 or
+ * 16-bit data bus.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-06
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_DBI_I80__
+#define __MIPI_DBI_I80__
+
+#include "mipi.h"
+#include "osal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/********************
+ * Global Constants
+ *******************/
+
+/**
+ * Write and read cycle times (tWC, tRC) which are safe for the majority of
+ * DBI type B controllers. Refer to the AC characteristics of the panel; most
+ * accept much shorter write cycles, but reads are generally several times
+ * slower.
+ */
+#define _I80_DEF_WR_CYCLE_NS 66
+#define _I80_DEF_RD_CYCLE_NS 450
+
+extern const struct mipi_io_ctr _MIPI_I80_CTR_FUNCS;
+
+
+/********************
+ *      Types
+ *******************/
+
+enum mipi_i80_bus_width {
+  MIPI_I80_BUS_8_BIT=8,
+  MIPI_I80_BUS_16_BIT=16
+};
+
+struct mipi_i80_ctr {
+  struct mipi_io_ctr io; /* BASE */
+  struct _osal_i80_bus * bus;
+  enum mipi_i80_bus_width bus_width;
+  _osal_gpio_pin_T data_base, wr, rd, dcx, cs;
+  uint32_t wr_cycle_ns, rd_cycle_ns;
+
+  mipi_osal_mtx_T bus_mtx;
+  int dma_chan; // << -1 when no channel is claimed
+  _Bool in_fmbf_stream;
+  /**
+   * On a 16-bit bus, the last byte of a chunk of pixel data which did not
+   * fill a WR cycle, held back to be sent with the first byte of the next.
+   */
+  uint8_t px_carry;
+  _Bool has_px_carry;
+  /**
+   * In the case that a transaction fails, this flag is set to the relevant
+   * error code(s), as with `mipi_spi_ctr`.
+   */
+  int errno;
+};
+
+
+/********************
+ * Global Functions
+ *******************/
+
+/**
+ * D0 through D7 (or D15) must be consecutive GPIO, starting at `data_base`.
+ */
+extern struct mipi_i80_ctr
+mipi_create_i80_ctr (
+  enum mipi_i80_bus_width bus_width,
+  _osal_gpio_pin_T data_base,
+  _osal_gpio_pin_T wr,
+  _osal_gpio_pin_T rd,
+  _osal_gpio_pin_T cs,
+  _osal_gpio_pin_T dcx
+);
+
+extern void
+mipi_init_i80_ctr (struct mipi_i80_ctr * self);
+
+extern void
+mipi_free_i80_ctr (struct mipi_i80_ctr * self);
+
+/**
+ * Overrides the default WR/RD cycle times. Must be called before
+ * `mipi_init_i80_ctr`.
+ */
+extern void
+mipi_i80_set_timing_ns (
+  struct mipi_i80_ctr * self,
+  uint32_t wr_cycle_ns,
+  uint32_t rd_cycle_ns
+);
+
+extern void
+mipi_i80_send_cmd (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t params[],
+  size_t len
+);
+
+extern void
+mipi_i80_write_txn (
+  struct mipi_io_ctr * self,
+  _IN const struct mipi_io_txn_seg segs[],
+  size_t num_segs,
+  _IN const uint8_t px_data[],
+  size_t px_sz
+);
+
+extern ssize_t
+mipi_i80_recv_params (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _OUT uint8_t params[],
+  size_t len
+);
+
+extern void
+mipi_i80_flush_fmbf (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t pix_buff[],
+  const struct mipi_area bounds,
+  size_t len
+);
+
+extern void
+mipi_i80_flush_fmbf_vec (
+  struct mipi_io_ctr * self,
+  _IN byte_buffer_view_T spans[],
+  size_t num_spans,
+  const struct mipi_area bounds
+);
+
+extern mipi_err_T
+mipi_i80_begin_fmbf_stream (
+  struct mipi_io_ctr * self,
+  const struct mipi_area bounds
+);
+
+extern mipi_err_T
+mipi_i80_write_fmbf_chunk (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t chunk[],
+  size_t len
+);
+
+extern void
+mipi_i80_end_fmbf_stream (struct mipi_io_ctr * self);
+
+extern mipi_err_T
+mipi_i80_take_err (struct mipi_io_ctr * self);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_DBI_I80__
@@ -0,0 +1,191 @@
+/**
+ * ========================
+ *     mipi_dbi_qspi.h
+ * ========================
+ *
+ * DBI controllers with a dual or quad-SPI interface (eg. as found on AMOLED
+ * panels). There is no DCX line; instead, every command is sent in a frame
+ * of its own, prefixed by an instruction byte and a 24-bit address whose
+ * middle byte is the DCS command, all on D0:
+ *
+ *   CS low | instr | 0x00 | cmd | 0x00 | data ... | CS high
+ *
+ * The instruction selects the width of the data phase. Commands and their
+ * parameters are written on a single line, and pixel data (following RAMWR
+ * or RAMWRC) on two or four, which is where the bandwidth is needed.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-15
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_DBI_QSPI__
+#define __MIPI_DBI_QSPI__
+
+#include "mipi.h"
+#include "osal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/********************
+ * Global Constants
+ *******************/
+
+/**
+ * Instructions understood by the majority of these controllers; see
+ * `mipi_qspi_set_instr` for those which differ. The pixel instruction sends
+ * the header on one line and the data on all of them ("1-1-4").
+ */
+#define MIPI_QSPI_WR_INSTR 0x02
+#define MIPI_QSPI_RD_INSTR 0x03
+#define MIPI_QSPI_PX_INSTR 0x32
+
+#define _QSPI_DEF_SCK_HZ      40000000u
+#define _QSPI_DEF_RD_CYCLE_NS 150
+
+extern const struct mipi_io_ctr _MIPI_QSPI_CTR_FUNCS;
+
+
+/********************
+ *      Types
+ *******************/
+
+enum mipi_qspi_lanes {
+  MIPI_QSPI_DUAL=2,
+  MIPI_QSPI_QUAD=4
+};
+
+struct mipi_qspi_ctr {
+  struct mipi_io_ctr io; /* BASE */
+  struct _osal_qspi_bus * bus;
+  enum mipi_qspi_lanes px_lanes;
+  _osal_gpio_pin_T data_base, sck, cs;
+  uint32_t sck_hz, rd_cycle_ns;
+  uint8_t wr_instr, rd_instr, px_instr;
+
+  mipi_osal_mtx_T bus_mtx;
+  int dma_chan; // << -1 when no channel is claimed
+  _Bool in_fmbf_stream;
+  /**
+   * In the case that a transaction fails, this flag is set to the relevant
+   * error code(s), as with `mipi_spi_ctr`.
+   */
+  int errno;
+};
+
+
+/********************
+ * Global Functions
+ *******************/
+
+/**
+ * D0 through D1 (or D3) must be consecutive GPIO, starting at `data_base`.
+ */
+extern struct mipi_qspi_ctr
+mipi_create_qspi_ctr (
+  enum mipi_qspi_lanes px_lanes,
+  _osal_gpio_pin_T data_base,
+  _osal_gpio_pin_T sck,
+  _osal_gpio_pin_T cs
+);
+
+extern void
+mipi_init_qspi_ctr (struct mipi_qspi_ctr * self);
+
+extern void
+mipi_free_qspi_ctr (struct mipi_qspi_ctr * self);
+
+/**
+ * Overrides the default SCK frequency of writes and the SCK period of
+ * reads. Must be called before `mipi_init_qspi_ctr`.
+ */
+extern void
+mipi_qspi_set_timing (
+  struct mipi_qspi_ctr * self,
+  uint32_t sck_hz,
+  uint32_t rd_cycle_ns
+);
+
+/**
+ * Overrides the instructions which prefix each frame, for controllers which
+ * do not use the defaults (in particular, the pixel instruction of those on
+ * a dual-line bus varies between vendors).
+ */
+extern void
+mipi_qspi_set_instr (
+  struct mipi_qspi_ctr * self,
+  uint8_t wr_instr,
+  uint8_t rd_instr,
+  uint8_t px_instr
+);
+
+extern void
+mipi_qspi_send_cmd (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t params[],
+  size_t len
+);
+
+extern void
+mipi_qspi_write_txn (
+  struct mipi_io_ctr * self,
+  _IN const struct mipi_io_txn_seg segs[],
+  size_t num_segs,
+  _IN const uint8_t px_data[],
+  size_t px_sz
+);
+
+extern ssize_t
+mipi_qspi_recv_params (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _OUT uint8_t params[],
+  size_t len
+);
+
+extern void
+mipi_qspi_flush_fmbf (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t pix_buff[],
+  const struct mipi_area bounds,
+  size_t len
+);
+
+extern void
+mipi_qspi_flush_fmbf_vec (
+  struct mipi_io_ctr * self,
+  _IN byte_buffer_view_T spans[],
+  size_t num_spans,
+  const struct mipi_area bounds
+);
+
+extern mipi_err_T
+mipi_qspi_begin_fmbf_stream (
+  struct mipi_io_ctr * self,
+  const struct mipi_area bounds
+);
+
+extern mipi_err_T
+mipi_qspi_write_fmbf_chunk (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t chunk[],
+  size_t len
+);
+
+extern void
+mipi_qspi_end_fmbf_stream (struct mipi_io_ctr * self);
+
+extern mipi_err_T
+mipi_qspi_take_err (struct mipi_io_ctr * self);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_DBI_QSPI__
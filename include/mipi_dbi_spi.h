@@ -16,8 +16,8 @@
 #ifndef __MIPI_DBI_SPI__
 #define __MIPI_DBI_SPI__
 
-#include <pico/mutex.h>
-#include <hardware/spi.h>
+#include <stdatomic.h>
+
 #include "mipi.h"
 #include "osal.h"
 
@@ -32,19 +32,33 @@ extern "C" {
 
 #define _SPI_ACTIVE_STATE ((_Bool)0)
 
-#define _SPI_BEGIN_TX(_spi_dev)                          \
-  _osal_spi_dev_lock_timeout_ms (_spi_dev, MIPI_MAX_TM); \
-  _osal_set_gpio_pin_state (                             \
-    _spi_dev->cs,                                        \
-    _SPI_ACTIVE_STATE                                    \
-  );
+/**
+ * Takes ownership of the bus and asserts the chip select of the connector.
+ * Evaluates to `false` if the lock could not be acquired in time, or a DMA
+ * transfer left on the bus did not complete in time, in which case no pin
+ * state has been changed.
+ */
+#define _SPI_BEGIN_TX(_spi_ctr)                     \
+  (mipi_lock_spi_dev_timeout_ms (                   \
+     (_spi_ctr)->spi_dev,                           \
+     MIPI_MAX_TM                                    \
+   )                                                \
+   ? (_osal_set_gpio_pin_state (                    \
+        (_spi_ctr)->cs,                             \
+        _SPI_ACTIVE_STATE                           \
+      ), true)                                      \
+   : false)
 
-#define _SPI_END_TX(_spi_dev)                   \
-  _osal_spi_dev_unlock (_spi_dev);              \
+/**
+ * CS must be released before the bus is, else another connector sharing the
+ * bus could assert its own while this one is still selected.
+ */
+#define _SPI_END_TX(_spi_ctr)                   \
   _osal_set_gpio_pin_state (                    \
-    _spi_dev->cs,                               \
-    ~(_SPI_ACTIVE_STATE)                        \
-  );
+    (_spi_ctr)->cs,                             \
+    !(_SPI_ACTIVE_STATE)                        \
+  );                                            \
+  mipi_unlock_spi_dev ((_spi_ctr)->spi_dev);
 
 /********************
  * Global Constants
@@ -55,7 +69,16 @@ extern "C" {
  * for the Pico, and the SPI port is defined for `pico_runtime`.
  */
 #define _SPI_DEF_BD 32*1000*1000 /* 32 MHz */
-#define MIPI_SPI_DEFAULT_PORT (spi_inst_t *)spi0
+/**
+ * Register writes and reads are clocked conservatively by default; most
+ * panels specify a much longer read cycle than write cycle. Pixel data goes
+ * out at `_SPI_DEF_BD`, unless calibrated (see `mipi_calibrate_px_clk`).
+ */
+#define _SPI_DEF_CMD_BD 10*1000*1000 /* 10 MHz */
+#define _SPI_DEF_RD_BD  6*1000*1000  /* 6 MHz */
+#define _SPI_DEF_RD_DUMMY_BITS     1
+#define _SPI_DEF_RAM_RD_DUMMY_BITS 8
+#define MIPI_SPI_DEFAULT_PORT (struct _osal_spi_dev *)spi0
 #define MIPI_SPI_DEFAULT_MOSI_PIN 19
 #define MIPI_SPI_DEFAULT_MISO_PIN 16
 #define MIPI_SPI_DEFAULT_SCK_PIN  18
@@ -70,16 +93,59 @@ extern const struct mipi_io_ctr _MIPI_SPI_CTR_FUNCS;
  *******************/
 
 struct _mipi_spi_dev {
-  const spi_inst_t * spi; // << FIXME: const _osal_spi_dev_T * spi_inst
+  struct _osal_spi_dev * spi;
   const _osal_gpio_pin_T sck, mosi, miso;
-  _osal_mutex_T spi_mtx;
+  /**
+   * The lock is only ever taken and released by the thread running a
+   * transaction. A DMA transfer outlives the call which started it, so
+   * rather than keeping the lock, that call leaves `dma_in_prog` set (and CS
+   * asserted) when it lets go of it; the completion handler clears it, and
+   * whoever takes the lock next waits for it to be cleared before touching
+   * the bus (see `mipi_lock_spi_dev_timeout_ms`).
+   */
+  mipi_osal_mtx_T spi_mtx;
+  atomic_bool dma_in_prog;
+  uint32_t cur_hz; // << as last requested; the bus may be shared
   const size_t buff_sz;
   uint8_t * tx_buff, * rx_buff;
+  /**
+   * Number of connectors created on the bus; it is brought up by the first
+   * of them to be initialised and released with the last.
+   */
+  uint8_t num_ctrs;
+  _Bool is_init;
+};
+
+/**
+ * In `MIPI_SPI_FLUSH_DMA` mode, `flush_fmbf` arms a DMA channel and returns
+ * immediately. CS stays asserted, and no other transaction is started on the
+ * bus, until the transfer has completed, at which point `io.wt_in_prog` is
+ * cleared and the callback registered with `mipi_spi_set_flush_mode` is
+ * invoked with the error state of the connector. The pixel buffer MUST NOT
+ * be modified or freed before then.
+ */
+enum mipi_spi_flush_mode {
+  MIPI_SPI_FLUSH_BLOCKING,
+  MIPI_SPI_FLUSH_DMA
 };
 
 struct mipi_spi_ctr {
   struct mipi_io_ctr io; /* BASE */
   struct _mipi_spi_dev * spi_dev;
+  _osal_gpio_pin_T cs, dcx;
+
+  uint32_t phase_hz[MIPI_IO_NUM_PHASES];
+  /**
+   * Dummy clock cycles between the command and the data of a read. On the
+   * serial interface, reads of a single byte have none, longer register
+   * reads (eg. RDDID, RDDST) typically one, and RAMRD/RAMRDC a full byte.
+   */
+  uint8_t rd_dummy_bits, ram_rd_dummy_bits;
+  enum mipi_spi_flush_mode flush_mode;
+  int dma_chan; // << -1 when no channel is claimed
+  mipi_io_done_cb flush_done_cb;
+  void * flush_cb_arg;
+  _Bool in_fmbf_stream; // << bus is held between `begin`/`end_fmbf_stream`
   /**
    * In the case that a transaction fails, this flag is set to the relevant
    * error code(s). It is the responsibility of the caller of these interface
@@ -95,12 +161,46 @@ struct mipi_spi_ctr {
 
 extern struct mipi_spi_ctr
 mipi_create_spi_ctr (
-  spi_inst_t * spi,
-  uint sck,
-  uint mosi,
-  uint miso,
-  uint cs,
-  uint dcx
+  struct _osal_spi_dev * spi,
+  _osal_gpio_pin_T sck,
+  _osal_gpio_pin_T mosi,
+  _osal_gpio_pin_T miso,
+  _osal_gpio_pin_T cs,
+  _osal_gpio_pin_T dcx
+);
+
+/**
+ * Several panels may share SCK, MOSI and MISO, each with a CS and DCX of its
+ * own. Create the bus once and a connector for each panel on it; the bus
+ * lock serialises their transactions (see `mipi_bus_sched` to interleave
+ * them at a finer grain than a whole frame).
+ *
+ * `mipi_create_spi_ctr` is shorthand for a bus with a single connector.
+ */
+extern struct _mipi_spi_dev *
+mipi_create_spi_bus (
+  struct _osal_spi_dev * spi,
+  _osal_gpio_pin_T sck,
+  _osal_gpio_pin_T mosi,
+  _osal_gpio_pin_T miso
+);
+
+extern struct mipi_spi_ctr
+mipi_create_spi_ctr_on_bus (
+  struct _mipi_spi_dev * spi_dev,
+  _osal_gpio_pin_T cs,
+  _osal_gpio_pin_T dcx
+);
+
+/**
+ * Brings the bus up at `hz`, unless a connector on it already has. Called by
+ * `mipi_init_spi_ctr`; other connectors which share the bus (eg. that of
+ * `mipi_dbi_spi9.h`) call it from their own.
+ */
+extern void
+mipi_init_spi_bus (
+  struct _mipi_spi_dev * spi_dev,
+  uint32_t hz
 );
 
 extern void
@@ -114,11 +214,31 @@ extern void
 mipi_spi_send_cmd (
   struct mipi_io_ctr * self,
   mipi_dcs_cmd_T cmd,
-  _IN uint8_t * buf,
+  _IN const uint8_t * buf,
   size_t len
 );
 
-extern size_t
+/**
+ * Writes the commands in `segs`, then `px_data` as the data phase of the
+ * last one, under a single CS assertion. In `MIPI_SPI_FLUSH_DMA` mode the
+ * trailing data is sent by DMA and completion is reported as for a flush.
+ */
+extern void
+mipi_spi_write_txn (
+  struct mipi_io_ctr * self,
+  _IN const struct mipi_io_txn_seg segs[],
+  size_t num_segs,
+  _IN const uint8_t * px_data,
+  size_t px_sz
+);
+
+/**
+ * Reads `len` bytes following `cmd`, after skipping the dummy clock cycles
+ * the panel inserts before them (see `mipi_spi_set_rd_dummy_bits`). The
+ * panel must be wired for reads, either on MISO or, for 3-wire panels, with
+ * SDA connected to both MOSI and MISO.
+ */
+extern ssize_t
 mipi_spi_recv_params (
   struct mipi_io_ctr * self,
   mipi_dcs_cmd_T cmd,
@@ -126,14 +246,90 @@ mipi_spi_recv_params (
   size_t len
 );
 
+extern void
+mipi_spi_set_rd_dummy_bits (
+  struct mipi_spi_ctr * self,
+  uint8_t reg_bits,
+  uint8_t ram_bits
+);
+
 extern void
 mipi_spi_flush_fmbf (
   struct mipi_io_ctr * self,
-  _IN mipi_dcs_cmd_T * buf,
+  _IN const mipi_dcs_cmd_T * buf,
   const struct mipi_area bounds,
   size_t len
 );
 
+/**
+ * In `MIPI_SPI_FLUSH_DMA` mode the spans are chained into a single DMA
+ * transfer; otherwise, or if the transfer cannot be set up, they are written
+ * one after another.
+ */
+extern void
+mipi_spi_flush_fmbf_vec (
+  struct mipi_io_ctr * self,
+  _IN byte_buffer_view_T spans[],
+  size_t num_spans,
+  const struct mipi_area bounds
+);
+
+extern mipi_err_T
+mipi_spi_begin_fmbf_stream (
+  struct mipi_io_ctr * self,
+  const struct mipi_area bounds
+);
+
+extern mipi_err_T
+mipi_spi_write_fmbf_chunk (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t * chunk,
+  size_t len
+);
+
+extern void
+mipi_spi_end_fmbf_stream (struct mipi_io_ctr * self);
+
+extern mipi_err_T
+mipi_spi_take_err (struct mipi_io_ctr * self);
+
+extern uint32_t
+mipi_spi_set_phase_clk (
+  struct mipi_io_ctr * self,
+  enum mipi_io_phase phase,
+  uint32_t hz
+);
+
+/**
+ * Selects how `mipi_spi_flush_fmbf` transmits pixel data. A DMA channel is
+ * claimed the first time DMA mode is requested; if none is available, the
+ * connector remains in blocking mode and `MIPI_ERR_RES_LOCKED` is set.
+ */
+extern void
+mipi_spi_set_flush_mode (
+  struct mipi_spi_ctr * self,
+  enum mipi_spi_flush_mode mode,
+  mipi_io_done_cb done_cb,
+  void * cb_arg
+);
+
+extern _Bool
+mipi_spi_flush_in_prog (struct mipi_spi_ctr * self);
+
+/**
+ * Blocks until an outstanding DMA flush has completed, returning `false` if
+ * it is still in progress after `ms` milliseconds.
+ */
+extern _Bool
+mipi_spi_wait_flush_ms (
+  struct mipi_spi_ctr * self,
+  uint32_t ms
+);
+
+/**
+ * Takes the lock of the bus, then waits out any DMA transfer still on it,
+ * both within `ms`.
+ */
 extern _Bool
 mipi_lock_spi_dev_timeout_ms (
   struct _mipi_spi_dev * dev,
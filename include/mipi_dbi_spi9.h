@@ -0,0 +1,179 @@
+/**
+ * ========================
+ *     mipi_dbi_spi9.h
+ * ========================
+ *
+ * MIPI DBI type C device, option 1: the 3-wire serial interface, on which
+ * there is no DCX line and the D/C flag is sent as a ninth bit ahead of each
+ * byte. The words are packed into bytes (see `mipi_spi9.h`), so that the
+ * panel may be driven by the same byte-wide peripheral, and the same bus,
+ * as the 4-wire connector of `mipi_dbi_spi.h`.
+ *
+ * Each transaction is encoded through a pair of staging buffers: while one
+ * is being sent by DMA, the next slice is encoded into the other, so that
+ * the bus is kept busy without the frame ever being expanded in full.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-16
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_DBI_SPI9__
+#define __MIPI_DBI_SPI9__
+
+#include "mipi.h"
+#include "mipi_dbi_spi.h"
+#include "mipi_spi9.h"
+#include "osal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/********************
+ * Global Constants
+ *******************/
+
+/**
+ * Each staging buffer holds a chunk of pixel data once encoded.
+ */
+#define MIPI_SPI9_STAGE_SZ MIPI_SPI9_ENC_SZ(MIPI_TX_CHUNK_SZ)
+
+extern const struct mipi_io_ctr _MIPI_SPI9_CTR_FUNCS;
+
+
+/********************
+ *      Types
+ *******************/
+
+struct mipi_spi9_ctr {
+  struct mipi_io_ctr io; /* BASE */
+  struct _mipi_spi_dev * spi_dev;
+  _osal_gpio_pin_T cs;
+
+  uint32_t phase_hz[MIPI_IO_NUM_PHASES];
+  uint8_t rd_dummy_bits, ram_rd_dummy_bits; // << as for `mipi_spi_ctr`
+  int dma_chan; // << -1 when no channel is claimed
+
+  struct mipi_spi9_enc enc;
+  uint8_t stage[2][MIPI_SPI9_STAGE_SZ];
+  uint8_t cur_stage;
+  size_t stage_len;
+  _Bool in_fmbf_stream;
+  /**
+   * In the case that a transaction fails, this flag is set to the relevant
+   * error code(s), as with `mipi_spi_ctr`.
+   */
+  int errno;
+};
+
+
+/********************
+ * Global Functions
+ *******************/
+
+extern struct mipi_spi9_ctr
+mipi_create_spi9_ctr (
+  struct _osal_spi_dev * spi,
+  _osal_gpio_pin_T sck,
+  _osal_gpio_pin_T mosi,
+  _osal_gpio_pin_T miso,
+  _osal_gpio_pin_T cs
+);
+
+extern struct mipi_spi9_ctr
+mipi_create_spi9_ctr_on_bus (
+  struct _mipi_spi_dev * spi_dev,
+  _osal_gpio_pin_T cs
+);
+
+extern void
+mipi_init_spi9_ctr (struct mipi_spi9_ctr * self);
+
+extern void
+mipi_free_spi9_ctr (struct mipi_spi9_ctr * self);
+
+extern void
+mipi_spi9_send_cmd (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t params[],
+  size_t len
+);
+
+extern void
+mipi_spi9_write_txn (
+  struct mipi_io_ctr * self,
+  _IN const struct mipi_io_txn_seg segs[],
+  size_t num_segs,
+  _IN const uint8_t px_data[],
+  size_t px_sz
+);
+
+/**
+ * The command word, the dummy cycles and the data are clocked in a single
+ * transfer, of at most `MIPI_SPI9_STAGE_SZ` bytes. As for 3-wire reads on
+ * `mipi_spi_ctr`, SDA must be wired to both MOSI and MISO.
+ */
+extern ssize_t
+mipi_spi9_recv_params (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _OUT uint8_t params[],
+  size_t len
+);
+
+extern void
+mipi_spi9_flush_fmbf (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t pix_buff[],
+  const struct mipi_area bounds,
+  size_t len
+);
+
+extern void
+mipi_spi9_flush_fmbf_vec (
+  struct mipi_io_ctr * self,
+  _IN byte_buffer_view_T spans[],
+  size_t num_spans,
+  const struct mipi_area bounds
+);
+
+extern mipi_err_T
+mipi_spi9_begin_fmbf_stream (
+  struct mipi_io_ctr * self,
+  const struct mipi_area bounds
+);
+
+/**
+ * The chunk is encoded before this returns, so its buffer may be reused
+ * immediately.
+ */
+extern mipi_err_T
+mipi_spi9_write_fmbf_chunk (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t chunk[],
+  size_t len
+);
+
+extern void
+mipi_spi9_end_fmbf_stream (struct mipi_io_ctr * self);
+
+extern mipi_err_T
+mipi_spi9_take_err (struct mipi_io_ctr * self);
+
+extern uint32_t
+mipi_spi9_set_phase_clk (
+  struct mipi_io_ctr * self,
+  enum mipi_io_phase phase,
+  uint32_t hz
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_DBI_SPI9__
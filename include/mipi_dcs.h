@@ -86,6 +86,7 @@ extern "C" {
 #define VMOFCTRL  0xC7
 #define WRID2     0xD1
 #define WRID3     0xD2
+#define RDID4     0xD3 /* ILI93xx: IC part number */
 #define NVFCTRL1  0xD9
 #define NVFCTRL2  0xDE
 #define NVFCTRL3  0xDF
@@ -115,83 +116,262 @@ extern "C" {
 #define PIXEL_ORDER_BGR     1<<5
 #define PIXEL_ORDER_RGB     0<<5
 
-struct mipi_dcs_cmd {
-  uint code_pt;
-  ssize_t nargs;
-  uint8_t * params;
-};
+/**
+ * Packs the parameters of a CASET or RASET command: the first and last
+ * column (or row) of the window, inclusive, each big-endian.
+ */
+static __force_inline void
+_mipi_dcs_pack_addr (
+  _OUT uint8_t params[4],
+  uint16_t addr_start,
+  uint16_t addr_end )
+{
+  params[0]=(uint8_t)(addr_start>>8);
+  params[1]=(uint8_t)addr_start;
+  params[2]=(uint8_t)(addr_end>>8);
+  params[3]=(uint8_t)addr_end;
+}
 
 static size_t
-_mipi_dcs_get_seq_len (_IN_ u8 mipi_dcs_seq[]);
+_mipi_dcs_get_seq_len (_IN const uint8_t mipi_dcs_seq[]);
 
 /**
  * Writes the given initialization commands in the format specified above to a
- * panel over the given `mipi_io_ctr`.
+ * panel over the given `mipi_io_ctr`: each command is followed by the number
+ * of its parameters, with `MIPI_DELAY` set if the parameters are followed by
+ * a delay in milliseconds. Each command is a transaction of its own, and the
+ * delays are slept through here; see `mipi_init_seq.h` for sequences framed
+ * ahead of time. Stops at the first command the connector fails, returning
+ * `-1` with its error added to `mipi_err_code`.
  */
 static ssize_t
 _mipi_dcs_write_seq (
   struct mipi_io_ctr * io_ctr,
-  u8 init_seq[] )
+  const u8 init_seq[] )
 {
+  size_t i=0;
+
   if (!io_ctr || !init_seq) {
-		mipi_err_code|=MIPI_ERR_INV;
+    mipi_err_code|=MIPI_ERR_INV;
     return -1;
   }
+  // Errors left from before belong to no command of the sequence.
+  if (io_ctr->take_err)
+    mipi_err_code|=io_ctr->take_err (io_ctr);
 
-  while (true) {
-    size_t i=0;
-
-    if (init_seq[i]==END_DCS_SEQ) {
-      return i;
-    } else {
-      // Get number of parameters to write.
-      uint8_t num_params=init_seq[++i];
-      uint8_t * params=(init_seq+i);
-
-      io_ctr->write_panel_reg (
-        io_ctr,
-        init_seq[i],
-        params,
-        num_params
-      );
-      i+=num_params;
+  while (init_seq[i]!=END_DCS_SEQ) {
+    const u8 cmd=init_seq[i++];
+    const u8 num_params=(u8)(init_seq[i] & ~(MIPI_DELAY));
+    const _Bool has_delay=init_seq[i++] & (MIPI_DELAY);
+    mipi_err_T err;
+
+    io_ctr->write_panel_reg (io_ctr, cmd, init_seq+i, num_params);
+    err=io_ctr->take_err ? io_ctr->take_err (io_ctr) : 0;
+    if (err) {
+      mipi_err_code|=err;
+      return -1;
     }
+    i+=num_params;
+    if (has_delay)
+      _osal_sleep_ms (init_seq[i++]);
   }
+
+  return (ssize_t)i;
 }
 
-#define _MIPI_DEFINE_DCS_CMD(name, code, n_params)       \
-  static const struct mipi_dcs_cmd MIPI_DCS_CMD ## name= \
-  (struct mipi_dcs_cmd) {                                \
-    .code_pt=code,                                       \
-    .nargs=n_params,                                     \
-  };                                                     \
-  \
-  static const size_t              \
-  name (                           \
-    _OUT u8 dcs_seq_buff[],        \
-    _IN_ u8 * args[],              \
-    size_t n )                     \
-  {                                \
-    return (struct mipi_dcs_cmd) { \
-      .code_pt=code,               \
-      .nargs=n_params,             \
-    };                             \
+/**
+ * ========================
+ *    Typed DCS Commands
+ * ========================
+ *
+ * Each command with a fixed set of parameters is listed once, along with the
+ * way its parameters are packed; the list gives both the descriptors of
+ * `MIPI_DCS_CMDS` and an encoder per command, `mipi_dcs_enc_<CMD>`, whose
+ * arguments are those of the command. The encoders pack the parameters
+ * straight into a `mipi_dcs_stage`, which is then sent as one transaction:
+ *
+ * mipi_dcs_stage_reset (&dev->cmd_stage);
+ * mipi_dcs_enc_CASET (&dev->cmd_stage, x0, x1);
+ * mipi_dcs_enc_RASET (&dev->cmd_stage, y0, y1);
+ * mipi_dcs_enc_RAMWR (&dev->cmd_stage);
+ * mipi_dcs_stage_send (&dev->cmd_stage, dev->io, px_data, px_sz);
+ *
+ * As the encoders are typed, a command given the wrong number of arguments
+ * does not build.
+ */
+enum mipi_dcs_pack {
+  MIPI_DCS_PACK_NONE,  // << no parameters
+  MIPI_DCS_PACK_U8,    // << a single byte
+  MIPI_DCS_PACK_U16,   // << a big-endian half-word
+  MIPI_DCS_PACK_ADDR,  // << first and last address, inclusive (see above)
+  MIPI_DCS_PACK_U16X3  // << three big-endian half-words
+};
+
+#define _MIPI_DCS_SZ_NONE  0
+#define _MIPI_DCS_SZ_U8    1
+#define _MIPI_DCS_SZ_U16   2
+#define _MIPI_DCS_SZ_ADDR  4
+#define _MIPI_DCS_SZ_U16X3 6
+
+#define _MIPI_DCS_ARGS_NONE
+#define _MIPI_DCS_ARGS_U8    , uint8_t v
+#define _MIPI_DCS_ARGS_U16   , uint16_t v
+#define _MIPI_DCS_ARGS_ADDR  , uint16_t addr_start, uint16_t addr_end
+#define _MIPI_DCS_ARGS_U16X3 , uint16_t v0, uint16_t v1, uint16_t v2
+
+#define _MIPI_DCS_PUT16(p, v) \
+  ((p)[0]=(uint8_t)((v)>>8), (p)[1]=(uint8_t)(v))
+
+#define _MIPI_DCS_PACK_NONE(p)  (void)(p)
+#define _MIPI_DCS_PACK_U8(p)    ((p)[0]=v)
+#define _MIPI_DCS_PACK_U16(p)   _MIPI_DCS_PUT16 (p, v)
+#define _MIPI_DCS_PACK_ADDR(p)  _mipi_dcs_pack_addr (p, addr_start, addr_end)
+#define _MIPI_DCS_PACK_U16X3(p) \
+  (_MIPI_DCS_PUT16 (p, v0), _MIPI_DCS_PUT16 ((p)+2, v1), \
+    _MIPI_DCS_PUT16 ((p)+4, v2))
+
+/**
+ * X (cmd, pack)
+ */
+#define MIPI_DCS_CMD_TABLE(X) \
+  X (NOP, NONE)               \
+  X (SWRST, NONE)             \
+  X (SLPIN, NONE)             \
+  X (SLPOUT, NONE)            \
+  X (PTLON, NONE)             \
+  X (NORON, NONE)             \
+  X (INVOFF, NONE)            \
+  X (INVON, NONE)             \
+  X (GAMSET, U8)              \
+  X (DISPOFF, NONE)           \
+  X (DISPON, NONE)            \
+  X (CASET, ADDR)             \
+  X (RASET, ADDR)             \
+  X (RAMWR, NONE)             \
+  X (PTLAR, ADDR)             \
+  X (VSCRDEF, U16X3)          \
+  X (TEOFF, NONE)             \
+  X (TEON, U8)                \
+  X (MADCTL, U8)              \
+  X (VSCRSADD, U16)           \
+  X (IDMOFF, NONE)            \
+  X (IDMON, NONE)             \
+  X (COLMOD, U8)              \
+  X (RAMWRC, NONE)            \
+  X (TESCAN, U16)
+
+struct mipi_dcs_cmd {
+  mipi_dcs_cmd_T code_pt;
+  uint8_t num_params;
+  enum mipi_dcs_pack pack;
+};
+
+#define _MIPI_DCS_CMD_DESC(cmd, pack_) \
+  { .code_pt=(cmd), .num_params=_MIPI_DCS_SZ_##pack_, .pack=MIPI_DCS_PACK_##pack_ },
+
+static const struct mipi_dcs_cmd MIPI_DCS_CMDS[]=
+{
+  MIPI_DCS_CMD_TABLE (_MIPI_DCS_CMD_DESC)
+};
+
+/**
+ * Returns the descriptor of `code_pt`, or NULL if it is not in the table.
+ */
+static inline const struct mipi_dcs_cmd *
+mipi_dcs_find_cmd (mipi_dcs_cmd_T code_pt)
+{
+  for (size_t i=0; i<sizeof(MIPI_DCS_CMDS)/sizeof(MIPI_DCS_CMDS[0]); i++) {
+    if (MIPI_DCS_CMDS[i].code_pt==code_pt)
+      return &MIPI_DCS_CMDS[i];
   }
+  return NULL;
+}
+
+static inline void
+mipi_dcs_stage_reset (struct mipi_dcs_stage * stage)
+{
+  stage->num_segs=0;
+  stage->num_params=0;
+}
 
 /**
- * const struct mipi_dcs_cmd cmd=mipi_dcs_cmd (
- *   RAMWR,
- *   0,
- *   NULL
- * );
- *
- * _MIPI_DEFINE_DCS_CMD (
- *   RAMWR,
- *   0x2C,
- *   -1
- * );
- * RAMWR (arg_buff, sz, _io_ctr);
+ * Appends `cmd` to the stage, returning where its `n` parameters are to be
+ * packed, or NULL if the stage is full.
  */
+static inline uint8_t *
+_mipi_dcs_stage_push (
+  struct mipi_dcs_stage * stage,
+  mipi_dcs_cmd_T cmd,
+  size_t n )
+{
+  uint8_t * p=stage->params+stage->num_params;
+
+  if (stage->num_segs>=MIPI_DCS_STAGE_SEGS
+      || n>sizeof(stage->params)-stage->num_params)
+    return NULL;
+
+  stage->segs[stage->num_segs++]=(struct mipi_io_txn_seg){
+    .cmd=cmd,
+    .params=p,
+    .num_params=n
+  };
+  stage->num_params+=(uint8_t)n;
+  return p;
+}
+
+/**
+ * Defines the encoder of `cmd`, which returns `MIPI_ERR_NO_MEM` if the stage
+ * has no room left for it.
+ */
+#define _MIPI_DEFINE_DCS_CMD(cmd, pack_)                        \
+  static inline mipi_err_T                                      \
+  mipi_dcs_enc_##cmd (                                          \
+    struct mipi_dcs_stage * stage _MIPI_DCS_ARGS_##pack_ )      \
+  {                                                             \
+    uint8_t * p=_mipi_dcs_stage_push (                          \
+      stage,                                                    \
+      cmd,                                                      \
+      _MIPI_DCS_SZ_##pack_                                      \
+    );                                                          \
+                                                                \
+    if (!p)                                                     \
+      return MIPI_ERR_NO_MEM;                                   \
+    _MIPI_DCS_PACK_##pack_ (p);                                 \
+    return 0;                                                   \
+  }
+
+MIPI_DCS_CMD_TABLE (_MIPI_DEFINE_DCS_CMD)
+
+/**
+ * Sends the staged commands as one transaction, followed by `px_data` if
+ * `px_sz` is not 0, and empties the stage. Connectors without
+ * `write_panel_txn` are sent each command in turn, and cannot be sent pixel
+ * data this way.
+ */
+static inline void
+mipi_dcs_stage_send (
+  struct mipi_dcs_stage * stage,
+  struct mipi_io_ctr * io,
+  _IN const uint8_t px_data[],
+  size_t px_sz )
+{
+  if (!stage->num_segs)
+    return;
+
+  if (io->write_panel_txn) {
+    io->write_panel_txn (io, stage->segs, stage->num_segs, px_data, px_sz);
+  } else {
+    for (size_t i=0; i<stage->num_segs; i++) {
+      io->write_panel_reg (
+        io,
+        stage->segs[i].cmd,
+        stage->segs[i].params,
+        stage->segs[i].num_params
+      );
+    }
+  }
+  mipi_dcs_stage_reset (stage);
+}
 
 #ifdef __cplusplus
 }
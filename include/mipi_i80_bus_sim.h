@@ -0,0 +1,126 @@
+/**
+ * ========================
+ *    mipi_i80_bus_sim.h
+ * ========================
+ *
+ * Panel-side model of an Intel 8080-series bus, for use with the native
+ * OSAL. The simulator is driven with the pin levels seen by the panel (CS,
+ * DCX, WR, RD and the data lines), with a timestamp for each edge, and
+ * decodes them back into the DCS transactions they encode, checking the WR
+ * timing against the minimum pulse widths it was configured with.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-06
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_I80_BUS_SIM__
+#define __MIPI_I80_BUS_SIM__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mipi_dcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of leading data bytes kept with each decoded transaction. Longer
+ * payloads (ie. pixel data) are only counted.
+ */
+#define MIPI_I80_SIM_PARAM_CAP 16
+
+struct mipi_i80_sim_txn {
+	mipi_dcs_cmd_T cmd;
+	size_t num_bytes;
+	uint8_t params[MIPI_I80_SIM_PARAM_CAP];
+	uint64_t t_start_ns, t_end_ns;
+};
+
+/**
+ * Called once a transaction is complete, which is when the next command is
+ * latched or CS is released.
+ */
+typedef void
+(*mipi_i80_sim_txn_cb)(
+	void * usr_ctx,
+	const struct mipi_i80_sim_txn * txn
+);
+
+/**
+ * Supplies the byte the panel drives onto D[7:0] for the `idx`th RD cycle
+ * following `cmd`. Note that `idx` 0 is the dummy read.
+ */
+typedef uint8_t
+(*mipi_i80_sim_rd_cb)(
+	void * usr_ctx,
+	mipi_dcs_cmd_T cmd,
+	size_t idx
+);
+
+struct mipi_i80_bus_sim {
+	uint8_t bus_width;
+	uint32_t min_wr_low_ns, min_wr_high_ns;
+
+	_Bool cs_active, wr_lvl, rd_lvl, in_txn;
+	uint64_t t_wr_fall_ns, t_wr_rise_ns;
+	size_t rd_idx;
+	struct mipi_i80_sim_txn cur;
+
+	size_t num_txns, num_wr_cycles, num_rd_cycles, num_timing_errs;
+
+	mipi_i80_sim_txn_cb on_txn;
+	mipi_i80_sim_rd_cb on_rd;
+	void * usr_ctx;
+};
+
+extern void
+mipi_i80_sim_init (
+	struct mipi_i80_bus_sim * sim,
+	uint8_t bus_width,
+	uint32_t min_wr_low_ns,
+	uint32_t min_wr_high_ns
+);
+
+/**
+ * CS is active low, as are WR and RD.
+ */
+extern void
+mipi_i80_sim_set_cs (
+	struct mipi_i80_bus_sim * sim,
+	uint64_t t_ns,
+	_Bool cs_lvl
+);
+
+/**
+ * Data and DCX are sampled on the rising edge of WR.
+ */
+extern void
+mipi_i80_sim_set_wr (
+	struct mipi_i80_bus_sim * sim,
+	uint64_t t_ns,
+	_Bool wr_lvl,
+	_Bool dcx_lvl,
+	uint16_t data
+);
+
+/**
+ * Returns the value the panel drives onto the data lines once RD has been
+ * brought low; the host samples it before the rising edge.
+ */
+extern uint16_t
+mipi_i80_sim_set_rd (
+	struct mipi_i80_bus_sim * sim,
+	uint64_t t_ns,
+	_Bool rd_lvl
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_I80_BUS_SIM__
@@ -0,0 +1,181 @@
+/**
+ * ========================
+ *     mipi_init_seq.h
+ * ========================
+ *
+ * Init sequences framed at compile time. A sequence is written once, as a
+ * list of commands, and expanded into the segments a connector sends with
+ * `write_panel_txn`, so that nothing is parsed at boot. The delays are kept
+ * apart from the segments: each splits the sequence into runs, and a run is
+ * sent as a single transaction.
+ *
+ * A list is a macro which takes the two entry macros as arguments:
+ *
+ * #define MY_PANEL_INIT(CMD, CMD_D) \
+ *   CMD_D (SWRST, 150)              \
+ *   CMD (COLMOD, IFPF_16_BIT)       \
+ *   CMD_D (DISPON, 100)
+ *
+ * MIPI_INIT_SEQ_DEFINE (MIPI_INIT_MY_PANEL, MY_PANEL_INIT);
+ *
+ * `CMD (cmd, params...)` is a command and its parameters; `CMD_D (cmd, ms,
+ * params...)` is one which must be followed by a delay of `ms`. The same list
+ * also gives the byte-coded form of `mipi_init.h`, with
+ * `MIPI_INIT_SEQ_DEFINE_BYTES`, for `_mipi_dcs_write_seq`.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-19
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_INIT_SEQ__
+#define __MIPI_INIT_SEQ__
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mipi_init_seq {
+	const char * name;
+	const struct mipi_io_txn_seg * segs;
+	const uint16_t * delay_ms; // << after each segment; 0 for none
+	size_t num_segs;
+};
+
+/**
+ * The parameters of each entry are a compound literal with a leading pad
+ * byte, so that an entry without any still has an array to point into.
+ */
+#define _MIPI_INIT_ARGS(...)  ((const uint8_t[]){ 0, ##__VA_ARGS__ })
+#define _MIPI_INIT_NARGS(...) (sizeof(_MIPI_INIT_ARGS (__VA_ARGS__))-1)
+
+#define _MIPI_INIT_SEG(cmd_, ...)                   \
+	{                                                 \
+		.cmd=(cmd_),                                    \
+		.params=_MIPI_INIT_ARGS (__VA_ARGS__)+1,        \
+		.num_params=_MIPI_INIT_NARGS (__VA_ARGS__)      \
+	},
+#define _MIPI_INIT_SEG_D(cmd_, ms, ...) _MIPI_INIT_SEG (cmd_, ##__VA_ARGS__)
+
+#define _MIPI_INIT_NO_DLY(cmd_, ...)    0,
+#define _MIPI_INIT_DLY(cmd_, ms, ...)   (ms),
+
+#define _MIPI_INIT_BYTES(cmd_, ...) \
+	(cmd_), _MIPI_INIT_NARGS (__VA_ARGS__), ##__VA_ARGS__,
+#define _MIPI_INIT_BYTES_D(cmd_, ms, ...)                          \
+	(cmd_), MIPI_DELAY | _MIPI_INIT_NARGS (__VA_ARGS__), ##__VA_ARGS__, \
+	(uint8_t)(ms),
+
+#define MIPI_INIT_SEQ_DEFINE(name_, seq_list)                       \
+	static const struct mipi_io_txn_seg _##name_##_SEGS[]=            \
+	{                                                                 \
+		seq_list (_MIPI_INIT_SEG, _MIPI_INIT_SEG_D)                     \
+	};                                                                \
+	static const uint16_t _##name_##_DELAY_MS[]=                      \
+	{                                                                 \
+		seq_list (_MIPI_INIT_NO_DLY, _MIPI_INIT_DLY)                    \
+	};                                                                \
+	static const struct mipi_init_seq name_=                          \
+	{                                                                 \
+		.name=#name_,                                                   \
+		.segs=_##name_##_SEGS,                                          \
+		.delay_ms=_##name_##_DELAY_MS,                                  \
+		.num_segs=sizeof(_##name_##_SEGS)/sizeof(_##name_##_SEGS[0])    \
+	}
+
+/**
+ * Delays of the byte-coded form are a single byte, so are at most 255 ms.
+ */
+#define MIPI_INIT_SEQ_DEFINE_BYTES(name_, seq_list)                 \
+	static const uint8_t name_[]=                                     \
+	{                                                                 \
+		seq_list (_MIPI_INIT_BYTES, _MIPI_INIT_BYTES_D)                 \
+		END_DCS_SEQ                                                     \
+	}
+
+/**
+ * Time taken to write a sequence, for comparison with the byte-coded form;
+ * on the Pico, the microsecond counter starts at reset, so the time stamps
+ * of `mipi_dbi_dev` are measured from boot.
+ */
+struct mipi_init_stats {
+	size_t num_txns;
+	uint32_t wr_us;    // << spent writing, ie. not including the delays
+	uint32_t delay_ms;
+};
+
+/**
+ * Writes a sequence without waiting out its delays. Each call to
+ * `mipi_init_exec_poll` sends the runs which have come due and returns; in
+ * between, the caller is free to do other work (load assets, render the
+ * first frame, or bring up other panels, each with an executor of its own).
+ * The executor must stay in place until the sequence is done.
+ */
+struct mipi_init_exec {
+	struct mipi_io_ctr * io;
+	const struct mipi_init_seq * seq;
+	size_t next_seg;
+	uint32_t due_ms; // << time at which the next run may be sent
+
+	/**
+	 * If set, an OSAL alarm calls `ready_cb` when each delay has passed, eg.
+	 * to wake the core or the task which polls the executor. It is called in
+	 * interrupt context.
+	 */
+	_osal_alarm_cb ready_cb;
+	void * cb_arg;
+
+	struct mipi_init_stats stats;
+	mipi_err_T err; // << raised by the connector for the run which failed
+};
+
+/**
+ * Sends the first run of `seq` and returns, unless the sequence is done by
+ * then (ie. it has no delays).
+ */
+extern mipi_err_T
+mipi_init_exec_start (
+	struct mipi_init_exec * exec,
+	struct mipi_io_ctr * io,
+	const struct mipi_init_seq * seq,
+	_osal_alarm_cb ready_cb,
+	void * cb_arg
+);
+
+/**
+ * Sends each run whose delay has passed. Returns `true` once the whole
+ * sequence has been sent, or a run has failed (see `err`), and otherwise the
+ * time until the next run is due, in `wait_ms` if it is not `NULL`. From a
+ * protothread, eg.:
+ *
+ * ASYNC_PT_WAIT_UNTIL (pt, mipi_init_exec_poll (&panel->init, NULL));
+ */
+extern _Bool
+mipi_init_exec_poll (
+	struct mipi_init_exec * exec,
+	_OUT uint32_t * wait_ms
+);
+
+/**
+ * Writes `seq`, one transaction per run of segments between delays, and
+ * sleeps through each delay with `_osal_sleep_ms`. Falls back to a command
+ * at a time on connectors without `write_panel_txn`. Returns the error of the
+ * first run the connector fails, after which nothing more is sent.
+ */
+extern mipi_err_T
+mipi_init_seq_write (
+	struct mipi_io_ctr * io,
+	const struct mipi_init_seq * seq,
+	_OUT struct mipi_init_stats * stats
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_INIT_SEQ__
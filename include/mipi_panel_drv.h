@@ -0,0 +1,99 @@
+/**
+ * ========================
+ *     mipi_panel_drv.h
+ * ========================
+ *
+ * Selection of the driver for whichever panel is fitted, by the ID it reports.
+ * Each known controller is listed with the register its ID is read from, its
+ * init sequence, geometry and the interface pixel formats it accepts. The
+ * driver chosen is remembered in a word which survives a warm reset (see
+ * `_osal_persist_load`), so that only a cold boot has to probe the panel.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-20
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_PANEL_DRV__
+#define __MIPI_PANEL_DRV__
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+#include "mipi_init_seq.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIPI_IFPF_BIT(ifpf) (1u<<(ifpf))
+
+struct mipi_panel_drv {
+	const char * name;
+
+	/**
+	 * The ID read from `id_reg` (RDDID for most controllers) matches if it
+	 * equals `id` in every bit set in `id_mask`; the version byte is usually
+	 * masked out, as it differs between revisions of the same controller.
+	 */
+	mipi_dcs_cmd_T id_reg;
+	uint8_t id[3], id_mask[3];
+
+	const struct mipi_init_seq * init_seq;
+	uint16_t width, height;
+	uint32_t ifpfs; // << `MIPI_IFPF_BIT` of each COLMOD value supported
+};
+
+/**
+ * The controllers known to the library, with the init sequences of
+ * `mipi_init.h`. Those read with RDDID come first, so a panel which answers
+ * it is matched without reading any other register.
+ */
+extern const struct mipi_panel_drv MIPI_PANEL_DRVS[];
+extern const size_t MIPI_NUM_PANEL_DRVS;
+
+struct mipi_panel_probe_stats {
+	uint8_t id[3];     // << last ID read; not set if the probe was skipped
+	_Bool cache_hit;   // << the driver was taken from the persistent slot
+	size_t num_reads;  // << ID registers read from the panel
+	uint32_t probe_us;
+};
+
+/**
+ * Returns the driver of the panel behind `io`, out of `drvs` (or
+ * `MIPI_PANEL_DRVS` if `NULL`), and remembers it for the next boot. If a
+ * driver was remembered from the last one, and is still in `drvs`, it is
+ * returned without reading anything from the panel.
+ *
+ * Returns `NULL` if the panel cannot be read, or matches none of `drvs`.
+ */
+extern const struct mipi_panel_drv *
+mipi_panel_drv_select (
+	struct mipi_io_ctr * io,
+	_IN const struct mipi_panel_drv drvs[],
+	size_t num_drvs,
+	_OUT struct mipi_panel_probe_stats * stats
+);
+
+/**
+ * Discards the driver remembered by `mipi_panel_drv_select`, eg. once the
+ * panel has failed to come up with it, so that the next boot probes again.
+ */
+extern void
+mipi_panel_drv_forget (void);
+
+/**
+ * Sets up `dev` for the panel of `drv`: its geometry and init sequence.
+ */
+extern void
+mipi_panel_drv_apply (
+	struct mipi_dbi_dev * dev,
+	_IN const struct mipi_panel_drv * drv
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_PANEL_DRV__
@@ -0,0 +1,128 @@
+/**
+ * ========================
+ *   mipi_qspi_bus_sim.h
+ * ========================
+ *
+ * Panel-side model of a quad-SPI DBI bus, for use with the native OSAL. The
+ * simulator is driven with CS and, for each rising edge of SCK, the levels
+ * of D[3:0]. It decodes each frame (the time CS is held low) back into the
+ * DCS transaction it carries: an instruction byte and a 24-bit address, both
+ * on D0, whose middle byte is the command, followed by the data phase on the
+ * number of lines the instruction selects.
+ *
+ * Frames which end part way through the header or a byte, or which carry an
+ * instruction the panel was not configured with, are counted as framing
+ * errors and otherwise ignored, as a panel would.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-15
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_QSPI_BUS_SIM__
+#define __MIPI_QSPI_BUS_SIM__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mipi_dcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of leading data bytes kept with each decoded transaction. Longer
+ * payloads (ie. pixel data) are only counted.
+ */
+#define MIPI_QSPI_SIM_PARAM_CAP 16
+
+struct mipi_qspi_sim_txn {
+	uint8_t instr;
+	mipi_dcs_cmd_T cmd;
+	uint8_t num_lanes; // << of the data phase
+	size_t num_bytes;
+	uint8_t params[MIPI_QSPI_SIM_PARAM_CAP];
+	uint64_t t_start_ns, t_end_ns;
+};
+
+/**
+ * Called once a frame is complete, which is when CS is released.
+ */
+typedef void
+(*mipi_qspi_sim_txn_cb)(
+	void * usr_ctx,
+	const struct mipi_qspi_sim_txn * txn
+);
+
+/**
+ * Supplies the `idx`th byte the panel shifts out on D1 following a read of
+ * `cmd`.
+ */
+typedef uint8_t
+(*mipi_qspi_sim_rd_cb)(
+	void * usr_ctx,
+	mipi_dcs_cmd_T cmd,
+	size_t idx
+);
+
+struct mipi_qspi_bus_sim {
+	uint8_t wr_instr, rd_instr, px_instr, px_lanes;
+
+	_Bool cs_active, in_data, skip;
+	uint32_t num_hdr_bits;
+	uint32_t hdr;
+	uint8_t cur_byte, cur_bits;
+	uint8_t rd_byte, rd_bits;
+	size_t rd_idx;
+	struct mipi_qspi_sim_txn cur;
+
+	size_t num_txns, num_clks, num_framing_errs;
+
+	mipi_qspi_sim_txn_cb on_txn;
+	mipi_qspi_sim_rd_cb on_rd;
+	void * usr_ctx;
+};
+
+/**
+ * `wr_instr` and `rd_instr` select single-line writes and reads, and
+ * `px_instr` a write whose data phase is on `px_lanes` lines (2 or 4).
+ */
+extern void
+mipi_qspi_sim_init (
+	struct mipi_qspi_bus_sim * sim,
+	uint8_t wr_instr,
+	uint8_t rd_instr,
+	uint8_t px_instr,
+	uint8_t px_lanes
+);
+
+/**
+ * CS is active low.
+ */
+extern void
+mipi_qspi_sim_set_cs (
+	struct mipi_qspi_bus_sim * sim,
+	uint64_t t_ns,
+	_Bool cs_lvl
+);
+
+/**
+ * Presents a rising edge of SCK, with the host driving `d_lines` onto
+ * D[3:0]. Returns the level the panel drives onto D1 for this edge, which
+ * is only meaningful during the data phase of a read.
+ */
+extern _Bool
+mipi_qspi_sim_clock (
+	struct mipi_qspi_bus_sim * sim,
+	uint64_t t_ns,
+	uint8_t d_lines
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_QSPI_BUS_SIM__
@@ -0,0 +1,276 @@
+/**
+ * ========================
+ *      mipi_sim_ctr.h
+ * ========================
+ *
+ * Simulated panel connector, for use on the native target. Commands written
+ * through it are decoded by a model of the panel which keeps its own GRAM,
+ * so that what was drawn may be read back with RAMRD as from a real panel.
+ *
+ * The model can be made to misbehave above given clock rates: each byte of
+ * parameters or pixel data then has a chance of having a bit flipped on its
+ * way, as a panel driven past its timing limits would see it.
+ *
+ * Each operation is charged the time it would take on a real bus: the bits on
+ * the wire at the clock rate of its phase, plus a fixed cost for every CS
+ * assertion and DCX change (see `struct mipi_sim_cost`). With frames marked
+ * by the caller, the model predicts the frame rate the traffic would sustain,
+ * so that changes to MGL or the flush path can be compared on the host.
+ * Commands may also be recorded to a log, along with their leading
+ * parameters and the time at which they were sent.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-10
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_SIM_CTR__
+#define __MIPI_SIM_CTR__
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Wire time shared by the models of panels on one bus; the models advance it
+ * with each byte they are sent, so that `t_ns` is how long the traffic of all
+ * of them would have occupied a real bus at the clock rates they were set to.
+ */
+struct mipi_sim_bus {
+	uint64_t t_ns;
+	const struct mipi_sim_ctr * owner; // << last panel to have been selected
+	size_t num_switches;
+};
+
+/**
+ * Number of leading parameter bytes kept with each entry of the log. Longer
+ * payloads (ie. pixel data) are only counted.
+ */
+#ifndef MIPI_SIM_LOG_PARAM_CAP
+#define MIPI_SIM_LOG_PARAM_CAP 8
+#endif
+
+struct mipi_sim_log_ent {
+	mipi_dcs_cmd_T cmd;
+	size_t num_bytes;
+	uint8_t params[MIPI_SIM_LOG_PARAM_CAP];
+	uint64_t t_ns; // << modelled time at which the command was sent
+};
+
+/**
+ * Fixed costs of the model, in addition to the bits on the wire. `cs_ns`
+ * covers the setup and hold time around each assertion of CS, and any time
+ * the host spends arming the transfer; `dcx_ns` is charged whenever DCX
+ * changes level between the command and its data.
+ */
+struct mipi_sim_cost {
+	uint32_t cs_ns, dcx_ns;
+};
+
+struct mipi_sim_report {
+	size_t num_frames;
+	uint64_t ns_per_frame;
+	float fps;       // << sustainable by the bus, if it did nothing else
+	float occupancy; // << fraction of the target frame period the bus is busy
+};
+
+struct mipi_sim_ctr {
+	struct mipi_io_ctr io; /* BASE */
+
+	uint16_t width, height;
+	uint8_t bytes_per_px;
+	uint8_t * gram;
+	uint8_t id[3]; // << returned for RDDID
+
+	/**
+	 * Decoder state. `win` is held in panel coordinates, inclusive of its
+	 * last column and row, as CASET and RASET set it.
+	 */
+	mipi_dcs_cmd_T cur_cmd;
+	size_t param_idx;
+	uint8_t params[4];
+	uint16_t xs, xe, ys, ye;
+	size_t wr_pos, rd_pos; // << in bytes from the start of the window
+
+	uint32_t phase_hz[MIPI_IO_NUM_PHASES];
+	/**
+	 * Clock rates above which bytes are corrupted on write and on read,
+	 * respectively, one in `err_1_in` on average; `0` disables injection.
+	 */
+	uint32_t max_wr_hz, max_rd_hz, err_1_in;
+	uint32_t rng;
+
+	uint8_t madctl;
+	_Bool dcx_lvl;
+
+	struct mipi_sim_cost cost;
+	struct mipi_sim_log_ent * log;
+	size_t log_cap, num_logged; // << the log keeps the last `log_cap` entries
+
+	size_t num_cmds, num_wr_bytes, num_rd_bytes, num_errs_injected;
+	size_t num_selects, num_dcx_changes, num_frames;
+	/**
+	 * Modelled bus time; `wire_ns` is the sum of the time spent in each phase
+	 * and the fixed costs, `cs_ns` and `dcx_ns`.
+	 */
+	uint64_t wire_ns, phase_ns[MIPI_IO_NUM_PHASES], cs_ns, dcx_ns;
+	struct mipi_sim_bus * bus;
+	int errno;
+};
+
+extern const struct mipi_io_ctr _MIPI_SIM_CTR_FUNCS;
+
+extern struct mipi_sim_ctr
+mipi_create_sim_ctr (
+	uint16_t width,
+	uint16_t height,
+	uint8_t bytes_per_px
+);
+
+extern void
+mipi_free_sim_ctr (struct mipi_sim_ctr * self);
+
+extern void
+mipi_sim_set_err_threshold (
+	struct mipi_sim_ctr * self,
+	uint32_t max_wr_hz,
+	uint32_t max_rd_hz,
+	uint32_t err_1_in
+);
+
+extern void
+mipi_sim_set_cost (
+	struct mipi_sim_ctr * self,
+	const struct mipi_sim_cost cost
+);
+
+/**
+ * Starts recording commands to a log of `cap` entries, replacing any previous
+ * log; `0` stops recording.
+ */
+extern mipi_err_T
+mipi_sim_set_log (
+	struct mipi_sim_ctr * self,
+	size_t cap
+);
+
+/**
+ * Returns the `idx`th entry still held in the log, oldest first, or `NULL`
+ * if there is none.
+ */
+extern const struct mipi_sim_log_ent *
+mipi_sim_log_at (
+	const struct mipi_sim_ctr * self,
+	size_t idx
+);
+
+extern size_t
+mipi_sim_log_len (const struct mipi_sim_ctr * self);
+
+/**
+ * Clears the counters, modelled time and log, but not GRAM or the state of
+ * the panel.
+ */
+extern void
+mipi_sim_reset_stats (struct mipi_sim_ctr * self);
+
+/**
+ * Marks the end of a frame, for `mipi_sim_get_report`.
+ */
+extern void
+mipi_sim_mark_frame (struct mipi_sim_ctr * self);
+
+/**
+ * Reports the modelled bus time per frame since the counters were last
+ * reset, and the share of a frame period at `target_fps` it occupies.
+ */
+extern void
+mipi_sim_get_report (
+	const struct mipi_sim_ctr * self,
+	uint32_t target_fps,
+	_OUT struct mipi_sim_report * rep
+);
+
+extern void
+mipi_sim_attach_bus (
+	struct mipi_sim_ctr * self,
+	struct mipi_sim_bus * bus
+);
+
+extern void
+mipi_sim_send_cmd (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T cmd,
+	_IN const uint8_t params[],
+	size_t len
+);
+
+extern void
+mipi_sim_write_txn (
+	struct mipi_io_ctr * self,
+	_IN const struct mipi_io_txn_seg segs[],
+	size_t num_segs,
+	_IN const uint8_t px_data[],
+	size_t px_sz
+);
+
+extern ssize_t
+mipi_sim_recv_params (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T cmd,
+	_OUT uint8_t params[],
+	size_t len
+);
+
+extern void
+mipi_sim_flush_fmbf (
+	struct mipi_io_ctr * self,
+	_IN const uint8_t pix_buff[],
+	const struct mipi_area bounds,
+	size_t len
+);
+
+extern void
+mipi_sim_flush_fmbf_vec (
+	struct mipi_io_ctr * self,
+	_IN byte_buffer_view_T spans[],
+	size_t num_spans,
+	const struct mipi_area bounds
+);
+
+extern mipi_err_T
+mipi_sim_begin_fmbf_stream (
+	struct mipi_io_ctr * self,
+	const struct mipi_area bounds
+);
+
+extern mipi_err_T
+mipi_sim_write_fmbf_chunk (
+	struct mipi_io_ctr * self,
+	_IN const uint8_t chunk[],
+	size_t len
+);
+
+extern void
+mipi_sim_end_fmbf_stream (struct mipi_io_ctr * self);
+
+extern mipi_err_T
+mipi_sim_take_err (struct mipi_io_ctr * self);
+
+extern uint32_t
+mipi_sim_set_phase_clk (
+	struct mipi_io_ctr * self,
+	enum mipi_io_phase phase,
+	uint32_t hz
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_SIM_CTR__
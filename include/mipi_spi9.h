@@ -0,0 +1,113 @@
+/**
+ * ========================
+ *       mipi_spi9.h
+ * ========================
+ *
+ * Bit packing for the 3-wire serial interface (DBI type C, option 1), on
+ * which each byte is preceded by its D/C flag in a 9-bit word: low for a
+ * command, high for data. SPI peripherals which only shift whole bytes can
+ * still drive such a panel, by packing the words end to end, eight words to
+ * nine bytes, MSB first.
+ *
+ * The encoder keeps the bits which do not yet fill a byte between calls, so
+ * that a transaction may be encoded in slices of any size. At the end of the
+ * transaction it is padded out to a byte with zeros; the panel discards the
+ * incomplete word this leaves once CS is released.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-16
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_SPI9__
+#define __MIPI_SPI9__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIPI_SPI9_DCX_BIT 0x100
+
+/**
+ * Upper bound of the bytes produced by encoding `n` bytes, including the
+ * bits held over from a previous call and the padding of a flush.
+ */
+#define MIPI_SPI9_ENC_SZ(n) ((n)+(n)/8+1)
+
+/**
+ * Upper bound of the words decoded from `n` bytes, including those held over
+ * from a previous call.
+ */
+#define MIPI_SPI9_DEC_SZ(n) ((n)*8/9+1)
+
+struct mipi_spi9_enc {
+	uint8_t acc;      // << bits not yet filling a byte, right aligned
+	uint8_t num_bits; // << always less than 8
+};
+
+struct mipi_spi9_dec {
+	uint16_t acc;
+	uint8_t num_bits; // << always less than 9
+};
+
+static inline void
+mipi_spi9_enc_reset (struct mipi_spi9_enc * enc)
+{
+	enc->acc=0;
+	enc->num_bits=0;
+}
+
+static inline void
+mipi_spi9_dec_reset (struct mipi_spi9_dec * dec)
+{
+	dec->acc=0;
+	dec->num_bits=0;
+}
+
+/**
+ * Encodes `num_bytes` bytes, all with the D/C flag `dcx`, into `out`, which
+ * must hold `MIPI_SPI9_ENC_SZ(num_bytes)` bytes. Returns the number of bytes
+ * written.
+ */
+extern size_t
+mipi_spi9_encode (
+	struct mipi_spi9_enc * enc,
+	_Bool dcx,
+	const uint8_t in[],
+	size_t num_bytes,
+	uint8_t out[]
+);
+
+/**
+ * Pads the bits held by the encoder out to a byte, returning the number of
+ * bytes written to `out` (0 or 1).
+ */
+extern size_t
+mipi_spi9_enc_flush (
+	struct mipi_spi9_enc * enc,
+	uint8_t out[]
+);
+
+/**
+ * Unpacks the words of a packed stream into `words`, which must hold
+ * `MIPI_SPI9_DEC_SZ(num_bytes)` entries, with the D/C flag in
+ * `MIPI_SPI9_DCX_BIT`. Returns the number of words decoded.
+ */
+extern size_t
+mipi_spi9_decode (
+	struct mipi_spi9_dec * dec,
+	const uint8_t in[],
+	size_t num_bytes,
+	uint16_t words[]
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_SPI9__
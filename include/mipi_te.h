@@ -0,0 +1,156 @@
+/**
+ * ========================
+ *        mipi_te.h
+ * ========================
+ *
+ * Flushes synchronised with the tearing effect (TE) output of a panel. The
+ * panel raises TE at the start of its vertical blanking interval and then
+ * scans GRAM out to the glass row by row, top to bottom, over the rest of
+ * the refresh period. A frame written while it is being scanned out tears
+ * wherever the write and the scan cross.
+ *
+ * The scheduler writes each band of a frame only once the scan has passed
+ * the last row of the band, so that the write pointer stays behind the scan
+ * of the current refresh and the next refresh shows the whole of the new
+ * frame. A band which could not be started before the scan of the next
+ * refresh reaches it is still written, and counted as late.
+ *
+ * Bands are released as the scan passes them rather than at the next TE, so
+ * a frame submitted part way through a refresh does not wait one out.
+ *
+ * Where no TE pin is wired, the start of each refresh is estimated from the
+ * configured refresh period; the estimate drifts with the oscillator of the
+ * panel, so it should be preferred only where the pin is unavailable.
+ *
+ * Rows are those of the panel's scan, ie. with MADCTL in its default state.
+ * Writes go directly to the connector; the window cache of a DBI device on
+ * the same connector must be invalidated after them.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-14
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_TE__
+#define __MIPI_TE__
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIPI_TE_NO_PIN (-1)
+
+struct mipi_te_sched {
+	struct mipi_io_ctr * io;
+	int te_pin;
+
+	uint16_t num_rows;  // << rows of the panel, in scan order
+	uint16_t band_rows;
+	uint32_t vblank_us; // << time from TE to the scan of the first row
+
+	/**
+	 * Written by the TE interrupt. `seq` is odd while the others are being
+	 * updated, so that a reader can tell whether it saw a consistent set.
+	 */
+	volatile uint32_t seq;
+	volatile uint32_t period_us; // << refresh period; tracked from TE when wired
+	volatile uint32_t vsync_us;
+	volatile uint32_t num_edges;
+
+	/**
+	 * Frame being written; `ref_us` is the start of the refresh behind whose
+	 * scan it is written, and `next_row` the first row not yet written.
+	 */
+	struct mipi_area bds;
+	const uint8_t * px_data;
+	size_t row_sz;
+	uint16_t next_row;
+	uint32_t ref_us;
+	_Bool busy;
+	mipi_err_T err; // << raised by the connector for any band of the frame
+	mipi_io_done_cb done_cb;
+	void * cb_arg;
+
+	size_t num_frames, num_bands, num_late_bands;
+};
+
+/**
+ * Enables TE output on the panel, if `te_pin` is not `MIPI_TE_NO_PIN`, and
+ * registers for its rising edge. `period_us` is the refresh period of the
+ * panel as configured (eg. with FRMCTRL1), used until one has been measured
+ * and throughout if no pin is wired.
+ */
+extern mipi_err_T
+mipi_te_sched_init (
+	struct mipi_te_sched * self,
+	struct mipi_io_ctr * io,
+	int te_pin,
+	uint16_t num_rows,
+	uint16_t band_rows,
+	uint32_t period_us,
+	uint32_t vblank_us
+);
+
+/**
+ * Disables TE output and its interrupt.
+ */
+extern void
+mipi_te_sched_deinit (struct mipi_te_sched * self);
+
+/**
+ * To be called on each rising edge of TE, where the OSAL does not deliver
+ * them itself (eg. from a PIO or a simulated panel).
+ */
+extern void
+mipi_te_sched_on_te (struct mipi_te_sched * self);
+
+/**
+ * Queues a frame for `bds`, whose rows are held contiguously in `px_data`.
+ * The data must remain valid until `done_cb` has been invoked, with the
+ * error the connector raised for any of its bands. Returns
+ * `MIPI_ERR_RES_LOCKED` if a frame is still being written.
+ */
+extern mipi_err_T
+mipi_te_sched_submit (
+	struct mipi_te_sched * self,
+	const struct mipi_area bds,
+	_IN const uint8_t px_data[],
+	size_t px_sz,
+	mipi_io_done_cb done_cb,
+	void * cb_arg
+);
+
+/**
+ * Writes each band of the current frame which the scan has passed. Returns
+ * `true` once there is no frame left to write, and the time until the next
+ * band is due otherwise, in `wait_us` if it is not `NULL`.
+ */
+extern _Bool
+mipi_te_sched_poll (
+	struct mipi_te_sched * self,
+	_OUT uint32_t * wait_us
+);
+
+/**
+ * Submits a frame and polls until it has been written, sleeping (or for
+ * less than a millisecond, yielding) until each band is due. Returns the
+ * error the connector raised for any of its bands.
+ */
+extern mipi_err_T
+mipi_te_sched_flush (
+	struct mipi_te_sched * self,
+	const struct mipi_area bds,
+	_IN const uint8_t px_data[],
+	size_t px_sz
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_TE__
@@ -0,0 +1,187 @@
+/**
+ * ========================
+ *        mipi_txq.h
+ * ========================
+ *
+ * Transaction queue in front of a panel connector. Any number of producers,
+ * on either core or on any thread, may submit commands and window updates
+ * without blocking; a single drain owner (eg. the MGL event loop on core 1,
+ * or a host thread) issues them to the connector in the order they were
+ * submitted. Only the drain owner ever takes the lock of the connector, so
+ * producers never wait on one another or on the bus.
+ *
+ * The queue is a bounded ring of descriptors, each with a sequence number
+ * which tells producers and the consumer whose turn it is to use the slot;
+ * a submission costs one compare-and-swap on the ring, regardless of how
+ * busy the connector is.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-12
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_TXQ__
+#define __MIPI_TXQ__
+
+#include <stdatomic.h>
+
+#include "mipi.h"
+
+#ifdef __STDC_NO_ATOMICS__
+# error The transaction queue requires C11 atomics
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Parameters are copied into the descriptor, so that the caller need not keep
+ * them; pixel data is not.
+ */
+#ifndef MIPI_TXQ_PARAM_CAP
+#define MIPI_TXQ_PARAM_CAP 16
+#endif
+
+enum mipi_txq_op {
+	MIPI_TXQ_CMD,   // << a single command and its parameters
+	MIPI_TXQ_AREA,  // << a window and the pixel data for it
+	MIPI_TXQ_DELAY  // << holds back what follows, eg. after SLPOUT
+};
+
+struct mipi_txq_desc {
+	enum mipi_txq_op op;
+	mipi_dcs_cmd_T cmd;
+	uint8_t num_params;
+	uint8_t params[MIPI_TXQ_PARAM_CAP];
+
+	struct mipi_area bds;
+	const uint8_t * px_data;
+	size_t px_sz;
+	uint32_t delay_ms;
+
+	/**
+	 * Invoked by the drain owner once the descriptor has been handed to the
+	 * connector, with any error the connector raised for it (see
+	 * `mipi_io_ctr::take_err`). If the connector completes transfers
+	 * asynchronously, the pixel data remains in use until it reports
+	 * completion of its own.
+	 */
+	mipi_io_done_cb done_cb;
+	void * cb_arg;
+};
+
+struct _mipi_txq_slot {
+	atomic_size_t seq;
+	struct mipi_txq_desc desc;
+};
+
+struct mipi_txq {
+	struct mipi_io_ctr * io;
+	struct _mipi_txq_slot * slots;
+	size_t mask;
+
+	atomic_size_t head; // << next slot to be claimed by a producer
+	size_t tail;        // << next slot to be issued; drain owner only
+	atomic_flag draining;
+	uint32_t resume_at_ms; // << end of the delay at the head, if any
+	_Bool in_delay;
+
+	/**
+	 * Called by a producer after each submission, eg. to wake the drain owner.
+	 * Runs on the thread of the producer and must not block.
+	 */
+	void
+	(*on_submit)(void * arg);
+	void * on_submit_arg;
+
+	atomic_size_t num_submitted, num_rejected;
+	size_t num_issued;
+};
+
+/**
+ * `num_slots` must be a power of 2.
+ */
+extern mipi_err_T
+mipi_txq_init (
+	struct mipi_txq * self,
+	struct mipi_io_ctr * io,
+	size_t num_slots
+);
+
+extern void
+mipi_txq_free (struct mipi_txq * self);
+
+/**
+ * Each of these returns `MIPI_ERR_NO_MEM` without waiting if the queue is
+ * full, in which case nothing has been submitted.
+ */
+extern mipi_err_T
+mipi_txq_submit_cmd (
+	struct mipi_txq * self,
+	mipi_dcs_cmd_T cmd,
+	_COPY_FROM_USER const uint8_t params[],
+	size_t num_params
+);
+
+extern mipi_err_T
+mipi_txq_submit_area (
+	struct mipi_txq * self,
+	const struct mipi_area bds,
+	_IN const uint8_t px_data[],
+	size_t px_sz,
+	mipi_io_done_cb done_cb,
+	void * cb_arg
+);
+
+/**
+ * Submits a delay: nothing submitted after it is issued until `ms` have
+ * passed from the time it reaches the head of the queue. Neither the drain
+ * owner nor the producer wait on it; a drain which reaches it stops there.
+ */
+extern mipi_err_T
+mipi_txq_submit_delay (
+	struct mipi_txq * self,
+	uint32_t ms
+);
+
+/**
+ * Issues up to `max_descs` of the queued descriptors to the connector, in
+ * order, and returns how many were issued. If another thread is already
+ * draining the queue, returns `0` at once.
+ */
+extern size_t
+mipi_txq_drain (
+	struct mipi_txq * self,
+	size_t max_descs
+);
+
+/**
+ * For drain owners which issue descriptors themselves (see `mipi_bus_sched`)
+ * rather than through `mipi_txq_drain`. `mipi_txq_peek` returns the
+ * descriptor at the head of the queue, or `NULL` if there is none ready, and
+ * `mipi_txq_consume` releases it back to the producers. The descriptor must
+ * not be used after it has been consumed.
+ */
+extern const struct mipi_txq_desc *
+mipi_txq_peek (struct mipi_txq * self);
+
+extern void
+mipi_txq_consume (struct mipi_txq * self);
+
+/**
+ * Issues `desc`, which must be a command or an area, to `io`.
+ */
+extern void
+mipi_txq_issue (
+	struct mipi_io_ctr * io,
+	_IN const struct mipi_txq_desc * desc
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MIPI_TXQ__
@@ -0,0 +1,128 @@
+/**
+ * ========================
+ *    native_pf_types.h
+ * ========================
+ *
+ * Platform types for the native (host) OSAL. Select this header by defining
+ * `_PF_TYPE_DEFNS="native_pf_types.h"` in the build system.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-02
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_NATIVE_PF_TYPES__
+#define __MIPI_NATIVE_PF_TYPES__
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <threads.h>
+
+typedef unsigned int uint;
+typedef uint8_t      _osal_gpio_pin_T;
+typedef mtx_t        mipi_osal_mtx_T;
+
+#define MIPI_OSAL_ATOMIC_INT atomic_int
+
+#define _NATIVE_NUM_GPIO_PINS 64
+#define _NATIVE_NUM_DMA_CHAN  4
+
+/**
+ * The emulated SPI peripheral. Bytes written to it, whether by the blocking
+ * functions or by a DMA channel, are copied into `mem` (wrapping at
+ * `mem_sz`) and, if set, passed to `on_write` in the same order they would
+ * appear on the wire.
+ */
+struct _osal_spi_dev {
+	mtx_t io_mtx; // << initialised by `_osal_init_spi_dev`
+	uint32_t baud_hz;
+	uint8_t * mem;
+	size_t mem_sz, mem_pos;
+
+	void
+	(*on_write)(
+		struct _osal_spi_dev * spi_dev,
+		const uint8_t byte_arr[],
+		size_t num_bytes
+	);
+	void * usr_ctx;
+};
+
+struct mipi_i80_bus_sim;
+
+/**
+ * The emulated 8080 bus. Each WR and RD cycle advances a virtual clock by the
+ * configured cycle time and is presented, edge by edge, to the simulator
+ * attached with `_native_i80_attach_sim`.
+ */
+struct _osal_i80_bus {
+	_Bool claimed;
+	uint8_t bus_width;
+	_osal_gpio_pin_T data_base, wr, rd, dcx, cs;
+	uint32_t wr_cycle_ns;
+	uint64_t t_ns;
+	struct mipi_i80_bus_sim * sim;
+};
+
+/**
+ * Connects `bus` to a panel model. `dcx` and `cs` are the GPIO driven by the
+ * connector; changes to `cs` are forwarded to the simulator as they happen.
+ */
+extern void
+_native_i80_attach_sim (
+	struct _osal_i80_bus * bus,
+	struct mipi_i80_bus_sim * sim,
+	_osal_gpio_pin_T dcx,
+	_osal_gpio_pin_T cs
+);
+
+struct mipi_qspi_bus_sim;
+
+/**
+ * The emulated quad-SPI bus. Each SCK period advances a virtual clock and is
+ * presented, with the levels of D[3:0], to the simulator attached with
+ * `_native_qspi_attach_sim`.
+ */
+struct _osal_qspi_bus {
+	_Bool claimed;
+	uint8_t max_lanes;
+	_osal_gpio_pin_T data_base, sck, cs;
+	uint32_t sck_period_ns;
+	uint64_t t_ns;
+	struct mipi_qspi_bus_sim * sim;
+};
+
+/**
+ * Connects `bus` to a panel model. Changes to `cs` are forwarded to the
+ * simulator as they happen.
+ */
+extern void
+_native_qspi_attach_sim (
+	struct _osal_qspi_bus * bus,
+	struct mipi_qspi_bus_sim * sim,
+	_osal_gpio_pin_T cs
+);
+
+/**
+ * Drives an input pin from outside of the library, as a panel would its TE
+ * output, invoking the callback registered with `_osal_set_gpio_irq` on the
+ * edge it was registered for.
+ */
+extern void
+_native_drive_gpio_pin (
+	_osal_gpio_pin_T pin,
+	_Bool pin_val
+);
+
+/**
+ * The level last driven on `pin`, by the library or otherwise; eg. for an
+ * emulated peripheral to see whether it is selected.
+ */
+extern _Bool
+_native_get_gpio_pin (_osal_gpio_pin_T pin);
+
+#endif // __MIPI_NATIVE_PF_TYPES__
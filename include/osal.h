@@ -19,6 +19,9 @@
  * Copyright Surface EP, LLC 2025.
  */
 
+#ifndef __MIPI_OSAL__
+#define __MIPI_OSAL__
+
 #include <stdbool.h>
 #include _PF_TYPE_DEFNS // Defined in the build system per platform target.
 
@@ -69,10 +72,10 @@ struct dma_mem {
 		 * It's possible that `dma_mem_al` has a stricter alignment than its type
 		 * dictates; inherit this requirement. Note that use of `_Alignof` with an
 		 * expression is supported by some compilers but ultimately a non-standard
-		 * feature.
+		 * feature, so name the type instead.
 		 */
-		_Alignas (_Alignof (typeid(dma_mem_al)))
-		uint8_t dma_buff[sizeof(dma_mem_al)];
+		_Alignas (_Alignof (uint32_t))
+		uint8_t dma_buff[sizeof(uint32_t)];
 	};
 };
 
@@ -86,10 +89,24 @@ typedef thrd_t * mipi_osal_thrd_handle_T;
  * The standard library functions are guaranteed thread-safe by their
  * implementation in the Pico SDK.
  */
+#ifndef MIPI_COUNT_HEAP_OPS
 #define mipi_osal_alloc   malloc
 #define mipi_osal_calloc  calloc
 #define mipi_osal_realloc realloc
 #define mipi_osal_free    free
+#else
+/**
+ * Counts each call made through the macros above, so that a host build can
+ * check that a path (eg. a flush, once the device is up) makes none. The
+ * count is not atomic, and is only meant for single-threaded tests.
+ */
+extern size_t mipi_num_heap_ops;
+
+#define mipi_osal_alloc(sz)       (mipi_num_heap_ops++, malloc (sz))
+#define mipi_osal_calloc(n, sz)   (mipi_num_heap_ops++, calloc (n, sz))
+#define mipi_osal_realloc(p, sz)  (mipi_num_heap_ops++, realloc (p, sz))
+#define mipi_osal_free(p)         (mipi_num_heap_ops++, free (p))
+#endif
 
 /**
  * dma_mem_T _dma_buff[<const_expr>];
@@ -148,6 +165,13 @@ typedef struct _hid_ptc_dsc hid_ptc_dsc_T;
  * How difficult would it be to support the display over USB?
  */
 
+/**
+ * Capabilities understood by every implementation; others are up to the
+ * platform.
+ */
+#define _OSAL_GPIO_IN  0
+#define _OSAL_GPIO_OUT 1 // << driven high until set otherwise
+
 _WEAK_DEF extern void
 _osal_init_gpio_pin (
 	const _osal_gpio_pin_T pin,
@@ -161,12 +185,48 @@ _osal_set_gpio_pin_state (
 	const _Bool pin_val
 );
 
+/**
+ * Registers `irq_cb` to be called, in interrupt context, on each rising (or
+ * falling) edge of `pin`, which is configured as an input. Passing `NULL`
+ * disables the interrupt. Used for the tearing effect output of a panel.
+ */
+typedef void
+(*_osal_gpio_irq_cb)(
+	_osal_gpio_pin_T pin,
+	void * cb_arg
+);
+
+_WEAK_DEF extern _Bool
+_osal_set_gpio_irq (
+	_osal_gpio_pin_T pin,
+	_Bool rising,
+	_osal_gpio_irq_cb irq_cb,
+	void * cb_arg
+);
+
 /**
  * <<SPI>>
  */
 
-_WEAK_DEF extern void
-_osal_init_spi_dev ();
+/**
+ * Brings up `spi_dev` in mode 0, with `sck`, `mosi` and `miso` given over to
+ * it, and returns the clock rate actually set, which is the closest the
+ * peripheral allows to `hz` without exceeding it.
+ */
+_WEAK_DEF extern uint32_t
+_osal_init_spi_dev (
+	struct _osal_spi_dev * spi_dev,
+	_osal_gpio_pin_T sck,
+	_osal_gpio_pin_T mosi,
+	_osal_gpio_pin_T miso,
+	uint32_t hz
+);
+
+_WEAK_DEF extern uint32_t
+_osal_spi_set_baudrate (
+	struct _osal_spi_dev * spi_dev,
+	uint32_t hz
+);
 
 _WEAK_DEF extern _Bool
 _osal_spi_read_block_ms (
@@ -184,6 +244,222 @@ _osal_spi_write_block_ms (
 	uint32_t ms
 );
 
+/**
+ * Writes `tx` while reading as many bytes into `rx`.
+ */
+_WEAK_DEF extern _Bool
+_osal_spi_write_read_block_ms (
+	struct _osal_spi_dev * spi_dev,
+	/*_IN_*/ const uint8_t tx[],
+	/*_OUT*/ uint8_t rx[],
+	size_t num_bytes,
+	uint32_t ms
+);
+
+/**
+ * <<DMA>>
+ *
+ * A transfer started with one of the `*_async` functions returns as soon as
+ * the channel has been armed. The completion callback is invoked once the
+ * last byte has left the peripheral (not merely its FIFO), so that the caller
+ * may safely release the chip select from within it. On most targets it runs
+ * in interrupt context and must not block.
+ *
+ * A host implementation may back these with a worker thread which copies the
+ * source buffer into the emulated peripheral; the same contract applies.
+ */
+typedef void
+(*_osal_dma_done_cb)(void * cb_arg);
+
+_WEAK_DEF extern int
+_osal_dma_claim_chan (void);
+
+_WEAK_DEF extern void
+_osal_dma_unclaim_chan (int dma_chan);
+
+_WEAK_DEF extern _Bool
+_osal_dma_spi_write_async (
+	int dma_chan,
+	struct _osal_spi_dev * spi_dev,
+	/*_IN_*/ const uint8_t byte_arr[],
+	size_t num_bytes,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg
+);
+
+/**
+ * Scatter-gather form of `_osal_dma_spi_write_async`. The `num_bufs` buffers
+ * are sent back to back, as though they were one, with a single completion.
+ * `bufs` itself, and not only the memory it refers to, must remain valid
+ * until the callback is invoked.
+ */
+struct byte_buffer;
+
+_WEAK_DEF extern _Bool
+_osal_dma_spi_write_vec_async (
+	int dma_chan,
+	struct _osal_spi_dev * spi_dev,
+	/*_IN_*/ const struct byte_buffer * bufs,
+	size_t num_bufs,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg
+);
+
+_WEAK_DEF extern _Bool
+_osal_dma_is_busy (int dma_chan);
+
+/**
+ * <<I80>>
+ *
+ * Intel 8080-series parallel bus. The data lines occupy `bus_width`
+ * consecutive pins starting at `data_base`; the panel latches them on the
+ * rising edge of WR and drives them while RD is low. DCX and CS are plain
+ * GPIO, driven by the connector between bursts.
+ *
+ * When `wide` is set on a 16-bit bus, each pair of bytes is sent in a single
+ * WR cycle, most significant byte first (used for pixel data). Otherwise each
+ * byte takes a cycle of its own on D[7:0], which is what panels expect for
+ * commands and their parameters. On an 8-bit bus `wide` has no effect.
+ */
+struct _osal_i80_bus;
+
+_WEAK_DEF extern struct _osal_i80_bus *
+_osal_i80_bus_init (
+	_osal_gpio_pin_T data_base,
+	uint8_t bus_width,
+	_osal_gpio_pin_T wr,
+	_osal_gpio_pin_T rd,
+	uint32_t wr_cycle_ns
+);
+
+_WEAK_DEF extern void
+_osal_i80_bus_deinit (struct _osal_i80_bus * bus);
+
+_WEAK_DEF extern _Bool
+_osal_i80_write_block (
+	struct _osal_i80_bus * bus,
+	/*_IN_*/ const uint8_t byte_arr[],
+	size_t num_bytes,
+	_Bool wide
+);
+
+_WEAK_DEF extern _Bool
+_osal_i80_write_async (
+	struct _osal_i80_bus * bus,
+	int dma_chan,
+	/*_IN_*/ const uint8_t byte_arr[],
+	size_t num_bytes,
+	_Bool wide,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg
+);
+
+/**
+ * Reads `num_bytes` RD cycles from D[7:0]. The write path is idle for the
+ * duration and is restored before returning.
+ */
+_WEAK_DEF extern _Bool
+_osal_i80_read_block (
+	struct _osal_i80_bus * bus,
+	/*_OUT*/ uint8_t byte_arr[],
+	size_t num_bytes,
+	uint32_t rd_cycle_ns
+);
+
+/**
+ * Blocks until the last WR cycle queued on the bus has completed, so that
+ * DCX or CS may be changed without corrupting it.
+ */
+_WEAK_DEF extern void
+_osal_i80_wait_idle (struct _osal_i80_bus * bus);
+
+/**
+ * <<QSPI>>
+ *
+ * SPI with up to four data lines, D0 through D3 on consecutive pins starting
+ * at `data_base`, and SCK idle low (mode 0). Each write is sent on
+ * `num_lanes` lines (1, 2 or 4), most significant bits first and on the
+ * highest line; the lines of a bus need only be switched between writes.
+ * Reads are single-line, on D1. CS is plain GPIO, driven by the connector.
+ */
+struct _osal_qspi_bus;
+
+_WEAK_DEF extern struct _osal_qspi_bus *
+_osal_qspi_bus_init (
+	_osal_gpio_pin_T data_base,
+	uint8_t max_lanes,
+	_osal_gpio_pin_T sck,
+	uint32_t sck_hz
+);
+
+_WEAK_DEF extern void
+_osal_qspi_bus_deinit (struct _osal_qspi_bus * bus);
+
+_WEAK_DEF extern _Bool
+_osal_qspi_write_block (
+	struct _osal_qspi_bus * bus,
+	/*_IN_*/ const uint8_t byte_arr[],
+	size_t num_bytes,
+	uint8_t num_lanes
+);
+
+_WEAK_DEF extern _Bool
+_osal_qspi_write_async (
+	struct _osal_qspi_bus * bus,
+	int dma_chan,
+	/*_IN_*/ const uint8_t byte_arr[],
+	size_t num_bytes,
+	uint8_t num_lanes,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg
+);
+
+/**
+ * Clocks in `num_bytes` from D1, each SCK period lasting `rd_cycle_ns`. The
+ * write path is idle for the duration and is restored before returning.
+ */
+_WEAK_DEF extern _Bool
+_osal_qspi_read_block (
+	struct _osal_qspi_bus * bus,
+	/*_OUT*/ uint8_t byte_arr[],
+	size_t num_bytes,
+	uint32_t rd_cycle_ns
+);
+
+/**
+ * Blocks until the last bit queued on the bus has been clocked out, so that
+ * CS may be changed without truncating it.
+ */
+_WEAK_DEF extern void
+_osal_qspi_wait_idle (struct _osal_qspi_bus * bus);
+
+/**
+ * <<ASIO>>
+ *
+ * A background worker for `asio.h`. Once started, the worker invokes
+ * `work_fn` whenever it is woken, and otherwise sleeps; a wake which arrives
+ * while `work_fn` is running must cause it to be invoked again, so that no
+ * work is lost. Platforms without a scheduler return NULL from
+ * `_osal_asio_worker_start`, in which case the work is done by polling.
+ */
+typedef void
+(*_osal_asio_work_fn)(void * arg);
+
+_WEAK_DEF extern struct _osal_asio_worker *
+_osal_asio_worker_start (
+	_osal_asio_work_fn work_fn,
+	void * arg
+);
+
+_WEAK_DEF extern void
+_osal_asio_worker_wake (struct _osal_asio_worker * wkr);
+
+/**
+ * Waits for `work_fn` to return, if running, and releases the worker.
+ */
+_WEAK_DEF extern void
+_osal_asio_worker_stop (struct _osal_asio_worker * wkr);
+
 /**
  * <<MGL>>
  */
@@ -200,5 +476,63 @@ _osal_lock_mtx_block_ms (
 	uint32_t ms
 );
 
+_WEAK_DEF extern void
+_osal_unlock_mtx (mipi_osal_mtx_T * osal_mtx);
+
+/**
+ * Releases a mutex made by `_osal_create_mutex`, which must not be held.
+ */
+_WEAK_DEF extern void
+_osal_destroy_mtx (mipi_osal_mtx_T * osal_mtx);
+
 _WEAK_DEF extern uint32_t
 _osal_get_time_ms (void);
+
+/**
+ * Blocks the calling thread for at least `ms`, letting others run. Only for
+ * waits of a millisecond or more; shorter ones spin on `_osal_yield`.
+ */
+_WEAK_DEF extern void
+_osal_sleep_ms (uint32_t ms);
+
+/**
+ * Called on each turn of a loop which spins on a condition set by another
+ * thread or an interrupt.
+ */
+_WEAK_DEF extern void
+_osal_yield (void);
+
+/**
+ * Free-running microsecond counter; it wraps after some 71 minutes, so only
+ * differences between its values are meaningful.
+ */
+_WEAK_DEF extern uint32_t
+_osal_get_time_us (void);
+
+/**
+ * Calls `alarm_cb` once, `ms` from now, in interrupt context (or on a thread
+ * of its own); it must not block. Returns false if no alarm could be set.
+ */
+typedef void
+(*_osal_alarm_cb)(void * cb_arg);
+
+_WEAK_DEF extern _Bool
+_osal_set_alarm_ms (
+	uint32_t ms,
+	_osal_alarm_cb alarm_cb,
+	void * cb_arg
+);
+
+/**
+ * A word which survives a warm reset (eg. by the watchdog), though not loss of
+ * power. `_osal_persist_load` returns false if there is no such storage; the
+ * contents are otherwise whatever was last stored, or garbage after a cold
+ * boot, so a stored word should carry a check of its own.
+ */
+_WEAK_DEF extern _Bool
+_osal_persist_load (uint32_t * word);
+
+_WEAK_DEF extern _Bool
+_osal_persist_store (uint32_t word);
+
+#endif // __MIPI_OSAL__
@@ -0,0 +1,422 @@
+/**
+ * ========================
+ *          asio.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-17
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "asio.h"
+#include "mipi_dcs.h"
+
+/**
+ * Size of each read made for `async_io_read_until` when the register can be
+ * continued; smaller reads find the delimeter sooner, at the cost of a frame
+ * per read.
+ */
+#define _ASYNC_IO_RD_CHUNK 8
+
+#define _ASYNC_IO_MASK (ASYNC_IO_MAX_OPS-1)
+
+/**
+ * `head` is only advanced by producers, with the lock of the context held,
+ * `next` only by the executor and `tail` only by the dispatcher; each reads
+ * the others' with acquire semantics, so that the slot handed over is always
+ * seen in full.
+ */
+#define _ASYNC_IO_LD(ctx, idx) \
+	atomic_load_explicit (&(ctx)->idx, memory_order_acquire)
+#define _ASYNC_IO_ST(ctx, idx, v) \
+	atomic_store_explicit (&(ctx)->idx, (v), memory_order_release)
+
+static void
+_async_io_run (void * arg);
+
+mipi_err_T
+async_io_ctx_init (
+	struct async_io_ctx * io_ctx,
+	_Bool use_worker )
+{
+	if (!io_ctx)
+		return MIPI_ERR_INV;
+
+	memset (io_ctx, 0, sizeof(*io_ctx));
+	io_ctx->mtx=_osal_create_mutex ();
+	atomic_init (&io_ctx->head, 0);
+	atomic_init (&io_ctx->next, 0);
+	atomic_init (&io_ctx->tail, 0);
+	atomic_flag_clear (&io_ctx->in_dispatch);
+
+	if (use_worker)
+		io_ctx->wkr=_osal_asio_worker_start (_async_io_run, io_ctx);
+
+	return 0;
+}
+
+void
+async_io_ctx_free (struct async_io_ctx * io_ctx)
+{
+	if (io_ctx->wkr) {
+		_osal_asio_worker_stop (io_ctx->wkr);
+		io_ctx->wkr=NULL;
+	}
+	_ASYNC_IO_ST (io_ctx, next, _ASYNC_IO_LD (io_ctx, head));
+	_ASYNC_IO_ST (io_ctx, tail, _ASYNC_IO_LD (io_ctx, head));
+	_osal_destroy_mtx (&io_ctx->mtx);
+}
+
+/**
+ * Claims the slot at the head of the ring, returning with the lock of the
+ * context held, or NULL (and the lock released) if there is none.
+ */
+static struct async_io_op *
+_async_io_claim (
+	struct async_io_ctx * io_ctx,
+	_OUT mipi_err_T * err )
+{
+	size_t head;
+
+	if (!_osal_lock_mtx_block_ms (&io_ctx->mtx, MIPI_MAX_TM)) {
+		*err=MIPI_ERR_RES_LOCKED;
+		return NULL;
+	}
+
+	head=atomic_load_explicit (&io_ctx->head, memory_order_relaxed);
+	if (head-_ASYNC_IO_LD (io_ctx, tail)>=ASYNC_IO_MAX_OPS) {
+		io_ctx->num_rejected++;
+		_osal_unlock_mtx (&io_ctx->mtx);
+		*err=MIPI_ERR_NO_MEM;
+		return NULL;
+	}
+
+	struct async_io_op * op=&io_ctx->ops[head & _ASYNC_IO_MASK];
+	*op=(struct async_io_op){ 0 };
+
+	return op;
+}
+
+static void
+_async_io_commit (struct async_io_ctx * io_ctx)
+{
+	size_t head=atomic_load_explicit (&io_ctx->head, memory_order_relaxed);
+
+	_ASYNC_IO_ST (io_ctx, head, head+1);
+	io_ctx->num_submitted++;
+	_osal_unlock_mtx (&io_ctx->mtx);
+
+	if (io_ctx->wkr)
+		_osal_asio_worker_wake (io_ctx->wkr);
+}
+
+mipi_err_T
+async_io_write_some (
+	struct async_io_ctx * io_ctx,
+	struct mipi_io_ctr * io_ctr,
+	_COPY_FROM_USER byte_buffer_view_T in_buff,
+	async_io_write_cb cb,
+	void * cb_arg )
+{
+	struct async_io_op * op;
+	mipi_err_T err;
+
+	if (!io_ctx || !io_ctr || !in_buff.buff || !in_buff.buff_sz)
+		return MIPI_ERR_INV;
+	if (!io_ctr->can_wt || !io_ctr->write_panel_reg)
+		return MIPI_ERR_OP_NOT_IMPL;
+	if (!(op=_async_io_claim (io_ctx, &err)))
+		return err;
+
+	op->kind=ASYNC_IO_WRITE;
+	op->io_ctr=io_ctr;
+	op->len=in_buff.buff_sz<ASYNC_IO_BUFF_CAP ?
+		in_buff.buff_sz :
+		ASYNC_IO_BUFF_CAP;
+	memcpy (op->buff, in_buff.buff, op->len);
+	op->wt_cb=cb;
+	op->cb_arg=cb_arg;
+	_async_io_commit (io_ctx);
+
+	return 0;
+}
+
+static mipi_err_T
+_async_io_submit_read (
+	struct async_io_ctx * io_ctx,
+	struct mipi_io_ctr * io_ctr,
+	enum async_io_op_kind kind,
+	mipi_dcs_cmd_T cmd,
+	uint8_t delim,
+	byte_buffer_T out_buff,
+	async_io_read_cb cb,
+	void * cb_arg )
+{
+	struct async_io_op * op;
+	mipi_err_T err;
+
+	if (!io_ctx || !io_ctr || !out_buff.buff || !out_buff.buff_sz)
+		return MIPI_ERR_INV;
+	if (!io_ctr->can_rd || !io_ctr->read_panel_reg)
+		return MIPI_ERR_OP_NOT_IMPL;
+	if (!(op=_async_io_claim (io_ctx, &err)))
+		return err;
+
+	op->kind=kind;
+	op->io_ctr=io_ctr;
+	op->cmd=cmd;
+	op->delim=delim;
+	op->len=out_buff.buff_sz<ASYNC_IO_BUFF_CAP ?
+		out_buff.buff_sz :
+		ASYNC_IO_BUFF_CAP;
+	op->out_buff=out_buff;
+	op->rd_cb=cb;
+	op->cb_arg=cb_arg;
+	_async_io_commit (io_ctx);
+
+	return 0;
+}
+
+mipi_err_T
+async_io_read_some (
+	struct async_io_ctx * io_ctx,
+	struct mipi_io_ctr * io_ctr,
+	mipi_dcs_cmd_T cmd,
+	_COPY_TO_USER byte_buffer_T out_buff,
+	async_io_read_cb cb,
+	void * cb_arg )
+{
+	return _async_io_submit_read (
+		io_ctx,
+		io_ctr,
+		ASYNC_IO_READ,
+		cmd,
+		0,
+		out_buff,
+		cb,
+		cb_arg
+	);
+}
+
+mipi_err_T
+async_io_read_until (
+	struct async_io_ctx * io_ctx,
+	struct mipi_io_ctr * io_ctr,
+	mipi_dcs_cmd_T cmd,
+	uint8_t delim,
+	_COPY_TO_USER byte_buffer_T out_buff,
+	async_io_read_cb cb,
+	void * cb_arg )
+{
+	return _async_io_submit_read (
+		io_ctx,
+		io_ctr,
+		ASYNC_IO_READ_UNTIL,
+		cmd,
+		delim,
+		out_buff,
+		cb,
+		cb_arg
+	);
+}
+
+static void
+_async_io_exec_read_until (struct async_io_op * op)
+{
+	struct mipi_io_ctr * io=op->io_ctr;
+	const _Bool can_cont=op->cmd==RAMRD || op->cmd==RAMRDC;
+	mipi_dcs_cmd_T cmd=op->cmd;
+	size_t n=0;
+
+	while (n<op->len) {
+		size_t want=op->len-n;
+		ssize_t r;
+
+		if (can_cont && want>_ASYNC_IO_RD_CHUNK)
+			want=_ASYNC_IO_RD_CHUNK;
+		r=io->read_panel_reg (io, cmd, op->buff+n, want);
+		if (r<=0) {
+			op->errno=MIPI_ERR_IO;
+			break;
+		}
+		if ((size_t)r>want)
+			r=(ssize_t)want;
+
+		const uint8_t * d=memchr (op->buff+n, op->delim, (size_t)r);
+		if (d) {
+			op->num_bytes=(size_t)(d-op->buff)+1;
+			return;
+		}
+		n+=(size_t)r;
+		if (!can_cont)
+			break;
+		cmd=RAMRDC;
+	}
+
+	op->num_bytes=n;
+	if (!op->errno)
+		op->errno=MIPI_ERR_NO_MEM;
+}
+
+/**
+ * Runs `op` on its connector. The error the connector raised for it (see
+ * `mipi_io_ctr::take_err`) is passed to its callback along with any of its
+ * own; errors left from before belong to no operation, and are reported.
+ */
+static void
+_async_io_exec (struct async_io_op * op)
+{
+	struct mipi_io_ctr * io=op->io_ctr;
+	ssize_t r;
+
+	if (io->take_err)
+		mipi_err_code|=io->take_err (io);
+
+	switch (op->kind) {
+	case ASYNC_IO_WRITE:
+		io->write_panel_reg (io, op->buff[0], op->buff+1, op->len-1);
+		op->num_bytes=op->len;
+		break;
+	case ASYNC_IO_READ:
+		r=io->read_panel_reg (io, op->cmd, op->buff, op->len);
+		if (r<0)
+			op->errno=MIPI_ERR_IO;
+		else
+			op->num_bytes=(size_t)r<op->len ? (size_t)r : op->len;
+		break;
+	case ASYNC_IO_READ_UNTIL:
+		_async_io_exec_read_until (op);
+		break;
+	default:
+		op->errno=MIPI_ERR_OP_NOT_IMPL;
+		break;
+	}
+
+	if (io->take_err)
+		op->errno|=io->take_err (io);
+}
+
+/**
+ * Runs every operation which has been submitted, in order. This is the work
+ * function of the worker, if there is one; otherwise it is called by
+ * `async_io_poll`. Either way, it is only ever run by one thread at a time.
+ */
+static void
+_async_io_run (void * arg)
+{
+	struct async_io_ctx * io_ctx=arg;
+	size_t next=atomic_load_explicit (&io_ctx->next, memory_order_relaxed);
+
+	while (next!=_ASYNC_IO_LD (io_ctx, head)) {
+		_async_io_exec (&io_ctx->ops[next & _ASYNC_IO_MASK]);
+		next++;
+		_ASYNC_IO_ST (io_ctx, next, next);
+	}
+}
+
+static void
+_async_io_dispatch_op (struct async_io_op * op)
+{
+	if (op->kind==ASYNC_IO_WRITE) {
+		if (op->wt_cb)
+			op->wt_cb (op->errno, op->num_bytes, op->cb_arg);
+		return;
+	}
+
+	memcpy (op->out_buff.buff, op->buff, op->num_bytes);
+	if (op->rd_cb)
+		op->rd_cb (
+			op->errno,
+			byte_buffer (op->out_buff.buff, op->num_bytes),
+			op->cb_arg
+		);
+}
+
+size_t
+async_io_poll (struct async_io_ctx * io_ctx)
+{
+	size_t tail, num_dispatched=0;
+
+	if (atomic_flag_test_and_set_explicit (
+			&io_ctx->in_dispatch,
+			memory_order_acquire))
+		return 0;
+
+	if (!io_ctx->wkr)
+		_async_io_run (io_ctx);
+
+	/**
+	 * The slot is only released once its callback has returned, so that the
+	 * callback may submit another operation without its own being reused.
+	 */
+	tail=atomic_load_explicit (&io_ctx->tail, memory_order_relaxed);
+	while (tail!=_ASYNC_IO_LD (io_ctx, next)) {
+		_async_io_dispatch_op (&io_ctx->ops[tail & _ASYNC_IO_MASK]);
+		tail++;
+		_ASYNC_IO_ST (io_ctx, tail, tail);
+		io_ctx->num_completed++;
+		num_dispatched++;
+	}
+
+	atomic_flag_clear_explicit (&io_ctx->in_dispatch, memory_order_release);
+	return num_dispatched;
+}
+
+static void
+_async_io_await_cb (
+	mipi_err_T errno,
+	byte_buffer_T out_buff,
+	void * cb_arg )
+{
+	struct async_awaitable_result * result=cb_arg;
+
+	result->errno=errno;
+	result->num_bytes=out_buff.buff_sz;
+	result->done=true;
+}
+
+/**
+ * If the read times out, it remains queued and `result` will still be
+ * written when it completes; it must outlive the context, or the read.
+ */
+mipi_err_T
+async_io_await_result (
+	struct async_io_ctx * io_ctx,
+	struct mipi_io_ctr * io_ctr,
+	mipi_dcs_cmd_T cmd,
+	_IN byte_buffer_T read_params_buff,
+	_OUT struct async_awaitable_result * result )
+{
+	mipi_err_T err;
+	uint32_t t0;
+
+	if (!result)
+		return MIPI_ERR_INV;
+
+	result->done=false;
+	err=async_io_read_some (
+		io_ctx,
+		io_ctr,
+		cmd,
+		read_params_buff,
+		_async_io_await_cb,
+		result
+	);
+	if (err)
+		return err;
+
+	t0=_osal_get_time_ms ();
+	while (!result->done) {
+		if (async_io_poll (io_ctx) || result->done)
+			continue;
+		if ((_osal_get_time_ms ()-t0)>=MIPI_MAX_TM)
+			return MIPI_ERR_INTERRUPT;
+		_osal_yield ();
+	}
+
+	return result->errno;
+}
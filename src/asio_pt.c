@@ -0,0 +1,137 @@
+/**
+ * ========================
+ *        asio_pt.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-18
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include "asio_pt.h"
+
+void
+async_pt_sched_init (
+	struct async_pt_sched * sched,
+	struct async_io_ctx * io_ctx )
+{
+	*sched=(struct async_pt_sched){ .io_ctx=io_ctx };
+}
+
+void
+async_pt_spawn (
+	struct async_pt_sched * sched,
+	struct async_pt * pt,
+	async_pt_fn fn,
+	void * arg )
+{
+	struct async_pt ** link=&sched->head;
+
+	*pt=(struct async_pt){ .fn=fn, .arg=arg };
+	while (*link)
+		link=&(*link)->next;
+	*link=pt;
+	sched->num_pts++;
+}
+
+size_t
+async_pt_sched_run (struct async_pt_sched * sched)
+{
+	struct async_pt ** link=&sched->head;
+
+	if (sched->io_ctx)
+		async_io_poll (sched->io_ctx);
+
+	while (*link) {
+		struct async_pt * pt=*link;
+
+		sched->num_resumes++;
+		if (pt->fn (pt, pt->arg)==ASYNC_PT_EXITED) {
+			*link=pt->next;
+			pt->next=NULL;
+			sched->num_pts--;
+			continue;
+		}
+		link=&pt->next;
+	}
+
+	return sched->num_pts;
+}
+
+static void
+_async_pt_write_done (
+	mipi_err_T errno,
+	size_t bytes_written,
+	void * cb_arg )
+{
+	struct async_pt * pt=cb_arg;
+
+	pt->io.errno=errno;
+	pt->io.num_bytes=bytes_written;
+	pt->io.done=true;
+}
+
+static void
+_async_pt_read_done (
+	mipi_err_T errno,
+	byte_buffer_T out_buff,
+	void * cb_arg )
+{
+	_async_pt_write_done (errno, out_buff.buff_sz, cb_arg);
+}
+
+/**
+ * Only a full queue is worth retrying; anything else would fail again.
+ */
+static _Bool
+_async_pt_submitted (
+	struct async_pt * pt,
+	mipi_err_T err )
+{
+	if (err==MIPI_ERR_NO_MEM)
+		return false;
+	if (err) {
+		pt->io.errno=err;
+		pt->io.num_bytes=0;
+		pt->io.done=true;
+	}
+	return true;
+}
+
+_Bool
+async_pt_submit_write (
+	struct async_pt * pt,
+	struct async_io_ctx * io_ctx,
+	struct mipi_io_ctr * io_ctr,
+	_COPY_FROM_USER byte_buffer_view_T in_buff )
+{
+	pt->io.done=false;
+	return _async_pt_submitted (
+		pt,
+		async_io_write_some (io_ctx, io_ctr, in_buff, _async_pt_write_done, pt)
+	);
+}
+
+_Bool
+async_pt_submit_read (
+	struct async_pt * pt,
+	struct async_io_ctx * io_ctx,
+	struct mipi_io_ctr * io_ctr,
+	mipi_dcs_cmd_T cmd,
+	_COPY_TO_USER byte_buffer_T out_buff )
+{
+	pt->io.done=false;
+	return _async_pt_submitted (
+		pt,
+		async_io_read_some (
+			io_ctx,
+			io_ctr,
+			cmd,
+			out_buff,
+			_async_pt_read_done,
+			pt
+		)
+	);
+}
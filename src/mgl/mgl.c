@@ -5,6 +5,7 @@
 #include "pico/async_context_poll.h"
 
 #include "mipi.h"
+#include "mipi_txq.h"
 #include "mgl.h"
 
 /**
@@ -19,6 +20,18 @@ _mgl_init_fmbf_tx (struct mgl_gfx_ctx * ctx);
 static void
 _mgl_render_gfx_objs (struct mgl_gfx_ctx * ctx);
 
+static void
+_mgl_drain_txq (
+	async_context_t * async_ctx,
+	async_when_pending_worker_t * wkr
+);
+
+static void
+_mgl_resume_txq (
+	async_context_t * async_ctx,
+	async_at_time_worker_t * wkr
+);
+
 /* clang-format off */
 /**
  * Number of MS per each tick.
@@ -46,7 +59,8 @@ static struct _mipi_evt_tk_ll_node * _evt_tk_cbs;
 
 enum _mgl_async_task_type {
   MGL_REDRAW_DIRTY_FMBF_TASK,
-  MGL_INIT_FMBF_TX_TASK
+  MGL_INIT_FMBF_TX_TASK,
+  MGL_DRAIN_TXQ_TASK
 };
 
 /**
@@ -86,6 +100,10 @@ _evt_tick_wkr[]=
 	{
 		.do_work=_mgl_init_fmbf_tx,
 	},
+	[MGL_DRAIN_TXQ_TASK]=
+	{
+		.do_work=_mgl_drain_txq,
+	},
 	{
 		/* SENTINEL */
 	}
@@ -261,15 +279,263 @@ mgl_set_evt_tick_cb (
 	}
 }
 
+void
+mgl_mark_area_dirty (
+	struct mgl_gfx_ctx * gfx_ctx,
+	const struct mipi_area bds )
+{
+	struct mipi_area * dirty=&gfx_ctx->dirty_bds;
+
+	if (!bds.w || !bds.h)
+		return;
+
+	if (gfx_ctx->used_y0>=gfx_ctx->used_y1) {
+		gfx_ctx->used_y0=bds.y;
+		gfx_ctx->used_y1=bds.y+bds.h;
+	} else {
+		gfx_ctx->used_y0=MIN (gfx_ctx->used_y0, bds.y);
+		gfx_ctx->used_y1=MAX (gfx_ctx->used_y1, bds.y+bds.h);
+	}
+
+	if (!dirty->h) {
+		*dirty=bds;
+	} else {
+		const uint x1=MAX (dirty->x+dirty->w, bds.x+bds.w),
+			y1=MAX (dirty->y+dirty->h, bds.y+bds.h);
+
+		dirty->x=MIN (dirty->x, bds.x);
+		dirty->y=MIN (dirty->y, bds.y);
+		dirty->w=(uint16_t)(x1-dirty->x);
+		dirty->h=(uint16_t)(y1-dirty->y);
+	}
+
+	async_context_set_work_pending (
+		&_async_ctx,
+		&_evt_tick_wkr[MGL_REDRAW_DIRTY_FMBF_TASK]
+	);
+}
+
 void
 mgl_mark_fmbf_dirty (struct mgl_gfx_ctx * gfx_ctx)
 {
+	mgl_mark_area_dirty (gfx_ctx, gfx_ctx->fmbf_bounds);
+}
+
+void
+mgl_set_partial_policy (
+	struct mgl_gfx_ctx * gfx_ctx,
+	uint16_t max_rows,
+	uint8_t settle_frames )
+{
+	if (!mipi_dbi_set_ptl_policy (gfx_ctx->panel_dev, max_rows, settle_frames))
+		return;
+
+	// Rows outside of the partial area were clipped, so resend all of them.
+	gfx_ctx->dirty_bds=gfx_ctx->fmbf_bounds;
 	async_context_set_work_pending (
 		&_async_ctx,
 		&_evt_tick_wkr[MGL_REDRAW_DIRTY_FMBF_TASK]
 	);
 }
 
+/**
+ * Nothing is drawn on the screen afterwards, so no rows are in use until the
+ * next draw.
+ */
+void
+mgl_clear_screen (struct mgl_gfx_ctx * gfx_ctx)
+{
+	struct mipi_shared_fmbf * fmbf=&gfx_ctx->gfx_fmbf;
+
+	if (!mutex_enter_timeout_ms (&fmbf->clr_buff_mtx, MIPI_MAX_TM)) {
+		_mipi_dbg (
+			MIPI_DBG_TAG,
+			"stalled acquiring lock for frame buffer, screen not cleared"
+		);
+		return;
+	}
+	for (size_t i=0; i<fmbf->fmbf_sz; i++)
+		fmbf->clr_buff[i]=(struct mipi_color){ 0 };
+	mutex_exit (&fmbf->clr_buff_mtx);
+
+	mgl_mark_fmbf_dirty (gfx_ctx);
+	gfx_ctx->used_y0=0;
+	gfx_ctx->used_y1=0;
+}
+
+mipi_err_T
+mgl_set_scroll_area (
+	struct mgl_gfx_ctx * gfx_ctx,
+	uint16_t tfa,
+	uint16_t bfa )
+{
+	mipi_err_T err=mipi_dbi_set_scroll_area (gfx_ctx->panel_dev, tfa, bfa);
+
+	/**
+	 * The scroll position is reset, so the screen shows the frame buffer as
+	 * it is laid out again.
+	 */
+	if (!err)
+		mgl_mark_fmbf_dirty (gfx_ctx);
+	return err;
+}
+
+mipi_err_T
+mgl_scroll (
+	struct mgl_gfx_ctx * gfx_ctx,
+	int rows )
+{
+	struct mipi_area exposed;
+	mipi_err_T err=mipi_dbi_scroll (gfx_ctx->panel_dev, rows, &exposed);
+
+	if (!err)
+		mgl_mark_area_dirty (gfx_ctx, exposed);
+	return err;
+}
+
+/**
+ * Converts the dirty rows of the frame buffer of the context to the output
+ * IFPF of its panel and transmits them. The frame buffer lock is held until
+ * the last chunk has been sent, as the conversion reads from it as the
+ * transfer progresses.
+ *
+ * Whole rows are sent, so that each run of them is contiguous in the frame
+ * buffer; while the panel is scrolled, the dirty area may map to up to
+ * `MIPI_DBI_SCROLL_MAX_AREAS` runs of GRAM. In partial mode, only the rows
+ * of the partial area are sent.
+ */
+static void
+_mgl_init_fmbf_tx (struct mgl_gfx_ctx * ctx)
+{
+	struct mipi_shared_fmbf * fmbf=&ctx->gfx_fmbf;
+	const struct mipi_area * fb=&ctx->fmbf_bounds;
+	struct mipi_area runs[MIPI_DBI_SCROLL_MAX_AREAS];
+	struct mipi_area rows;
+	size_t num_runs;
+	_Bool b_lock;
+
+	if (!ctx->dirty_bds.h)
+		return;
+
+	/**
+	 * Rows outside of the partial area are not sent while the panel is in
+	 * partial mode, so leaving it, or moving the area, means sending the
+	 * whole frame (of which only the new area is sent, if still partial).
+	 */
+	if (mipi_dbi_note_active_rows (
+			ctx->panel_dev,
+			ctx->used_y0,
+			ctx->used_y1-ctx->used_y0
+		))
+		ctx->dirty_bds=*fb;
+	if (mipi_dbi_eval_ptl (ctx->panel_dev))
+		ctx->dirty_bds=*fb;
+
+	rows=(struct mipi_area){ fb->x, ctx->dirty_bds.y, fb->w, ctx->dirty_bds.h };
+	ctx->dirty_bds=(struct mipi_area){ 0 };
+	if (!mipi_dbi_clip_to_ptl (ctx->panel_dev, &rows))
+		return;
+	num_runs=mipi_dbi_scroll_map_area (ctx->panel_dev, rows, runs);
+
+	b_lock=mutex_enter_timeout_ms (
+		&fmbf->clr_buff_mtx,
+		MIPI_MAX_TM
+	);
+
+	if (!b_lock) {
+		_mipi_dbg (
+			MIPI_DBG_TAG,
+			"stalled acquiring lock for frame buffer, frame dropped"
+		);
+		return;
+	}
+
+	for (size_t i=0; i<num_runs; i++) {
+		mipi_stream_fmbf (
+			ctx->panel_dev,
+			fmbf->clr_buff+(size_t)(runs[i].y-fb->y)*fb->w,
+			runs[i]
+		);
+	}
+	mutex_exit (&fmbf->clr_buff_mtx);
+}
+
+/**
+ * The queue attached with `mgl_set_txq`. Only core 1 drains it, from within
+ * the async context, so there is never more than one drain owner.
+ */
+static struct mipi_txq * volatile _txq;
+
+/**
+ * Wakes the drain once a delay at the head of the queue has run out; nothing
+ * else would, if no more is submitted in the meantime.
+ */
+static async_at_time_worker_t _txq_resume_wkr=
+{
+	.do_work=_mgl_resume_txq,
+};
+
+static void
+_mgl_drain_txq (
+	async_context_t * async_ctx,
+	async_when_pending_worker_t * wkr )
+{
+	struct mipi_txq * txq=_txq;
+	int32_t left_ms;
+
+	(void)wkr;
+	if (!txq)
+		return;
+	mipi_txq_drain (txq, SIZE_MAX);
+	if (!txq->in_delay)
+		return;
+
+	left_ms=(int32_t)(txq->resume_at_ms-_osal_get_time_ms ());
+	async_context_remove_at_time_worker (async_ctx, &_txq_resume_wkr);
+	async_context_add_at_time_worker_in_ms (
+		async_ctx,
+		&_txq_resume_wkr,
+		left_ms>0 ? (uint32_t)left_ms : 0
+	);
+}
+
+static void
+_mgl_resume_txq (
+	async_context_t * async_ctx,
+	async_at_time_worker_t * wkr )
+{
+	(void)wkr;
+	async_context_set_work_pending (
+		async_ctx,
+		&_evt_tick_wkr[MGL_DRAIN_TXQ_TASK]
+	);
+}
+
+static void
+_mgl_txq_on_submit (void * arg)
+{
+	(void)arg;
+	async_context_set_work_pending (
+		&_async_ctx,
+		&_evt_tick_wkr[MGL_DRAIN_TXQ_TASK]
+	);
+}
+
+void
+mgl_set_txq (struct mipi_txq * txq)
+{
+	if (_txq)
+		_txq->on_submit=NULL;
+	if (txq) {
+		txq->on_submit_arg=NULL;
+		txq->on_submit=_mgl_txq_on_submit;
+	}
+	_txq=txq;
+
+	// Anything submitted before it was attached is issued now.
+	_mgl_txq_on_submit (NULL);
+}
+
 void
 mgl_exec_task_in_bkgd (mgl_bkgd_task_cb bkgd_tsk)
 {
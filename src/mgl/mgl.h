@@ -78,7 +78,11 @@ struct mgl_gfx_obj {
 struct mipi_shared_fmbf {
   const size_t fmbf_sz;
   mutex_t clr_buff_mtx; // struct rw_lock buff_lk;
-  volatile struct mipi_color clr_buff[];
+  /**
+   * Only ever accessed with `clr_buff_mtx` held, which orders the accesses
+   * of the renderer and the flush, so the colors need not be volatile.
+   */
+  struct mipi_color clr_buff[];
 };
 // THREAD 1:
 // volatile int f,x; // volatile ensures that compiler optimizations do not
@@ -115,6 +119,21 @@ struct _mgl_obj_ll_node;
 struct mgl_gfx_ctx {
   struct mipi_area fmbf_bounds;
   struct mipi_dbi_dev * panel_dev;
+  /**
+   * The frame buffer mirrors GRAM, rather than the screen, so that scrolling
+   * the panel does not move its contents (see `mgl_scroll`). Rows of the
+   * screen are mapped to it with `mgl_fmbf_row`.
+   *
+   * Screen area which has changed since the last transmission, in screen
+   * coordinates; only it is sent to the panel. Empty when `h` is 0.
+   */
+  struct mipi_area dirty_bds;
+  /**
+   * Rows which have been drawn to since the screen was last cleared. They
+   * are reported to the panel device each frame, which switches the panel
+   * to partial mode while they are few (see `mipi_dbi_set_ptl_policy`).
+   */
+  uint16_t used_y0, used_y1;
   /**
    * Each entry in the object stack is an object node, which consists of a
    * linked list of `_mgl_pt` objects to be joined in an anti-clockwise order
@@ -185,6 +204,77 @@ mgl_set_evt_tick_cb (
 extern void
 mgl_exec_task_in_bkgd (mgl_bkgd_task_cb bkgd_cb);
 
+struct mipi_txq;
+
+/**
+ * Makes the event tick loop the drain owner of `txq` (see `mipi_txq.h`).
+ * Submissions to the queue from either core wake the loop, which issues them
+ * to the connector between its other tasks. Pass `NULL` to detach it again;
+ * the queue must not be freed while it is attached.
+ */
+extern void
+mgl_set_txq (struct mipi_txq * txq);
+
+/**
+ * Marks the area `bds` of the screen as changed, so that it is rendered and
+ * transmitted in the next tick; `mgl_mark_fmbf_dirty` marks the whole of it.
+ * Both must be called from within an event tick callback.
+ */
+extern void
+mgl_mark_area_dirty (
+  struct mgl_gfx_ctx * self,
+  const struct mipi_area bds
+);
+
+extern void
+mgl_mark_fmbf_dirty (struct mgl_gfx_ctx * self);
+
+/**
+ * Switches the panel to partial mode, showing only the rows drawn to since
+ * the screen was last cleared, once they have spanned at most `max_rows` for
+ * `settle_frames` frames; it returns to normal mode as soon as anything is
+ * drawn outside of them. `max_rows` of 0 disables partial mode.
+ */
+extern void
+mgl_set_partial_policy (
+  struct mgl_gfx_ctx * self,
+  uint16_t max_rows,
+  uint8_t settle_frames
+);
+
+/**
+ * Keeps the top `tfa` and bottom `bfa` rows of the screen in place and
+ * scrolls those between them with the panel (see `mipi_dbi_set_scroll_area`).
+ */
+extern mipi_err_T
+mgl_set_scroll_area (
+  struct mgl_gfx_ctx * self,
+  uint16_t tfa,
+  uint16_t bfa
+);
+
+/**
+ * Scrolls the scroll area up by `rows` (down, if negative). Nothing already
+ * on the screen is redrawn or retransmitted; only the rows scrolled into
+ * view are marked dirty, for the caller to draw into.
+ */
+extern mipi_err_T
+mgl_scroll (
+  struct mgl_gfx_ctx * self,
+  int rows
+);
+
+/**
+ * Row of the frame buffer shown at row `y` of the screen.
+ */
+static inline uint
+mgl_fmbf_row (
+  const struct mgl_gfx_ctx * self,
+  uint y )
+{
+  return mipi_dbi_scroll_map_row (self->panel_dev, (uint16_t)y);
+}
+
 extern void
 mgl_ctx_set_render_buffer (
   struct mgl_gfx_ctx * self,
@@ -0,0 +1,228 @@
+/**
+ * ========================
+ *     mipi_bus_sched.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-13
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "mipi_dcs.h"
+#include "mipi_bus_sched.h"
+
+void
+mipi_bus_sched_init (
+	struct mipi_bus_sched * self,
+	size_t quantum )
+{
+	memset (self, 0, sizeof(*self));
+	self->quantum=quantum ? quantum : MIPI_TX_CHUNK_SZ;
+}
+
+int
+mipi_bus_sched_add (
+	struct mipi_bus_sched * self,
+	struct mipi_txq * txq )
+{
+	struct mipi_bus_port * port;
+
+	if (!txq || self->num_ports>=MIPI_BUS_SCHED_MAX_PORTS)
+		return -1;
+
+	port=&self->ports[self->num_ports];
+	memset (port, 0, sizeof(*port));
+	port->txq=txq;
+
+	return self->num_ports++;
+}
+
+/**
+ * Sends the next quantum of the window the port is part way through,
+ * completing it if this is the last. A quantum which the connector fails
+ * ends the window there: the panel may not have accepted it, so there is
+ * nothing to continue with RAMWRC.
+ */
+static void
+_mipi_bus_sched_px_turn (
+	struct mipi_bus_sched * self,
+	struct mipi_bus_port * port )
+{
+	struct mipi_io_ctr * io=port->txq->io;
+	const struct mipi_txq_desc * desc=&port->cur;
+	size_t len=desc->px_sz-port->cur_off;
+	uint8_t ca_params[4], ra_params[4];
+	mipi_err_T err;
+
+	if (len>self->quantum)
+		len=self->quantum;
+
+	// As in `mipi_txq_issue`, errors left from before belong to no window.
+	if (io->take_err)
+		mipi_err_code|=io->take_err (io);
+
+	if (!port->cur_off) {
+		_mipi_dcs_pack_addr (
+			ca_params,
+			desc->bds.x,
+			(uint16_t)(desc->bds.x+desc->bds.w-1)
+		);
+		_mipi_dcs_pack_addr (
+			ra_params,
+			desc->bds.y,
+			(uint16_t)(desc->bds.y+desc->bds.h-1)
+		);
+		io->write_panel_txn (
+			io,
+			(const struct mipi_io_txn_seg [])
+			{
+				{ .cmd=CASET, .params=ca_params, .num_params=4 },
+				{ .cmd=RASET, .params=ra_params, .num_params=4 },
+				{ .cmd=RAMWR }
+			},
+			3,
+			desc->px_data,
+			len
+		);
+	} else {
+		io->write_panel_txn (
+			io,
+			(const struct mipi_io_txn_seg []){{ .cmd=RAMWRC }},
+			1,
+			desc->px_data+port->cur_off,
+			len
+		);
+	}
+
+	err=io->take_err ? io->take_err (io) : 0;
+	port->cur_off+=len;
+	port->num_px_bytes+=len;
+	if (!err && port->cur_off<desc->px_sz)
+		return;
+
+	port->has_cur=false;
+	if (desc->done_cb)
+		desc->done_cb (io, err, desc->cb_arg);
+}
+
+/**
+ * Takes one turn on behalf of the port, returning `false` if it had nothing
+ * it could issue.
+ */
+static _Bool
+_mipi_bus_sched_turn (
+	struct mipi_bus_sched * self,
+	struct mipi_bus_port * port )
+{
+	struct mipi_txq * txq=port->txq;
+	const struct mipi_txq_desc * head;
+
+	if (port->in_delay) {
+		if ((int32_t)(_osal_get_time_ms ()-port->resume_at_ms)<0)
+			return false;
+		port->in_delay=false;
+	}
+
+	while (!port->has_cur) {
+		head=mipi_txq_peek (txq);
+		if (!head)
+			return false;
+
+		switch (head->op) {
+		case MIPI_TXQ_DELAY:
+			port->in_delay=true;
+			port->resume_at_ms=_osal_get_time_ms ()+head->delay_ms;
+			mipi_txq_consume (txq);
+			return false;
+		case MIPI_TXQ_AREA:
+			/**
+			 * Connectors without a transaction op cannot continue a window, so
+			 * such a port has the bus for the whole of it.
+			 */
+			if (head->px_sz && txq->io->write_panel_txn) {
+				port->cur=*head;
+				port->cur_off=0;
+				port->has_cur=true;
+				mipi_txq_consume (txq);
+				break;
+			}
+			// fall through
+		case MIPI_TXQ_CMD:
+		{
+			const struct mipi_txq_desc desc=*head;
+
+			mipi_txq_consume (txq);
+			mipi_txq_issue (txq->io, &desc);
+			txq->num_issued++;
+			return true;
+		}
+		default:
+			// Not a descriptor which can be issued; drop it.
+			mipi_txq_consume (txq);
+			break;
+		}
+	}
+
+	_mipi_bus_sched_px_turn (self, port);
+	if (!port->has_cur)
+		txq->num_issued++;
+	return true;
+}
+
+size_t
+mipi_bus_sched_run (
+	struct mipi_bus_sched * self,
+	size_t max_turns )
+{
+	size_t n=0;
+	uint8_t num_idle=0;
+
+	/**
+	 * Visit the ports round robin, starting after the last one to have had a
+	 * turn, and stop once a full round has passed without one.
+	 */
+	while (n<max_turns && self->num_ports && num_idle<self->num_ports) {
+		const uint8_t idx=self->next_port;
+		struct mipi_bus_port * port=&self->ports[idx];
+
+		self->next_port=(uint8_t)((idx+1)%self->num_ports);
+		if (!_mipi_bus_sched_turn (self, port)) {
+			num_idle++;
+			continue;
+		}
+
+		if (self->num_turns && idx!=self->last_port)
+			self->num_switches++;
+		self->last_port=idx;
+		self->num_turns++;
+		port->num_turns++;
+		num_idle=0;
+		n++;
+	}
+
+	return n;
+}
+
+_Bool
+mipi_bus_sched_next_deadline (
+	const struct mipi_bus_sched * self,
+	_OUT uint32_t * at_ms )
+{
+	_Bool found=false;
+
+	for (uint8_t i=0; i<self->num_ports; i++) {
+		const struct mipi_bus_port * port=&self->ports[i];
+
+		if (!port->in_delay)
+			continue;
+		if (!found || (int32_t)(port->resume_at_ms-*at_ms)<0)
+			*at_ms=port->resume_at_ms;
+		found=true;
+	}
+
+	return found;
+}
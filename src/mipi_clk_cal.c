@@ -0,0 +1,164 @@
+/**
+ * ========================
+ *      mipi_clk_cal.c
+ * ========================
+ *
+ * Calibration of the pixel clock of a panel connector, by writing a test
+ * pattern at increasing rates and reading it back at a safe one.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-10
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+
+/**
+ * Fills `buff` with a pattern which differs for each trial. Alternating bits
+ * catch most sampling errors at high clock rates; the trial number mixed in
+ * keeps a stale readback from passing for a fresh write.
+ */
+static void
+_mipi_cal_pattern (
+	_OUT uint8_t buff[],
+	size_t len,
+	uint32_t trial )
+{
+	uint32_t x=0x9E3779B9u^(trial*0x85EBCA6Bu);
+
+	for (size_t i=0; i<len; i++) {
+		x^=x<<13;
+		x^=x>>17;
+		x^=x<<5;
+		buff[i]=(i & 1)
+			? (uint8_t)(0xAA^(x & 0x0F))
+			: (uint8_t)(0x55^(x & 0xF0));
+	}
+}
+
+static _Bool
+_mipi_cal_read_id (
+	struct mipi_io_ctr * io,
+	_OUT uint8_t id[3] )
+{
+	return io->read_panel_reg (io, RDDID, id, 3)==3;
+}
+
+static _Bool
+_mipi_cal_trial (
+	struct mipi_io_ctr * io,
+	_IN const struct mipi_clk_cal_cfg * cfg,
+	uint32_t trial )
+{
+	const size_t num_px=(size_t)cfg->win.w*cfg->win.h,
+		wr_sz=num_px*cfg->wr_bytes_per_px,
+		rd_sz=num_px*cfg->rd_bytes_per_px;
+	uint8_t wr_buff[MIPI_CLK_CAL_PATTERN_SZ], rd_buff[MIPI_CLK_CAL_PATTERN_SZ],
+		ca_params[4], ra_params[4];
+	const struct mipi_io_txn_seg segs[]=
+	{
+		{ .cmd=CASET, .params=ca_params, .num_params=sizeof(ca_params) },
+		{ .cmd=RASET, .params=ra_params, .num_params=sizeof(ra_params) },
+		{ .cmd=RAMWR }
+	};
+
+	_mipi_dcs_pack_addr (
+		ca_params,
+		cfg->win.x,
+		(uint16_t)(cfg->win.x+cfg->win.w-1)
+	);
+	_mipi_dcs_pack_addr (
+		ra_params,
+		cfg->win.y,
+		(uint16_t)(cfg->win.y+cfg->win.h-1)
+	);
+	_mipi_cal_pattern (wr_buff, wr_sz, trial);
+
+	io->write_panel_txn (io, segs, 3, wr_buff, wr_sz);
+
+	/**
+	 * RAMRD reads from the start of the window, which is still that of the
+	 * write; the address commands are not part of the phase under test, so
+	 * are sent again at the rate of register writes.
+	 */
+	io->write_panel_reg (io, CASET, ca_params, sizeof(ca_params));
+	io->write_panel_reg (io, RASET, ra_params, sizeof(ra_params));
+	memset (rd_buff, 0, rd_sz);
+	if (io->read_panel_reg (io, RAMRD, rd_buff, rd_sz)!=(ssize_t)rd_sz)
+		return false;
+
+	if (cfg->px_match)
+		return cfg->px_match (wr_buff, rd_buff, num_px, cfg->px_match_arg);
+	return rd_sz==wr_sz && !memcmp (wr_buff, rd_buff, wr_sz);
+}
+
+mipi_err_T
+mipi_calibrate_px_clk (
+	struct mipi_io_ctr * io,
+	_IN const struct mipi_clk_cal_cfg * cfg,
+	_OUT struct mipi_clk_cal_result * res )
+{
+	const size_t num_px=(size_t)cfg->win.w*cfg->win.h;
+	uint32_t hz, trial=0;
+	uint8_t id[3];
+
+	memset (res, 0, sizeof(*res));
+	/**
+	 * `can_rd` is only set by connectors whose `read_panel_reg` works; some
+	 * provide one which always fails.
+	 */
+	if (!io->can_rd
+			|| !io->set_phase_clk
+			|| !io->read_panel_reg
+			|| !io->write_panel_txn)
+		return MIPI_ERR_OP_NOT_IMPL;
+	if (!num_px
+			|| !cfg->step_hz
+			|| !cfg->num_trials
+			|| cfg->start_hz>cfg->max_hz
+			|| num_px*cfg->wr_bytes_per_px>MIPI_CLK_CAL_PATTERN_SZ
+			|| num_px*cfg->rd_bytes_per_px>MIPI_CLK_CAL_PATTERN_SZ)
+		return MIPI_ERR_INV;
+
+	if (!_mipi_cal_read_id (io, res->id)) {
+		_mipi_dbg (MIPI_DBG_TAG, "panel did not answer RDDID");
+		return MIPI_ERR_OP_NOT_IMPL;
+	}
+
+	for (hz=cfg->start_hz; hz<=cfg->max_hz; hz+=cfg->step_hz) {
+		const uint32_t set_hz=io->set_phase_clk (io, MIPI_IO_PHASE_PX, hz);
+		_Bool pass=(set_hz!=0);
+
+		res->num_rates++;
+		for (uint8_t i=0; pass && i<cfg->num_trials; i++)
+			pass=_mipi_cal_trial (io, cfg, trial++);
+		if (pass)
+			pass=_mipi_cal_read_id (io, id) && !memcmp (id, res->id, sizeof(id));
+
+		if (!pass) {
+			res->fail_hz=hz;
+			break;
+		}
+		res->max_pass_hz=hz;
+
+		if (hz>cfg->max_hz-cfg->step_hz) // << would wrap around
+			break;
+	}
+
+	if (!res->max_pass_hz) {
+		io->set_phase_clk (io, MIPI_IO_PHASE_PX, cfg->start_hz);
+		return MIPI_ERR_IO;
+	}
+
+	hz=res->max_pass_hz;
+	for (uint8_t i=0; i<cfg->margin_steps && hz>=cfg->start_hz+cfg->step_hz; i++)
+		hz-=cfg->step_hz;
+	res->px_hz=io->set_phase_clk (io, MIPI_IO_PHASE_PX, hz);
+
+	return 0;
+}
@@ -0,0 +1,366 @@
+/**
+ * ========================
+ *        mipi_cvt.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-21
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "mipi_cvt.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define _MIPI_CVT_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * The kernels read the frame buffer as packed R, G, B bytes.
+ */
+_Static_assert (
+	sizeof(struct mipi_color)==3,
+	"struct mipi_color must be packed RGB"
+);
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+#define _MIPI_CVT_LE
+#endif
+
+/**
+ * Clamps `num_px` to the pixels `out` has room for.
+ */
+static inline size_t
+_mipi_cvt_fit (
+	size_t num_px,
+	size_t out_sz )
+{
+	return num_px>out_sz/2 ? out_sz/2 : num_px;
+}
+
+/**
+ * Converts the pixels from `i` on with the scalar reference, and returns the
+ * total size of the output.
+ */
+static inline size_t
+_mipi_cvt_tail (
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t i,
+	size_t num_px,
+	_OUT uint8_t out[] )
+{
+	_ifpf_cvt_rgb565 (self, in+i, num_px-i, out+2*i, 2*(num_px-i));
+	return 2*num_px;
+}
+
+/**
+ * Each 16-bit lane holds one pixel, so shifts which cross into the lane above
+ * are masked off again.
+ */
+static size_t
+_mipi_cvt_rgb565_swar (
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz )
+{
+	const uint8_t * p=(const uint8_t *) in;
+	size_t i=0;
+
+	num_px=_mipi_cvt_fit (num_px, out_sz);
+	for (; i+2<=num_px; i+=2, p+=6) {
+		const uint32_t r=p[0] | (uint32_t)p[3]<<16,
+			g=p[1] | (uint32_t)p[4]<<16,
+			b=p[2] | (uint32_t)p[5]<<16;
+		const uint32_t hi=(b & 0x00F800F8u) | ((g>>5) & 0x00070007u),
+			lo=((g & 0x001C001Cu)<<3) | ((r>>3) & 0x001F001Fu);
+		const uint32_t w=hi | lo<<8; // << hi0, lo0, hi1, lo1 in memory
+
+		memcpy (out+2*i, &w, sizeof(w));
+	}
+
+	return _mipi_cvt_tail (self, in, i, num_px, out);
+}
+
+#ifdef _MIPI_CVT_X86
+static inline uint32_t
+_mipi_cvt_ld32 (const uint8_t * p)
+{
+	uint32_t v;
+
+	memcpy (&v, p, sizeof(v));
+	return v;
+}
+
+/**
+ * Converts the pixel in the low three bytes of each 32-bit lane (R in the
+ * lowest) to RGB565, in the low half of the lane.
+ */
+static inline __m128i
+_mipi_cvt_565_x4 (__m128i v)
+{
+	const __m128i b=_mm_and_si128 (_mm_srli_epi32 (v, 16), _mm_set1_epi32 (0xF8)),
+		g_hi=_mm_and_si128 (_mm_srli_epi32 (v, 13), _mm_set1_epi32 (0x07)),
+		g_lo=_mm_and_si128 (_mm_slli_epi32 (v, 3), _mm_set1_epi32 (0xE000)),
+		r=_mm_and_si128 (_mm_slli_epi32 (v, 5), _mm_set1_epi32 (0x1F00));
+
+	return _mm_or_si128 (_mm_or_si128 (b, g_hi), _mm_or_si128 (g_lo, r));
+}
+
+/**
+ * SSE2 has no byte shuffle, so each pixel is loaded as a word of its own;
+ * the fourth byte of each belongs to the next pixel, which is why the loop
+ * stops short of the last. The results are sign-extended, as SSE2 can only
+ * narrow to 16 bits with signed saturation.
+ */
+static size_t
+_mipi_cvt_rgb565_sse2 (
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz )
+{
+	const uint8_t * p=(const uint8_t *) in;
+	size_t i=0;
+
+	num_px=_mipi_cvt_fit (num_px, out_sz);
+	for (; i+8<num_px; i+=8, p+=24) {
+		__m128i v0=_mm_set_epi32 (
+			(int)_mipi_cvt_ld32 (p+9),
+			(int)_mipi_cvt_ld32 (p+6),
+			(int)_mipi_cvt_ld32 (p+3),
+			(int)_mipi_cvt_ld32 (p)
+		);
+		__m128i v1=_mm_set_epi32 (
+			(int)_mipi_cvt_ld32 (p+21),
+			(int)_mipi_cvt_ld32 (p+18),
+			(int)_mipi_cvt_ld32 (p+15),
+			(int)_mipi_cvt_ld32 (p+12)
+		);
+
+		v0=_mm_srai_epi32 (_mm_slli_epi32 (_mipi_cvt_565_x4 (v0), 16), 16);
+		v1=_mm_srai_epi32 (_mm_slli_epi32 (_mipi_cvt_565_x4 (v1), 16), 16);
+		_mm_storeu_si128 ((void *)(out+2*i), _mm_packs_epi32 (v0, v1));
+	}
+
+	return _mipi_cvt_tail (self, in, i, num_px, out);
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+_mipi_cvt_565_x8 (__m256i v)
+{
+	const __m256i b=_mm256_and_si256 (_mm256_srli_epi32 (v, 16), _mm256_set1_epi32 (0xF8)),
+		g_hi=_mm256_and_si256 (_mm256_srli_epi32 (v, 13), _mm256_set1_epi32 (0x07)),
+		g_lo=_mm256_and_si256 (_mm256_slli_epi32 (v, 3), _mm256_set1_epi32 (0xE000)),
+		r=_mm256_and_si256 (_mm256_slli_epi32 (v, 5), _mm256_set1_epi32 (0x1F00));
+
+	return _mm256_or_si256 (_mm256_or_si256 (b, g_hi), _mm256_or_si256 (g_lo, r));
+}
+
+/**
+ * As SSE2, with the pixels gathered eight at a time. `packus` narrows within
+ * each 128-bit half, so the quarters are put back in order afterwards.
+ */
+__attribute__((target("avx2"))) static size_t
+_mipi_cvt_rgb565_avx2 (
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz )
+{
+	const __m256i idx=_mm256_setr_epi32 (0, 3, 6, 9, 12, 15, 18, 21);
+	const uint8_t * p=(const uint8_t *) in;
+	size_t i=0;
+
+	num_px=_mipi_cvt_fit (num_px, out_sz);
+	for (; i+16<num_px; i+=16, p+=48) {
+		__m256i v0=_mm256_i32gather_epi32 ((const void *) p, idx, 1),
+			v1=_mm256_i32gather_epi32 ((const void *)(p+24), idx, 1);
+
+		v0=_mm256_packus_epi32 (_mipi_cvt_565_x8 (v0), _mipi_cvt_565_x8 (v1));
+		_mm256_storeu_si256 (
+			(void *)(out+2*i),
+			_mm256_permute4x64_epi64 (v0, 0xD8)
+		);
+	}
+
+	return _mipi_cvt_tail (self, in, i, num_px, out);
+}
+
+static _Bool
+_mipi_cvt_has_avx2 (void)
+{
+	__builtin_cpu_init ();
+	return __builtin_cpu_supports ("avx2");
+}
+#endif // _MIPI_CVT_X86
+
+#ifdef __ARM_NEON
+/**
+ * `vld3q` splits the channels and `vst2q` interleaves the two output bytes,
+ * so each pixel is converted in its own byte lanes.
+ */
+static size_t
+_mipi_cvt_rgb565_neon (
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz )
+{
+	const uint8_t * p=(const uint8_t *) in;
+	size_t i=0;
+
+	num_px=_mipi_cvt_fit (num_px, out_sz);
+	for (; i+16<=num_px; i+=16, p+=48) {
+		const uint8x16x3_t c=vld3q_u8 (p);
+		uint8x16x2_t o;
+
+		o.val[0]=vorrq_u8 (
+			vandq_u8 (c.val[2], vdupq_n_u8 (0xF8)),
+			vshrq_n_u8 (c.val[1], 5)
+		);
+		o.val[1]=vorrq_u8 (
+			vshlq_n_u8 (vandq_u8 (c.val[1], vdupq_n_u8 (0x1C)), 3),
+			vshrq_n_u8 (c.val[0], 3)
+		);
+		vst2q_u8 (out+2*i, o);
+	}
+
+	return _mipi_cvt_tail (self, in, i, num_px, out);
+}
+#endif // __ARM_NEON
+
+static size_t
+_mipi_cvt_rgb565_scalar (
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz )
+{
+	return _ifpf_cvt_rgb565 (self, in, num_px, out, out_sz);
+}
+
+const struct mipi_cvt_kernel MIPI_CVT_KERNELS[]=
+{
+#ifdef _MIPI_CVT_X86
+	{ "avx2", _mipi_cvt_rgb565_avx2, _mipi_cvt_has_avx2 },
+	{ "sse2", _mipi_cvt_rgb565_sse2, NULL },
+#endif
+#ifdef __ARM_NEON
+	{ "neon", _mipi_cvt_rgb565_neon, NULL },
+#endif
+#ifdef _MIPI_CVT_LE
+	{ "swar", _mipi_cvt_rgb565_swar, NULL },
+#endif
+	{ "scalar", _mipi_cvt_rgb565_scalar, NULL }
+};
+
+const size_t MIPI_NUM_CVT_KERNELS=sizeof(MIPI_CVT_KERNELS)/sizeof(MIPI_CVT_KERNELS[0]);
+
+#ifdef MIPI_DBG_EN
+/**
+ * Lengths up to 67 pixels take each kernel through its main loop and every
+ * length of tail; the output is also given a byte to spare, which must be
+ * left alone.
+ */
+#define _MIPI_CVT_CHK_PX 67
+
+static _Bool
+_mipi_cvt_self_check (const struct mipi_cvt_kernel * k)
+{
+	struct mipi_color in[_MIPI_CVT_CHK_PX];
+	uint8_t ref[2*_MIPI_CVT_CHK_PX+1], out[2*_MIPI_CVT_CHK_PX+1];
+	uint32_t x=0x2545F491u;
+
+	for (size_t i=0; i<_MIPI_CVT_CHK_PX; i++) {
+		x^=x<<13;
+		x^=x>>17;
+		x^=x<<5;
+		in[i]=(struct mipi_color){ .r=(uint8_t)x, .g=(uint8_t)(x>>8), .b=(uint8_t)(x>>16) };
+	}
+
+	for (size_t n=0; n<=_MIPI_CVT_CHK_PX; n++) {
+		memset (ref, 0xA5, sizeof(ref));
+		memset (out, 0xA5, sizeof(out));
+		if (_ifpf_cvt_rgb565 (NULL, in, n, ref, 2*n)
+				!=k->cvt_rgb565 (NULL, in, n, out, 2*n)
+				|| memcmp (ref, out, sizeof(out))) {
+			_mipi_dbg (
+				MIPI_DBG_TAG,
+				"%s conversion differs from scalar at %zu px",
+				k->name,
+				n
+			);
+			return false;
+		}
+	}
+	return true;
+}
+#endif
+
+static size_t
+_mipi_cvt_rgb565_first (
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz );
+
+static mipi_cvt_fn _mipi_cvt_rgb565_impl=_mipi_cvt_rgb565_first;
+
+const struct mipi_cvt_kernel *
+mipi_cvt_init (void)
+{
+	const struct mipi_cvt_kernel * k=&MIPI_CVT_KERNELS[MIPI_NUM_CVT_KERNELS-1];
+
+	for (size_t i=0; i<MIPI_NUM_CVT_KERNELS-1; i++) {
+		if (MIPI_CVT_KERNELS[i].is_supported
+				&& !MIPI_CVT_KERNELS[i].is_supported ())
+			continue;
+#ifdef MIPI_DBG_EN
+		if (!_mipi_cvt_self_check (&MIPI_CVT_KERNELS[i]))
+			continue;
+#endif
+		k=&MIPI_CVT_KERNELS[i];
+		break;
+	}
+
+	_mipi_cvt_rgb565_impl=k->cvt_rgb565;
+	return k;
+}
+
+static size_t
+_mipi_cvt_rgb565_first (
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz )
+{
+	return mipi_cvt_init ()->cvt_rgb565 (self, in, num_px, out, out_sz);
+}
+
+size_t
+mipi_cvt_rgb565 (
+	const struct mipi_ifpf * self,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz )
+{
+	return _mipi_cvt_rgb565_impl (self, in, num_px, out, out_sz);
+}
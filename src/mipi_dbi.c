@@ -5,43 +5,51 @@
  */
 
 #include "mipi.h"
+#include "mipi_dcs.h"
+#include "mipi_init_seq.h"
+#include "mipi_cvt.h"
 
 const struct mipi_ifpf MIPI_PANEL_FMT[]=
 {
-  [RGB_565]=
+  [MIPI_CLR_FMT_RGB_565]=
   {
-    .fmt=RGB_565,
-    .bpp=2,
-    .fmt_color=_ifpf_cvt_rgb565
+    .in_clr_fmt=MIPI_CLR_FMT_RGB_888,
+    .bytes_per_px=2,
+    .stride=2,
+    .cvt_to_ifpf=mipi_cvt_rgb565
   },
 	/**
 	 * Both `RGB_666` and `RGB_888` can be transmitted to the panel as-is due to
 	 * the alignment requirements of the color components in the destination
 	 * format.
 	 */
-  [RGB_888]=
+  [MIPI_CLR_FMT_RGB_888]=
   {
-    .fmt=RGB_888,
-    .bpp=3,
-    .fmt_color=NULL
+    .in_clr_fmt=MIPI_CLR_FMT_RGB_888,
+    .bytes_per_px=3,
+    .stride=3,
+    .cvt_to_ifpf=NULL
   }
 };
 
+volatile MIPI_OSAL_ATOMIC_INT mipi_err_code;
+
 
 struct mipi_dbi_dev
 mipi_dbi_dev_create (
   const char * panel_name,
   uint width,
   uint height,
-  struct mipi_color_fmt clr_fmt,
-  _IN_ const u8 mipi_init_seq[] )
+  enum mipi_color_fmt clr_fmt,
+  _IN const uint8_t panel_init_seq[] )
 {
+  (void)panel_name;
   return (struct mipi_dbi_dev)
 	{
     .width=width,
     .height=height,
-    .out_fmt=clr_fmt,
-    .mipi_init_seq=mipi_init_seq
+    .dst_ifpf=MIPI_PANEL_FMT[clr_fmt],
+    .panel_init_seq=panel_init_seq
   };
 }
 
@@ -54,27 +62,633 @@ mipi_dbi_dev_init (
   MIPI_CHK_NOT_NULL_OR_EXIT (ctr, init_failed);
 
   dev->io=ctr;
+  mipi_dbi_invalidate_win (dev);
+  mipi_cvt_init ();
   /**
    * Set output format, initialize frame buffer.
    */
 
-  if (dev->mipi_init_seq) {
+  dev->boot_stats=(struct mipi_dbi_boot_stats){
+    .init_begin_us=_osal_get_time_us ()
+  };
+  if (dev->init_seq) {
+    struct mipi_init_stats st;
+    const mipi_err_T err=mipi_init_seq_write (dev->io, dev->init_seq, &st);
+
+    if (!err)
+      dev->boot_stats.num_init_txns=st.num_txns;
+    mipi_err_code|=err;
+    dev->boot_stats.init_end_us=_osal_get_time_us ();
+    return;
+  } else if (dev->panel_init_seq) {
     _mipi_dcs_write_seq (
       dev->io,
-      dev->mipi_init_seq
+      dev->panel_init_seq
     );
+    dev->boot_stats.init_end_us=_osal_get_time_us ();
 
     return;
   } else {
     _mipi_dbg (
-      dev->DBG_TAG,
+      MIPI_DBG_TAG,
       "panel initialization sequence required, init failed"
     );
     goto init_failed;
   }
 
 init_failed:
-  dev->errno=EINVAL;
+  mipi_err_code|=MIPI_ERR_INV;
+  return;
+}
+
+
+/**
+ * A CASET or RASET command and its four parameters.
+ */
+#define _MIPI_ADDR_CMD_SZ 5
+
+void
+mipi_dbi_invalidate_win (struct mipi_dbi_dev * dev)
+{
+  dev->win_cache.ca_valid=false;
+  dev->win_cache.ra_valid=false;
+  dev->win_cache.wp_valid=false;
+}
+
+/**
+ * Whether `bds` starts where the last write to the cached window stopped, so
+ * that `RAMWRC` places its first pixel at `bds.x`,`bds.y`. The pointer has to
+ * sit at the start of a row, as the columns of `bds` must be those of the
+ * window for the rest of the rows to land in place.
+ */
+static _Bool
+_mipi_dbi_win_continues (
+  const struct mipi_dbi_win_cache * cache,
+  const struct mipi_area bds )
+{
+  const struct mipi_area * win=&cache->win;
+
+  if (!cache->ca_valid || !cache->ra_valid || !cache->wp_valid)
+    return false;
+  if (bds.x!=win->x || bds.w!=win->w || cache->wr_pos%win->w)
+    return false;
+
+  return bds.y==win->y+cache->wr_pos/win->w
+    && bds.y+bds.h<=win->y+win->h;
+}
+
+/**
+ * Stages whichever of CASET and RASET are needed to set the window `bds`. It
+ * is only recorded as that held by the panel, with `_mipi_dbi_commit_win`,
+ * once the transaction has been sent.
+ */
+static mipi_err_T
+_mipi_dbi_stage_win (
+  struct mipi_dbi_dev * dev,
+  const struct mipi_area bds )
+{
+  struct mipi_dbi_win_cache * cache=&dev->win_cache;
+  struct mipi_dbi_win_stats * stats=&dev->win_stats;
+  mipi_err_T err=0;
+
+  if (cache->ca_valid && bds.x==cache->win.x && bds.w==cache->win.w) {
+    stats->num_caset_skipped++;
+    stats->cmd_bytes_saved+=_MIPI_ADDR_CMD_SZ;
+  } else {
+    err|=mipi_dcs_enc_CASET (
+      &dev->cmd_stage,
+      bds.x,
+      (uint16_t)(bds.x+bds.w-1)
+    );
+  }
+
+  if (cache->ra_valid && bds.y==cache->win.y && bds.h==cache->win.h) {
+    stats->num_raset_skipped++;
+    stats->cmd_bytes_saved+=_MIPI_ADDR_CMD_SZ;
+  } else {
+    err|=mipi_dcs_enc_RASET (
+      &dev->cmd_stage,
+      bds.y,
+      (uint16_t)(bds.y+bds.h-1)
+    );
+  }
+  return err;
+}
+
+/**
+ * A command which did not fit in the stage would otherwise be dropped from
+ * the transaction without a word, and the rest of it sent regardless.
+ */
+static inline mipi_err_T
+_mipi_dbi_chk_staged (mipi_err_T err)
+{
+  if (err) {
+    _mipi_dbg (MIPI_DBG_TAG, "commands overflow the DCS stage");
+    mipi_err_code|=err;
+  }
+  return err;
+}
+
+static void
+_mipi_dbi_commit_win (
+  struct mipi_dbi_dev * dev,
+  const struct mipi_area bds )
+{
+  dev->win_cache.win=bds;
+  dev->win_cache.ca_valid=true;
+  dev->win_cache.ra_valid=true;
+}
+
+/**
+ * The errors the connector has raised since it was last asked; see
+ * `mipi_io_ctr::take_err`.
+ */
+static inline mipi_err_T
+_mipi_dbi_take_io_err (struct mipi_io_ctr * io)
+{
+  return io->take_err ? io->take_err (io) : 0;
+}
+
+static inline void
+_mipi_dbi_note_first_px (struct mipi_dbi_dev * dev)
+{
+  if (!dev->boot_stats.first_px_us)
+    dev->boot_stats.first_px_us=_osal_get_time_us ();
+}
+
+void
+mipi_dbi_write_area (
+  struct mipi_dbi_dev * dev,
+  const struct mipi_area bds,
+  _IN const uint8_t px_data[],
+  size_t px_sz )
+{
+  struct mipi_dbi_win_cache * cache;
+  struct mipi_dbi_win_stats * stats;
+  size_t bytes_per_px, num_px;
+  _Bool new_win;
+  mipi_err_T err;
+
+  MIPI_CHK_NOT_NULL_OR_EXIT (dev, write_failed);
+  MIPI_CHK_NOT_NULL_OR_EXIT (dev->io, write_failed);
+  if (!bds.w || !bds.h)
+    goto write_failed;
+
+  cache=&dev->win_cache;
+  stats=&dev->win_stats;
+  _mipi_dbi_note_first_px (dev);
+  bytes_per_px=dev->dst_ifpf.cvt_to_ifpf
+    ? dev->dst_ifpf.bytes_per_px
+    : sizeof(struct mipi_color);
+  num_px=px_sz/bytes_per_px;
+  stats->num_writes++;
+
+  /**
+   * Connectors predating `write_panel_txn` frame the window themselves as a
+   * part of their flush.
+   */
+  if (!dev->io->write_panel_txn) {
+    dev->io->flush_fmbf (dev->io, px_data, bds, px_sz);
+    mipi_dbi_invalidate_win (dev);
+    return;
+  }
+
+  /**
+   * Errors left over from earlier use of the connector are reported, but must
+   * not be taken for a failure of this write.
+   */
+  mipi_err_code|=_mipi_dbi_take_io_err (dev->io);
+  mipi_dcs_stage_reset (&dev->cmd_stage);
+  new_win=!_mipi_dbi_win_continues (cache, bds);
+  if (!new_win) {
+    err=mipi_dcs_enc_RAMWRC (&dev->cmd_stage);
+    stats->num_ramwrc++;
+    stats->cmd_bytes_saved+=2*_MIPI_ADDR_CMD_SZ;
+  } else {
+    err=_mipi_dbi_stage_win (dev, bds);
+    err|=mipi_dcs_enc_RAMWR (&dev->cmd_stage);
+  }
+  if (_mipi_dbi_chk_staged (err))
+    return;
+
+  mipi_dcs_stage_send (&dev->cmd_stage, dev->io, px_data, px_sz);
+
+  /**
+   * What part of the transaction reached the panel is not known, so neither
+   * is the window it holds.
+   */
+  if ((err=_mipi_dbi_take_io_err (dev->io))) {
+    mipi_dbi_invalidate_win (dev);
+    mipi_err_code|=err;
+    return;
+  }
+  if (new_win) {
+    _mipi_dbi_commit_win (dev, bds);
+    cache->wr_pos=0;
+  }
+
+  /**
+   * Once the window is full the pointer wraps, which not all controllers do
+   * in the same way; a partial pixel leaves it somewhere in between.
+   */
+  cache->wr_pos+=num_px;
+  cache->wp_valid=!(px_sz%bytes_per_px)
+    && cache->wr_pos<(size_t)cache->win.w*cache->win.h;
   return;
+
+write_failed:
+  mipi_err_code|=MIPI_ERR_INV;
+}
+
+void
+mipi_dbi_write_area_vec (
+  struct mipi_dbi_dev * dev,
+  const struct mipi_area bds,
+  _IN byte_buffer_view_T spans[],
+  size_t num_spans )
+{
+  mipi_err_T err;
+
+  MIPI_CHK_NOT_NULL_OR_EXIT (dev, write_failed);
+  MIPI_CHK_NOT_NULL_OR_EXIT (dev->io, write_failed);
+  if (!spans || !num_spans || !bds.w || !bds.h)
+    goto write_failed;
+
+  if (!dev->io->flush_fmbf_vec) {
+    _mipi_dbg (
+      MIPI_DBG_TAG,
+      "connector does not implement scatter-gather flush"
+    );
+    mipi_err_code|=MIPI_ERR_OP_NOT_IMPL;
+    return;
+  }
+
+  /**
+   * The connector frames the window itself. The write pointer is not tracked
+   * across it, so the next write to the window starts over with `RAMWR`.
+   */
+  _mipi_dbi_note_first_px (dev);
+  mipi_err_code|=_mipi_dbi_take_io_err (dev->io);
+  dev->io->flush_fmbf_vec (dev->io, spans, num_spans, bds);
+  dev->win_stats.num_writes++;
+  if ((err=_mipi_dbi_take_io_err (dev->io))) {
+    mipi_dbi_invalidate_win (dev);
+    mipi_err_code|=err;
+    return;
+  }
+  _mipi_dbi_commit_win (dev, bds);
+  dev->win_cache.wp_valid=false;
+  return;
+
+write_failed:
+  mipi_err_code|=MIPI_ERR_INV;
+}
+
+/**
+ * The address counter is shared between memory reads and writes on most
+ * controllers, so a read leaves the window in place but the write pointer
+ * unknown.
+ */
+mipi_err_T
+mipi_dbi_read_area (
+  struct mipi_dbi_dev * dev,
+  const struct mipi_area bds,
+  _OUT uint8_t px_data[],
+  size_t px_sz )
+{
+  mipi_err_T err;
+
+  if (!dev || !dev->io || !px_data || !px_sz || !bds.w || !bds.h) {
+    mipi_err_code|=MIPI_ERR_INV;
+    return MIPI_ERR_INV;
+  }
+  if (!dev->io->can_rd || !dev->io->read_panel_reg || !dev->io->write_panel_txn)
+    return MIPI_ERR_OP_NOT_IMPL;
+
+  mipi_err_code|=_mipi_dbi_take_io_err (dev->io);
+  mipi_dcs_stage_reset (&dev->cmd_stage);
+  if ((err=_mipi_dbi_chk_staged (_mipi_dbi_stage_win (dev, bds))))
+    return err;
+  mipi_dcs_stage_send (&dev->cmd_stage, dev->io, NULL, 0);
+  dev->win_cache.wp_valid=false;
+  if (_mipi_dbi_take_io_err (dev->io)) {
+    mipi_dbi_invalidate_win (dev);
+    return MIPI_ERR_IO;
+  }
+  _mipi_dbi_commit_win (dev, bds);
+
+  if (dev->io->read_panel_reg (dev->io, RAMRD, px_data, px_sz)!=(ssize_t)px_sz)
+    return MIPI_ERR_IO;
+  return 0;
+}
+
+mipi_err_T
+mipi_dbi_read_area_cont (
+  struct mipi_dbi_dev * dev,
+  _OUT uint8_t px_data[],
+  size_t px_sz )
+{
+  if (!dev || !dev->io || !px_data || !px_sz) {
+    mipi_err_code|=MIPI_ERR_INV;
+    return MIPI_ERR_INV;
+  }
+  if (!dev->io->can_rd || !dev->io->read_panel_reg)
+    return MIPI_ERR_OP_NOT_IMPL;
+
+  if (dev->io->read_panel_reg (dev->io, RAMRDC, px_data, px_sz)!=(ssize_t)px_sz)
+    return MIPI_ERR_IO;
+  return 0;
+}
+
+static mipi_err_T
+_mipi_dbi_send_vsp (
+  struct mipi_dbi_dev * dev,
+  uint16_t vsp )
+{
+  mipi_err_T err;
+
+  mipi_dcs_stage_reset (&dev->cmd_stage);
+  if ((err=_mipi_dbi_chk_staged (mipi_dcs_enc_VSCRSADD (&dev->cmd_stage, vsp))))
+    return err;
+  mipi_dcs_stage_send (&dev->cmd_stage, dev->io, NULL, 0);
+  return 0;
+}
+
+mipi_err_T
+mipi_dbi_set_scroll_area (
+  struct mipi_dbi_dev * dev,
+  uint16_t tfa,
+  uint16_t bfa )
+{
+  mipi_err_T err;
+
+  if (!dev || !dev->io || (uint32_t)tfa+bfa>=dev->height) {
+    mipi_err_code|=MIPI_ERR_INV;
+    return MIPI_ERR_INV;
+  }
+
+  const struct mipi_dbi_scroll scroll={
+    .tfa=tfa,
+    .vsa=(uint16_t)(dev->height-tfa-bfa),
+    .bfa=bfa,
+    .vsp=tfa
+  };
+
+  mipi_dcs_stage_reset (&dev->cmd_stage);
+  err=mipi_dcs_enc_VSCRDEF (&dev->cmd_stage, tfa, scroll.vsa, bfa);
+  err|=mipi_dcs_enc_VSCRSADD (&dev->cmd_stage, scroll.vsp);
+  if (_mipi_dbi_chk_staged (err))
+    return err;
+  mipi_dcs_stage_send (&dev->cmd_stage, dev->io, NULL, 0);
+  dev->scroll=scroll;
+  return 0;
+}
+
+mipi_err_T
+mipi_dbi_scroll (
+  struct mipi_dbi_dev * dev,
+  int rows,
+  _OUT struct mipi_area * exposed )
+{
+  struct mipi_dbi_scroll * scr;
+  mipi_err_T err;
+  int n;
+
+  if (!dev || !dev->io || !dev->scroll.vsa) {
+    mipi_err_code|=MIPI_ERR_INV;
+    return MIPI_ERR_INV;
+  }
+
+  scr=&dev->scroll;
+  n=rows%scr->vsa;
+  if (n<0)
+    n+=scr->vsa;
+  if (n) {
+    const uint16_t vsp=(uint16_t)(scr->tfa+(scr->vsp-scr->tfa+n)%scr->vsa);
+
+    if ((err=_mipi_dbi_send_vsp (dev, vsp)))
+      return err;
+    scr->vsp=vsp;
+  }
+
+  if (!exposed)
+    return 0;
+
+  /**
+   * Scrolling by the height of the area or more exposes all of it, though
+   * the panel cannot tell this apart from a smaller scroll.
+   */
+  n=rows<0 ? -rows : rows;
+  if (n>scr->vsa)
+    n=scr->vsa;
+  *exposed=(struct mipi_area){
+    .x=0,
+    .y=(uint16_t)(rows>0 ? scr->tfa+scr->vsa-n : scr->tfa),
+    .w=(uint16_t)dev->width,
+    .h=(uint16_t)n
+  };
+  return 0;
+}
+
+uint16_t
+mipi_dbi_scroll_map_row (
+  const struct mipi_dbi_dev * dev,
+  uint16_t y )
+{
+  const struct mipi_dbi_scroll * scr=&dev->scroll;
+
+  if (!scr->vsa || y<scr->tfa || y>=scr->tfa+scr->vsa)
+    return y;
+  return (uint16_t)(scr->tfa+(y-scr->tfa+scr->vsp-scr->tfa)%scr->vsa);
+}
+
+size_t
+mipi_dbi_scroll_map_area (
+  const struct mipi_dbi_dev * dev,
+  const struct mipi_area bds,
+  _OUT struct mipi_area out[] )
+{
+  const uint32_t end=(uint32_t)bds.y+bds.h;
+  uint32_t y=bds.y;
+  size_t n=0;
+
+  /**
+   * Within each of the fixed areas and each side of the wrap, consecutive
+   * screen rows map to consecutive GRAM rows; walk the area a run at a time.
+   */
+  while (y<end) {
+    const struct mipi_dbi_scroll * scr=&dev->scroll;
+    const uint16_t gram_y=mipi_dbi_scroll_map_row (dev, (uint16_t)y);
+    uint32_t run_end=end;
+
+    if (scr->vsa) {
+      const uint32_t va_end=(uint32_t)scr->tfa+scr->vsa;
+
+      if (y<scr->tfa)
+        run_end=scr->tfa;
+      else if (y<va_end)
+        run_end=y+(va_end-gram_y);
+      if (run_end>end)
+        run_end=end;
+    }
+
+    if (n && out[n-1].y+out[n-1].h==gram_y) {
+      out[n-1].h+=(uint16_t)(run_end-y);
+    } else {
+      out[n++]=(struct mipi_area){
+        .x=bds.x,
+        .y=gram_y,
+        .w=bds.w,
+        .h=(uint16_t)(run_end-y)
+      };
+    }
+    y=run_end;
+  }
+
+  return n;
+}
+
+mipi_err_T
+mipi_dbi_set_partial_area (
+  struct mipi_dbi_dev * dev,
+  uint16_t sr,
+  uint16_t er )
+{
+  mipi_err_T err;
+
+  if (!dev || !dev->io || sr>er || er>=dev->height) {
+    mipi_err_code|=MIPI_ERR_INV;
+    return MIPI_ERR_INV;
+  }
+
+  mipi_dcs_stage_reset (&dev->cmd_stage);
+  err=mipi_dcs_enc_PTLAR (&dev->cmd_stage, sr, er);
+  if (!dev->ptl.on)
+    err|=mipi_dcs_enc_PTLON (&dev->cmd_stage);
+  if (_mipi_dbi_chk_staged (err))
+    return err;
+  mipi_dcs_stage_send (&dev->cmd_stage, dev->io, NULL, 0);
+  dev->ptl.sr=sr;
+  dev->ptl.er=er;
+  dev->ptl.on=true;
+
+  return 0;
+}
+
+mipi_err_T
+mipi_dbi_set_normal_mode (struct mipi_dbi_dev * dev)
+{
+  if (!dev || !dev->io) {
+    mipi_err_code|=MIPI_ERR_INV;
+    return MIPI_ERR_INV;
+  }
+
+  dev->io->write_panel_reg (dev->io, NORON, NULL, 0);
+  dev->ptl.on=false;
+  dev->ptl.num_small_evals=0;
+
+  return 0;
 }
 
+_Bool
+mipi_dbi_set_ptl_policy (
+  struct mipi_dbi_dev * dev,
+  uint16_t max_rows,
+  uint8_t settle_evals )
+{
+  dev->ptl.max_rows=max_rows;
+  dev->ptl.settle_evals=settle_evals;
+  dev->ptl.num_small_evals=0;
+  if (!max_rows && dev->ptl.on) {
+    mipi_dbi_set_normal_mode (dev);
+    return true;
+  }
+  return false;
+}
+
+_Bool
+mipi_dbi_note_active_rows (
+  struct mipi_dbi_dev * dev,
+  uint16_t y,
+  uint16_t h )
+{
+  struct mipi_dbi_ptl * ptl=&dev->ptl;
+  const uint16_t y1=y+h;
+
+  if (!h)
+    return false;
+
+  if (ptl->act_y0>=ptl->act_y1) {
+    ptl->act_y0=y;
+    ptl->act_y1=y1;
+  } else {
+    if (y<ptl->act_y0)
+      ptl->act_y0=y;
+    if (y1>ptl->act_y1)
+      ptl->act_y1=y1;
+  }
+
+  if (!ptl->on || (y>=ptl->sr && y1<=ptl->er+1))
+    return false;
+  mipi_dbi_set_normal_mode (dev);
+  return true;
+}
+
+_Bool
+mipi_dbi_eval_ptl (struct mipi_dbi_dev * dev)
+{
+  struct mipi_dbi_ptl * ptl=&dev->ptl;
+  const uint16_t y0=ptl->act_y0, y1=ptl->act_y1;
+
+  ptl->act_y0=0;
+  ptl->act_y1=0;
+
+  /**
+   * Nothing was drawn, so whatever the panel shows is still what it should;
+   * keep to the current mode. The partial area is given in rows of GRAM,
+   * which only match those noted while the panel is not scrolled.
+   */
+  if (!ptl->max_rows || y0>=y1 || dev->scroll.vsa)
+    return false;
+
+  if (y1-y0>ptl->max_rows) {
+    ptl->num_small_evals=0;
+    if (!ptl->on)
+      return false;
+    mipi_dbi_set_normal_mode (dev);
+    return true;
+  }
+
+  if (ptl->num_small_evals<ptl->settle_evals) {
+    ptl->num_small_evals++;
+    return false;
+  }
+  if (ptl->on && ptl->sr==y0 && ptl->er==y1-1)
+    return false;
+
+  // Entering partial mode, or shrinking the partial area.
+  return !mipi_dbi_set_partial_area (dev, y0, y1-1);
+}
+
+_Bool
+mipi_dbi_clip_to_ptl (
+  const struct mipi_dbi_dev * dev,
+  _IN _OUT struct mipi_area * bds )
+{
+  const struct mipi_dbi_ptl * ptl=&dev->ptl;
+  uint16_t y0=bds->y, y1=bds->y+bds->h;
+
+  if (!ptl->on)
+    return bds->h!=0;
+
+  if (y0<ptl->sr)
+    y0=ptl->sr;
+  if (y1>ptl->er+1)
+    y1=ptl->er+1;
+  if (y0>=y1)
+    return false;
+
+  bds->y=y0;
+  bds->h=y1-y0;
+  return true;
+}
@@ -0,0 +1,281 @@
+/**
+ * ========================
+ *      mipi_dither.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-22
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "mipi.h"
+
+/**
+ * The thresholds of a 4x4 Bayer matrix, scaled to the step of a 5-bit and a
+ * 6-bit component (8 and 4), so that each pixel takes a single lookup.
+ */
+static const uint8_t _MIPI_BAYER_5[4][4]=
+{
+	{ 0, 4, 1, 5 },
+	{ 6, 2, 7, 3 },
+	{ 1, 5, 0, 4 },
+	{ 7, 3, 6, 2 }
+};
+
+static const uint8_t _MIPI_BAYER_6[4][4]=
+{
+	{ 0, 2, 0, 2 },
+	{ 3, 1, 3, 1 },
+	{ 0, 2, 0, 2 },
+	{ 3, 1, 3, 1 }
+};
+
+/**
+ * Bits kept of R, G and B.
+ */
+static const uint8_t _MIPI_MASK_565[3]={ 0xF8, 0xFC, 0xF8 },
+	_MIPI_MASK_666[3]={ 0xFC, 0xFC, 0xFC };
+
+/**
+ * Writes a pixel whose components have already been truncated, in the same
+ * layout as `_ifpf_cvt_rgb565`, or as RGB666.
+ */
+static inline void
+_mipi_dither_put (
+	const struct mipi_dither * dither,
+	_OUT uint8_t out[],
+	const uint8_t c[3] )
+{
+	if (dither->bytes_per_px==2) {
+		out[0]=c[2] | (c[1]>>5);
+		out[1]=(uint8_t)((c[1] & 0x1C)<<3) | (c[0]>>3);
+	} else {
+		out[0]=c[0];
+		out[1]=c[1];
+		out[2]=c[2];
+	}
+}
+
+static inline void
+_mipi_dither_advance (struct mipi_dither * dither)
+{
+	if (++dither->x==dither->w) {
+		dither->x=0;
+		dither->y++;
+	}
+}
+
+mipi_err_T
+mipi_dbi_set_dither (
+	struct mipi_dbi_dev * dev,
+	enum mipi_dither_mode mode,
+	int16_t err_row[],
+	size_t err_row_len )
+{
+	if (!dev || (mode==MIPI_DITHER_FS && (!err_row || !err_row_len))) {
+		mipi_err_code|=MIPI_ERR_INV;
+		return MIPI_ERR_INV;
+	}
+
+	dev->dither=(struct mipi_dither){
+		.mode=mode,
+		.err_row=err_row,
+		.err_row_len=err_row_len
+	};
+	return 0;
+}
+
+mipi_err_T
+mipi_dither_begin (
+	struct mipi_dither * dither,
+	const struct mipi_ifpf * ifpf,
+	const struct mipi_area bds )
+{
+	const _Bool cont=dither->w==bds.w
+		&& dither->x0==bds.x
+		&& !dither->x
+		&& dither->y0+dither->y==bds.y;
+
+	if (!bds.w || !bds.h)
+		return MIPI_ERR_INV;
+	if (dither->mode==MIPI_DITHER_FS
+			&& dither->err_row_len<3*((size_t)bds.w+2)) {
+		_mipi_dbg (
+			MIPI_DBG_TAG,
+			"error row too short for an area %u wide",
+			(unsigned)bds.w
+		);
+		return MIPI_ERR_NO_MEM;
+	}
+
+	/**
+	 * Taken from the IFPF of the panel as it is now, as it may be changed
+	 * after the dithering was set.
+	 */
+	dither->bytes_per_px=ifpf->cvt_to_ifpf ? 2 : 3;
+	if (dither->mode==MIPI_DITHER_FS && !cont)
+		memset (dither->err_row, 0, 3*((size_t)bds.w+2)*sizeof(int16_t));
+	dither->x0=bds.x;
+	dither->y0=bds.y;
+	dither->w=bds.w;
+	dither->x=0;
+	dither->y=0;
+	memset (dither->carry, 0, sizeof(dither->carry));
+	memset (dither->acc_prev, 0, sizeof(dither->acc_prev));
+	memset (dither->acc_cur, 0, sizeof(dither->acc_cur));
+
+	return 0;
+}
+
+static void
+_mipi_dither_bayer (
+	struct mipi_dither * dither,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[] )
+{
+	const uint8_t (* rb)[4]=dither->bytes_per_px==2 ? _MIPI_BAYER_5 : _MIPI_BAYER_6;
+	const uint8_t * mask=dither->bytes_per_px==2 ? _MIPI_MASK_565 : _MIPI_MASK_666;
+
+	for (size_t i=0; i<num_px; i++, out+=dither->bytes_per_px) {
+		const unsigned ax=(dither->x0+dither->x) & 3,
+			ay=(dither->y0+dither->y) & 3;
+		const unsigned t_rb=rb[ay][ax], t_g=_MIPI_BAYER_6[ay][ax];
+		const unsigned r=in[i].r+t_rb, g=in[i].g+t_g, b=in[i].b+t_rb;
+		const uint8_t c[3]=
+		{
+			(uint8_t)((r>0xFF ? 0xFF : r) & mask[0]),
+			(uint8_t)((g>0xFF ? 0xFF : g) & mask[1]),
+			(uint8_t)((b>0xFF ? 0xFF : b) & mask[2])
+		};
+
+		_mipi_dither_put (dither, out, c);
+		_mipi_dither_advance (dither);
+	}
+}
+
+/**
+ * Quantizes the pixel at column `x` of the current row and diffuses its
+ * error. Values and errors are in sixteenths of a level, and the weighted
+ * errors are summed before they are divided, so that the small errors of a
+ * 6-bit component are not lost to rounding. `err_row` is offset by a column,
+ * so that the error bound for the column before the first (or after the
+ * last) lands in padding.
+ *
+ * Column `x` of the row holds the error bound for this row until the pixel
+ * has been read; the column behind it is then given its final error for the
+ * row below, which is built up from the three pixels above it.
+ */
+static inline void
+_mipi_dither_fs_px (
+	struct mipi_dither * dither,
+	const uint8_t * mask,
+	size_t x,
+	_IN const struct mipi_color * px,
+	_OUT uint8_t out[] )
+{
+	int16_t * cur=dither->err_row+3*(x+1),
+		* behind=cur-3*dither->dir;
+	const uint8_t in[3]={ px->r, px->g, px->b };
+	uint8_t c[3];
+
+	for (int k=0; k<3; k++) {
+		int v=16*in[k]+((cur[k]+dither->carry[k]+8)>>4), e;
+
+		v=v<0 ? 0 : v>16*0xFF ? 16*0xFF : v;
+		c[k]=(uint8_t)(v>>4) & mask[k];
+		e=v-16*c[k];
+
+		dither->carry[k]=(int16_t)(7*e);
+		behind[k]=(int16_t)(dither->acc_prev[k]+3*e);
+		dither->acc_prev[k]=(int16_t)(dither->acc_cur[k]+5*e);
+		dither->acc_cur[k]=(int16_t)e;
+	}
+
+	_mipi_dither_put (dither, out, c);
+}
+
+static inline void
+_mipi_dither_fs_end_row (
+	struct mipi_dither * dither,
+	size_t last_x )
+{
+	int16_t * last=dither->err_row+3*(last_x+1);
+
+	for (int k=0; k<3; k++) {
+		last[k]=dither->acc_prev[k];
+		dither->carry[k]=0;
+		dither->acc_prev[k]=0;
+		dither->acc_cur[k]=0;
+	}
+}
+
+/**
+ * A row is only run right to left (on odd rows of the panel) if it is all
+ * converted in one call; one split between calls runs left to right, as the
+ * pixels after the split are not yet at hand.
+ */
+static void
+_mipi_dither_fs (
+	struct mipi_dither * dither,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[] )
+{
+	const uint8_t * mask=dither->bytes_per_px==2 ? _MIPI_MASK_565 : _MIPI_MASK_666;
+	const size_t bpp=dither->bytes_per_px, w=dither->w;
+	size_t i=0;
+
+	while (i<num_px) {
+		if (!dither->x) {
+			dither->dir=((dither->y0+dither->y) & 1) && num_px-i>=w ? -1 : 1;
+		}
+
+		if (dither->dir<0) {
+			for (size_t x=w; x-->0;)
+				_mipi_dither_fs_px (dither, mask, x, &in[i+x], out+(i+x)*bpp);
+			_mipi_dither_fs_end_row (dither, 0);
+			i+=w;
+			dither->y++;
+			continue;
+		}
+
+		_mipi_dither_fs_px (dither, mask, dither->x, &in[i], out+i*bpp);
+		if (dither->x==w-1)
+			_mipi_dither_fs_end_row (dither, w-1);
+		_mipi_dither_advance (dither);
+		i++;
+	}
+}
+
+size_t
+mipi_dither_cvt (
+	struct mipi_dither * dither,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	_OUT uint8_t out[],
+	size_t out_sz )
+{
+	// Nothing has been begun.
+	if (!dither->bytes_per_px)
+		return 0;
+	if (num_px>out_sz/dither->bytes_per_px)
+		num_px=out_sz/dither->bytes_per_px;
+
+	switch (dither->mode) {
+	case MIPI_DITHER_BAYER:
+		_mipi_dither_bayer (dither, in, num_px, out);
+		break;
+	case MIPI_DITHER_FS:
+		_mipi_dither_fs (dither, in, num_px, out);
+		break;
+	default:
+		return 0;
+	}
+
+	return num_px*dither->bytes_per_px;
+}
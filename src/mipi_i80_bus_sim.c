@@ -0,0 +1,142 @@
+/**
+ * ========================
+ *    mipi_i80_bus_sim.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-06
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "mipi_i80_bus_sim.h"
+
+void
+mipi_i80_sim_init (
+	struct mipi_i80_bus_sim * sim,
+	uint8_t bus_width,
+	uint32_t min_wr_low_ns,
+	uint32_t min_wr_high_ns )
+{
+	memset (sim, 0, sizeof(*sim));
+	sim->bus_width=bus_width;
+	sim->min_wr_low_ns=min_wr_low_ns;
+	sim->min_wr_high_ns=min_wr_high_ns;
+	sim->wr_lvl=true;
+	sim->rd_lvl=true;
+}
+
+static void
+_mipi_i80_sim_end_txn (
+	struct mipi_i80_bus_sim * sim,
+	uint64_t t_ns )
+{
+	if (!sim->in_txn)
+		return;
+
+	sim->cur.t_end_ns=t_ns;
+	sim->num_txns++;
+	sim->in_txn=false;
+	if (sim->on_txn)
+		sim->on_txn (sim->usr_ctx, &sim->cur);
+}
+
+static void
+_mipi_i80_sim_push_byte (
+	struct mipi_i80_bus_sim * sim,
+	uint8_t b )
+{
+	if (sim->cur.num_bytes<MIPI_I80_SIM_PARAM_CAP)
+		sim->cur.params[sim->cur.num_bytes]=b;
+	sim->cur.num_bytes++;
+}
+
+void
+mipi_i80_sim_set_cs (
+	struct mipi_i80_bus_sim * sim,
+	uint64_t t_ns,
+	_Bool cs_lvl )
+{
+	_Bool active=!cs_lvl;
+
+	if (sim->cs_active && !active)
+		_mipi_i80_sim_end_txn (sim, t_ns);
+	sim->cs_active=active;
+}
+
+void
+mipi_i80_sim_set_wr (
+	struct mipi_i80_bus_sim * sim,
+	uint64_t t_ns,
+	_Bool wr_lvl,
+	_Bool dcx_lvl,
+	uint16_t data )
+{
+	if (wr_lvl==sim->wr_lvl)
+		return;
+	sim->wr_lvl=wr_lvl;
+
+	if (!wr_lvl) {
+		if (sim->num_wr_cycles
+				&& t_ns-sim->t_wr_rise_ns<sim->min_wr_high_ns)
+			sim->num_timing_errs++;
+		sim->t_wr_fall_ns=t_ns;
+		return;
+	}
+
+	// Rising edge; the panel latches D and DCX.
+	if (t_ns-sim->t_wr_fall_ns<sim->min_wr_low_ns)
+		sim->num_timing_errs++;
+	sim->t_wr_rise_ns=t_ns;
+	sim->num_wr_cycles++;
+	if (!sim->cs_active)
+		return;
+
+	if (!dcx_lvl) {
+		_mipi_i80_sim_end_txn (sim, t_ns);
+		memset (&sim->cur, 0, sizeof(sim->cur));
+		sim->cur.cmd=(mipi_dcs_cmd_T)data;
+		sim->cur.t_start_ns=sim->t_wr_fall_ns;
+		sim->in_txn=true;
+		sim->rd_idx=0;
+		return;
+	}
+	if (!sim->in_txn)
+		return; // << data without a command is ignored by the panel
+
+	/**
+	 * Only pixel data occupies the full width of a 16-bit bus; parameters are
+	 * transferred on D[7:0].
+	 */
+	if (sim->bus_width==16
+			&& (sim->cur.cmd==RAMWR || sim->cur.cmd==RAMWRC)) {
+		_mipi_i80_sim_push_byte (sim, (uint8_t)(data>>8));
+	}
+	_mipi_i80_sim_push_byte (sim, (uint8_t)data);
+}
+
+uint16_t
+mipi_i80_sim_set_rd (
+	struct mipi_i80_bus_sim * sim,
+	uint64_t t_ns,
+	_Bool rd_lvl )
+{
+	uint8_t b=0;
+
+	(void)t_ns;
+	if (rd_lvl==sim->rd_lvl)
+		return 0;
+	sim->rd_lvl=rd_lvl;
+	if (rd_lvl || !sim->cs_active || !sim->in_txn)
+		return 0;
+
+	if (sim->on_rd)
+		b=sim->on_rd (sim->usr_ctx, sim->cur.cmd, sim->rd_idx);
+	sim->rd_idx++;
+	sim->num_rd_cycles++;
+
+	return b;
+}
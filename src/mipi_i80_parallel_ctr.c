@@ -1,4 +1,479 @@
 /**
+ *
+ * Intel 8080-series parallel bus connector. Bursts of pixel data are fed to
+ * the bus by DMA; commands and their parameters, which are short, are written
+ * by the CPU.
  *
  * Copyright Surface EP, LLC 2025.
  */
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+#include "mipi_dbi_i80.h"
+
+#define _I80_ACTIVE_STATE ((_Bool)0)
+
+
+const struct mipi_io_ctr _MIPI_I80_CTR_FUNCS=
+(struct mipi_io_ctr) {
+  .write_panel_reg=mipi_i80_send_cmd,
+  .write_panel_txn=mipi_i80_write_txn,
+  .read_panel_reg=mipi_i80_recv_params,
+  .flush_fmbf=mipi_i80_flush_fmbf,
+  .flush_fmbf_vec=mipi_i80_flush_fmbf_vec,
+  .begin_fmbf_stream=mipi_i80_begin_fmbf_stream,
+  .write_fmbf_chunk=mipi_i80_write_fmbf_chunk,
+  .end_fmbf_stream=mipi_i80_end_fmbf_stream,
+  .take_err=mipi_i80_take_err
+};
+
+struct mipi_i80_ctr
+mipi_create_i80_ctr (
+  enum mipi_i80_bus_width bus_width,
+  _osal_gpio_pin_T data_base,
+  _osal_gpio_pin_T wr,
+  _osal_gpio_pin_T rd,
+  _osal_gpio_pin_T cs,
+  _osal_gpio_pin_T dcx )
+{
+  return (struct mipi_i80_ctr){
+    .io=_MIPI_I80_CTR_FUNCS,
+    .bus_width=bus_width,
+    .data_base=data_base,
+    .wr=wr,
+    .rd=rd,
+    .cs=cs,
+    .dcx=dcx,
+    .wr_cycle_ns=_I80_DEF_WR_CYCLE_NS,
+    .rd_cycle_ns=_I80_DEF_RD_CYCLE_NS,
+    .dma_chan=-1
+  };
+}
+
+void
+mipi_i80_set_timing_ns (
+  struct mipi_i80_ctr * self,
+  uint32_t wr_cycle_ns,
+  uint32_t rd_cycle_ns )
+{
+  self->wr_cycle_ns=wr_cycle_ns;
+  self->rd_cycle_ns=rd_cycle_ns;
+}
+
+void
+mipi_init_i80_ctr (struct mipi_i80_ctr * self)
+{
+  self->bus_mtx=_osal_create_mutex ();
+  self->bus=_osal_i80_bus_init (
+    self->data_base,
+    (uint8_t)self->bus_width,
+    self->wr,
+    self->rd,
+    self->wr_cycle_ns
+  );
+  if (!self->bus) {
+    _mipi_dbg (
+      MIPI_DBG_TAG,
+      "failed to claim resources for the 8080 bus"
+    );
+    self->errno|=MIPI_ERR_IO;
+    return;
+  }
+
+  _osal_init_gpio_pin (self->cs, _OSAL_GPIO_OUT);
+  _osal_init_gpio_pin (self->dcx, _OSAL_GPIO_OUT);
+  _osal_set_gpio_pin_state (self->cs, !_I80_ACTIVE_STATE);
+  _osal_set_gpio_pin_state (self->dcx, 1);
+
+  /**
+   * Without a channel, pixel data is still written, only by the CPU; this is
+   * not an error.
+   */
+  self->dma_chan=_osal_dma_claim_chan ();
+  self->io.can_wt=1;
+  self->io.can_rd=1;
+}
+
+void
+mipi_free_i80_ctr (struct mipi_i80_ctr * self)
+{
+  if (self->bus)
+    _osal_i80_wait_idle (self->bus);
+  if (self->dma_chan>=0) {
+    _osal_dma_unclaim_chan (self->dma_chan);
+    self->dma_chan=-1;
+  }
+  if (self->bus) {
+    _osal_i80_bus_deinit (self->bus);
+    self->bus=NULL;
+  }
+}
+
+static _Bool
+_mipi_i80_begin_tx (struct mipi_i80_ctr * self)
+{
+  if (!self->bus)
+    return false;
+  if (!_osal_lock_mtx_block_ms (&self->bus_mtx, MIPI_MAX_TM))
+    return false;
+
+  _osal_set_gpio_pin_state (self->cs, _I80_ACTIVE_STATE);
+  return true;
+}
+
+static void
+_mipi_i80_end_tx (struct mipi_i80_ctr * self)
+{
+  _osal_i80_wait_idle (self->bus);
+  _osal_set_gpio_pin_state (self->cs, !_I80_ACTIVE_STATE);
+  _osal_unlock_mtx (&self->bus_mtx);
+}
+
+/**
+ * The command is latched with DCX low. The level of DCX may only change once
+ * the bus is idle, as the last WR cycle may still be queued.
+ */
+static void
+_mipi_i80_write_reg_locked (
+  struct mipi_i80_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t params[],
+  size_t len )
+{
+  _osal_i80_wait_idle (self->bus);
+  _osal_set_gpio_pin_state (self->dcx, 0);
+  _osal_i80_write_block (self->bus, &cmd, 1, false);
+
+  _osal_i80_wait_idle (self->bus);
+  _osal_set_gpio_pin_state (self->dcx, 1);
+  if (len)
+    _osal_i80_write_block (self->bus, params, len, false);
+}
+
+/**
+ * A WR cycle of pixel data on the 16-bit bus carries two bytes, and the panel
+ * latches all sixteen lines of every one. An odd byte is therefore never
+ * given a cycle of its own, where D[15:8] would be taken for a byte before
+ * it; instead it is held until the next chunk. Sends the held byte along with
+ * the first of `*px`, and trims `*px`/`*len` to whole cycles, holding the
+ * byte after them. Returns `false` if the bus failed the write.
+ */
+static _Bool
+_mipi_i80_pair_px (
+  struct mipi_i80_ctr * self,
+  const uint8_t ** px,
+  size_t * len )
+{
+  if (self->bus_width!=MIPI_I80_BUS_16_BIT || !*len)
+    return true;
+
+  if (self->has_px_carry) {
+    const uint8_t pair[2]={ self->px_carry, (*px)[0] };
+
+    self->has_px_carry=false;
+    if (!_osal_i80_write_block (self->bus, pair, sizeof(pair), true))
+      return false;
+    (*px)++;
+    (*len)--;
+  }
+  if (*len & 1) {
+    self->px_carry=(*px)[--*len];
+    self->has_px_carry=true;
+  }
+  return true;
+}
+
+/**
+ * Ends the pixel data of a write; a byte still held goes out on D[15:8] of
+ * a last cycle, where it would have been had another followed it.
+ */
+static _Bool
+_mipi_i80_end_px (struct mipi_i80_ctr * self)
+{
+  const uint8_t pair[2]={ self->px_carry, 0 };
+
+  if (!self->has_px_carry)
+    return true;
+  self->has_px_carry=false;
+  return _osal_i80_write_block (self->bus, pair, sizeof(pair), true);
+}
+
+void
+mipi_i80_write_txn (
+  struct mipi_io_ctr * self,
+  _IN const struct mipi_io_txn_seg segs[],
+  size_t num_segs,
+  _IN const uint8_t px_data[],
+  size_t px_sz )
+{
+  struct mipi_i80_ctr * i80_conn=(struct mipi_i80_ctr *) self;
+
+  if (!num_segs || (px_sz && !px_data)) {
+    i80_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+  for (size_t i=0; i<num_segs; i++) {
+    if (segs[i].num_params && !segs[i].params) {
+      i80_conn->errno|=MIPI_ERR_INV;
+      return;
+    }
+  }
+  if (!_mipi_i80_begin_tx (i80_conn)) {
+    i80_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return;
+  }
+
+  for (size_t i=0; i<num_segs; i++) {
+    _mipi_i80_write_reg_locked (
+      i80_conn,
+      segs[i].cmd,
+      segs[i].params,
+      segs[i].num_params
+    );
+  }
+
+  /**
+   * Pixel data goes out on the full width of the bus; see `_osal_i80_bus`.
+   */
+  if (px_sz) {
+    const uint8_t * px=px_data;
+    size_t n=px_sz;
+
+    if (!_mipi_i80_pair_px (i80_conn, &px, &n)
+        || (n && !_osal_i80_write_block (i80_conn->bus, px, n, true))
+        || !_mipi_i80_end_px (i80_conn))
+      i80_conn->errno|=MIPI_ERR_IO;
+  }
+  _mipi_i80_end_tx (i80_conn);
+}
+
+void
+mipi_i80_send_cmd (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t params[],
+  size_t len )
+{
+  const struct mipi_io_txn_seg seg=
+  {
+    .cmd=cmd,
+    .params=params,
+    .num_params=len
+  };
+
+  mipi_i80_write_txn (self, &seg, 1, NULL, 0);
+}
+
+/**
+ * On the parallel interface, the first RD cycle following a read command
+ * returns invalid data (the "dummy read") and is discarded.
+ */
+ssize_t
+mipi_i80_recv_params (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _OUT uint8_t params[],
+  size_t len )
+{
+  struct mipi_i80_ctr * i80_conn=(struct mipi_i80_ctr *) self;
+  uint8_t dummy;
+  ssize_t n=(ssize_t)len;
+
+  if (!params || !len) {
+    i80_conn->errno|=MIPI_ERR_INV;
+    return -1;
+  }
+  if (!_mipi_i80_begin_tx (i80_conn)) {
+    i80_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return -1;
+  }
+
+  self->rd_in_prog=1;
+  _mipi_i80_write_reg_locked (i80_conn, cmd, NULL, 0);
+  _osal_i80_wait_idle (i80_conn->bus);
+  if (!_osal_i80_read_block (i80_conn->bus, &dummy, 1, i80_conn->rd_cycle_ns)
+      || !_osal_i80_read_block (i80_conn->bus, params, len, i80_conn->rd_cycle_ns)) {
+    i80_conn->errno|=MIPI_ERR_IO;
+    n=-1;
+  }
+  self->rd_in_prog=0;
+  _mipi_i80_end_tx (i80_conn);
+
+  return n;
+}
+
+mipi_err_T
+mipi_i80_begin_fmbf_stream (
+  struct mipi_io_ctr * self,
+  const struct mipi_area bounds )
+{
+  struct mipi_i80_ctr * i80_conn=(struct mipi_i80_ctr *) self;
+  uint8_t ca_params[4], ra_params[4];
+
+  if (!bounds.w || !bounds.h)
+    return MIPI_ERR_INV;
+  if (!_mipi_i80_begin_tx (i80_conn)) {
+    i80_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return MIPI_ERR_RES_LOCKED;
+  }
+
+  _mipi_dcs_pack_addr (ca_params, bounds.x, (uint16_t)(bounds.x+bounds.w-1));
+  _mipi_dcs_pack_addr (ra_params, bounds.y, (uint16_t)(bounds.y+bounds.h-1));
+  _mipi_i80_write_reg_locked (i80_conn, CASET, ca_params, sizeof(ca_params));
+  _mipi_i80_write_reg_locked (i80_conn, RASET, ra_params, sizeof(ra_params));
+  _mipi_i80_write_reg_locked (i80_conn, RAMWR, NULL, 0);
+
+  i80_conn->has_px_carry=false;
+  i80_conn->in_fmbf_stream=true;
+  return 0;
+}
+
+static void
+_mipi_i80_dma_chunk_done (void * cb_arg)
+{
+  struct mipi_i80_ctr * i80_conn=(struct mipi_i80_ctr *) cb_arg;
+  i80_conn->io.wt_in_prog=0;
+}
+
+static _Bool
+_mipi_i80_wait_chunk_ms (
+  struct mipi_i80_ctr * self,
+  uint32_t ms )
+{
+  uint32_t t0=_osal_get_time_ms ();
+
+  while (self->io.wt_in_prog) {
+    if ((_osal_get_time_ms ()-t0)>=ms)
+      return false;
+    _osal_yield ();
+  }
+  return true;
+}
+
+mipi_err_T
+mipi_i80_write_fmbf_chunk (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t chunk[],
+  size_t len )
+{
+  struct mipi_i80_ctr * i80_conn=(struct mipi_i80_ctr *) self;
+
+  if (!i80_conn->in_fmbf_stream || !chunk)
+    return MIPI_ERR_INV;
+  if (!_mipi_i80_wait_chunk_ms (i80_conn, MIPI_MAX_TM)) {
+    i80_conn->errno|=MIPI_ERR_IO;
+    return MIPI_ERR_IO;
+  }
+  if (!_mipi_i80_pair_px (i80_conn, &chunk, &len)) {
+    i80_conn->errno|=MIPI_ERR_IO;
+    return MIPI_ERR_IO;
+  }
+  if (!len)
+    return 0;
+
+  /**
+   * The DMA reads halfwords on the 16-bit bus, which a chunk continuing a
+   * held byte is no longer aligned to; it is written by the CPU instead.
+   */
+  if (i80_conn->dma_chan>=0
+      && (i80_conn->bus_width!=MIPI_I80_BUS_16_BIT
+        || !((uintptr_t)chunk & 1))) {
+    self->wt_in_prog=1;
+    if (_osal_i80_write_async (
+          i80_conn->bus,
+          i80_conn->dma_chan,
+          chunk,
+          len,
+          true,
+          _mipi_i80_dma_chunk_done,
+          i80_conn
+        ))
+      return 0;
+    self->wt_in_prog=0;
+  }
+
+  if (!_osal_i80_write_block (i80_conn->bus, chunk, len, true)) {
+    i80_conn->errno|=MIPI_ERR_IO;
+    return MIPI_ERR_IO;
+  }
+  return 0;
+}
+
+void
+mipi_i80_end_fmbf_stream (struct mipi_io_ctr * self)
+{
+  struct mipi_i80_ctr * i80_conn=(struct mipi_i80_ctr *) self;
+
+  if (!i80_conn->in_fmbf_stream)
+    return;
+  if (!_mipi_i80_wait_chunk_ms (i80_conn, MIPI_MAX_TM)
+      || !_mipi_i80_end_px (i80_conn))
+    i80_conn->errno|=MIPI_ERR_IO;
+
+  i80_conn->in_fmbf_stream=false;
+  _mipi_i80_end_tx (i80_conn);
+}
+
+mipi_err_T
+mipi_i80_take_err (struct mipi_io_ctr * self)
+{
+  struct mipi_i80_ctr * i80_conn=(struct mipi_i80_ctr *) self;
+  const mipi_err_T err=(mipi_err_T)i80_conn->errno;
+
+  i80_conn->errno=0;
+  return err;
+}
+
+void
+mipi_i80_flush_fmbf (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t pix_buff[],
+  const struct mipi_area bounds,
+  size_t len )
+{
+  struct mipi_i80_ctr * i80_conn=(struct mipi_i80_ctr *) self;
+
+  if (!pix_buff) {
+    _mipi_dbg (
+      MIPI_DBG_TAG,
+      "pixel data buffer empty, aborting transaction\n"
+    );
+    i80_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+
+  if (mipi_i80_begin_fmbf_stream (self, bounds))
+    return;
+  mipi_i80_write_fmbf_chunk (self, pix_buff, len);
+  mipi_i80_end_fmbf_stream (self);
+}
+
+/**
+ * The PIO program has no use for control blocks, so each span is a DMA
+ * transfer of its own; the next is started as soon as the previous one has
+ * left, while the bus is still held.
+ */
+void
+mipi_i80_flush_fmbf_vec (
+  struct mipi_io_ctr * self,
+  _IN byte_buffer_view_T spans[],
+  size_t num_spans,
+  const struct mipi_area bounds )
+{
+  struct mipi_i80_ctr * i80_conn=(struct mipi_i80_ctr *) self;
+
+  if (!spans || !num_spans) {
+    i80_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+
+  if (mipi_i80_begin_fmbf_stream (self, bounds))
+    return;
+  for (size_t i=0; i<num_spans; i++) {
+    if (!spans[i].buff_sz)
+      continue;
+    if (mipi_i80_write_fmbf_chunk (self, spans[i].buff, spans[i].buff_sz))
+      break;
+  }
+  mipi_i80_end_fmbf_stream (self);
+}
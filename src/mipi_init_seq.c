@@ -0,0 +1,152 @@
+/**
+ * ========================
+ *     mipi_init_seq.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-19
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include "mipi_init_seq.h"
+
+/**
+ * Sends the run of segments starting at `first`, up to and including the
+ * next which is followed by a delay. Returns the number of segments sent.
+ */
+static size_t
+_mipi_init_seq_send_run (
+	struct mipi_io_ctr * io,
+	const struct mipi_init_seq * seq,
+	size_t first,
+	struct mipi_init_stats * stats )
+{
+	size_t n=1;
+	uint32_t t0;
+
+	while (first+n<seq->num_segs && !seq->delay_ms[first+n-1])
+		n++;
+
+	t0=_osal_get_time_us ();
+	if (io->write_panel_txn) {
+		io->write_panel_txn (io, seq->segs+first, n, NULL, 0);
+		stats->num_txns++;
+	} else {
+		for (size_t i=first; i<first+n; i++) {
+			io->write_panel_reg (
+				io,
+				seq->segs[i].cmd,
+				seq->segs[i].params,
+				seq->segs[i].num_params
+			);
+		}
+		stats->num_txns+=n;
+	}
+	stats->wr_us+=_osal_get_time_us ()-t0;
+
+	return n;
+}
+
+mipi_err_T
+mipi_init_exec_start (
+	struct mipi_init_exec * exec,
+	struct mipi_io_ctr * io,
+	const struct mipi_init_seq * seq,
+	_osal_alarm_cb ready_cb,
+	void * cb_arg )
+{
+	if (!exec || !io || !seq || !seq->segs)
+		return MIPI_ERR_INV;
+	if (!io->write_panel_txn && !io->write_panel_reg)
+		return MIPI_ERR_OP_NOT_IMPL;
+
+	// Errors left from before belong to no run of the sequence.
+	if (io->take_err)
+		mipi_err_code|=io->take_err (io);
+
+	*exec=(struct mipi_init_exec){
+		.io=io,
+		.seq=seq,
+		.due_ms=_osal_get_time_ms (),
+		.ready_cb=ready_cb,
+		.cb_arg=cb_arg
+	};
+	mipi_init_exec_poll (exec, NULL);
+
+	return 0;
+}
+
+_Bool
+mipi_init_exec_poll (
+	struct mipi_init_exec * exec,
+	_OUT uint32_t * wait_ms )
+{
+	const struct mipi_init_seq * seq=exec->seq;
+	uint32_t now=_osal_get_time_ms ();
+
+	/**
+	 * The sequence is only done once the delay after its last run has passed
+	 * too, eg. that after DISPON.
+	 */
+	for (;;) {
+		uint32_t delay_ms;
+
+		if ((int32_t)(now-exec->due_ms)<0) {
+			if (wait_ms)
+				*wait_ms=exec->due_ms-now;
+			return false;
+		}
+		if (exec->err || exec->next_seg==seq->num_segs)
+			break;
+
+		exec->next_seg+=_mipi_init_seq_send_run (
+			exec->io,
+			seq,
+			exec->next_seg,
+			&exec->stats
+		);
+		if (exec->io->take_err)
+			exec->err=exec->io->take_err (exec->io);
+		if (exec->err)
+			break;
+
+		delay_ms=seq->delay_ms[exec->next_seg-1];
+		now=_osal_get_time_ms ();
+		exec->due_ms=now+delay_ms;
+		exec->stats.delay_ms+=delay_ms;
+
+		/**
+		 * Polling alone still works if the alarm cannot be set; it only saves
+		 * the caller from having to poll on a schedule of its own.
+		 */
+		if (delay_ms && exec->ready_cb)
+			_osal_set_alarm_ms (delay_ms, exec->ready_cb, exec->cb_arg);
+	}
+
+	if (wait_ms)
+		*wait_ms=0;
+	return true;
+}
+
+mipi_err_T
+mipi_init_seq_write (
+	struct mipi_io_ctr * io,
+	const struct mipi_init_seq * seq,
+	_OUT struct mipi_init_stats * stats )
+{
+	struct mipi_init_exec exec;
+	uint32_t wait_ms;
+	mipi_err_T err;
+
+	err=mipi_init_exec_start (&exec, io, seq, NULL, NULL);
+	if (err)
+		return err;
+	while (!mipi_init_exec_poll (&exec, &wait_ms))
+		_osal_sleep_ms (wait_ms);
+
+	if (stats)
+		*stats=exec.stats;
+	return exec.err;
+}
@@ -0,0 +1,208 @@
+/**
+ * ========================
+ *     mipi_panel_drv.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-20
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include "mipi_panel_drv.h"
+#include "mipi_init.h"
+
+/**
+ * The geometry is that left by the init sequence, ie. after its MADCTL.
+ */
+const struct mipi_panel_drv MIPI_PANEL_DRVS[]=
+{
+	{
+		.name="ST7735",
+		.id_reg=RDDID,
+		.id={ 0x7C, 0x89, 0xF0 },
+		.id_mask={ 0xFF, 0x00, 0xFF },
+		.init_seq=&MIPI_INIT_ST7735,
+		.width=160,
+		.height=128,
+		.ifpfs=MIPI_IFPF_BIT (IFPF_16_BIT) | MIPI_IFPF_BIT (IFPF_18_BIT)
+	},
+	/**
+	 * The RDDID of the ILI9341 is left to the module vendor, and is often all
+	 * zeros; the part number is read from RDID4 instead.
+	 */
+	{
+		.name="ILI9341",
+		.id_reg=RDID4,
+		.id={ 0x00, 0x93, 0x41 },
+		.id_mask={ 0x00, 0xFF, 0xFF },
+		.init_seq=&MIPI_INIT_ILI9341,
+		.width=240,
+		.height=320,
+		.ifpfs=MIPI_IFPF_BIT (IFPF_16_BIT) | MIPI_IFPF_BIT (IFPF_18_BIT)
+	}
+};
+
+const size_t MIPI_NUM_PANEL_DRVS=sizeof(MIPI_PANEL_DRVS)/sizeof(MIPI_PANEL_DRVS[0]);
+
+/**
+ * The persistent word holds a tag, the index of the driver, and a check over
+ * the index and the ID of the driver at it; a table which has changed since
+ * the word was stored (eg. by a firmware update) fails the check rather than
+ * selecting whichever driver has taken the old one's place.
+ */
+#define _MIPI_DRV_CACHE_TAG 0xD5u
+
+static uint16_t
+_mipi_drv_cache_chk (
+	_IN const struct mipi_panel_drv * drv,
+	size_t idx )
+{
+	uint32_t h=2166136261u;
+	const uint8_t b[]=
+	{
+		(uint8_t)idx,
+		drv->id_reg,
+		drv->id[0], drv->id[1], drv->id[2],
+		drv->id_mask[0], drv->id_mask[1], drv->id_mask[2]
+	};
+
+	for (size_t i=0; i<sizeof(b); i++)
+		h=(h^b[i])*16777619u;
+	return (uint16_t)(h^(h>>16));
+}
+
+static const struct mipi_panel_drv *
+_mipi_drv_cache_load (
+	_IN const struct mipi_panel_drv drvs[],
+	size_t num_drvs )
+{
+	uint32_t word;
+	size_t idx;
+
+	if (!_osal_persist_load (&word) || (word>>24)!=_MIPI_DRV_CACHE_TAG)
+		return NULL;
+
+	idx=(word>>16) & 0xFF;
+	if (idx>=num_drvs || (uint16_t)word!=_mipi_drv_cache_chk (&drvs[idx], idx))
+		return NULL;
+	return &drvs[idx];
+}
+
+static void
+_mipi_drv_cache_store (
+	_IN const struct mipi_panel_drv drvs[],
+	size_t idx )
+{
+	_osal_persist_store (
+		(uint32_t)_MIPI_DRV_CACHE_TAG<<24
+			| (uint32_t)(idx & 0xFF)<<16
+			| _mipi_drv_cache_chk (&drvs[idx], idx)
+	);
+}
+
+static _Bool
+_mipi_drv_matches (
+	_IN const struct mipi_panel_drv * drv,
+	_IN const uint8_t id[3] )
+{
+	for (size_t i=0; i<3; i++) {
+		if ((id[i]^drv->id[i]) & drv->id_mask[i])
+			return false;
+	}
+	return true;
+}
+
+const struct mipi_panel_drv *
+mipi_panel_drv_select (
+	struct mipi_io_ctr * io,
+	_IN const struct mipi_panel_drv drvs[],
+	size_t num_drvs,
+	_OUT struct mipi_panel_probe_stats * stats )
+{
+	const struct mipi_panel_drv * drv=NULL;
+	struct mipi_panel_probe_stats st={ 0 };
+	const uint32_t t0=_osal_get_time_us ();
+	int last_reg=-1;
+	_Bool have_id=false;
+	mipi_err_T err;
+
+	if (!drvs) {
+		drvs=MIPI_PANEL_DRVS;
+		num_drvs=MIPI_NUM_PANEL_DRVS;
+	}
+	if (!io || !num_drvs || num_drvs>0xFF) {
+		mipi_err_code|=MIPI_ERR_INV;
+		goto done;
+	}
+
+	if ((drv=_mipi_drv_cache_load (drvs, num_drvs))) {
+		st.cache_hit=true;
+		goto done;
+	}
+	if (!io->can_rd || !io->read_panel_reg) {
+		_mipi_dbg (MIPI_DBG_TAG, "connector cannot read the panel ID");
+		goto done;
+	}
+
+	/**
+	 * A register is read once for each run of drivers keyed by it, so a table
+	 * grouped by register reads each only once. An ID the connector raised an
+	 * error for is not matched against; it may be anything.
+	 */
+	if (io->take_err)
+		mipi_err_code|=io->take_err (io);
+	for (size_t i=0; i<num_drvs; i++) {
+		if (drvs[i].id_reg!=last_reg) {
+			last_reg=drvs[i].id_reg;
+			st.num_reads++;
+			have_id=io->read_panel_reg (io, drvs[i].id_reg, st.id, sizeof(st.id))
+				==(ssize_t)sizeof(st.id);
+			err=io->take_err ? io->take_err (io) : 0;
+			if (err) {
+				mipi_err_code|=err;
+				have_id=false;
+			}
+		}
+		if (have_id && _mipi_drv_matches (&drvs[i], st.id)) {
+			drv=&drvs[i];
+			_mipi_drv_cache_store (drvs, i);
+			break;
+		}
+	}
+
+	if (!drv) {
+		_mipi_dbg (
+			MIPI_DBG_TAG,
+			"no driver for panel ID %02x %02x %02x",
+			st.id[0],
+			st.id[1],
+			st.id[2]
+		);
+		mipi_panel_drv_forget ();
+	}
+
+done:
+	st.probe_us=_osal_get_time_us ()-t0;
+	if (stats)
+		*stats=st;
+	return drv;
+}
+
+void
+mipi_panel_drv_forget (void)
+{
+	_osal_persist_store (0);
+}
+
+void
+mipi_panel_drv_apply (
+	struct mipi_dbi_dev * dev,
+	_IN const struct mipi_panel_drv * drv )
+{
+	dev->width=drv->width;
+	dev->height=drv->height;
+	dev->init_seq=drv->init_seq;
+	dev->panel_init_seq=NULL;
+}
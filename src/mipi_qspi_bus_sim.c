@@ -0,0 +1,154 @@
+/**
+ * ========================
+ *   mipi_qspi_bus_sim.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-15
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "mipi_qspi_bus_sim.h"
+
+#define _QSPI_HDR_BITS 32 // << instruction and 24-bit address, on D0
+
+void
+mipi_qspi_sim_init (
+	struct mipi_qspi_bus_sim * sim,
+	uint8_t wr_instr,
+	uint8_t rd_instr,
+	uint8_t px_instr,
+	uint8_t px_lanes )
+{
+	memset (sim, 0, sizeof(*sim));
+	sim->wr_instr=wr_instr;
+	sim->rd_instr=rd_instr;
+	sim->px_instr=px_instr;
+	sim->px_lanes=px_lanes;
+}
+
+static void
+_mipi_qspi_sim_push_byte (
+	struct mipi_qspi_bus_sim * sim,
+	uint8_t b )
+{
+	if (sim->cur.num_bytes<MIPI_QSPI_SIM_PARAM_CAP)
+		sim->cur.params[sim->cur.num_bytes]=b;
+	sim->cur.num_bytes++;
+}
+
+void
+mipi_qspi_sim_set_cs (
+	struct mipi_qspi_bus_sim * sim,
+	uint64_t t_ns,
+	_Bool cs_lvl )
+{
+	const _Bool active=!cs_lvl;
+
+	if (active==sim->cs_active)
+		return;
+	sim->cs_active=active;
+
+	if (active) {
+		memset (&sim->cur, 0, sizeof(sim->cur));
+		sim->cur.t_start_ns=t_ns;
+		sim->in_data=false;
+		sim->skip=false;
+		sim->num_hdr_bits=0;
+		sim->hdr=0;
+		sim->cur_byte=0;
+		sim->cur_bits=0;
+		sim->rd_bits=0;
+		sim->rd_idx=0;
+		return;
+	}
+
+	if (sim->skip)
+		return;
+	if (!sim->in_data) {
+		if (sim->num_hdr_bits)
+			sim->num_framing_errs++;
+		return;
+	}
+	// The panel discards a byte (or pixel) left incomplete by CS.
+	if (sim->cur_bits)
+		sim->num_framing_errs++;
+
+	sim->cur.t_end_ns=t_ns;
+	sim->num_txns++;
+	if (sim->on_txn)
+		sim->on_txn (sim->usr_ctx, &sim->cur);
+}
+
+/**
+ * Decodes the instruction and address once the header is complete; the
+ * command is the middle byte of the address.
+ */
+static void
+_mipi_qspi_sim_end_hdr (struct mipi_qspi_bus_sim * sim)
+{
+	const uint8_t instr=(uint8_t)(sim->hdr>>24);
+
+	sim->cur.instr=instr;
+	sim->cur.cmd=(mipi_dcs_cmd_T)(sim->hdr>>8);
+	if (instr==sim->wr_instr || instr==sim->rd_instr) {
+		sim->cur.num_lanes=1;
+	} else if (instr==sim->px_instr) {
+		sim->cur.num_lanes=sim->px_lanes;
+	} else {
+		sim->num_framing_errs++;
+		sim->skip=true;
+		return;
+	}
+	sim->in_data=true;
+}
+
+_Bool
+mipi_qspi_sim_clock (
+	struct mipi_qspi_bus_sim * sim,
+	uint64_t t_ns,
+	uint8_t d_lines )
+{
+	_Bool d1;
+
+	(void)t_ns;
+	sim->num_clks++;
+	if (!sim->cs_active || sim->skip)
+		return false;
+
+	if (!sim->in_data) {
+		sim->hdr=sim->hdr<<1 | (d_lines & 1u);
+		if (++sim->num_hdr_bits==_QSPI_HDR_BITS)
+			_mipi_qspi_sim_end_hdr (sim);
+		return false;
+	}
+
+	if (sim->cur.instr==sim->rd_instr) {
+		if (!sim->rd_bits) {
+			sim->rd_byte=sim->on_rd
+				? sim->on_rd (sim->usr_ctx, sim->cur.cmd, sim->rd_idx)
+				: 0;
+			sim->rd_idx++;
+			sim->rd_bits=8;
+			_mipi_qspi_sim_push_byte (sim, sim->rd_byte);
+		}
+		d1=(sim->rd_byte>>7) & 1u;
+		sim->rd_byte=(uint8_t)(sim->rd_byte<<1);
+		sim->rd_bits--;
+		return d1;
+	}
+
+	sim->cur_byte=(uint8_t)(sim->cur_byte<<sim->cur.num_lanes
+		| (d_lines & ((1u<<sim->cur.num_lanes)-1)));
+	sim->cur_bits=(uint8_t)(sim->cur_bits+sim->cur.num_lanes);
+	if (sim->cur_bits>=8) {
+		_mipi_qspi_sim_push_byte (sim, sim->cur_byte);
+		sim->cur_byte=0;
+		sim->cur_bits=0;
+	}
+	return false;
+}
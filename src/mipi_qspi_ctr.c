@@ -0,0 +1,455 @@
+/**
+ *
+ * Dual/quad-SPI connector. Every command is a frame of its own, opened by an
+ * instruction and address on D0; the pixel data following RAMWR and RAMWRC
+ * is written on all of the data lines, by DMA where a channel is available,
+ * and everything else on D0 by the CPU.
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+#include "mipi_dbi_qspi.h"
+
+#define _QSPI_ACTIVE_STATE ((_Bool)0)
+#define _QSPI_HDR_SZ       4
+
+
+const struct mipi_io_ctr _MIPI_QSPI_CTR_FUNCS=
+(struct mipi_io_ctr) {
+  .write_panel_reg=mipi_qspi_send_cmd,
+  .write_panel_txn=mipi_qspi_write_txn,
+  .read_panel_reg=mipi_qspi_recv_params,
+  .flush_fmbf=mipi_qspi_flush_fmbf,
+  .flush_fmbf_vec=mipi_qspi_flush_fmbf_vec,
+  .begin_fmbf_stream=mipi_qspi_begin_fmbf_stream,
+  .write_fmbf_chunk=mipi_qspi_write_fmbf_chunk,
+  .end_fmbf_stream=mipi_qspi_end_fmbf_stream,
+  .take_err=mipi_qspi_take_err
+};
+
+struct mipi_qspi_ctr
+mipi_create_qspi_ctr (
+  enum mipi_qspi_lanes px_lanes,
+  _osal_gpio_pin_T data_base,
+  _osal_gpio_pin_T sck,
+  _osal_gpio_pin_T cs )
+{
+  return (struct mipi_qspi_ctr){
+    .io=_MIPI_QSPI_CTR_FUNCS,
+    .px_lanes=px_lanes,
+    .data_base=data_base,
+    .sck=sck,
+    .cs=cs,
+    .sck_hz=_QSPI_DEF_SCK_HZ,
+    .rd_cycle_ns=_QSPI_DEF_RD_CYCLE_NS,
+    .wr_instr=MIPI_QSPI_WR_INSTR,
+    .rd_instr=MIPI_QSPI_RD_INSTR,
+    .px_instr=MIPI_QSPI_PX_INSTR,
+    .dma_chan=-1
+  };
+}
+
+void
+mipi_qspi_set_timing (
+  struct mipi_qspi_ctr * self,
+  uint32_t sck_hz,
+  uint32_t rd_cycle_ns )
+{
+  self->sck_hz=sck_hz;
+  self->rd_cycle_ns=rd_cycle_ns;
+}
+
+void
+mipi_qspi_set_instr (
+  struct mipi_qspi_ctr * self,
+  uint8_t wr_instr,
+  uint8_t rd_instr,
+  uint8_t px_instr )
+{
+  self->wr_instr=wr_instr;
+  self->rd_instr=rd_instr;
+  self->px_instr=px_instr;
+}
+
+void
+mipi_init_qspi_ctr (struct mipi_qspi_ctr * self)
+{
+  self->bus_mtx=_osal_create_mutex ();
+  self->bus=_osal_qspi_bus_init (
+    self->data_base,
+    (uint8_t)self->px_lanes,
+    self->sck,
+    self->sck_hz
+  );
+  if (!self->bus) {
+    _mipi_dbg (
+      MIPI_DBG_TAG,
+      "failed to claim resources for the quad-SPI bus"
+    );
+    self->errno|=MIPI_ERR_IO;
+    return;
+  }
+
+  _osal_init_gpio_pin (self->cs, _OSAL_GPIO_OUT);
+  _osal_set_gpio_pin_state (self->cs, !_QSPI_ACTIVE_STATE);
+
+  // As with the 8080 connector, the CPU can stand in for a missing channel.
+  self->dma_chan=_osal_dma_claim_chan ();
+  self->io.can_wt=1;
+  self->io.can_rd=1;
+}
+
+void
+mipi_free_qspi_ctr (struct mipi_qspi_ctr * self)
+{
+  if (self->bus)
+    _osal_qspi_wait_idle (self->bus);
+  if (self->dma_chan>=0) {
+    _osal_dma_unclaim_chan (self->dma_chan);
+    self->dma_chan=-1;
+  }
+  if (self->bus) {
+    _osal_qspi_bus_deinit (self->bus);
+    self->bus=NULL;
+  }
+}
+
+static _Bool
+_mipi_qspi_begin_tx (struct mipi_qspi_ctr * self)
+{
+  if (!self->bus)
+    return false;
+  return _osal_lock_mtx_block_ms (&self->bus_mtx, MIPI_MAX_TM);
+}
+
+static void
+_mipi_qspi_end_tx (struct mipi_qspi_ctr * self)
+{
+  _osal_unlock_mtx (&self->bus_mtx);
+}
+
+/**
+ * Selects the panel and sends the header of a frame. The frame stays open
+ * for its data phase until `_mipi_qspi_close_frame`.
+ */
+static void
+_mipi_qspi_open_frame (
+  struct mipi_qspi_ctr * self,
+  uint8_t instr,
+  mipi_dcs_cmd_T cmd )
+{
+  const uint8_t hdr[_QSPI_HDR_SZ]={ instr, 0x00, cmd, 0x00 };
+
+  _osal_set_gpio_pin_state (self->cs, _QSPI_ACTIVE_STATE);
+  _osal_qspi_write_block (self->bus, hdr, sizeof(hdr), 1);
+}
+
+/**
+ * The last bits may still be queued; CS must stay asserted until they have
+ * been clocked out.
+ */
+static void
+_mipi_qspi_close_frame (struct mipi_qspi_ctr * self)
+{
+  _osal_qspi_wait_idle (self->bus);
+  _osal_set_gpio_pin_state (self->cs, !_QSPI_ACTIVE_STATE);
+}
+
+static void
+_mipi_qspi_write_reg_locked (
+  struct mipi_qspi_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t params[],
+  size_t len )
+{
+  _mipi_qspi_open_frame (self, self->wr_instr, cmd);
+  if (len)
+    _osal_qspi_write_block (self->bus, params, len, 1);
+  _mipi_qspi_close_frame (self);
+}
+
+void
+mipi_qspi_write_txn (
+  struct mipi_io_ctr * self,
+  _IN const struct mipi_io_txn_seg segs[],
+  size_t num_segs,
+  _IN const uint8_t px_data[],
+  size_t px_sz )
+{
+  struct mipi_qspi_ctr * qspi_conn=(struct mipi_qspi_ctr *) self;
+  const uint8_t lanes=(uint8_t)qspi_conn->px_lanes;
+  const struct mipi_io_txn_seg * last;
+
+  if (!num_segs || (px_sz && !px_data)) {
+    qspi_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+  last=&segs[num_segs-1];
+  for (size_t i=0; i<num_segs; i++) {
+    if (segs[i].num_params && !segs[i].params) {
+      qspi_conn->errno|=MIPI_ERR_INV;
+      return;
+    }
+  }
+  if (!_mipi_qspi_begin_tx (qspi_conn)) {
+    qspi_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return;
+  }
+
+  for (size_t i=0; i+1<num_segs; i++) {
+    _mipi_qspi_write_reg_locked (
+      qspi_conn,
+      segs[i].cmd,
+      segs[i].params,
+      segs[i].num_params
+    );
+  }
+
+  /**
+   * The pixel data belongs to the frame of the last segment, which is then
+   * sent with the pixel instruction so that all of its data phase is on the
+   * full width of the bus.
+   */
+  if (!px_sz) {
+    _mipi_qspi_write_reg_locked (
+      qspi_conn,
+      last->cmd,
+      last->params,
+      last->num_params
+    );
+  } else {
+    _mipi_qspi_open_frame (qspi_conn, qspi_conn->px_instr, last->cmd);
+    if ((last->num_params && !_osal_qspi_write_block (
+          qspi_conn->bus,
+          last->params,
+          last->num_params,
+          lanes))
+        || !_osal_qspi_write_block (qspi_conn->bus, px_data, px_sz, lanes))
+      qspi_conn->errno|=MIPI_ERR_IO;
+    _mipi_qspi_close_frame (qspi_conn);
+  }
+  _mipi_qspi_end_tx (qspi_conn);
+}
+
+void
+mipi_qspi_send_cmd (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t params[],
+  size_t len )
+{
+  const struct mipi_io_txn_seg seg=
+  {
+    .cmd=cmd,
+    .params=params,
+    .num_params=len
+  };
+
+  mipi_qspi_write_txn (self, &seg, 1, NULL, 0);
+}
+
+/**
+ * Unlike on the parallel interface, there is no dummy cycle; the panel
+ * turns D1 around within the last bit of the address.
+ */
+ssize_t
+mipi_qspi_recv_params (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _OUT uint8_t params[],
+  size_t len )
+{
+  struct mipi_qspi_ctr * qspi_conn=(struct mipi_qspi_ctr *) self;
+  ssize_t n=(ssize_t)len;
+
+  if (!params || !len) {
+    qspi_conn->errno|=MIPI_ERR_INV;
+    return -1;
+  }
+  if (!_mipi_qspi_begin_tx (qspi_conn)) {
+    qspi_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return -1;
+  }
+
+  self->rd_in_prog=1;
+  _mipi_qspi_open_frame (qspi_conn, qspi_conn->rd_instr, cmd);
+  _osal_qspi_wait_idle (qspi_conn->bus);
+  if (!_osal_qspi_read_block (
+        qspi_conn->bus,
+        params,
+        len,
+        qspi_conn->rd_cycle_ns)) {
+    qspi_conn->errno|=MIPI_ERR_IO;
+    n=-1;
+  }
+  _mipi_qspi_close_frame (qspi_conn);
+  self->rd_in_prog=0;
+  _mipi_qspi_end_tx (qspi_conn);
+
+  return n;
+}
+
+/**
+ * Opens the RAMWR frame and leaves it open, so that the chunks which follow
+ * are all part of its data phase.
+ */
+mipi_err_T
+mipi_qspi_begin_fmbf_stream (
+  struct mipi_io_ctr * self,
+  const struct mipi_area bounds )
+{
+  struct mipi_qspi_ctr * qspi_conn=(struct mipi_qspi_ctr *) self;
+  uint8_t ca_params[4], ra_params[4];
+
+  if (!bounds.w || !bounds.h)
+    return MIPI_ERR_INV;
+  if (!_mipi_qspi_begin_tx (qspi_conn)) {
+    qspi_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return MIPI_ERR_RES_LOCKED;
+  }
+
+  _mipi_dcs_pack_addr (ca_params, bounds.x, (uint16_t)(bounds.x+bounds.w-1));
+  _mipi_dcs_pack_addr (ra_params, bounds.y, (uint16_t)(bounds.y+bounds.h-1));
+  _mipi_qspi_write_reg_locked (qspi_conn, CASET, ca_params, sizeof(ca_params));
+  _mipi_qspi_write_reg_locked (qspi_conn, RASET, ra_params, sizeof(ra_params));
+  _mipi_qspi_open_frame (qspi_conn, qspi_conn->px_instr, RAMWR);
+
+  qspi_conn->in_fmbf_stream=true;
+  return 0;
+}
+
+static void
+_mipi_qspi_dma_chunk_done (void * cb_arg)
+{
+  struct mipi_qspi_ctr * qspi_conn=(struct mipi_qspi_ctr *) cb_arg;
+  qspi_conn->io.wt_in_prog=0;
+}
+
+static _Bool
+_mipi_qspi_wait_chunk_ms (
+  struct mipi_qspi_ctr * self,
+  uint32_t ms )
+{
+  uint32_t t0=_osal_get_time_ms ();
+
+  while (self->io.wt_in_prog) {
+    if ((_osal_get_time_ms ()-t0)>=ms)
+      return false;
+    _osal_yield ();
+  }
+  return true;
+}
+
+mipi_err_T
+mipi_qspi_write_fmbf_chunk (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t chunk[],
+  size_t len )
+{
+  struct mipi_qspi_ctr * qspi_conn=(struct mipi_qspi_ctr *) self;
+  const uint8_t lanes=(uint8_t)qspi_conn->px_lanes;
+
+  if (!qspi_conn->in_fmbf_stream || !chunk)
+    return MIPI_ERR_INV;
+  if (!_mipi_qspi_wait_chunk_ms (qspi_conn, MIPI_MAX_TM)) {
+    qspi_conn->errno|=MIPI_ERR_IO;
+    return MIPI_ERR_IO;
+  }
+
+  if (qspi_conn->dma_chan>=0) {
+    self->wt_in_prog=1;
+    if (_osal_qspi_write_async (
+          qspi_conn->bus,
+          qspi_conn->dma_chan,
+          chunk,
+          len,
+          lanes,
+          _mipi_qspi_dma_chunk_done,
+          qspi_conn
+        ))
+      return 0;
+    self->wt_in_prog=0;
+  }
+
+  if (!_osal_qspi_write_block (qspi_conn->bus, chunk, len, lanes)) {
+    qspi_conn->errno|=MIPI_ERR_IO;
+    return MIPI_ERR_IO;
+  }
+  return 0;
+}
+
+void
+mipi_qspi_end_fmbf_stream (struct mipi_io_ctr * self)
+{
+  struct mipi_qspi_ctr * qspi_conn=(struct mipi_qspi_ctr *) self;
+
+  if (!qspi_conn->in_fmbf_stream)
+    return;
+  if (!_mipi_qspi_wait_chunk_ms (qspi_conn, MIPI_MAX_TM))
+    qspi_conn->errno|=MIPI_ERR_IO;
+
+  qspi_conn->in_fmbf_stream=false;
+  _mipi_qspi_close_frame (qspi_conn);
+  _mipi_qspi_end_tx (qspi_conn);
+}
+
+mipi_err_T
+mipi_qspi_take_err (struct mipi_io_ctr * self)
+{
+  struct mipi_qspi_ctr * qspi_conn=(struct mipi_qspi_ctr *) self;
+  const mipi_err_T err=(mipi_err_T)qspi_conn->errno;
+
+  qspi_conn->errno=0;
+  return err;
+}
+
+void
+mipi_qspi_flush_fmbf (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t pix_buff[],
+  const struct mipi_area bounds,
+  size_t len )
+{
+  struct mipi_qspi_ctr * qspi_conn=(struct mipi_qspi_ctr *) self;
+
+  if (!pix_buff) {
+    _mipi_dbg (
+      MIPI_DBG_TAG,
+      "pixel data buffer empty, aborting transaction\n"
+    );
+    qspi_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+
+  if (mipi_qspi_begin_fmbf_stream (self, bounds))
+    return;
+  mipi_qspi_write_fmbf_chunk (self, pix_buff, len);
+  mipi_qspi_end_fmbf_stream (self);
+}
+
+void
+mipi_qspi_flush_fmbf_vec (
+  struct mipi_io_ctr * self,
+  _IN byte_buffer_view_T spans[],
+  size_t num_spans,
+  const struct mipi_area bounds )
+{
+  struct mipi_qspi_ctr * qspi_conn=(struct mipi_qspi_ctr *) self;
+
+  if (!spans || !num_spans) {
+    qspi_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+
+  if (mipi_qspi_begin_fmbf_stream (self, bounds))
+    return;
+  for (size_t i=0; i<num_spans; i++) {
+    if (!spans[i].buff_sz)
+      continue;
+    if (mipi_qspi_write_fmbf_chunk (self, spans[i].buff, spans[i].buff_sz))
+      break;
+  }
+  mipi_qspi_end_fmbf_stream (self);
+}
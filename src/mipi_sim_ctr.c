@@ -0,0 +1,648 @@
+/**
+ * ========================
+ *      mipi_sim_ctr.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-10
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "mipi_sim_ctr.h"
+
+#define _SIM_DEF_HZ 10*1000*1000
+
+const struct mipi_io_ctr _MIPI_SIM_CTR_FUNCS=
+(struct mipi_io_ctr) {
+	.write_panel_reg=mipi_sim_send_cmd,
+	.write_panel_txn=mipi_sim_write_txn,
+	.read_panel_reg=mipi_sim_recv_params,
+	.flush_fmbf=mipi_sim_flush_fmbf,
+	.flush_fmbf_vec=mipi_sim_flush_fmbf_vec,
+	.begin_fmbf_stream=mipi_sim_begin_fmbf_stream,
+	.write_fmbf_chunk=mipi_sim_write_fmbf_chunk,
+	.end_fmbf_stream=mipi_sim_end_fmbf_stream,
+	.take_err=mipi_sim_take_err,
+	.set_phase_clk=mipi_sim_set_phase_clk
+};
+
+struct mipi_sim_ctr
+mipi_create_sim_ctr (
+	uint16_t width,
+	uint16_t height,
+	uint8_t bytes_per_px )
+{
+	struct mipi_sim_ctr sim=
+	{
+		.io=_MIPI_SIM_CTR_FUNCS,
+		.width=width,
+		.height=height,
+		.bytes_per_px=bytes_per_px,
+		.xe=width ? width-1 : 0,
+		.ye=height ? height-1 : 0,
+		.phase_hz=
+		{
+			[MIPI_IO_PHASE_CMD]=_SIM_DEF_HZ,
+			[MIPI_IO_PHASE_RD]=_SIM_DEF_HZ,
+			[MIPI_IO_PHASE_PX]=_SIM_DEF_HZ
+		},
+		.rng=0x2545F491u,
+		.dcx_lvl=true
+	};
+
+	sim.gram=mipi_osal_calloc ((size_t)width*height, bytes_per_px);
+	if (!sim.gram) {
+		_mipi_dbg (
+			MIPI_DBG_TAG,
+			"failed to allocate GRAM for simulated panel"
+		);
+		mipi_err_code|=MIPI_ERR_NO_MEM;
+		sim.errno|=MIPI_ERR_NO_MEM;
+	} else {
+		sim.io.can_wt=1;
+		sim.io.can_rd=1;
+	}
+
+	return sim;
+}
+
+void
+mipi_free_sim_ctr (struct mipi_sim_ctr * self)
+{
+	mipi_osal_free (self->gram);
+	self->gram=NULL;
+	mipi_osal_free (self->log);
+	self->log=NULL;
+	self->log_cap=0;
+}
+
+void
+mipi_sim_set_err_threshold (
+	struct mipi_sim_ctr * self,
+	uint32_t max_wr_hz,
+	uint32_t max_rd_hz,
+	uint32_t err_1_in )
+{
+	self->max_wr_hz=max_wr_hz;
+	self->max_rd_hz=max_rd_hz;
+	self->err_1_in=err_1_in;
+}
+
+static uint8_t
+_mipi_sim_corrupt (
+	struct mipi_sim_ctr * self,
+	uint8_t b,
+	uint32_t hz,
+	uint32_t max_hz )
+{
+	uint32_t x=self->rng;
+
+	if (!self->err_1_in || !max_hz || hz<=max_hz)
+		return b;
+
+	x^=x<<13;
+	x^=x>>17;
+	x^=x<<5;
+	self->rng=x;
+	if (x%self->err_1_in)
+		return b;
+
+	self->num_errs_injected++;
+	return b^(uint8_t)(1u<<((x>>8) & 7));
+}
+
+/**
+ * Maps a byte offset into the current window to one into GRAM, or returns
+ * `-1` if it falls outside of the panel. The window is in the coordinates
+ * set by MADCTL; GRAM is kept in those of the panel itself.
+ */
+static ssize_t
+_mipi_sim_gram_off (
+	struct mipi_sim_ctr * self,
+	size_t pos )
+{
+	const size_t win_w=(size_t)self->xe-self->xs+1,
+		px=pos/self->bytes_per_px;
+	size_t x=self->xs+px%win_w, y=self->ys+px/win_w;
+
+	if (self->madctl & SWAP_XY) {
+		const size_t tmp=x;
+
+		x=y;
+		y=tmp;
+	}
+	if (x>=self->width || y>=self->height)
+		return -1;
+	if (self->madctl & MIRROR_X)
+		x=self->width-1-x;
+	if (self->madctl & MIRROR_Y)
+		y=self->height-1-y;
+
+	return (ssize_t)((y*self->width+x)*self->bytes_per_px
+		+pos%self->bytes_per_px);
+}
+
+static size_t
+_mipi_sim_win_sz (struct mipi_sim_ctr * self)
+{
+	if (self->xe<self->xs || self->ye<self->ys)
+		return 0;
+	return ((size_t)self->xe-self->xs+1)
+		*((size_t)self->ye-self->ys+1)
+		*self->bytes_per_px;
+}
+
+/**
+ * Advances the time the model has spent on the bus, and that of the bus it
+ * shares with other panels, by `ns`.
+ */
+static void
+_mipi_sim_charge (
+	struct mipi_sim_ctr * self,
+	uint64_t ns )
+{
+	self->wire_ns+=ns;
+	if (!self->bus)
+		return;
+
+	if (self->bus->owner!=self) {
+		if (self->bus->owner)
+			self->bus->num_switches++;
+		self->bus->owner=self;
+	}
+	self->bus->t_ns+=ns;
+}
+
+static void
+_mipi_sim_clock (
+	struct mipi_sim_ctr * self,
+	size_t num_bytes,
+	enum mipi_io_phase phase )
+{
+	const uint32_t hz=self->phase_hz[phase];
+	uint64_t ns;
+
+	if (!hz || !num_bytes)
+		return;
+	ns=(uint64_t)num_bytes*8*1000*1000*1000/hz;
+	self->phase_ns[phase]+=ns;
+	_mipi_sim_charge (self, ns);
+}
+
+/**
+ * Charges the assertion of CS at the start of an operation; DCX is left as
+ * the previous one left it.
+ */
+static void
+_mipi_sim_select (struct mipi_sim_ctr * self)
+{
+	self->num_selects++;
+	self->cs_ns+=self->cost.cs_ns;
+	_mipi_sim_charge (self, self->cost.cs_ns);
+}
+
+static void
+_mipi_sim_set_dcx (
+	struct mipi_sim_ctr * self,
+	_Bool lvl )
+{
+	if (self->dcx_lvl==lvl)
+		return;
+	self->dcx_lvl=lvl;
+	self->num_dcx_changes++;
+	self->dcx_ns+=self->cost.dcx_ns;
+	_mipi_sim_charge (self, self->cost.dcx_ns);
+}
+
+static void
+_mipi_sim_log_cmd (
+	struct mipi_sim_ctr * self,
+	mipi_dcs_cmd_T cmd )
+{
+	struct mipi_sim_log_ent * ent;
+
+	if (!self->log_cap)
+		return;
+	ent=&self->log[self->num_logged++%self->log_cap];
+	memset (ent, 0, sizeof(*ent));
+	ent->cmd=cmd;
+	ent->t_ns=self->wire_ns;
+}
+
+static void
+_mipi_sim_log_data (
+	struct mipi_sim_ctr * self,
+	_IN const uint8_t data[],
+	size_t len )
+{
+	struct mipi_sim_log_ent * ent;
+
+	if (!self->log_cap || !self->num_logged)
+		return;
+	ent=&self->log[(self->num_logged-1)%self->log_cap];
+	for (size_t i=0; i<len && ent->num_bytes+i<MIPI_SIM_LOG_PARAM_CAP; i++)
+		ent->params[ent->num_bytes+i]=data[i];
+	ent->num_bytes+=len;
+}
+
+static void
+_mipi_sim_cmd (
+	struct mipi_sim_ctr * self,
+	mipi_dcs_cmd_T cmd,
+	enum mipi_io_phase phase )
+{
+	_mipi_sim_set_dcx (self, false);
+	_mipi_sim_log_cmd (self, cmd);
+	_mipi_sim_clock (self, 1, phase);
+	self->cur_cmd=cmd;
+	self->param_idx=0;
+	self->num_cmds++;
+
+	switch (cmd) {
+	case SWRST:
+		self->madctl=0;
+		self->xs=0;
+		self->ys=0;
+		self->xe=self->width-1;
+		self->ye=self->height-1;
+		break;
+	case RAMWR:
+		self->wr_pos=0;
+		break;
+	case RAMRD:
+		self->rd_pos=0;
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+_mipi_sim_data (
+	struct mipi_sim_ctr * self,
+	_IN const uint8_t data[],
+	size_t len,
+	enum mipi_io_phase phase )
+{
+	const size_t win_sz=_mipi_sim_win_sz (self);
+
+	if (!len)
+		return;
+	_mipi_sim_set_dcx (self, true);
+	_mipi_sim_log_data (self, data, len);
+	_mipi_sim_clock (self, len, phase);
+	for (size_t i=0; i<len; i++) {
+		const uint8_t b=_mipi_sim_corrupt (
+			self,
+			data[i],
+			self->phase_hz[phase],
+			self->max_wr_hz
+		);
+		ssize_t off;
+
+		self->num_wr_bytes++;
+		switch (self->cur_cmd) {
+		case CASET:
+		case RASET:
+			if (self->param_idx>=sizeof(self->params))
+				break;
+			self->params[self->param_idx++]=b;
+			if (self->param_idx<sizeof(self->params))
+				break;
+			if (self->cur_cmd==CASET) {
+				self->xs=(uint16_t)(self->params[0]<<8 | self->params[1]);
+				self->xe=(uint16_t)(self->params[2]<<8 | self->params[3]);
+			} else {
+				self->ys=(uint16_t)(self->params[0]<<8 | self->params[1]);
+				self->ye=(uint16_t)(self->params[2]<<8 | self->params[3]);
+			}
+			break;
+		case MADCTL:
+			if (!self->param_idx++)
+				self->madctl=b;
+			break;
+		case RAMWR:
+		case RAMWRC:
+			if (!win_sz || !self->gram)
+				break;
+			off=_mipi_sim_gram_off (self, self->wr_pos);
+			if (off>=0)
+				self->gram[off]=b;
+			self->wr_pos=(self->wr_pos+1)%win_sz;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void
+mipi_sim_send_cmd (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T cmd,
+	_IN const uint8_t params[],
+	size_t len )
+{
+	struct mipi_sim_ctr * sim=(struct mipi_sim_ctr *) self;
+
+	if (len && !params) {
+		sim->errno|=MIPI_ERR_INV;
+		return;
+	}
+	_mipi_sim_select (sim);
+	_mipi_sim_cmd (sim, cmd, MIPI_IO_PHASE_CMD);
+	_mipi_sim_data (sim, params, len, MIPI_IO_PHASE_CMD);
+}
+
+void
+mipi_sim_write_txn (
+	struct mipi_io_ctr * self,
+	_IN const struct mipi_io_txn_seg segs[],
+	size_t num_segs,
+	_IN const uint8_t px_data[],
+	size_t px_sz )
+{
+	struct mipi_sim_ctr * sim=(struct mipi_sim_ctr *) self;
+	const enum mipi_io_phase phase=px_sz
+		? MIPI_IO_PHASE_PX
+		: MIPI_IO_PHASE_CMD;
+
+	if (!num_segs || (px_sz && !px_data)) {
+		sim->errno|=MIPI_ERR_INV;
+		return;
+	}
+
+	_mipi_sim_select (sim);
+	for (size_t i=0; i<num_segs; i++) {
+		_mipi_sim_cmd (sim, segs[i].cmd, phase);
+		_mipi_sim_data (sim, segs[i].params, segs[i].num_params, phase);
+	}
+	_mipi_sim_data (sim, px_data, px_sz, phase);
+}
+
+ssize_t
+mipi_sim_recv_params (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T cmd,
+	_OUT uint8_t params[],
+	size_t len )
+{
+	struct mipi_sim_ctr * sim=(struct mipi_sim_ctr *) self;
+	size_t win_sz;
+
+	if (!params || !len) {
+		sim->errno|=MIPI_ERR_INV;
+		return -1;
+	}
+
+	_mipi_sim_select (sim);
+	_mipi_sim_cmd (sim, cmd, MIPI_IO_PHASE_CMD);
+	_mipi_sim_set_dcx (sim, true);
+	_mipi_sim_clock (sim, len, MIPI_IO_PHASE_RD);
+	win_sz=_mipi_sim_win_sz (sim);
+	for (size_t i=0; i<len; i++) {
+		uint8_t b=0;
+		ssize_t off;
+
+		switch (cmd) {
+		case RDDID:
+			if (i<sizeof(sim->id))
+				b=sim->id[i];
+			break;
+		case RAMRD:
+		case RAMRDC:
+			if (!win_sz || !sim->gram)
+				break;
+			off=_mipi_sim_gram_off (sim, sim->rd_pos);
+			if (off>=0)
+				b=sim->gram[off];
+			sim->rd_pos=(sim->rd_pos+1)%win_sz;
+			break;
+		default:
+			break;
+		}
+
+		params[i]=_mipi_sim_corrupt (
+			sim,
+			b,
+			sim->phase_hz[MIPI_IO_PHASE_RD],
+			sim->max_rd_hz
+		);
+		sim->num_rd_bytes++;
+	}
+	_mipi_sim_log_data (sim, params, len);
+
+	return (ssize_t)len;
+}
+
+mipi_err_T
+mipi_sim_begin_fmbf_stream (
+	struct mipi_io_ctr * self,
+	const struct mipi_area bounds )
+{
+	struct mipi_sim_ctr * sim=(struct mipi_sim_ctr *) self;
+	uint8_t ca_params[4], ra_params[4];
+
+	if (!bounds.w || !bounds.h)
+		return MIPI_ERR_INV;
+
+	_mipi_dcs_pack_addr (ca_params, bounds.x, (uint16_t)(bounds.x+bounds.w-1));
+	_mipi_dcs_pack_addr (ra_params, bounds.y, (uint16_t)(bounds.y+bounds.h-1));
+	_mipi_sim_select (sim);
+	_mipi_sim_cmd (sim, CASET, MIPI_IO_PHASE_PX);
+	_mipi_sim_data (sim, ca_params, sizeof(ca_params), MIPI_IO_PHASE_PX);
+	_mipi_sim_cmd (sim, RASET, MIPI_IO_PHASE_PX);
+	_mipi_sim_data (sim, ra_params, sizeof(ra_params), MIPI_IO_PHASE_PX);
+	_mipi_sim_cmd (sim, RAMWR, MIPI_IO_PHASE_PX);
+
+	return 0;
+}
+
+mipi_err_T
+mipi_sim_write_fmbf_chunk (
+	struct mipi_io_ctr * self,
+	_IN const uint8_t chunk[],
+	size_t len )
+{
+	struct mipi_sim_ctr * sim=(struct mipi_sim_ctr *) self;
+
+	if (!chunk)
+		return MIPI_ERR_INV;
+	_mipi_sim_data (sim, chunk, len, MIPI_IO_PHASE_PX);
+	return 0;
+}
+
+void
+mipi_sim_end_fmbf_stream (struct mipi_io_ctr * self)
+{
+	(void)self;
+}
+
+mipi_err_T
+mipi_sim_take_err (struct mipi_io_ctr * self)
+{
+	struct mipi_sim_ctr * sim=(struct mipi_sim_ctr *) self;
+	const mipi_err_T err=(mipi_err_T)sim->errno;
+
+	sim->errno=0;
+	return err;
+}
+
+void
+mipi_sim_flush_fmbf (
+	struct mipi_io_ctr * self,
+	_IN const uint8_t pix_buff[],
+	const struct mipi_area bounds,
+	size_t len )
+{
+	struct mipi_sim_ctr * sim=(struct mipi_sim_ctr *) self;
+
+	if (!pix_buff) {
+		sim->errno|=MIPI_ERR_INV;
+		return;
+	}
+	if (mipi_sim_begin_fmbf_stream (self, bounds))
+		return;
+	_mipi_sim_data (sim, pix_buff, len, MIPI_IO_PHASE_PX);
+}
+
+void
+mipi_sim_flush_fmbf_vec (
+	struct mipi_io_ctr * self,
+	_IN byte_buffer_view_T spans[],
+	size_t num_spans,
+	const struct mipi_area bounds )
+{
+	struct mipi_sim_ctr * sim=(struct mipi_sim_ctr *) self;
+
+	if (!spans || !num_spans) {
+		sim->errno|=MIPI_ERR_INV;
+		return;
+	}
+	if (mipi_sim_begin_fmbf_stream (self, bounds))
+		return;
+	for (size_t i=0; i<num_spans; i++)
+		_mipi_sim_data (sim, spans[i].buff, spans[i].buff_sz, MIPI_IO_PHASE_PX);
+}
+
+uint32_t
+mipi_sim_set_phase_clk (
+	struct mipi_io_ctr * self,
+	enum mipi_io_phase phase,
+	uint32_t hz )
+{
+	struct mipi_sim_ctr * sim=(struct mipi_sim_ctr *) self;
+
+	if (phase>=MIPI_IO_NUM_PHASES)
+		return 0;
+	sim->phase_hz[phase]=hz;
+	return hz;
+}
+
+void
+mipi_sim_attach_bus (
+	struct mipi_sim_ctr * self,
+	struct mipi_sim_bus * bus )
+{
+	self->bus=bus;
+}
+
+void
+mipi_sim_set_cost (
+	struct mipi_sim_ctr * self,
+	const struct mipi_sim_cost cost )
+{
+	self->cost=cost;
+}
+
+mipi_err_T
+mipi_sim_set_log (
+	struct mipi_sim_ctr * self,
+	size_t cap )
+{
+	struct mipi_sim_log_ent * log=NULL;
+
+	if (cap) {
+		log=mipi_osal_calloc (cap, sizeof(*log));
+		if (!log) {
+			_mipi_dbg (
+				MIPI_DBG_TAG,
+				"failed to allocate log for simulated panel"
+			);
+			mipi_err_code|=MIPI_ERR_NO_MEM;
+			return MIPI_ERR_NO_MEM;
+		}
+	}
+
+	mipi_osal_free (self->log);
+	self->log=log;
+	self->log_cap=cap;
+	self->num_logged=0;
+
+	return 0;
+}
+
+size_t
+mipi_sim_log_len (const struct mipi_sim_ctr * self)
+{
+	return self->num_logged<self->log_cap
+		? self->num_logged
+		: self->log_cap;
+}
+
+const struct mipi_sim_log_ent *
+mipi_sim_log_at (
+	const struct mipi_sim_ctr * self,
+	size_t idx )
+{
+	const size_t len=mipi_sim_log_len (self);
+
+	if (idx>=len)
+		return NULL;
+	return &self->log[(self->num_logged-len+idx)%self->log_cap];
+}
+
+void
+mipi_sim_reset_stats (struct mipi_sim_ctr * self)
+{
+	self->num_cmds=0;
+	self->num_wr_bytes=0;
+	self->num_rd_bytes=0;
+	self->num_errs_injected=0;
+	self->num_selects=0;
+	self->num_dcx_changes=0;
+	self->num_frames=0;
+	self->wire_ns=0;
+	memset (self->phase_ns, 0, sizeof(self->phase_ns));
+	self->cs_ns=0;
+	self->dcx_ns=0;
+	self->num_logged=0;
+}
+
+void
+mipi_sim_mark_frame (struct mipi_sim_ctr * self)
+{
+	self->num_frames++;
+}
+
+void
+mipi_sim_get_report (
+	const struct mipi_sim_ctr * self,
+	uint32_t target_fps,
+	_OUT struct mipi_sim_report * rep )
+{
+	memset (rep, 0, sizeof(*rep));
+	rep->num_frames=self->num_frames;
+	if (!self->num_frames)
+		return;
+
+	rep->ns_per_frame=self->wire_ns/self->num_frames;
+	if (rep->ns_per_frame)
+		rep->fps=1e9f/(float)rep->ns_per_frame;
+	if (target_fps)
+		rep->occupancy=(float)rep->ns_per_frame*(float)target_fps/1e9f;
+}
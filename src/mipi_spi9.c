@@ -0,0 +1,122 @@
+/**
+ * ========================
+ *       mipi_spi9.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-16
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include "mipi_spi9.h"
+
+static inline void
+_mipi_spi9_put_be64 (
+	uint8_t out[],
+	uint64_t v )
+{
+	for (int i=7; i>=0; i--) {
+		out[i]=(uint8_t)v;
+		v>>=8;
+	}
+}
+
+size_t
+mipi_spi9_encode (
+	struct mipi_spi9_enc * enc,
+	_Bool dcx,
+	const uint8_t in[],
+	size_t num_bytes,
+	uint8_t out[] )
+{
+	const uint32_t flag=dcx ? MIPI_SPI9_DCX_BIT : 0;
+	const unsigned nb=enc->num_bits;
+	uint32_t acc=enc->acc;
+	size_t i=0, o=0;
+
+	/**
+	 * Eight words are 72 bits: the top eight bits of the first word, then the
+	 * 64 which follow. Prefixed by the `nb` bits held over, they fill nine
+	 * bytes and leave the last `nb` bits of the group over in turn, so the
+	 * alignment is the same at the start of every group.
+	 */
+	for (; i+8<=num_bytes; i+=8) {
+		const uint8_t * w=in+i;
+		const uint8_t hi=(uint8_t)((flag | w[0])>>1);
+		const uint64_t lo=(uint64_t)(w[0] & 1u)<<63
+			| (uint64_t)(flag | w[1])<<54
+			| (uint64_t)(flag | w[2])<<45
+			| (uint64_t)(flag | w[3])<<36
+			| (uint64_t)(flag | w[4])<<27
+			| (uint64_t)(flag | w[5])<<18
+			| (uint64_t)(flag | w[6])<<9
+			| (uint64_t)(flag | w[7]);
+
+		out[o++]=(uint8_t)(acc<<(8-nb) | hi>>nb);
+		_mipi_spi9_put_be64 (
+			out+o,
+			nb ? (uint64_t)hi<<(64-nb) | lo>>nb : lo
+		);
+		o+=8;
+		acc=(uint32_t)(lo & ((1u<<nb)-1));
+	}
+
+	enc->num_bits=(uint8_t)nb;
+	for (; i<num_bytes; i++) {
+		unsigned n=enc->num_bits+9u;
+
+		acc=acc<<9 | flag | in[i];
+		out[o++]=(uint8_t)(acc>>(n-8));
+		n-=8;
+		if (n==8) {
+			out[o++]=(uint8_t)acc;
+			n=0;
+		}
+		acc&=(1u<<n)-1;
+		enc->num_bits=(uint8_t)n;
+	}
+	enc->acc=(uint8_t)acc;
+
+	return o;
+}
+
+size_t
+mipi_spi9_enc_flush (
+	struct mipi_spi9_enc * enc,
+	uint8_t out[] )
+{
+	if (!enc->num_bits)
+		return 0;
+
+	out[0]=(uint8_t)(enc->acc<<(8-enc->num_bits));
+	mipi_spi9_enc_reset (enc);
+	return 1;
+}
+
+size_t
+mipi_spi9_decode (
+	struct mipi_spi9_dec * dec,
+	const uint8_t in[],
+	size_t num_bytes,
+	uint16_t words[] )
+{
+	uint32_t acc=dec->acc;
+	unsigned nb=dec->num_bits;
+	size_t n=0;
+
+	for (size_t i=0; i<num_bytes; i++) {
+		acc=acc<<8 | in[i];
+		nb+=8;
+		if (nb<9)
+			continue;
+		nb-=9;
+		words[n++]=(uint16_t)(acc>>nb & 0x1ffu);
+		acc&=(1u<<nb)-1;
+	}
+	dec->acc=(uint16_t)acc;
+	dec->num_bits=(uint8_t)nb;
+
+	return n;
+}
@@ -0,0 +1,504 @@
+/**
+ *
+ * 3-wire, 9-bit serial connector. Commands and their data are encoded into
+ * the staging buffers as they are written, and each buffer is sent as it
+ * fills, by DMA where a channel is available.
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+#include "mipi_dbi_spi9.h"
+
+#define _SPI9_CMD_BITS 9
+
+
+const struct mipi_io_ctr _MIPI_SPI9_CTR_FUNCS=
+(struct mipi_io_ctr) {
+  .write_panel_reg=mipi_spi9_send_cmd,
+  .write_panel_txn=mipi_spi9_write_txn,
+  .read_panel_reg=mipi_spi9_recv_params,
+  .flush_fmbf=mipi_spi9_flush_fmbf,
+  .flush_fmbf_vec=mipi_spi9_flush_fmbf_vec,
+  .begin_fmbf_stream=mipi_spi9_begin_fmbf_stream,
+  .write_fmbf_chunk=mipi_spi9_write_fmbf_chunk,
+  .end_fmbf_stream=mipi_spi9_end_fmbf_stream,
+  .take_err=mipi_spi9_take_err,
+  .set_phase_clk=mipi_spi9_set_phase_clk
+};
+
+struct mipi_spi9_ctr
+mipi_create_spi9_ctr_on_bus (
+  struct _mipi_spi_dev * spi_dev,
+  _osal_gpio_pin_T cs )
+{
+  if (spi_dev)
+    spi_dev->num_ctrs++;
+
+  return (struct mipi_spi9_ctr){
+    .io=_MIPI_SPI9_CTR_FUNCS,
+    .spi_dev=spi_dev,
+    .cs=cs,
+    .phase_hz=
+    {
+      [MIPI_IO_PHASE_CMD]=_SPI_DEF_CMD_BD,
+      [MIPI_IO_PHASE_RD]=_SPI_DEF_RD_BD,
+      [MIPI_IO_PHASE_PX]=_SPI_DEF_BD
+    },
+    .rd_dummy_bits=_SPI_DEF_RD_DUMMY_BITS,
+    .ram_rd_dummy_bits=_SPI_DEF_RAM_RD_DUMMY_BITS,
+    .dma_chan=-1
+  };
+}
+
+struct mipi_spi9_ctr
+mipi_create_spi9_ctr (
+  struct _osal_spi_dev * spi,
+  _osal_gpio_pin_T sck,
+  _osal_gpio_pin_T mosi,
+  _osal_gpio_pin_T miso,
+  _osal_gpio_pin_T cs )
+{
+  return mipi_create_spi9_ctr_on_bus (
+    mipi_create_spi_bus (spi, sck, mosi, miso),
+    cs
+  );
+}
+
+void
+mipi_init_spi9_ctr (struct mipi_spi9_ctr * self)
+{
+  mipi_init_spi_bus (self->spi_dev, self->phase_hz[MIPI_IO_PHASE_CMD]);
+
+  _osal_init_gpio_pin (self->cs, _OSAL_GPIO_OUT);
+  _osal_set_gpio_pin_state (self->cs, !(_SPI_ACTIVE_STATE));
+
+  // Without a channel, each staging buffer is written by the CPU instead.
+  self->dma_chan=_osal_dma_claim_chan ();
+  self->io.can_wt=1;
+  self->io.can_rd=1;
+}
+
+static _Bool
+_mipi_spi9_wait_stage_ms (
+  struct mipi_spi9_ctr * self,
+  uint32_t ms )
+{
+  uint32_t t0=_osal_get_time_ms ();
+
+  while (self->io.wt_in_prog) {
+    if ((_osal_get_time_ms ()-t0)>=ms)
+      return false;
+    _osal_yield ();
+  }
+  return true;
+}
+
+void
+mipi_free_spi9_ctr (struct mipi_spi9_ctr * self)
+{
+  if (self->dma_chan>=0) {
+    _mipi_spi9_wait_stage_ms (self, MIPI_MAX_TM);
+    _osal_dma_unclaim_chan (self->dma_chan);
+    self->dma_chan=-1;
+  }
+  if (self->spi_dev && !--self->spi_dev->num_ctrs)
+    mipi_osal_free (self->spi_dev);
+  self->spi_dev=NULL;
+}
+
+static void
+_mipi_spi9_use_phase (
+  struct mipi_spi9_ctr * self,
+  enum mipi_io_phase phase )
+{
+  struct _mipi_spi_dev * spi_dev=self->spi_dev;
+
+  if (spi_dev->cur_hz==self->phase_hz[phase])
+    return;
+  _osal_spi_set_baudrate (spi_dev->spi, self->phase_hz[phase]);
+  spi_dev->cur_hz=self->phase_hz[phase];
+}
+
+static void
+_mipi_spi9_stage_done (void * cb_arg)
+{
+  struct mipi_spi9_ctr * spi9_conn=(struct mipi_spi9_ctr *) cb_arg;
+  spi9_conn->io.wt_in_prog=0;
+}
+
+/**
+ * Sends the current staging buffer and switches to the other, which is only
+ * free once the transfer before this one has completed.
+ */
+static void
+_mipi_spi9_send_stage (struct mipi_spi9_ctr * self)
+{
+  struct _osal_spi_dev * spi=self->spi_dev->spi;
+  const uint8_t * buf=self->stage[self->cur_stage];
+
+  if (!self->stage_len)
+    return;
+  if (!_mipi_spi9_wait_stage_ms (self, MIPI_MAX_TM)) {
+    self->errno|=MIPI_ERR_IO;
+    return;
+  }
+
+  if (self->dma_chan>=0) {
+    self->io.wt_in_prog=1;
+    if (!_osal_dma_spi_write_async (
+          self->dma_chan,
+          spi,
+          buf,
+          self->stage_len,
+          _mipi_spi9_stage_done,
+          self
+        )) {
+      self->io.wt_in_prog=0;
+      _osal_spi_write_block_ms (spi, buf, self->stage_len, MIPI_MAX_TM);
+    }
+  } else {
+    _osal_spi_write_block_ms (spi, buf, self->stage_len, MIPI_MAX_TM);
+  }
+
+  self->cur_stage^=1;
+  self->stage_len=0;
+}
+
+/**
+ * Encodes `len` bytes with the D/C flag `dcx` onto the end of the frame,
+ * sending each staging buffer as it fills.
+ */
+static void
+_mipi_spi9_put (
+  struct mipi_spi9_ctr * self,
+  _Bool dcx,
+  _IN const uint8_t data[],
+  size_t len )
+{
+  while (len) {
+    const size_t room=MIPI_SPI9_STAGE_SZ-self->stage_len;
+    size_t n=room ? (room-1)*8/9 : 0;
+
+    if (!n) {
+      _mipi_spi9_send_stage (self);
+      continue;
+    }
+    if (n>len)
+      n=len;
+    self->stage_len+=mipi_spi9_encode (
+      &self->enc,
+      dcx,
+      data,
+      n,
+      self->stage[self->cur_stage]+self->stage_len
+    );
+    data+=n;
+    len-=n;
+  }
+}
+
+static _Bool
+_mipi_spi9_begin_tx (struct mipi_spi9_ctr * self)
+{
+  if (!_SPI_BEGIN_TX (self))
+    return false;
+
+  mipi_spi9_enc_reset (&self->enc);
+  self->stage_len=0;
+  return true;
+}
+
+/**
+ * Pads out the last word, sends whatever is left and waits for it to leave
+ * the peripheral before CS is released.
+ */
+static void
+_mipi_spi9_end_tx (struct mipi_spi9_ctr * self)
+{
+  self->stage_len+=mipi_spi9_enc_flush (
+    &self->enc,
+    self->stage[self->cur_stage]+self->stage_len
+  );
+  _mipi_spi9_send_stage (self);
+  if (!_mipi_spi9_wait_stage_ms (self, MIPI_MAX_TM))
+    self->errno|=MIPI_ERR_IO;
+
+  _SPI_END_TX (self);
+}
+
+static void
+_mipi_spi9_write_reg_locked (
+  struct mipi_spi9_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t params[],
+  size_t len )
+{
+  _mipi_spi9_put (self, false, &cmd, 1);
+  if (len)
+    _mipi_spi9_put (self, true, params, len);
+}
+
+void
+mipi_spi9_write_txn (
+  struct mipi_io_ctr * self,
+  _IN const struct mipi_io_txn_seg segs[],
+  size_t num_segs,
+  _IN const uint8_t px_data[],
+  size_t px_sz )
+{
+  struct mipi_spi9_ctr * spi9_conn=(struct mipi_spi9_ctr *) self;
+
+  if (!num_segs || (px_sz && !px_data)) {
+    spi9_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+  for (size_t i=0; i<num_segs; i++) {
+    if (segs[i].num_params && !segs[i].params) {
+      spi9_conn->errno|=MIPI_ERR_INV;
+      return;
+    }
+  }
+  if (!_mipi_spi9_begin_tx (spi9_conn)) {
+    spi9_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return;
+  }
+
+  _mipi_spi9_use_phase (
+    spi9_conn,
+    px_sz ? MIPI_IO_PHASE_PX : MIPI_IO_PHASE_CMD
+  );
+  for (size_t i=0; i<num_segs; i++) {
+    _mipi_spi9_write_reg_locked (
+      spi9_conn,
+      segs[i].cmd,
+      segs[i].params,
+      segs[i].num_params
+    );
+  }
+  if (px_sz)
+    _mipi_spi9_put (spi9_conn, true, px_data, px_sz);
+
+  _mipi_spi9_end_tx (spi9_conn);
+}
+
+void
+mipi_spi9_send_cmd (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t params[],
+  size_t len )
+{
+  const struct mipi_io_txn_seg seg=
+  {
+    .cmd=cmd,
+    .params=params,
+    .num_params=len
+  };
+
+  mipi_spi9_write_txn (self, &seg, 1, NULL, 0);
+}
+
+/**
+ * The panel starts driving SDA straight after the ninth bit of the command,
+ * so the data (after any dummy cycles) is not aligned to the bytes clocked
+ * in; it is picked out of them bit by bit.
+ */
+ssize_t
+mipi_spi9_recv_params (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _OUT uint8_t params[],
+  size_t len )
+{
+  struct mipi_spi9_ctr * spi9_conn=(struct mipi_spi9_ctr *) self;
+  uint8_t * tx=spi9_conn->stage[0], * rx=spi9_conn->stage[1];
+  uint8_t dummy_bits;
+  size_t pre_bits, num_bytes;
+
+  if (!params || !len) {
+    spi9_conn->errno|=MIPI_ERR_INV;
+    return -1;
+  }
+
+  if (cmd==RAMRD || cmd==RAMRDC)
+    dummy_bits=spi9_conn->ram_rd_dummy_bits;
+  else
+    dummy_bits=(len>1) ? spi9_conn->rd_dummy_bits : 0;
+  pre_bits=_SPI9_CMD_BITS+dummy_bits;
+  num_bytes=(pre_bits+8*len+7)/8;
+  if (num_bytes>MIPI_SPI9_STAGE_SZ) {
+    spi9_conn->errno|=MIPI_ERR_INV;
+    return -1;
+  }
+
+  if (!_SPI_BEGIN_TX (spi9_conn)) {
+    spi9_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return -1;
+  }
+
+  self->rd_in_prog=1;
+  _mipi_spi9_use_phase (spi9_conn, MIPI_IO_PHASE_RD);
+  memset (tx, 0, num_bytes);
+  tx[0]=(uint8_t)(cmd>>1); // << D/C low, then the command
+  tx[1]=(uint8_t)(cmd<<7);
+  _osal_spi_write_read_block_ms (
+    spi9_conn->spi_dev->spi,
+    tx,
+    rx,
+    num_bytes,
+    MIPI_MAX_TM
+  );
+  self->rd_in_prog=0;
+  _SPI_END_TX (spi9_conn);
+
+  for (size_t i=0; i<len; i++) {
+    const size_t bit=pre_bits+8*i, idx=bit/8;
+    const uint sh=bit%8;
+
+    params[i]=(uint8_t)(rx[idx]<<sh | (sh ? rx[idx+1]>>(8-sh) : 0));
+  }
+
+  return (ssize_t)len;
+}
+
+mipi_err_T
+mipi_spi9_begin_fmbf_stream (
+  struct mipi_io_ctr * self,
+  const struct mipi_area bounds )
+{
+  struct mipi_spi9_ctr * spi9_conn=(struct mipi_spi9_ctr *) self;
+  uint8_t ca_params[4], ra_params[4];
+
+  if (!bounds.w || !bounds.h)
+    return MIPI_ERR_INV;
+  if (!_mipi_spi9_begin_tx (spi9_conn)) {
+    spi9_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return MIPI_ERR_RES_LOCKED;
+  }
+
+  _mipi_spi9_use_phase (spi9_conn, MIPI_IO_PHASE_PX);
+  _mipi_dcs_pack_addr (ca_params, bounds.x, (uint16_t)(bounds.x+bounds.w-1));
+  _mipi_dcs_pack_addr (ra_params, bounds.y, (uint16_t)(bounds.y+bounds.h-1));
+  _mipi_spi9_write_reg_locked (spi9_conn, CASET, ca_params, sizeof(ca_params));
+  _mipi_spi9_write_reg_locked (spi9_conn, RASET, ra_params, sizeof(ra_params));
+  _mipi_spi9_write_reg_locked (spi9_conn, RAMWR, NULL, 0);
+
+  spi9_conn->in_fmbf_stream=true;
+  return 0;
+}
+
+mipi_err_T
+mipi_spi9_write_fmbf_chunk (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t chunk[],
+  size_t len )
+{
+  struct mipi_spi9_ctr * spi9_conn=(struct mipi_spi9_ctr *) self;
+
+  if (!spi9_conn->in_fmbf_stream || !chunk)
+    return MIPI_ERR_INV;
+
+  _mipi_spi9_put (spi9_conn, true, chunk, len);
+  return (spi9_conn->errno & MIPI_ERR_IO) ? MIPI_ERR_IO : 0;
+}
+
+void
+mipi_spi9_end_fmbf_stream (struct mipi_io_ctr * self)
+{
+  struct mipi_spi9_ctr * spi9_conn=(struct mipi_spi9_ctr *) self;
+
+  if (!spi9_conn->in_fmbf_stream)
+    return;
+
+  spi9_conn->in_fmbf_stream=false;
+  _mipi_spi9_end_tx (spi9_conn);
+}
+
+mipi_err_T
+mipi_spi9_take_err (struct mipi_io_ctr * self)
+{
+  struct mipi_spi9_ctr * spi9_conn=(struct mipi_spi9_ctr *) self;
+  const mipi_err_T err=(mipi_err_T)spi9_conn->errno;
+
+  spi9_conn->errno=0;
+  return err;
+}
+
+void
+mipi_spi9_flush_fmbf (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t pix_buff[],
+  const struct mipi_area bounds,
+  size_t len )
+{
+  struct mipi_spi9_ctr * spi9_conn=(struct mipi_spi9_ctr *) self;
+
+  if (!pix_buff) {
+    _mipi_dbg (
+      MIPI_DBG_TAG,
+      "pixel data buffer empty, aborting transaction\n"
+    );
+    spi9_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+
+  if (mipi_spi9_begin_fmbf_stream (self, bounds))
+    return;
+  mipi_spi9_write_fmbf_chunk (self, pix_buff, len);
+  mipi_spi9_end_fmbf_stream (self);
+}
+
+/**
+ * Every span is encoded on the way out regardless, so they are simply
+ * written one after another into the same frame.
+ */
+void
+mipi_spi9_flush_fmbf_vec (
+  struct mipi_io_ctr * self,
+  _IN byte_buffer_view_T spans[],
+  size_t num_spans,
+  const struct mipi_area bounds )
+{
+  struct mipi_spi9_ctr * spi9_conn=(struct mipi_spi9_ctr *) self;
+
+  if (!spans || !num_spans) {
+    spi9_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+
+  if (mipi_spi9_begin_fmbf_stream (self, bounds))
+    return;
+  for (size_t i=0; i<num_spans; i++) {
+    if (spans[i].buff_sz)
+      _mipi_spi9_put (spi9_conn, true, spans[i].buff, spans[i].buff_sz);
+  }
+  mipi_spi9_end_fmbf_stream (self);
+}
+
+uint32_t
+mipi_spi9_set_phase_clk (
+  struct mipi_io_ctr * self,
+  enum mipi_io_phase phase,
+  uint32_t hz )
+{
+  struct mipi_spi9_ctr * spi9_conn=(struct mipi_spi9_ctr *) self;
+  uint32_t actual;
+
+  if (phase>=MIPI_IO_NUM_PHASES || !hz)
+    return 0;
+  if (!mipi_lock_spi_dev_timeout_ms (spi9_conn->spi_dev, MIPI_MAX_TM)) {
+    spi9_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return 0;
+  }
+
+  actual=_osal_spi_set_baudrate (spi9_conn->spi_dev->spi, hz);
+  spi9_conn->spi_dev->cur_hz=hz;
+  spi9_conn->phase_hz[phase]=hz;
+  mipi_unlock_spi_dev (spi9_conn->spi_dev);
+
+  return actual;
+}
@@ -4,7 +4,8 @@
  * Copyright Surface EP, LLC 2025.
  */
 
-#include "hardware/spi.h"
+#include <string.h>
+
 #include "mipi.h"
 #include "mipi_dcs.h"
 #include "mipi_dbi_spi.h"
@@ -13,163 +14,725 @@
 const struct mipi_io_ctr _MIPI_SPI_CTR_FUNCS=
 (struct mipi_io_ctr) {
   .write_panel_reg=mipi_spi_send_cmd,
+  .write_panel_txn=mipi_spi_write_txn,
   .read_panel_reg=mipi_spi_recv_params,
-  .flush_fmbf=mipi_spi_flush_fmbf
+  .flush_fmbf=mipi_spi_flush_fmbf,
+  .flush_fmbf_vec=mipi_spi_flush_fmbf_vec,
+  .begin_fmbf_stream=mipi_spi_begin_fmbf_stream,
+  .write_fmbf_chunk=mipi_spi_write_fmbf_chunk,
+  .end_fmbf_stream=mipi_spi_end_fmbf_stream,
+  .take_err=mipi_spi_take_err,
+  .set_phase_clk=mipi_spi_set_phase_clk
 };
 
-struct mipi_spi_ctr
-mipi_spi_ctr (
-  spi_inst_t * spi,
-  uint sck,
-  uint mosi,
-  uint miso,
-  uint cs,
-  uint dcx )
+struct _mipi_spi_dev *
+mipi_create_spi_bus (
+  struct _osal_spi_dev * spi,
+  _osal_gpio_pin_T sck,
+  _osal_gpio_pin_T mosi,
+  _osal_gpio_pin_T miso )
 {
-  return (struct mipi_spi_ctr){
-    .io=_MIPI_SPI_CTR_FUNCS,
+  struct _mipi_spi_dev * spi_dev, tmp=
+  {
+    .spi=spi,
     .sck=sck,
     .mosi=mosi,
     .miso=miso,
+    .buff_sz=MIPI_CMD_BUFF_SZ
+  };
+
+  spi_dev=mipi_osal_alloc (sizeof(*spi_dev));
+  if (spi_dev) {
+    memcpy (spi_dev, &tmp, sizeof(*spi_dev));
+    atomic_init (&spi_dev->dma_in_prog, false);
+  } else {
+    _mipi_dbg (
+      MIPI_DBG_TAG,
+      "failed to allocate resources for SPI device"
+    );
+    mipi_err_code|=MIPI_ERR_NO_MEM;
+  }
+
+  return spi_dev;
+}
+
+struct mipi_spi_ctr
+mipi_create_spi_ctr_on_bus (
+  struct _mipi_spi_dev * spi_dev,
+  _osal_gpio_pin_T cs,
+  _osal_gpio_pin_T dcx )
+{
+  if (spi_dev)
+    spi_dev->num_ctrs++;
+
+  return (struct mipi_spi_ctr){
+    .io=_MIPI_SPI_CTR_FUNCS,
+    .spi_dev=spi_dev,
     .cs=cs,
-    .dcx=dcx
+    .dcx=dcx,
+    .phase_hz=
+    {
+      [MIPI_IO_PHASE_CMD]=_SPI_DEF_CMD_BD,
+      [MIPI_IO_PHASE_RD]=_SPI_DEF_RD_BD,
+      [MIPI_IO_PHASE_PX]=_SPI_DEF_BD
+    },
+    .rd_dummy_bits=_SPI_DEF_RD_DUMMY_BITS,
+    .ram_rd_dummy_bits=_SPI_DEF_RAM_RD_DUMMY_BITS,
+    .flush_mode=MIPI_SPI_FLUSH_BLOCKING,
+    .dma_chan=-1
   };
 }
 
+struct mipi_spi_ctr
+mipi_create_spi_ctr (
+  struct _osal_spi_dev * spi,
+  _osal_gpio_pin_T sck,
+  _osal_gpio_pin_T mosi,
+  _osal_gpio_pin_T miso,
+  _osal_gpio_pin_T cs,
+  _osal_gpio_pin_T dcx )
+{
+  return mipi_create_spi_ctr_on_bus (
+    mipi_create_spi_bus (spi, sck, mosi, miso),
+    cs,
+    dcx
+  );
+}
+
 void
-mipi_dbi_spi_connector_init (struct mipi_spi_ctr * self)
+mipi_init_spi_bus (
+  struct _mipi_spi_dev * spi_dev,
+  uint32_t hz )
 {
-  spi_init (
-    self->spi,
-    _SPI_DEF_BD
+  if (spi_dev->is_init)
+    return;
+
+  spi_dev->spi_mtx=_osal_create_mutex ();
+  _osal_init_spi_dev (
+    spi_dev->spi,
+    spi_dev->sck,
+    spi_dev->mosi,
+    spi_dev->miso,
+    hz
   );
+  spi_dev->cur_hz=hz;
+  spi_dev->is_init=true;
+}
+
+void
+mipi_init_spi_ctr (struct mipi_spi_ctr * self)
+{
+  mipi_init_spi_bus (self->spi_dev, self->phase_hz[MIPI_IO_PHASE_CMD]);
+  _osal_init_gpio_pin (self->cs, _OSAL_GPIO_OUT);
+  _osal_set_gpio_pin_state (self->cs, !(_SPI_ACTIVE_STATE));
+  _osal_init_gpio_pin (self->dcx, _OSAL_GPIO_OUT);
+  _osal_set_gpio_pin_state (self->dcx, 1);
+
+  self->io.can_wt=1;
+  self->io.can_rd=1;
+}
+
+void
+mipi_free_spi_ctr (struct mipi_spi_ctr * self)
+{
+  if (self->dma_chan>=0) {
+    /**
+     * Never pull the channel out from under a transfer in flight; the
+     * completion handler still references this connector.
+     */
+    mipi_spi_wait_flush_ms (self, MIPI_MAX_TM);
+    _osal_dma_unclaim_chan (self->dma_chan);
+    self->dma_chan=-1;
+  }
+  if (self->spi_dev && !--self->spi_dev->num_ctrs)
+    mipi_osal_free (self->spi_dev);
+  self->spi_dev=NULL;
+}
 
-  gpio_set_function (self->miso, GPIO_FUNC_SPI);
-  gpio_set_function (self->mosi, GPIO_FUNC_SPI);
-  gpio_set_function (self->sck,  GPIO_FUNC_SPI);
-  gpio_set_function (self->cs,   GPIO_FUNC_SIO);
-  gpio_set_function (self->dcx,  GPIO_FUNC_SIO);
+_Bool
+mipi_lock_spi_dev_timeout_ms (
+  struct _mipi_spi_dev * dev,
+  uint32_t ms )
+{
+  const uint32_t t0=_osal_get_time_ms ();
 
-  gpio_init (self->cs);
-  gpio_set_dir (self->cs, GPIO_OUT);
-  gpio_put (self->cs, 1);
+  if (!_osal_lock_mtx_block_ms (&dev->spi_mtx, ms))
+    return false;
 
-  gpio_init (self->dcx);
-  gpio_set_dir (self->dcx, GPIO_OUT);
-  gpio_put (self->dcx, 1);
+  while (atomic_load_explicit (&dev->dma_in_prog, memory_order_acquire)) {
+    if ((_osal_get_time_ms ()-t0)>=ms) {
+      _osal_unlock_mtx (&dev->spi_mtx);
+      return false;
+    }
+    _osal_yield ();
+  }
+  return true;
+}
+
+_Bool
+mipi_try_lock_spi_dev (struct _mipi_spi_dev * dev)
+{
+  if (!_osal_try_lock_mtx (&dev->spi_mtx))
+    return false;
+  if (atomic_load_explicit (&dev->dma_in_prog, memory_order_acquire)) {
+    _osal_unlock_mtx (&dev->spi_mtx);
+    return false;
+  }
+  return true;
 }
 
 void
-mipi_spi_send_cmd (
-  struct mipi_io_ctr * self,
-  uint cmd,
-  _IN_ uint8_t * params,
+mipi_unlock_spi_dev (struct _mipi_spi_dev * dev)
+{
+  _osal_unlock_mtx (&dev->spi_mtx);
+}
+
+/**
+ * Switches the bus to the clock of `phase`, if another was last in use. The
+ * caller must own the bus, and nothing may be left in the FIFO.
+ */
+static void
+_mipi_spi_use_phase (
+  struct mipi_spi_ctr * spi_conn,
+  enum mipi_io_phase phase )
+{
+  struct _mipi_spi_dev * spi_dev=spi_conn->spi_dev;
+
+  if (spi_dev->cur_hz==spi_conn->phase_hz[phase])
+    return;
+  _osal_spi_set_baudrate (spi_dev->spi, spi_conn->phase_hz[phase]);
+  spi_dev->cur_hz=spi_conn->phase_hz[phase];
+}
+
+/**
+ * Writes a command and its parameters to the panel. The caller must already
+ * own the bus and have asserted CS.
+ */
+static void
+_mipi_spi_write_reg_locked (
+  struct mipi_spi_ctr * spi_conn,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t * params,
   size_t len )
 {
-  struct mipi_spi_ctr * spi_conn;
+  struct _osal_spi_dev * spi=spi_conn->spi_dev->spi;
+
+  _osal_set_gpio_pin_state (spi_conn->dcx, 0);
+  _osal_spi_write_block_ms (spi, &cmd, 1, MIPI_MAX_TM);
+  if (len) {
+    _osal_set_gpio_pin_state (spi_conn->dcx, 1);
+    _osal_spi_write_block_ms (spi, params, len, MIPI_MAX_TM);
+  }
+}
+
+static void
+_mipi_spi_dma_flush_done (void * cb_arg);
+
+/**
+ * Marks the bus as held by a DMA transfer, before it is started: the transfer
+ * may complete, and `_mipi_spi_dma_flush_done` clear the flag, before the
+ * call which started it has returned.
+ */
+static void
+_mipi_spi_hold_for_dma (
+  struct mipi_spi_ctr * spi_conn,
+  _Bool hold )
+{
+  atomic_store_explicit (
+    &spi_conn->spi_dev->dma_in_prog,
+    hold,
+    memory_order_release
+  );
+}
 
-  if (params==NULL) {
+void
+mipi_spi_write_txn (
+  struct mipi_io_ctr * self,
+  _IN const struct mipi_io_txn_seg segs[],
+  size_t num_segs,
+  _IN const uint8_t * px_data,
+  size_t px_sz )
+{
+  struct mipi_spi_ctr * spi_conn=(struct mipi_spi_ctr *) self;
+
+  if (!spi_conn || !spi_conn->spi_dev) {
     _mipi_dbg (
-      self->DBG_TAG,
-      "command buffer empty, aborting transaction\n"
+      MIPI_DBG_TAG,
+      "SPI connector not initialized\n"
     );
-    spi_conn->errno|=EINVAL;
+    mipi_err_code|=MIPI_ERR_INV;
     return;
   }
 
-  spi_conn = (struct mipi_spi_ctr *) self;
-  if (spi_conn) {
-    _SPI_BEGIN_TX (spi_ctr->spi_dev);
+  if (!num_segs || (px_sz && !px_data)) {
+    spi_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+  for (size_t i=0; i<num_segs; i++) {
+    if (segs[i].num_params && !segs[i].params) {
+      spi_conn->errno|=MIPI_ERR_INV;
+      return;
+    }
+  }
 
-    gpio_put (spi_conn->dcx, 0);
-    spi_write_blocking (
-      spi_conn->spi,
-      &cmd,
-      1
-    );
+  /**
+   * A DMA flush still in progress holds the bus, so this also serves to wait
+   * for the previous frame to leave the buffer.
+   */
+  if (!_SPI_BEGIN_TX (spi_conn)) {
+    spi_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return;
+  }
 
-    gpio_put (spi_conn->dcx, 1);
-    spi_write_blocking (
-      spi_conn->spi,
-      params,
-      len
+  _mipi_spi_use_phase (
+    spi_conn,
+    px_sz ? MIPI_IO_PHASE_PX : MIPI_IO_PHASE_CMD
+  );
+  for (size_t i=0; i<num_segs; i++) {
+    _mipi_spi_write_reg_locked (
+      spi_conn,
+      segs[i].cmd,
+      segs[i].params,
+      segs[i].num_params
     );
+  }
 
-    _SPI_END_TX (spi_ctr->spi_dev);
-  } else {
-    _mipi_dbg (
-      self->DBG_TAG,
-      "SPI connector not initialized\n"
-    );
-    spi_conn->errno|=ENODEV;
+  if (px_sz) {
+    _osal_set_gpio_pin_state (spi_conn->dcx, 1);
+    if (spi_conn->flush_mode==MIPI_SPI_FLUSH_DMA) {
+      self->wt_in_prog=1;
+      _mipi_spi_hold_for_dma (spi_conn, true);
+      if (_osal_dma_spi_write_async (
+            spi_conn->dma_chan,
+            spi_conn->spi_dev->spi,
+            px_data,
+            px_sz,
+            _mipi_spi_dma_flush_done,
+            spi_conn
+          )) {
+        mipi_unlock_spi_dev (spi_conn->spi_dev);
+        return; // << CS is released by `_mipi_spi_dma_flush_done`
+      }
+
+      _mipi_spi_hold_for_dma (spi_conn, false);
+      self->wt_in_prog=0;
+      spi_conn->errno|=MIPI_ERR_IO;
+    } else {
+      _osal_spi_write_block_ms (
+        spi_conn->spi_dev->spi,
+        px_data,
+        px_sz,
+        MIPI_MAX_TM
+      );
+    }
+  }
+
+  _SPI_END_TX (spi_conn);
+}
+
+void
+mipi_spi_send_cmd (
+  struct mipi_io_ctr * self,
+  mipi_dcs_cmd_T cmd,
+  _IN const uint8_t * params,
+  size_t len )
+{
+  const struct mipi_io_txn_seg seg=
+  {
+    .cmd=cmd,
+    .params=params,
+    .num_params=len
+  };
+
+  mipi_spi_write_txn (self, &seg, 1, NULL, 0);
+}
+
+/**
+ * Reads `len` bytes which follow `dummy_bits` clock cycles on the bus. As the
+ * SPI peripheral only reads whole bytes, a number of dummy cycles which is
+ * not a multiple of 8 leaves the data straddling byte boundaries; it is
+ * realigned in place as it is read.
+ */
+static void
+_mipi_spi_read_after_dummy (
+  struct _osal_spi_dev * spi,
+  _OUT uint8_t * dst,
+  size_t len,
+  uint8_t dummy_bits )
+{
+  const uint shift=dummy_bits%8;
+  uint8_t prev=0;
+
+  for (uint i=0; i<dummy_bits/8; i++)
+    _osal_spi_read_block_ms (spi, &prev, 1, MIPI_MAX_TM);
+  if (shift)
+    _osal_spi_read_block_ms (spi, &prev, 1, MIPI_MAX_TM);
+
+  _osal_spi_read_block_ms (spi, dst, len, MIPI_MAX_TM);
+  if (!shift)
     return;
+
+  for (size_t i=0; i<len; i++) {
+    const uint8_t cur=dst[i];
+    dst[i]=(uint8_t)(prev<<shift | cur>>(8-shift));
+    prev=cur;
   }
 }
 
-size_t
-mipi_spi_recieve_params (
+ssize_t
+mipi_spi_recv_params (
   struct mipi_io_ctr * self,
-  uint cmd,
+  mipi_dcs_cmd_T cmd,
   _OUT uint8_t * params,
   size_t len )
 {
-  /*
-   * TODO
+  struct mipi_spi_ctr * spi_conn=(struct mipi_spi_ctr *) self;
+  uint8_t dummy_bits;
+
+  if (!params || !len) {
+    spi_conn->errno|=MIPI_ERR_INV;
+    return -1;
+  }
+  if (!_SPI_BEGIN_TX (spi_conn)) {
+    spi_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return -1;
+  }
+
+  if (cmd==RAMRD || cmd==RAMRDC)
+    dummy_bits=spi_conn->ram_rd_dummy_bits;
+  else
+    dummy_bits=(len>1) ? spi_conn->rd_dummy_bits : 0;
+
+  self->rd_in_prog=1;
+  _mipi_spi_use_phase (spi_conn, MIPI_IO_PHASE_RD);
+  _mipi_spi_write_reg_locked (spi_conn, cmd, NULL, 0);
+  _osal_set_gpio_pin_state (spi_conn->dcx, 1);
+  _mipi_spi_read_after_dummy (
+    spi_conn->spi_dev->spi,
+    params,
+    len,
+    dummy_bits
+  );
+  self->rd_in_prog=0;
+
+  _SPI_END_TX (spi_conn);
+  return (ssize_t)len;
+}
+
+void
+mipi_spi_set_rd_dummy_bits (
+  struct mipi_spi_ctr * self,
+  uint8_t reg_bits,
+  uint8_t ram_bits )
+{
+  self->rd_dummy_bits=reg_bits;
+  self->ram_rd_dummy_bits=ram_bits;
+}
+
+/**
+ * Runs once the final byte of a DMA flush has been shifted out, in interrupt
+ * context or on a thread of the OSAL; so it never touches the bus lock, which
+ * belongs to the thread which started the flush, and was let go of by it.
+ * Releasing CS and clearing `dma_in_prog` hands the bus back.
+ */
+static void
+_mipi_spi_dma_flush_done (void * cb_arg)
+{
+  struct mipi_spi_ctr * spi_conn=(struct mipi_spi_ctr *) cb_arg;
+
+  /**
+   * A chunk of a stream completing does not end the transaction; the bus is
+   * released by `mipi_spi_end_fmbf_stream`, on the thread which holds it.
    */
-  self->errno|=ENOTSUP;
+  if (spi_conn->in_fmbf_stream) {
+    spi_conn->io.wt_in_prog=0;
+    return;
+  }
+
+  _osal_set_gpio_pin_state (spi_conn->cs, !(_SPI_ACTIVE_STATE));
+  spi_conn->io.wt_in_prog=0;
+  atomic_store_explicit (
+    &spi_conn->spi_dev->dma_in_prog,
+    false,
+    memory_order_release
+  );
+
+  if (spi_conn->flush_done_cb) {
+    spi_conn->flush_done_cb (
+      &spi_conn->io,
+      (mipi_err_T)spi_conn->errno,
+      spi_conn->flush_cb_arg
+    );
+  }
 }
 
 void
 mipi_spi_flush_fmbf (
   struct mipi_io_ctr * self,
-  _IN_ uint8_t * pix_buff,
+  _IN const uint8_t * pix_buff,
   const struct mipi_area bounds,
   size_t len )
 {
-  struct mipi_spi_ctr * spi_conn;
+  struct mipi_spi_ctr * spi_conn=(struct mipi_spi_ctr *) self;
+  uint8_t ca_params[4], ra_params[4];
+  const struct mipi_io_txn_seg segs[]=
+  {
+    { .cmd=CASET, .params=ca_params, .num_params=sizeof(ca_params) },
+    { .cmd=RASET, .params=ra_params, .num_params=sizeof(ra_params) },
+    { .cmd=RAMWR }
+  };
 
   if (pix_buff==NULL) {
     _mipi_dbg (
-      self->DBG_TAG,
+      MIPI_DBG_TAG,
       "pixel data buffer empty, aborting transaction\n"
     );
-    spi_conn->errno|=EINVAL;
+    spi_conn->errno|=MIPI_ERR_INV;
     return;
-  } else {
-    spi_conn=(struct mipi_spi_ctr *) self;
-    if (spi_conn) {
-      _SPI_BEGIN_TX (spi_conn);
-
-      // u8 ca_params[];
-      // spi_conn->io->write_cmd(
-      //   self,
-      //   CASET,
-      //   ca_params,
-      //   4
-      // );
-
-      // spi_conn->io->write_cmd(
-      //   self,
-      //   RAMWR,
-      //   NULL,
-      //   0
-      // );
-
-      gpio_put (spi_conn->dcx, 1);
-      spi_write_blocking (
-        spi_conn->spi,
-        pix_buff,
-        len
-      );
+  }
+  if (!bounds.w || !bounds.h) {
+    spi_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
 
-      _SPI_END_TX (spi_conn);
-    } else {
+  _mipi_dcs_pack_addr (ca_params, bounds.x, (uint16_t)(bounds.x+bounds.w-1));
+  _mipi_dcs_pack_addr (ra_params, bounds.y, (uint16_t)(bounds.y+bounds.h-1));
+  mipi_spi_write_txn (
+    self,
+    segs,
+    sizeof(segs)/sizeof(segs[0]),
+    pix_buff,
+    len
+  );
+}
+
+void
+mipi_spi_flush_fmbf_vec (
+  struct mipi_io_ctr * self,
+  _IN byte_buffer_view_T spans[],
+  size_t num_spans,
+  const struct mipi_area bounds )
+{
+  struct mipi_spi_ctr * spi_conn=(struct mipi_spi_ctr *) self;
+  struct _osal_spi_dev * spi;
+  uint8_t ca_params[4], ra_params[4];
+
+  if (!spans || !num_spans || !bounds.w || !bounds.h) {
+    spi_conn->errno|=MIPI_ERR_INV;
+    return;
+  }
+  if (!_SPI_BEGIN_TX (spi_conn)) {
+    spi_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return;
+  }
+
+  spi=spi_conn->spi_dev->spi;
+  _mipi_spi_use_phase (spi_conn, MIPI_IO_PHASE_PX);
+  _mipi_dcs_pack_addr (ca_params, bounds.x, (uint16_t)(bounds.x+bounds.w-1));
+  _mipi_dcs_pack_addr (ra_params, bounds.y, (uint16_t)(bounds.y+bounds.h-1));
+  _mipi_spi_write_reg_locked (spi_conn, CASET, ca_params, sizeof(ca_params));
+  _mipi_spi_write_reg_locked (spi_conn, RASET, ra_params, sizeof(ra_params));
+  _mipi_spi_write_reg_locked (spi_conn, RAMWR, NULL, 0);
+  _osal_set_gpio_pin_state (spi_conn->dcx, 1);
+
+  if (spi_conn->flush_mode==MIPI_SPI_FLUSH_DMA) {
+    self->wt_in_prog=1;
+    _mipi_spi_hold_for_dma (spi_conn, true);
+    if (_osal_dma_spi_write_vec_async (
+          spi_conn->dma_chan,
+          spi,
+          spans,
+          num_spans,
+          _mipi_spi_dma_flush_done,
+          spi_conn
+        )) {
+      mipi_unlock_spi_dev (spi_conn->spi_dev);
+      return; // << CS is released by `_mipi_spi_dma_flush_done`
+    }
+    _mipi_spi_hold_for_dma (spi_conn, false);
+    self->wt_in_prog=0;
+    spi_conn->errno|=MIPI_ERR_IO;
+  }
+
+  /**
+   * Without a channel to chain them on (or if the transfer could not be
+   * started), the spans are sent one after another from where they lie;
+   * there is still no copy.
+   */
+  for (size_t i=0; i<num_spans; i++)
+    _osal_spi_write_block_ms (spi, spans[i].buff, spans[i].buff_sz, MIPI_MAX_TM);
+
+  _SPI_END_TX (spi_conn);
+}
+
+mipi_err_T
+mipi_spi_begin_fmbf_stream (
+  struct mipi_io_ctr * self,
+  const struct mipi_area bounds )
+{
+  struct mipi_spi_ctr * spi_conn=(struct mipi_spi_ctr *) self;
+  uint8_t ca_params[4], ra_params[4];
+
+  if (!bounds.w || !bounds.h)
+    return MIPI_ERR_INV;
+  if (!_SPI_BEGIN_TX (spi_conn)) {
+    spi_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return MIPI_ERR_RES_LOCKED;
+  }
+
+  _mipi_spi_use_phase (spi_conn, MIPI_IO_PHASE_PX);
+  _mipi_dcs_pack_addr (ca_params, bounds.x, (uint16_t)(bounds.x+bounds.w-1));
+  _mipi_dcs_pack_addr (ra_params, bounds.y, (uint16_t)(bounds.y+bounds.h-1));
+  _mipi_spi_write_reg_locked (spi_conn, CASET, ca_params, sizeof(ca_params));
+  _mipi_spi_write_reg_locked (spi_conn, RASET, ra_params, sizeof(ra_params));
+  _mipi_spi_write_reg_locked (spi_conn, RAMWR, NULL, 0);
+  _osal_set_gpio_pin_state (spi_conn->dcx, 1);
+
+  spi_conn->in_fmbf_stream=true;
+  return 0;
+}
+
+mipi_err_T
+mipi_spi_write_fmbf_chunk (
+  struct mipi_io_ctr * self,
+  _IN const uint8_t * chunk,
+  size_t len )
+{
+  struct mipi_spi_ctr * spi_conn=(struct mipi_spi_ctr *) self;
+
+  if (!spi_conn->in_fmbf_stream || !chunk)
+    return MIPI_ERR_INV;
+
+  /**
+   * There is a single channel per connector, so the previous chunk must have
+   * been sent before this one can be started. Once this returns, the caller
+   * is free to reuse the buffer of that previous chunk.
+   */
+  if (!mipi_spi_wait_flush_ms (spi_conn, MIPI_MAX_TM)) {
+    spi_conn->errno|=MIPI_ERR_IO;
+    return MIPI_ERR_IO;
+  }
+
+  if (spi_conn->flush_mode==MIPI_SPI_FLUSH_DMA) {
+    self->wt_in_prog=1;
+    if (_osal_dma_spi_write_async (
+          spi_conn->dma_chan,
+          spi_conn->spi_dev->spi,
+          chunk,
+          len,
+          _mipi_spi_dma_flush_done,
+          spi_conn
+        ))
+      return 0;
+
+    self->wt_in_prog=0;
+    spi_conn->errno|=MIPI_ERR_IO;
+    return MIPI_ERR_IO;
+  }
+
+  _osal_spi_write_block_ms (spi_conn->spi_dev->spi, chunk, len, MIPI_MAX_TM);
+  return 0;
+}
+
+void
+mipi_spi_end_fmbf_stream (struct mipi_io_ctr * self)
+{
+  struct mipi_spi_ctr * spi_conn=(struct mipi_spi_ctr *) self;
+
+  if (!spi_conn->in_fmbf_stream)
+    return;
+  if (!mipi_spi_wait_flush_ms (spi_conn, MIPI_MAX_TM))
+    spi_conn->errno|=MIPI_ERR_IO;
+
+  spi_conn->in_fmbf_stream=false;
+  _SPI_END_TX (spi_conn);
+}
+
+mipi_err_T
+mipi_spi_take_err (struct mipi_io_ctr * self)
+{
+  struct mipi_spi_ctr * spi_conn=(struct mipi_spi_ctr *) self;
+  const mipi_err_T err=(mipi_err_T)spi_conn->errno;
+
+  spi_conn->errno=0;
+  return err;
+}
+
+void
+mipi_spi_set_flush_mode (
+  struct mipi_spi_ctr * self,
+  enum mipi_spi_flush_mode mode,
+  mipi_io_done_cb done_cb,
+  void * cb_arg )
+{
+  if (mode==MIPI_SPI_FLUSH_DMA && self->dma_chan<0) {
+    self->dma_chan=_osal_dma_claim_chan ();
+    if (self->dma_chan<0) {
       _mipi_dbg (
-        self->DBG_TAG,
-        "SPI connector not initialized\n"
+        MIPI_DBG_TAG,
+        "no DMA channel available, flush remains blocking"
       );
-      spi_conn->errno|=ENODEV;
+      self->errno|=MIPI_ERR_RES_LOCKED;
       return;
     }
   }
+
+  /**
+   * Changing the callback while a transfer is in flight would race with the
+   * completion handler.
+   */
+  mipi_spi_wait_flush_ms (self, MIPI_MAX_TM);
+  self->flush_done_cb=done_cb;
+  self->flush_cb_arg=cb_arg;
+  self->flush_mode=mode;
+}
+
+_Bool
+mipi_spi_flush_in_prog (struct mipi_spi_ctr * self)
+{
+  return self->io.wt_in_prog;
+}
+
+_Bool
+mipi_spi_wait_flush_ms (
+  struct mipi_spi_ctr * self,
+  uint32_t ms )
+{
+  uint32_t t0=_osal_get_time_ms ();
+
+  while (self->io.wt_in_prog) {
+    if ((_osal_get_time_ms ()-t0)>=ms)
+      return false;
+    _osal_yield ();
+  }
+  return true;
+}
+
+uint32_t
+mipi_spi_set_phase_clk (
+  struct mipi_io_ctr * self,
+  enum mipi_io_phase phase,
+  uint32_t hz )
+{
+  struct mipi_spi_ctr * spi_conn=(struct mipi_spi_ctr *) self;
+  uint32_t actual;
+
+  if (phase>=MIPI_IO_NUM_PHASES || !hz)
+    return 0;
+  if (!mipi_lock_spi_dev_timeout_ms (spi_conn->spi_dev, MIPI_MAX_TM)) {
+    spi_conn->errno|=MIPI_ERR_RES_LOCKED;
+    return 0;
+  }
+
+  /**
+   * The divider only allows for certain rates; set it once to learn which
+   * one this request comes to. The next transaction switches to the rate of
+   * its own phase in any case.
+   */
+  actual=_osal_spi_set_baudrate (spi_conn->spi_dev->spi, hz);
+  spi_conn->spi_dev->cur_hz=hz;
+  spi_conn->phase_hz[phase]=hz;
+  mipi_unlock_spi_dev (spi_conn->spi_dev);
+
+  return actual;
 }
@@ -0,0 +1,286 @@
+/**
+ * ========================
+ *        mipi_te.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-14
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "mipi_te.h"
+
+#define _TE_MODE_VBLANK 0x00 // << TEON; TE only during vertical blanking
+
+static void
+_mipi_te_irq (
+	_osal_gpio_pin_T pin,
+	void * cb_arg )
+{
+	(void)pin;
+	mipi_te_sched_on_te ((struct mipi_te_sched *) cb_arg);
+}
+
+mipi_err_T
+mipi_te_sched_init (
+	struct mipi_te_sched * self,
+	struct mipi_io_ctr * io,
+	int te_pin,
+	uint16_t num_rows,
+	uint16_t band_rows,
+	uint32_t period_us,
+	uint32_t vblank_us )
+{
+	const uint8_t te_mode=_TE_MODE_VBLANK;
+	uint8_t scan_line[2]={0};
+
+	if (!io || !num_rows || !band_rows || vblank_us>=period_us)
+		return MIPI_ERR_INV;
+
+	memset (self, 0, sizeof(*self));
+	self->io=io;
+	self->te_pin=te_pin;
+	self->num_rows=num_rows;
+	self->band_rows=band_rows;
+	self->period_us=period_us;
+	self->vblank_us=vblank_us;
+	// Without a pin, the refreshes are counted from here on.
+	self->vsync_us=_osal_get_time_us ();
+
+	if (te_pin==MIPI_TE_NO_PIN)
+		return 0;
+
+	/**
+	 * TE is raised at the start of blanking; place the scan line at which it
+	 * fires at the first row explicitly, as some panels keep it across SWRST.
+	 */
+	io->write_panel_reg (io, TESCAN, scan_line, sizeof(scan_line));
+	io->write_panel_reg (io, TEON, &te_mode, 1);
+	if (!_osal_set_gpio_irq ((_osal_gpio_pin_T)te_pin, true, _mipi_te_irq, self)) {
+		io->write_panel_reg (io, TEOFF, NULL, 0);
+		self->te_pin=MIPI_TE_NO_PIN;
+		return MIPI_ERR_IO;
+	}
+
+	return 0;
+}
+
+void
+mipi_te_sched_deinit (struct mipi_te_sched * self)
+{
+	if (self->te_pin==MIPI_TE_NO_PIN)
+		return;
+	_osal_set_gpio_irq ((_osal_gpio_pin_T)self->te_pin, true, NULL, NULL);
+	self->io->write_panel_reg (self->io, TEOFF, NULL, 0);
+	self->te_pin=MIPI_TE_NO_PIN;
+}
+
+void
+mipi_te_sched_on_te (struct mipi_te_sched * self)
+{
+	const uint32_t now=_osal_get_time_us (),
+		dt=now-self->vsync_us,
+		period_us=self->period_us;
+
+	self->seq++;
+	/**
+	 * Track the period of the panel's oscillator, ignoring intervals which
+	 * are not plausibly a single refresh (ie. missed or spurious edges).
+	 */
+	if (self->num_edges && dt>period_us/2 && dt<period_us*2)
+		self->period_us=(uint32_t)((int32_t)period_us
+			+((int32_t)dt-(int32_t)period_us)/8);
+	self->vsync_us=now;
+	self->num_edges++;
+	self->seq++;
+}
+
+/**
+ * Returns the start of the refresh in progress at `now`, extrapolated from
+ * the last TE edge by whole periods if any have since been missed, or if no
+ * pin is wired.
+ */
+static uint32_t
+_mipi_te_cur_vsync (
+	struct mipi_te_sched * self,
+	uint32_t now )
+{
+	uint32_t seq, vsync_us, period_us;
+
+	do {
+		seq=self->seq;
+		vsync_us=self->vsync_us;
+		period_us=self->period_us;
+	} while ((seq & 1) || seq!=self->seq);
+
+	return vsync_us+(now-vsync_us)/period_us*period_us;
+}
+
+/**
+ * Time, from the start of a refresh, at which the scan reaches `row`.
+ */
+static uint32_t
+_mipi_te_row_us (
+	const struct mipi_te_sched * self,
+	uint16_t row )
+{
+	return self->vblank_us
+		+(uint32_t)((uint64_t)(self->period_us-self->vblank_us)*row
+			/self->num_rows);
+}
+
+mipi_err_T
+mipi_te_sched_submit (
+	struct mipi_te_sched * self,
+	const struct mipi_area bds,
+	_IN const uint8_t px_data[],
+	size_t px_sz,
+	mipi_io_done_cb done_cb,
+	void * cb_arg )
+{
+	if (!bds.w || !bds.h || !px_data || px_sz%bds.h
+			|| bds.y+bds.h>self->num_rows)
+		return MIPI_ERR_INV;
+	if (self->busy)
+		return MIPI_ERR_RES_LOCKED;
+
+	self->bds=bds;
+	self->px_data=px_data;
+	self->row_sz=px_sz/bds.h;
+	self->next_row=bds.y;
+	self->ref_us=_mipi_te_cur_vsync (self, _osal_get_time_us ());
+	self->done_cb=done_cb;
+	self->cb_arg=cb_arg;
+	self->err=0;
+	self->busy=true;
+
+	// Errors left from before belong to no band of this frame.
+	if (self->io->take_err)
+		mipi_err_code|=self->io->take_err (self->io);
+
+	return 0;
+}
+
+static void
+_mipi_te_write_band (
+	struct mipi_te_sched * self,
+	uint16_t r0,
+	uint16_t r1 )
+{
+	struct mipi_io_ctr * io=self->io;
+	const struct mipi_area * bds=&self->bds;
+	const uint8_t * px=self->px_data+(size_t)(r0-bds->y)*self->row_sz;
+	const size_t sz=(size_t)(r1-r0)*self->row_sz;
+	uint8_t ca_params[4], ra_params[4];
+
+	_mipi_dcs_pack_addr (ca_params, bds->x, (uint16_t)(bds->x+bds->w-1));
+	_mipi_dcs_pack_addr (ra_params, r0, (uint16_t)(r1-1));
+
+	if (!io->write_panel_txn) {
+		io->flush_fmbf (
+			io,
+			px,
+			(struct mipi_area){ bds->x, r0, bds->w, r1-r0 },
+			sz
+		);
+		return;
+	}
+	io->write_panel_txn (
+		io,
+		(const struct mipi_io_txn_seg [])
+		{
+			{ .cmd=CASET, .params=ca_params, .num_params=4 },
+			{ .cmd=RASET, .params=ra_params, .num_params=4 },
+			{ .cmd=RAMWR }
+		},
+		3,
+		px,
+		sz
+	);
+}
+
+_Bool
+mipi_te_sched_poll (
+	struct mipi_te_sched * self,
+	_OUT uint32_t * wait_us )
+{
+	const uint16_t end_row=self->bds.y+self->bds.h;
+
+	while (self->busy) {
+		const uint32_t now=_osal_get_time_us ();
+		const uint16_t r0=self->next_row,
+			r1=r0+self->band_rows<end_row ? (uint16_t)(r0+self->band_rows) : end_row;
+		const uint32_t ready_us=self->ref_us+_mipi_te_row_us (self, r1),
+			late_us=self->ref_us+self->period_us+_mipi_te_row_us (self, r0);
+
+		/**
+		 * The scan of the next refresh has already reached the band, so that
+		 * writing it now would put the write ahead of a scan. Count it, and
+		 * fall in behind the scan of the refresh now in progress instead.
+		 */
+		if ((int32_t)(now-late_us)>=0) {
+			self->num_late_bands++;
+			self->ref_us=_mipi_te_cur_vsync (self, now);
+			continue;
+		}
+		if ((int32_t)(now-ready_us)<0) {
+			if (wait_us)
+				*wait_us=ready_us-now;
+			return false;
+		}
+
+		/**
+		 * Each band is a window of its own, so a failed one does not stop the
+		 * rest; the frame is reported with the error once it is done.
+		 */
+		_mipi_te_write_band (self, r0, r1);
+		if (self->io->take_err)
+			self->err|=self->io->take_err (self->io);
+		self->num_bands++;
+		self->next_row=r1;
+		if (r1<end_row)
+			continue;
+
+		self->busy=false;
+		self->num_frames++;
+		if (self->done_cb)
+			self->done_cb (self->io, self->err, self->cb_arg);
+	}
+
+	if (wait_us)
+		*wait_us=0;
+	return true;
+}
+
+mipi_err_T
+mipi_te_sched_flush (
+	struct mipi_te_sched * self,
+	const struct mipi_area bds,
+	_IN const uint8_t px_data[],
+	size_t px_sz )
+{
+	mipi_err_T err=mipi_te_sched_submit (
+		self,
+		bds,
+		px_data,
+		px_sz,
+		NULL,
+		NULL
+	);
+	uint32_t wait_us;
+
+	if (err)
+		return err;
+	while (!mipi_te_sched_poll (self, &wait_us)) {
+		if (wait_us>=1000)
+			_osal_sleep_ms (wait_us/1000);
+		else
+			_osal_yield ();
+	}
+
+	return self->err;
+}
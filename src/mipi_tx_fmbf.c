@@ -1,5 +1,168 @@
-
 /**
+ * ========================
+ *      mipi_tx_fmbf.c
+ * ========================
+ *
+ * Transmission of frame buffer contents to a panel, converting from the
+ * internal color representation to the output IFPF on the way.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-04
+ * License:   MIT
  *
  * Copyright Surface EP, LLC 2025.
- */
\ No newline at end of file
+ */
+
+#include <string.h>
+
+#include "mipi.h"
+
+static size_t
+_mipi_cvt_chunk (
+	struct mipi_dbi_dev * dev,
+	_IN const struct mipi_color clr_buff[],
+	_OUT uint8_t chunk[],
+	size_t chunk_sz,
+	size_t num_px )
+{
+	const struct mipi_ifpf * ifpf=&dev->dst_ifpf;
+
+	if (dev->dither.mode!=MIPI_DITHER_NONE) {
+		return mipi_dither_cvt (
+			&dev->dither,
+			clr_buff,
+			num_px,
+			chunk,
+			chunk_sz
+		);
+	} else if (ifpf->cvt_to_ifpf) {
+		return ifpf->cvt_to_ifpf (
+			ifpf,
+			clr_buff,
+			num_px,
+			chunk,
+			chunk_sz
+		);
+	} else {
+		// RGB_666/888 are sent as they are stored (see `MIPI_PANEL_FMT`).
+		memcpy (chunk, clr_buff, num_px*sizeof(*clr_buff));
+		return num_px*sizeof(*clr_buff);
+	}
+}
+
+mipi_err_T
+mipi_stream_fmbf (
+	struct mipi_dbi_dev * dev,
+	_IN const struct mipi_color clr_buff[],
+	const struct mipi_area bds )
+{
+	struct mipi_io_ctr * io=dev->io;
+	const _Bool dither=dev->dither.mode!=MIPI_DITHER_NONE;
+	const size_t num_px=(size_t)bds.w*bds.h;
+	size_t bytes_per_px, px_per_chunk;
+	mipi_err_T err;
+	size_t px_off;
+	uint cur;
+
+	if (!clr_buff || !num_px) {
+		mipi_err_code|=MIPI_ERR_INV;
+		return MIPI_ERR_INV;
+	}
+	if (!io->begin_fmbf_stream
+			|| !io->write_fmbf_chunk
+			|| !io->end_fmbf_stream) {
+		_mipi_dbg (
+			MIPI_DBG_TAG,
+			"connector does not implement streaming flush"
+		);
+		return MIPI_ERR_OP_NOT_IMPL;
+	}
+
+	/**
+	 * Rows are only dithered in alternating directions when they are whole
+	 * within a chunk, so chunks are cut at the end of a row where one fits.
+	 */
+	if (dither) {
+		err=mipi_dither_begin (&dev->dither, &dev->dst_ifpf, bds);
+		if (err)
+			return err;
+		bytes_per_px=dev->dither.bytes_per_px;
+	} else {
+		bytes_per_px=dev->dst_ifpf.cvt_to_ifpf
+			? dev->dst_ifpf.bytes_per_px
+			: sizeof(*clr_buff);
+	}
+	px_per_chunk=sizeof(dev->tx_chunk[0])/bytes_per_px;
+	if (dev->dither.mode==MIPI_DITHER_FS && bds.w<=px_per_chunk)
+		px_per_chunk-=px_per_chunk%bds.w;
+
+	if (!dev->boot_stats.first_px_us)
+		dev->boot_stats.first_px_us=_osal_get_time_us ();
+	err=io->begin_fmbf_stream (io, bds);
+	if (err) {
+		mipi_dbi_invalidate_win (dev);
+		return err;
+	}
+
+	/**
+	 * `write_fmbf_chunk` does not return until the chunk before it has left
+	 * the connector, so by the time the next conversion starts, the chunk it
+	 * targets is free again. With a DMA-capable connector this overlaps each
+	 * conversion with the transmission of the previous chunk.
+	 */
+	for (px_off=0, cur=0; px_off<num_px; px_off+=px_per_chunk, cur^=1) {
+		size_t n=num_px-px_off, sz;
+		uint8_t * chunk=(uint8_t *) dev->tx_chunk[cur];
+
+		if (n>px_per_chunk)
+			n=px_per_chunk;
+		sz=_mipi_cvt_chunk (
+			dev,
+			clr_buff+px_off,
+			chunk,
+			sizeof(dev->tx_chunk[cur]),
+			n
+		);
+
+		err=io->write_fmbf_chunk (io, chunk, sz);
+		if (err)
+			break;
+	}
+
+	io->end_fmbf_stream (io);
+
+	/**
+	 * The stream programmed the window itself and filled it, so there is no
+	 * write to continue, but its ranges may still be reused.
+	 */
+	dev->win_cache.win=bds;
+	dev->win_cache.ca_valid=!err;
+	dev->win_cache.ra_valid=!err;
+	dev->win_cache.wp_valid=false;
+	return err;
+}
+
+size_t
+mipi_fmbf_rect_spans (
+	_IN uint8_t fmbf[],
+	size_t stride,
+	size_t bytes_per_px,
+	const struct mipi_area bds,
+	_OUT byte_buffer_T spans[] )
+{
+	const size_t row_sz=(size_t)bds.w*bytes_per_px;
+	uint8_t * row=fmbf+(size_t)bds.y*stride+(size_t)bds.x*bytes_per_px;
+
+	if (!bds.w || !bds.h)
+		return 0;
+
+	// Full-width rows are contiguous, and go out as one.
+	if (row_sz==stride) {
+		spans[0]=byte_buffer (row, row_sz*bds.h);
+		return 1;
+	}
+
+	for (uint16_t i=0; i<bds.h; i++, row+=stride)
+		spans[i]=byte_buffer (row, row_sz);
+	return bds.h;
+}
@@ -0,0 +1,332 @@
+/**
+ * ========================
+ *        mipi_txq.c
+ * ========================
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-12
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <string.h>
+
+#include "mipi_dcs.h"
+#include "mipi_txq.h"
+
+mipi_err_T
+mipi_txq_init (
+	struct mipi_txq * self,
+	struct mipi_io_ctr * io,
+	size_t num_slots )
+{
+	if (!io || !num_slots || (num_slots & (num_slots-1)))
+		return MIPI_ERR_INV;
+
+	memset (self, 0, sizeof(*self));
+	self->slots=mipi_osal_calloc (num_slots, sizeof(*self->slots));
+	if (!self->slots) {
+		_mipi_dbg (
+			MIPI_DBG_TAG,
+			"failed to allocate resources for transaction queue"
+		);
+		mipi_err_code|=MIPI_ERR_NO_MEM;
+		return MIPI_ERR_NO_MEM;
+	}
+
+	/**
+	 * A slot is free for the producer which claims position `pos` when its
+	 * sequence number equals `pos`, and ready for the consumer once it has
+	 * been set to `pos+1`.
+	 */
+	for (size_t i=0; i<num_slots; i++)
+		atomic_init (&self->slots[i].seq, i);
+	self->io=io;
+	self->mask=num_slots-1;
+	atomic_init (&self->head, 0);
+	atomic_flag_clear (&self->draining);
+
+	return 0;
+}
+
+void
+mipi_txq_free (struct mipi_txq * self)
+{
+	mipi_osal_free (self->slots);
+	self->slots=NULL;
+}
+
+/**
+ * Claims the next slot of the ring, or returns `NULL` if it is full.
+ */
+static struct _mipi_txq_slot *
+_mipi_txq_claim (struct mipi_txq * self)
+{
+	size_t pos=atomic_load_explicit (&self->head, memory_order_relaxed);
+
+	for (;;) {
+		struct _mipi_txq_slot * slot=&self->slots[pos & self->mask];
+		const size_t seq=atomic_load_explicit (&slot->seq, memory_order_acquire);
+		const ptrdiff_t dif=(ptrdiff_t)(seq-pos);
+
+		if (!dif) {
+			// On failure, `pos` is updated to the current head and tried again.
+			if (atomic_compare_exchange_weak_explicit (
+					&self->head,
+					&pos,
+					pos+1,
+					memory_order_relaxed,
+					memory_order_relaxed
+				))
+				return slot;
+		} else if (dif<0) {
+			atomic_fetch_add_explicit (
+				&self->num_rejected,
+				1,
+				memory_order_relaxed
+			);
+			return NULL;
+		} else {
+			pos=atomic_load_explicit (&self->head, memory_order_relaxed);
+		}
+	}
+}
+
+/**
+ * Hands a filled slot over to the drain owner.
+ */
+static void
+_mipi_txq_publish (
+	struct mipi_txq * self,
+	struct _mipi_txq_slot * slot )
+{
+	const size_t pos=atomic_load_explicit (&slot->seq, memory_order_relaxed);
+
+	atomic_store_explicit (&slot->seq, pos+1, memory_order_release);
+	atomic_fetch_add_explicit (&self->num_submitted, 1, memory_order_relaxed);
+	if (self->on_submit)
+		self->on_submit (self->on_submit_arg);
+}
+
+mipi_err_T
+mipi_txq_submit_cmd (
+	struct mipi_txq * self,
+	mipi_dcs_cmd_T cmd,
+	_COPY_FROM_USER const uint8_t params[],
+	size_t num_params )
+{
+	struct _mipi_txq_slot * slot;
+
+	if (num_params>MIPI_TXQ_PARAM_CAP || (num_params && !params))
+		return MIPI_ERR_INV;
+	slot=_mipi_txq_claim (self);
+	if (!slot)
+		return MIPI_ERR_NO_MEM;
+
+	slot->desc.op=MIPI_TXQ_CMD;
+	slot->desc.cmd=cmd;
+	slot->desc.num_params=(uint8_t)num_params;
+	if (num_params)
+		memcpy (slot->desc.params, params, num_params);
+	slot->desc.done_cb=NULL;
+	slot->desc.cb_arg=NULL;
+
+	_mipi_txq_publish (self, slot);
+	return 0;
+}
+
+mipi_err_T
+mipi_txq_submit_area (
+	struct mipi_txq * self,
+	const struct mipi_area bds,
+	_IN const uint8_t px_data[],
+	size_t px_sz,
+	mipi_io_done_cb done_cb,
+	void * cb_arg )
+{
+	struct _mipi_txq_slot * slot;
+
+	if (!bds.w || !bds.h || (px_sz && !px_data))
+		return MIPI_ERR_INV;
+	slot=_mipi_txq_claim (self);
+	if (!slot)
+		return MIPI_ERR_NO_MEM;
+
+	slot->desc.op=MIPI_TXQ_AREA;
+	slot->desc.bds=bds;
+	slot->desc.px_data=px_data;
+	slot->desc.px_sz=px_sz;
+	slot->desc.done_cb=done_cb;
+	slot->desc.cb_arg=cb_arg;
+
+	_mipi_txq_publish (self, slot);
+	return 0;
+}
+
+mipi_err_T
+mipi_txq_submit_delay (
+	struct mipi_txq * self,
+	uint32_t ms )
+{
+	struct _mipi_txq_slot * slot=_mipi_txq_claim (self);
+
+	if (!slot)
+		return MIPI_ERR_NO_MEM;
+
+	slot->desc.op=MIPI_TXQ_DELAY;
+	slot->desc.delay_ms=ms;
+	slot->desc.done_cb=NULL;
+	slot->desc.cb_arg=NULL;
+
+	_mipi_txq_publish (self, slot);
+	return 0;
+}
+
+void
+mipi_txq_issue (
+	struct mipi_io_ctr * io,
+	_IN const struct mipi_txq_desc * desc )
+{
+	uint8_t ca_params[4], ra_params[4];
+	mipi_err_T err;
+
+	/**
+	 * Errors left from before belong to no descriptor; they are reported,
+	 * but not passed to this one's callback.
+	 */
+	if (io->take_err)
+		mipi_err_code|=io->take_err (io);
+
+	switch (desc->op) {
+	case MIPI_TXQ_CMD:
+		io->write_panel_reg (
+			io,
+			desc->cmd,
+			desc->num_params ? desc->params : NULL,
+			desc->num_params
+		);
+		break;
+	case MIPI_TXQ_AREA:
+		if (!io->write_panel_txn) {
+			io->flush_fmbf (io, desc->px_data, desc->bds, desc->px_sz);
+			break;
+		}
+
+		_mipi_dcs_pack_addr (
+			ca_params,
+			desc->bds.x,
+			(uint16_t)(desc->bds.x+desc->bds.w-1)
+		);
+		_mipi_dcs_pack_addr (
+			ra_params,
+			desc->bds.y,
+			(uint16_t)(desc->bds.y+desc->bds.h-1)
+		);
+		io->write_panel_txn (
+			io,
+			(const struct mipi_io_txn_seg [])
+			{
+				{ .cmd=CASET, .params=ca_params, .num_params=4 },
+				{ .cmd=RASET, .params=ra_params, .num_params=4 },
+				{ .cmd=RAMWR }
+			},
+			3,
+			desc->px_data,
+			desc->px_sz
+		);
+		break;
+	case MIPI_TXQ_DELAY:
+		break;
+	default:
+		break;
+	}
+
+	err=io->take_err ? io->take_err (io) : 0;
+	if (desc->done_cb)
+		desc->done_cb (io, err, desc->cb_arg);
+}
+
+const struct mipi_txq_desc *
+mipi_txq_peek (struct mipi_txq * self)
+{
+	struct _mipi_txq_slot * slot=&self->slots[self->tail & self->mask];
+	const size_t seq=atomic_load_explicit (&slot->seq, memory_order_acquire);
+
+	// Either empty, or the next producer has yet to publish.
+	if (seq!=self->tail+1)
+		return NULL;
+	return &slot->desc;
+}
+
+void
+mipi_txq_consume (struct mipi_txq * self)
+{
+	struct _mipi_txq_slot * slot=&self->slots[self->tail & self->mask];
+
+	atomic_store_explicit (
+		&slot->seq,
+		self->tail+self->mask+1,
+		memory_order_release
+	);
+	self->tail++;
+}
+
+/**
+ * Returns whether the delay at the head of the queue has passed, starting it
+ * if it has only now been reached.
+ */
+static _Bool
+_mipi_txq_delay_done (
+	struct mipi_txq * self,
+	const struct mipi_txq_desc * desc )
+{
+	const uint32_t now=_osal_get_time_ms ();
+
+	if (!self->in_delay) {
+		self->in_delay=true;
+		self->resume_at_ms=now+desc->delay_ms;
+	}
+	if ((int32_t)(now-self->resume_at_ms)<0)
+		return false;
+
+	self->in_delay=false;
+	return true;
+}
+
+size_t
+mipi_txq_drain (
+	struct mipi_txq * self,
+	size_t max_descs )
+{
+	const struct mipi_txq_desc * head;
+	size_t n=0;
+
+	if (atomic_flag_test_and_set_explicit (&self->draining, memory_order_acquire))
+		return 0;
+
+	while (n<max_descs && (head=mipi_txq_peek (self))) {
+		struct mipi_txq_desc desc;
+
+		if (head->op==MIPI_TXQ_DELAY) {
+			if (!_mipi_txq_delay_done (self, head))
+				break;
+			mipi_txq_consume (self);
+			continue;
+		}
+
+		/**
+		 * Copy the descriptor out and release the slot before issuing it, so
+		 * that producers are not held up for the duration of the transfer.
+		 */
+		desc=*head;
+		mipi_txq_consume (self);
+
+		mipi_txq_issue (self->io, &desc);
+		self->num_issued++;
+		n++;
+	}
+
+	atomic_flag_clear_explicit (&self->draining, memory_order_release);
+	return n;
+}
@@ -0,0 +1,886 @@
+/**
+ *
+ * Implementation of the OSAL for a native (host) target. There is no real
+ * panel attached; GPIO state is kept in memory and SPI peripherals are
+ * emulated by `struct _osal_spi_dev` (see `native_pf_types.h`), so that the
+ * connector and graphics layers can be exercised on a development machine.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-02
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#include "mipi_i80_bus_sim.h"
+#include "mipi_qspi_bus_sim.h"
+#include "osal.h"
+
+#define _NATIVE_NUM_I80_BUS  2
+#define _NATIVE_NUM_QSPI_BUS 2
+
+#ifdef MIPI_COUNT_HEAP_OPS
+size_t mipi_num_heap_ops;
+#endif
+
+static volatile _Bool _GPIO_STATE[_NATIVE_NUM_GPIO_PINS];
+static struct {
+	_osal_gpio_irq_cb irq_cb;
+	void * cb_arg;
+	_Bool rising;
+} _GPIO_IRQ[_NATIVE_NUM_GPIO_PINS];
+static struct _osal_i80_bus _I80_BUS[_NATIVE_NUM_I80_BUS];
+static struct _osal_qspi_bus _QSPI_BUS[_NATIVE_NUM_QSPI_BUS];
+
+void
+_osal_init_gpio_pin (
+	const _osal_gpio_pin_T pin,
+	int _pf_caps )
+{
+	(void)_pf_caps;
+	_GPIO_STATE[pin % _NATIVE_NUM_GPIO_PINS]=true;
+}
+
+void
+_osal_set_gpio_pin_state (
+	_osal_gpio_pin_T pin,
+	const _Bool pin_val )
+{
+	_GPIO_STATE[pin % _NATIVE_NUM_GPIO_PINS]=pin_val;
+
+	for (int i=0; i<_NATIVE_NUM_I80_BUS; i++) {
+		struct _osal_i80_bus * bus=&_I80_BUS[i];
+		if (bus->claimed && bus->sim && bus->cs==pin)
+			mipi_i80_sim_set_cs (bus->sim, bus->t_ns, pin_val);
+	}
+	for (int i=0; i<_NATIVE_NUM_QSPI_BUS; i++) {
+		struct _osal_qspi_bus * bus=&_QSPI_BUS[i];
+		if (bus->claimed && bus->sim && bus->cs==pin)
+			mipi_qspi_sim_set_cs (bus->sim, bus->t_ns, pin_val);
+	}
+}
+
+_Bool
+_osal_set_gpio_irq (
+	_osal_gpio_pin_T pin,
+	_Bool rising,
+	_osal_gpio_irq_cb irq_cb,
+	void * cb_arg )
+{
+	pin%=_NATIVE_NUM_GPIO_PINS;
+	_GPIO_IRQ[pin].irq_cb=NULL;
+	_GPIO_IRQ[pin].rising=rising;
+	_GPIO_IRQ[pin].cb_arg=cb_arg;
+	_GPIO_IRQ[pin].irq_cb=irq_cb;
+	return true;
+}
+
+void
+_native_drive_gpio_pin (
+	_osal_gpio_pin_T pin,
+	_Bool pin_val )
+{
+	_Bool prev;
+
+	pin%=_NATIVE_NUM_GPIO_PINS;
+	prev=_GPIO_STATE[pin];
+	_GPIO_STATE[pin]=pin_val;
+	if (prev==pin_val || pin_val!=_GPIO_IRQ[pin].rising)
+		return;
+	if (_GPIO_IRQ[pin].irq_cb)
+		_GPIO_IRQ[pin].irq_cb (pin, _GPIO_IRQ[pin].cb_arg);
+}
+
+_Bool
+_native_get_gpio_pin (_osal_gpio_pin_T pin)
+{
+	return _GPIO_STATE[pin % _NATIVE_NUM_GPIO_PINS];
+}
+
+/**
+ * <<SPI>>
+ */
+
+uint32_t
+_osal_init_spi_dev (
+	struct _osal_spi_dev * spi_dev,
+	_osal_gpio_pin_T sck,
+	_osal_gpio_pin_T mosi,
+	_osal_gpio_pin_T miso,
+	uint32_t hz )
+{
+	(void)sck, (void)mosi, (void)miso;
+	mtx_init (&spi_dev->io_mtx, mtx_plain);
+	spi_dev->baud_hz=hz;
+	return hz;
+}
+
+uint32_t
+_osal_spi_set_baudrate (
+	struct _osal_spi_dev * spi_dev,
+	uint32_t hz )
+{
+	spi_dev->baud_hz=hz;
+	return hz;
+}
+
+static void
+_native_spi_push (
+	struct _osal_spi_dev * spi_dev,
+	const uint8_t byte_arr[],
+	size_t num_bytes )
+{
+	mtx_lock (&spi_dev->io_mtx);
+	if (spi_dev->mem && spi_dev->mem_sz) {
+		size_t off=0;
+		while (off<num_bytes) {
+			size_t n=spi_dev->mem_sz-spi_dev->mem_pos;
+			if (n>num_bytes-off)
+				n=num_bytes-off;
+			memcpy (spi_dev->mem+spi_dev->mem_pos, byte_arr+off, n);
+			spi_dev->mem_pos=(spi_dev->mem_pos+n) % spi_dev->mem_sz;
+			off+=n;
+		}
+	}
+	if (spi_dev->on_write)
+		spi_dev->on_write (spi_dev, byte_arr, num_bytes);
+	mtx_unlock (&spi_dev->io_mtx);
+}
+
+_Bool
+_osal_spi_write_block_ms (
+	struct _osal_spi_dev * spi_dev,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	uint32_t ms )
+{
+	(void)ms;
+	_native_spi_push (spi_dev, byte_arr, num_bytes);
+	return true;
+}
+
+_Bool
+_osal_spi_read_block_ms (
+	struct _osal_spi_dev * spi_dev,
+	uint8_t byte_arr[],
+	size_t num_bytes,
+	uint32_t ms )
+{
+	(void)spi_dev, (void)ms;
+	memset (byte_arr, 0, num_bytes);
+	return true;
+}
+
+_Bool
+_osal_spi_write_read_block_ms (
+	struct _osal_spi_dev * spi_dev,
+	const uint8_t tx[],
+	uint8_t rx[],
+	size_t num_bytes,
+	uint32_t ms )
+{
+	(void)ms;
+	_native_spi_push (spi_dev, tx, num_bytes);
+	memset (rx, 0, num_bytes);
+	return true;
+}
+
+/**
+ * <<DMA>>
+ *
+ * Each claimed channel is served by its own worker thread, which copies the
+ * source buffer into the emulated peripheral and then invokes the completion
+ * callback. As on hardware, the callback runs concurrently with the thread
+ * which started the transfer.
+ */
+struct _native_dma_chan {
+	_Bool claimed, quit;
+	thrd_t wkr;
+	mtx_t mtx;
+	cnd_t cnd;
+	atomic_bool busy;
+
+	struct _osal_spi_dev * spi_dev;
+	const uint8_t * src;
+	size_t num_bytes;
+	const struct byte_buffer * bufs; // << scatter-gather, if set
+	size_t num_bufs;
+	_osal_dma_done_cb done_cb;
+	void * cb_arg;
+};
+
+static struct _native_dma_chan _DMA_CHAN[_NATIVE_NUM_DMA_CHAN];
+static mtx_t _dma_claim_mtx;
+static once_flag _dma_once=ONCE_FLAG_INIT;
+
+static void
+_native_dma_init_once (void)
+{
+	mtx_init (&_dma_claim_mtx, mtx_plain);
+}
+
+static int
+_native_dma_wkr (void * arg)
+{
+	struct _native_dma_chan * ch=arg;
+
+	mtx_lock (&ch->mtx);
+	for (;;) {
+		while (!ch->quit && !ch->done_cb)
+			cnd_wait (&ch->cnd, &ch->mtx);
+		if (ch->quit)
+			break;
+
+		_osal_dma_done_cb done_cb=ch->done_cb;
+		void * cb_arg=ch->cb_arg;
+
+		mtx_unlock (&ch->mtx);
+		if (ch->bufs) {
+			for (size_t i=0; i<ch->num_bufs; i++)
+				_native_spi_push (ch->spi_dev, ch->bufs[i].buff, ch->bufs[i].buff_sz);
+		} else {
+			_native_spi_push (ch->spi_dev, ch->src, ch->num_bytes);
+		}
+		mtx_lock (&ch->mtx);
+
+		ch->done_cb=NULL;
+		atomic_store (&ch->busy, false);
+		/**
+		 * The callback may start the next transfer on this channel, so it must
+		 * not be invoked with the channel lock held.
+		 */
+		mtx_unlock (&ch->mtx);
+		done_cb (cb_arg);
+		mtx_lock (&ch->mtx);
+	}
+	mtx_unlock (&ch->mtx);
+
+	return 0;
+}
+
+int
+_osal_dma_claim_chan (void)
+{
+	int r=-1;
+
+	call_once (&_dma_once, _native_dma_init_once);
+	mtx_lock (&_dma_claim_mtx);
+	for (int i=0; i<_NATIVE_NUM_DMA_CHAN; i++) {
+		struct _native_dma_chan * ch=&_DMA_CHAN[i];
+		if (ch->claimed)
+			continue;
+
+		memset (ch, 0, sizeof(*ch));
+		mtx_init (&ch->mtx, mtx_plain);
+		cnd_init (&ch->cnd);
+		if (thrd_create (&ch->wkr, _native_dma_wkr, ch)!=thrd_success) {
+			mtx_destroy (&ch->mtx);
+			cnd_destroy (&ch->cnd);
+			break;
+		}
+		ch->claimed=true;
+		r=i;
+		break;
+	}
+	mtx_unlock (&_dma_claim_mtx);
+
+	return r;
+}
+
+void
+_osal_dma_unclaim_chan (int dma_chan)
+{
+	struct _native_dma_chan * ch=&_DMA_CHAN[dma_chan];
+
+	mtx_lock (&ch->mtx);
+	ch->quit=true;
+	cnd_signal (&ch->cnd);
+	mtx_unlock (&ch->mtx);
+	thrd_join (ch->wkr, NULL);
+
+	mtx_destroy (&ch->mtx);
+	cnd_destroy (&ch->cnd);
+	mtx_lock (&_dma_claim_mtx);
+	ch->claimed=false;
+	mtx_unlock (&_dma_claim_mtx);
+}
+
+_Bool
+_osal_dma_spi_write_async (
+	int dma_chan,
+	struct _osal_spi_dev * spi_dev,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg )
+{
+	struct _native_dma_chan * ch;
+	_Bool expect=false;
+
+	if (dma_chan<0 || dma_chan>=_NATIVE_NUM_DMA_CHAN || !done_cb)
+		return false;
+	ch=&_DMA_CHAN[dma_chan];
+	if (!atomic_compare_exchange_strong (&ch->busy, &expect, true))
+		return false;
+
+	mtx_lock (&ch->mtx);
+	ch->spi_dev=spi_dev;
+	ch->src=byte_arr;
+	ch->num_bytes=num_bytes;
+	ch->bufs=NULL;
+	ch->cb_arg=cb_arg;
+	ch->done_cb=done_cb;
+	cnd_signal (&ch->cnd);
+	mtx_unlock (&ch->mtx);
+
+	return true;
+}
+
+_Bool
+_osal_dma_spi_write_vec_async (
+	int dma_chan,
+	struct _osal_spi_dev * spi_dev,
+	const struct byte_buffer * bufs,
+	size_t num_bufs,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg )
+{
+	struct _native_dma_chan * ch;
+	_Bool expect=false;
+
+	if (dma_chan<0 || dma_chan>=_NATIVE_NUM_DMA_CHAN || !done_cb || !num_bufs)
+		return false;
+	ch=&_DMA_CHAN[dma_chan];
+	if (!atomic_compare_exchange_strong (&ch->busy, &expect, true))
+		return false;
+
+	mtx_lock (&ch->mtx);
+	ch->spi_dev=spi_dev;
+	ch->bufs=bufs;
+	ch->num_bufs=num_bufs;
+	ch->cb_arg=cb_arg;
+	ch->done_cb=done_cb;
+	cnd_signal (&ch->cnd);
+	mtx_unlock (&ch->mtx);
+
+	return true;
+}
+
+_Bool
+_osal_dma_is_busy (int dma_chan)
+{
+	return atomic_load (&_DMA_CHAN[dma_chan].busy);
+}
+
+/**
+ * <<I80>>
+ */
+
+struct _osal_i80_bus *
+_osal_i80_bus_init (
+	_osal_gpio_pin_T data_base,
+	uint8_t bus_width,
+	_osal_gpio_pin_T wr,
+	_osal_gpio_pin_T rd,
+	uint32_t wr_cycle_ns )
+{
+	for (int i=0; i<_NATIVE_NUM_I80_BUS; i++) {
+		struct _osal_i80_bus * bus=&_I80_BUS[i];
+		if (bus->claimed)
+			continue;
+
+		*bus=(struct _osal_i80_bus)
+		{
+			.claimed=true,
+			.bus_width=bus_width,
+			.data_base=data_base,
+			.wr=wr,
+			.rd=rd,
+			.wr_cycle_ns=wr_cycle_ns
+		};
+		return bus;
+	}
+	return NULL;
+}
+
+void
+_osal_i80_bus_deinit (struct _osal_i80_bus * bus)
+{
+	bus->claimed=false;
+	bus->sim=NULL;
+}
+
+void
+_native_i80_attach_sim (
+	struct _osal_i80_bus * bus,
+	struct mipi_i80_bus_sim * sim,
+	_osal_gpio_pin_T dcx,
+	_osal_gpio_pin_T cs )
+{
+	bus->sim=sim;
+	bus->dcx=dcx;
+	bus->cs=cs;
+}
+
+static void
+_native_i80_wr_cycle (
+	struct _osal_i80_bus * bus,
+	uint16_t data )
+{
+	const uint32_t t_half=bus->wr_cycle_ns/2;
+	const _Bool dcx=_GPIO_STATE[bus->dcx % _NATIVE_NUM_GPIO_PINS];
+
+	if (bus->sim)
+		mipi_i80_sim_set_wr (bus->sim, bus->t_ns, false, dcx, data);
+	bus->t_ns+=t_half;
+	if (bus->sim)
+		mipi_i80_sim_set_wr (bus->sim, bus->t_ns, true, dcx, data);
+	bus->t_ns+=bus->wr_cycle_ns-t_half;
+}
+
+_Bool
+_osal_i80_write_block (
+	struct _osal_i80_bus * bus,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	_Bool wide )
+{
+	size_t i=0;
+
+	if (wide && bus->bus_width==16) {
+		for (; i+1<num_bytes; i+=2) {
+			_native_i80_wr_cycle (
+				bus,
+				(uint16_t)(byte_arr[i]<<8 | byte_arr[i+1])
+			);
+		}
+	}
+	for (; i<num_bytes; i++)
+		_native_i80_wr_cycle (bus, byte_arr[i]);
+
+	return true;
+}
+
+/**
+ * The emulated bus has no notion of real time, so the transfer completes, and
+ * the callback runs, before this returns.
+ */
+_Bool
+_osal_i80_write_async (
+	struct _osal_i80_bus * bus,
+	int dma_chan,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	_Bool wide,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg )
+{
+	(void)dma_chan;
+	_osal_i80_write_block (bus, byte_arr, num_bytes, wide);
+	if (done_cb)
+		done_cb (cb_arg);
+	return true;
+}
+
+_Bool
+_osal_i80_read_block (
+	struct _osal_i80_bus * bus,
+	uint8_t byte_arr[],
+	size_t num_bytes,
+	uint32_t rd_cycle_ns )
+{
+	const uint32_t t_half=rd_cycle_ns/2;
+
+	for (size_t i=0; i<num_bytes; i++) {
+		uint16_t d=0;
+		if (bus->sim)
+			d=mipi_i80_sim_set_rd (bus->sim, bus->t_ns, false);
+		bus->t_ns+=t_half;
+		if (bus->sim)
+			mipi_i80_sim_set_rd (bus->sim, bus->t_ns, true);
+		bus->t_ns+=rd_cycle_ns-t_half;
+		byte_arr[i]=(uint8_t)d;
+	}
+	return true;
+}
+
+void
+_osal_i80_wait_idle (struct _osal_i80_bus * bus)
+{
+	(void)bus; // << every cycle completes before the write returns
+}
+
+/**
+ * <<QSPI>>
+ */
+
+struct _osal_qspi_bus *
+_osal_qspi_bus_init (
+	_osal_gpio_pin_T data_base,
+	uint8_t max_lanes,
+	_osal_gpio_pin_T sck,
+	uint32_t sck_hz )
+{
+	if ((max_lanes!=2 && max_lanes!=4) || !sck_hz)
+		return NULL;
+
+	for (int i=0; i<_NATIVE_NUM_QSPI_BUS; i++) {
+		struct _osal_qspi_bus * bus=&_QSPI_BUS[i];
+		if (bus->claimed)
+			continue;
+
+		*bus=(struct _osal_qspi_bus)
+		{
+			.claimed=true,
+			.max_lanes=max_lanes,
+			.data_base=data_base,
+			.sck=sck,
+			.sck_period_ns=1000000000u/sck_hz
+		};
+		return bus;
+	}
+	return NULL;
+}
+
+void
+_osal_qspi_bus_deinit (struct _osal_qspi_bus * bus)
+{
+	bus->claimed=false;
+	bus->sim=NULL;
+}
+
+void
+_native_qspi_attach_sim (
+	struct _osal_qspi_bus * bus,
+	struct mipi_qspi_bus_sim * sim,
+	_osal_gpio_pin_T cs )
+{
+	bus->sim=sim;
+	bus->cs=cs;
+}
+
+/**
+ * Presents one SCK period with `d_lines` on D[3:0], returning the level the
+ * panel drove onto D1 for it.
+ */
+static _Bool
+_native_qspi_clock (
+	struct _osal_qspi_bus * bus,
+	uint8_t d_lines )
+{
+	_Bool d1=false;
+
+	bus->t_ns+=bus->sck_period_ns/2;
+	if (bus->sim)
+		d1=mipi_qspi_sim_clock (bus->sim, bus->t_ns, d_lines);
+	bus->t_ns+=bus->sck_period_ns-bus->sck_period_ns/2;
+
+	return d1;
+}
+
+_Bool
+_osal_qspi_write_block (
+	struct _osal_qspi_bus * bus,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	uint8_t num_lanes )
+{
+	const uint8_t mask=(uint8_t)((1u<<num_lanes)-1);
+
+	if (num_lanes!=1 && num_lanes!=bus->max_lanes)
+		return false;
+
+	for (size_t i=0; i<num_bytes; i++) {
+		for (int sh=8-num_lanes; sh>=0; sh-=num_lanes)
+			_native_qspi_clock (bus, (uint8_t)(byte_arr[i]>>sh & mask));
+	}
+	return true;
+}
+
+/**
+ * As with the 8080 bus, the transfer completes before this returns.
+ */
+_Bool
+_osal_qspi_write_async (
+	struct _osal_qspi_bus * bus,
+	int dma_chan,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	uint8_t num_lanes,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg )
+{
+	(void)dma_chan;
+	if (!_osal_qspi_write_block (bus, byte_arr, num_bytes, num_lanes))
+		return false;
+	if (done_cb)
+		done_cb (cb_arg);
+	return true;
+}
+
+_Bool
+_osal_qspi_read_block (
+	struct _osal_qspi_bus * bus,
+	uint8_t byte_arr[],
+	size_t num_bytes,
+	uint32_t rd_cycle_ns )
+{
+	const uint32_t sck_period_ns=bus->sck_period_ns;
+
+	bus->sck_period_ns=rd_cycle_ns;
+	for (size_t i=0; i<num_bytes; i++) {
+		uint8_t b=0;
+		for (int bit=0; bit<8; bit++)
+			b=(uint8_t)(b<<1 | _native_qspi_clock (bus, 0));
+		byte_arr[i]=b;
+	}
+	bus->sck_period_ns=sck_period_ns;
+
+	return true;
+}
+
+void
+_osal_qspi_wait_idle (struct _osal_qspi_bus * bus)
+{
+	(void)bus;
+}
+
+/**
+ * <<ASIO>>
+ *
+ * Each worker is a thread of its own. Wakes are counted rather than flagged,
+ * so one which arrives while the work function is running is not lost.
+ */
+struct _osal_asio_worker {
+	thrd_t thrd;
+	mtx_t mtx;
+	cnd_t cnd;
+	_Bool quit;
+	size_t num_wakes;
+
+	_osal_asio_work_fn work_fn;
+	void * arg;
+};
+
+static int
+_native_asio_wkr (void * arg)
+{
+	struct _osal_asio_worker * wkr=arg;
+	size_t seen=0;
+
+	mtx_lock (&wkr->mtx);
+	for (;;) {
+		while (!wkr->quit && wkr->num_wakes==seen)
+			cnd_wait (&wkr->cnd, &wkr->mtx);
+		if (wkr->quit)
+			break;
+		seen=wkr->num_wakes;
+
+		mtx_unlock (&wkr->mtx);
+		wkr->work_fn (wkr->arg);
+		mtx_lock (&wkr->mtx);
+	}
+	mtx_unlock (&wkr->mtx);
+
+	return 0;
+}
+
+struct _osal_asio_worker *
+_osal_asio_worker_start (
+	_osal_asio_work_fn work_fn,
+	void * arg )
+{
+	struct _osal_asio_worker * wkr;
+
+	if (!work_fn || !(wkr=mipi_osal_calloc (1, sizeof(*wkr))))
+		return NULL;
+	wkr->work_fn=work_fn;
+	wkr->arg=arg;
+	mtx_init (&wkr->mtx, mtx_plain);
+	cnd_init (&wkr->cnd);
+	if (thrd_create (&wkr->thrd, _native_asio_wkr, wkr)!=thrd_success) {
+		mtx_destroy (&wkr->mtx);
+		cnd_destroy (&wkr->cnd);
+		mipi_osal_free (wkr);
+		return NULL;
+	}
+
+	return wkr;
+}
+
+void
+_osal_asio_worker_wake (struct _osal_asio_worker * wkr)
+{
+	mtx_lock (&wkr->mtx);
+	wkr->num_wakes++;
+	cnd_signal (&wkr->cnd);
+	mtx_unlock (&wkr->mtx);
+}
+
+void
+_osal_asio_worker_stop (struct _osal_asio_worker * wkr)
+{
+	mtx_lock (&wkr->mtx);
+	wkr->quit=true;
+	cnd_signal (&wkr->cnd);
+	mtx_unlock (&wkr->mtx);
+	thrd_join (wkr->thrd, NULL);
+
+	mtx_destroy (&wkr->mtx);
+	cnd_destroy (&wkr->cnd);
+	mipi_osal_free (wkr);
+}
+
+/**
+ * <<MGL>>
+ */
+
+mipi_osal_mtx_T
+_osal_create_mutex (void)
+{
+	mipi_osal_mtx_T mtx;
+	mtx_init (&mtx, mtx_timed);
+	return mtx;
+}
+
+_Bool
+_osal_try_lock_mtx (mipi_osal_mtx_T * osal_mtx)
+{
+	return mtx_trylock (osal_mtx)==thrd_success;
+}
+
+_Bool
+_osal_lock_mtx_block_ms (
+	mipi_osal_mtx_T * osal_mtx,
+	uint32_t ms )
+{
+	struct timespec ts;
+
+	timespec_get (&ts, TIME_UTC);
+	ts.tv_sec+=ms/1000;
+	ts.tv_nsec+=(long)(ms%1000)*1000000L;
+	if (ts.tv_nsec>=1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec-=1000000000L;
+	}
+	return mtx_timedlock (osal_mtx, &ts)==thrd_success;
+}
+
+void
+_osal_unlock_mtx (mipi_osal_mtx_T * osal_mtx)
+{
+	mtx_unlock (osal_mtx);
+}
+
+void
+_osal_destroy_mtx (mipi_osal_mtx_T * osal_mtx)
+{
+	mtx_destroy (osal_mtx);
+}
+
+uint32_t
+_osal_get_time_ms (void)
+{
+	struct timespec ts;
+	timespec_get (&ts, TIME_UTC);
+	return (uint32_t)(ts.tv_sec*1000+ts.tv_nsec/1000000L);
+}
+
+uint32_t
+_osal_get_time_us (void)
+{
+	struct timespec ts;
+	timespec_get (&ts, TIME_UTC);
+	return (uint32_t)(ts.tv_sec*1000000+ts.tv_nsec/1000L);
+}
+
+void
+_osal_sleep_ms (uint32_t ms)
+{
+	const struct timespec ts=
+	{
+		.tv_sec=ms/1000,
+		.tv_nsec=(long)(ms%1000)*1000000L
+	};
+
+	thrd_sleep (&ts, NULL);
+}
+
+void
+_osal_yield (void)
+{
+	thrd_yield ();
+}
+
+/**
+ * Each alarm sleeps on a detached thread of its own.
+ */
+struct _native_alarm {
+	uint32_t ms;
+	_osal_alarm_cb alarm_cb;
+	void * cb_arg;
+};
+
+static int
+_native_alarm_wkr (void * arg)
+{
+	const struct _native_alarm alarm=*(struct _native_alarm *) arg;
+	const struct timespec ts=
+	{
+		.tv_sec=alarm.ms/1000,
+		.tv_nsec=(long)(alarm.ms%1000)*1000000L
+	};
+
+	mipi_osal_free (arg);
+	thrd_sleep (&ts, NULL);
+	alarm.alarm_cb (alarm.cb_arg);
+
+	return 0;
+}
+
+_Bool
+_osal_set_alarm_ms (
+	uint32_t ms,
+	_osal_alarm_cb alarm_cb,
+	void * cb_arg )
+{
+	struct _native_alarm * alarm;
+	thrd_t thrd;
+
+	if (!alarm_cb || !(alarm=mipi_osal_alloc (sizeof(*alarm))))
+		return false;
+	*alarm=(struct _native_alarm){ ms, alarm_cb, cb_arg };
+	if (thrd_create (&thrd, _native_alarm_wkr, alarm)!=thrd_success) {
+		mipi_osal_free (alarm);
+		return false;
+	}
+	thrd_detach (thrd);
+
+	return true;
+}
+
+/**
+ * Nothing outlives the process here, so a warm reset is modelled as the same
+ * process bringing the panel up again.
+ */
+static uint32_t _native_persist_word;
+
+_Bool
+_osal_persist_load (uint32_t * word)
+{
+	*word=_native_persist_word;
+	return true;
+}
+
+_Bool
+_osal_persist_store (uint32_t word)
+{
+	_native_persist_word=word;
+	return true;
+}
@@ -11,8 +11,18 @@
  */
 
 #include "pico/mutex.h"
+#include "pico/time.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
 #include "hardware/spi.h"
+#include "hardware/watchdog.h"
 #include "osal.h"
+#include "bbuff.h" // << relies on the definitions of the OSAL
+
+#include "mipi_i80.pio.h" // Generated by `pico_generate_pio_header`
+#include "mipi_qspi.pio.h"
 
 //      Board Pin Number   GPIO Pin
 #define PICO_W_BOARD_PIN_1 0
@@ -61,3 +71,1056 @@ _osal_set_gpio_pin_func ();
 
  extern _Bool
  _osal_try_lock_mtx (_osal_mtx_T * osal_mtx);
+
+/**
+ * <<GPIO>>
+ */
+
+void
+_osal_init_gpio_pin (
+	const _osal_gpio_pin_T pin,
+	int _pf_caps )
+{
+	gpio_init (pin);
+	if (_pf_caps==_OSAL_GPIO_OUT) {
+		gpio_put (pin, 1);
+		gpio_set_dir (pin, GPIO_OUT);
+	} else {
+		gpio_set_dir (pin, GPIO_IN);
+	}
+}
+
+void
+_osal_set_gpio_pin_state (
+	_osal_gpio_pin_T pin,
+	const _Bool pin_val )
+{
+	gpio_put (pin, pin_val);
+}
+
+/**
+ * <<SPI>>
+ *
+ * `struct _osal_spi_dev` is the `spi_inst_t` of the SDK. The blocking
+ * transfers of the SDK have no timeout; the FIFO is always drained at the
+ * rate of the clock, so `ms` is not needed to bound them.
+ */
+
+uint32_t
+_osal_init_spi_dev (
+	struct _osal_spi_dev * spi_dev,
+	_osal_gpio_pin_T sck,
+	_osal_gpio_pin_T mosi,
+	_osal_gpio_pin_T miso,
+	uint32_t hz )
+{
+	const uint32_t actual=spi_init ((spi_inst_t *) spi_dev, hz);
+
+	gpio_set_function (miso, GPIO_FUNC_SPI);
+	gpio_set_function (mosi, GPIO_FUNC_SPI);
+	gpio_set_function (sck,  GPIO_FUNC_SPI);
+	return actual;
+}
+
+uint32_t
+_osal_spi_set_baudrate (
+	struct _osal_spi_dev * spi_dev,
+	uint32_t hz )
+{
+	return spi_set_baudrate ((spi_inst_t *) spi_dev, hz);
+}
+
+_Bool
+_osal_spi_read_block_ms (
+	struct _osal_spi_dev * spi_dev,
+	uint8_t byte_arr[],
+	size_t num_bytes,
+	uint32_t ms )
+{
+	(void)ms;
+	return spi_read_blocking ((spi_inst_t *) spi_dev, 0, byte_arr, num_bytes)
+		==(int)num_bytes;
+}
+
+_Bool
+_osal_spi_write_block_ms (
+	struct _osal_spi_dev * spi_dev,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	uint32_t ms )
+{
+	(void)ms;
+	return spi_write_blocking ((spi_inst_t *) spi_dev, byte_arr, num_bytes)
+		==(int)num_bytes;
+}
+
+_Bool
+_osal_spi_write_read_block_ms (
+	struct _osal_spi_dev * spi_dev,
+	const uint8_t tx[],
+	uint8_t rx[],
+	size_t num_bytes,
+	uint32_t ms )
+{
+	(void)ms;
+	return spi_write_read_blocking ((spi_inst_t *) spi_dev, tx, rx, num_bytes)
+		==(int)num_bytes;
+}
+
+
+/**
+ * <<DMA>>
+ *
+ * All channels claimed through the OSAL share `DMA_IRQ_0`. The handler is
+ * installed as a shared handler so as not to interfere with other users of
+ * the DMA in the application.
+ */
+/**
+ * A control block of a scatter-gather transfer, laid out to match the
+ * `TRANS_COUNT` and `READ_ADDR_TRIG` registers of alias 3 of a channel, which
+ * the control channel writes in a single burst of two words.
+ */
+struct _osal_dma_cblk {
+	uint32_t len;
+	const void * src;
+};
+
+struct _osal_dma_xfer {
+	spi_inst_t * spi;             // << at most one of `spi`, `i80` and
+	struct _osal_i80_bus * i80;   //    `qspi` is set for a given transfer
+	struct _osal_qspi_bus * qspi;
+	_osal_dma_done_cb done_cb;
+	void * cb_arg;
+
+	/**
+	 * Claimed along with the control block list on the first scatter-gather
+	 * transfer on this channel and kept until it is unclaimed, so that later
+	 * transfers do not allocate.
+	 */
+	int ctrl_chan;
+	struct _osal_dma_cblk * cblks;
+	size_t cblk_cap;
+
+	/**
+	 * Drains the RX FIFO of an SPI transfer into `_dma_rx_sink`, and raises
+	 * the interrupt of the transfer in place of the TX channel: the last byte
+	 * is only received once it has been shifted out, so the bus is idle by
+	 * the time this finishes. Claimed on the first SPI transfer.
+	 */
+	int rx_chan;
+};
+
+static struct _osal_dma_xfer _DMA_XFER[NUM_DMA_CHANNELS];
+static _Bool _dma_irq_installed;
+static uint8_t _dma_rx_sink;
+
+static void __isr
+_osal_dma_irq_hdlr (void)
+{
+	for (uint ch=0; ch<NUM_DMA_CHANNELS; ch++) {
+		struct _osal_dma_xfer * xfer=&_DMA_XFER[ch];
+		const uint irq_ch=xfer->spi ? (uint)xfer->rx_chan : ch;
+
+		if (!xfer->done_cb || !dma_channel_get_irq0_status (irq_ch))
+			continue;
+		dma_channel_acknowledge_irq0 (irq_ch);
+
+		// An SPI transfer is complete once its RX channel is (see `rx_chan`).
+		if (xfer->i80) {
+			_osal_i80_wait_idle (xfer->i80);
+		} else if (xfer->qspi) {
+			_osal_qspi_wait_idle (xfer->qspi);
+		}
+
+		_osal_dma_done_cb done_cb=xfer->done_cb;
+		xfer->done_cb=NULL;
+		done_cb (xfer->cb_arg);
+	}
+}
+
+int
+_osal_dma_claim_chan (void)
+{
+	int ch=dma_claim_unused_channel (false);
+	if (ch<0)
+		return -1;
+
+	if (!_dma_irq_installed) {
+		irq_add_shared_handler (
+			DMA_IRQ_0,
+			_osal_dma_irq_hdlr,
+			PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY
+		);
+		irq_set_enabled (DMA_IRQ_0, true);
+		_dma_irq_installed=true;
+	}
+	dma_channel_set_irq0_enabled ((uint)ch, true);
+	_DMA_XFER[ch].ctrl_chan=-1;
+	_DMA_XFER[ch].rx_chan=-1;
+
+	return ch;
+}
+
+void
+_osal_dma_unclaim_chan (int dma_chan)
+{
+	dma_channel_set_irq0_enabled ((uint)dma_chan, false);
+	dma_channel_abort ((uint)dma_chan);
+	_DMA_XFER[dma_chan].done_cb=NULL;
+	dma_channel_unclaim ((uint)dma_chan);
+
+	if (_DMA_XFER[dma_chan].ctrl_chan>=0) {
+		dma_channel_abort ((uint)_DMA_XFER[dma_chan].ctrl_chan);
+		dma_channel_unclaim ((uint)_DMA_XFER[dma_chan].ctrl_chan);
+	}
+	if (_DMA_XFER[dma_chan].rx_chan>=0) {
+		dma_channel_set_irq0_enabled ((uint)_DMA_XFER[dma_chan].rx_chan, false);
+		dma_channel_abort ((uint)_DMA_XFER[dma_chan].rx_chan);
+		dma_channel_unclaim ((uint)_DMA_XFER[dma_chan].rx_chan);
+	}
+	mipi_osal_free (_DMA_XFER[dma_chan].cblks);
+	_DMA_XFER[dma_chan].ctrl_chan=-1;
+	_DMA_XFER[dma_chan].rx_chan=-1;
+	_DMA_XFER[dma_chan].cblks=NULL;
+	_DMA_XFER[dma_chan].cblk_cap=0;
+}
+
+/**
+ * Starts the RX channel of an SPI transfer of `num_bytes`, ahead of its TX
+ * channel, whose own interrupt is masked for the transfer.
+ */
+static _Bool
+_osal_dma_spi_arm_rx (
+	int dma_chan,
+	spi_inst_t * spi,
+	size_t num_bytes )
+{
+	struct _osal_dma_xfer * xfer=&_DMA_XFER[dma_chan];
+	dma_channel_config cfg;
+
+	if (xfer->rx_chan<0) {
+		xfer->rx_chan=dma_claim_unused_channel (false);
+		if (xfer->rx_chan<0)
+			return false;
+		dma_channel_set_irq0_enabled ((uint)xfer->rx_chan, true);
+	}
+
+	// Bytes left in the FIFO by an earlier blocking write would be counted.
+	while (spi_is_readable (spi))
+		(void)spi_get_hw (spi)->dr;
+	spi_get_hw (spi)->icr=SPI_SSPICR_RORIC_BITS;
+	dma_channel_set_irq0_enabled ((uint)dma_chan, false);
+
+	cfg=dma_channel_get_default_config ((uint)xfer->rx_chan);
+	channel_config_set_transfer_data_size (&cfg, DMA_SIZE_8);
+	channel_config_set_read_increment (&cfg, false);
+	channel_config_set_write_increment (&cfg, false);
+	channel_config_set_dreq (&cfg, spi_get_dreq (spi, false));
+	dma_channel_configure (
+		(uint)xfer->rx_chan,
+		&cfg,
+		&_dma_rx_sink,
+		&spi_get_hw (spi)->dr,
+		(uint)num_bytes,
+		true
+	);
+
+	return true;
+}
+
+_Bool
+_osal_dma_spi_write_async (
+	int dma_chan,
+	struct _osal_spi_dev * spi_dev,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg )
+{
+	spi_inst_t * spi=(spi_inst_t *) spi_dev;
+	dma_channel_config cfg;
+
+	if (dma_chan<0 || dma_channel_is_busy ((uint)dma_chan) || !num_bytes)
+		return false;
+	if (!_osal_dma_spi_arm_rx (dma_chan, spi, num_bytes))
+		return false;
+
+	_DMA_XFER[dma_chan].spi=spi;
+	_DMA_XFER[dma_chan].i80=NULL;
+	_DMA_XFER[dma_chan].qspi=NULL;
+	_DMA_XFER[dma_chan].cb_arg=cb_arg;
+	_DMA_XFER[dma_chan].done_cb=done_cb;
+
+	cfg=dma_channel_get_default_config ((uint)dma_chan);
+	channel_config_set_transfer_data_size (&cfg, DMA_SIZE_8);
+	channel_config_set_read_increment (&cfg, true);
+	channel_config_set_write_increment (&cfg, false);
+	channel_config_set_dreq (&cfg, spi_get_dreq (spi, true));
+
+	dma_channel_configure (
+		(uint)dma_chan,
+		&cfg,
+		&spi_get_hw (spi)->dr,
+		byte_arr,
+		(uint)num_bytes,
+		true // << start immediately
+	);
+
+	return true;
+}
+
+/**
+ * The data channel is chained to a control channel, which reloads its length
+ * and source address from the next control block each time it finishes and
+ * retriggers it. The list ends with a null block; a null trigger on a channel
+ * in quiet mode is what raises its interrupt, so there is one for the whole
+ * list rather than one per buffer.
+ */
+_Bool
+_osal_dma_spi_write_vec_async (
+	int dma_chan,
+	struct _osal_spi_dev * spi_dev,
+	const struct byte_buffer * bufs,
+	size_t num_bufs,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg )
+{
+	spi_inst_t * spi=(spi_inst_t *) spi_dev;
+	struct _osal_dma_xfer * xfer;
+	dma_channel_config cfg;
+	size_t n=0, num_bytes=0;
+
+	if (dma_chan<0 || dma_channel_is_busy ((uint)dma_chan))
+		return false;
+	xfer=&_DMA_XFER[dma_chan];
+
+	if (xfer->ctrl_chan<0) {
+		xfer->ctrl_chan=dma_claim_unused_channel (false);
+		if (xfer->ctrl_chan<0)
+			return false;
+	}
+	if (xfer->cblk_cap<num_bufs+1) {
+		struct _osal_dma_cblk * cblks=mipi_osal_realloc (
+			xfer->cblks,
+			(num_bufs+1)*sizeof(*cblks)
+		);
+		if (!cblks)
+			return false;
+		xfer->cblks=cblks;
+		xfer->cblk_cap=num_bufs+1;
+	}
+
+	// An empty block would be taken for the end of the list.
+	for (size_t i=0; i<num_bufs; i++) {
+		if (!bufs[i].buff_sz)
+			continue;
+		xfer->cblks[n++]=(struct _osal_dma_cblk)
+		{
+			.len=(uint32_t)bufs[i].buff_sz,
+			.src=bufs[i].buff
+		};
+		num_bytes+=bufs[i].buff_sz;
+	}
+	if (!n || !_osal_dma_spi_arm_rx (dma_chan, spi, num_bytes))
+		return false;
+	xfer->cblks[n]=(struct _osal_dma_cblk){ 0 };
+
+	xfer->spi=spi;
+	xfer->i80=NULL;
+	xfer->qspi=NULL;
+	xfer->cb_arg=cb_arg;
+	xfer->done_cb=done_cb;
+
+	cfg=dma_channel_get_default_config ((uint)dma_chan);
+	channel_config_set_transfer_data_size (&cfg, DMA_SIZE_8);
+	channel_config_set_read_increment (&cfg, true);
+	channel_config_set_write_increment (&cfg, false);
+	channel_config_set_dreq (&cfg, spi_get_dreq (spi, true));
+	channel_config_set_chain_to (&cfg, (uint)xfer->ctrl_chan);
+	channel_config_set_irq_quiet (&cfg, true);
+	dma_channel_configure (
+		(uint)dma_chan,
+		&cfg,
+		&spi_get_hw (spi)->dr,
+		NULL,
+		0,
+		false
+	);
+
+	cfg=dma_channel_get_default_config ((uint)xfer->ctrl_chan);
+	channel_config_set_transfer_data_size (&cfg, DMA_SIZE_32);
+	channel_config_set_read_increment (&cfg, true);
+	channel_config_set_write_increment (&cfg, true);
+	channel_config_set_ring (&cfg, true, 3); // << wraps over the two registers
+	dma_channel_configure (
+		(uint)xfer->ctrl_chan,
+		&cfg,
+		&dma_hw->ch[dma_chan].al3_transfer_count,
+		xfer->cblks,
+		2,
+		true
+	);
+
+	return true;
+}
+
+_Bool
+_osal_dma_is_busy (int dma_chan)
+{
+	return dma_chan>=0 && _DMA_XFER[dma_chan].done_cb!=NULL;
+}
+
+/**
+ * <<I80>>
+ *
+ * WR cycles are generated by a PIO state machine (see `mipi_i80.pio`), which
+ * may be fed by DMA or by the CPU. Reads are infrequent and much slower, so
+ * for those the data lines are handed back to SIO and RD is toggled by the
+ * CPU.
+ */
+#define NUM_I80_BUS NUM_PIOS
+
+struct _osal_i80_bus {
+	PIO pio;
+	uint sm, offset;
+	const pio_program_t * prog;
+	uint8_t bus_width;
+	_osal_gpio_pin_T data_base, wr, rd;
+};
+
+static struct _osal_i80_bus _I80_BUS[NUM_I80_BUS];
+
+static __force_inline uint32_t
+_osal_ns_to_cycles (uint32_t ns)
+{
+	return (uint32_t)(((uint64_t)clock_get_hz (clk_sys)*ns)/1000000000u);
+}
+
+struct _osal_i80_bus *
+_osal_i80_bus_init (
+	_osal_gpio_pin_T data_base,
+	uint8_t bus_width,
+	_osal_gpio_pin_T wr,
+	_osal_gpio_pin_T rd,
+	uint32_t wr_cycle_ns )
+{
+	const pio_program_t * prog=(bus_width==16)
+		? &mipi_i80_wr16_program
+		: &mipi_i80_wr8_program;
+	struct _osal_i80_bus * bus=NULL;
+	PIO pio;
+	int sm;
+	float clk_div;
+
+	for (uint i=0; i<NUM_I80_BUS; i++) {
+		if (!_I80_BUS[i].pio) {
+			bus=&_I80_BUS[i];
+			break;
+		}
+	}
+	if (!bus)
+		return NULL;
+
+	pio=pio0;
+	if (!pio_can_add_program (pio, prog))
+		pio=pio1;
+	if (!pio_can_add_program (pio, prog))
+		return NULL;
+	sm=pio_claim_unused_sm (pio, false);
+	if (sm<0)
+		return NULL;
+
+	*bus=(struct _osal_i80_bus)
+	{
+		.pio=pio,
+		.sm=(uint)sm,
+		.offset=pio_add_program (pio, prog),
+		.prog=prog,
+		.bus_width=bus_width,
+		.data_base=data_base,
+		.wr=wr,
+		.rd=rd
+	};
+
+	// Each WR cycle takes four state machine cycles.
+	clk_div=(float)_osal_ns_to_cycles (wr_cycle_ns)/4.0f;
+	if (clk_div<1.0f)
+		clk_div=1.0f;
+	mipi_i80_wr_program_init (
+		pio,
+		bus->sm,
+		bus->offset,
+		data_base,
+		bus_width,
+		wr,
+		clk_div
+	);
+
+	gpio_init (rd);
+	gpio_set_dir (rd, GPIO_OUT);
+	gpio_put (rd, 1);
+
+	return bus;
+}
+
+void
+_osal_i80_bus_deinit (struct _osal_i80_bus * bus)
+{
+	pio_sm_set_enabled (bus->pio, bus->sm, false);
+	pio_remove_program (bus->pio, bus->prog, bus->offset);
+	pio_sm_unclaim (bus->pio, bus->sm);
+	bus->pio=NULL;
+}
+
+void
+_osal_i80_wait_idle (struct _osal_i80_bus * bus)
+{
+	const uint32_t stall_mask=1u<<(PIO_FDEBUG_TXSTALL_LSB+bus->sm);
+
+	bus->pio->fdebug=stall_mask;
+	while (!(bus->pio->fdebug & stall_mask))
+		tight_loop_contents ();
+}
+
+_Bool
+_osal_i80_write_block (
+	struct _osal_i80_bus * bus,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	_Bool wide )
+{
+	size_t i=0;
+
+	if (bus->bus_width==16) {
+		if (wide) {
+			for (; i+1<num_bytes; i+=2) {
+				pio_sm_put_blocking (
+					bus->pio,
+					bus->sm,
+					(uint32_t)byte_arr[i]<<24 | (uint32_t)byte_arr[i+1]<<16
+				);
+			}
+		}
+		for (; i<num_bytes; i++)
+			pio_sm_put_blocking (bus->pio, bus->sm, (uint32_t)byte_arr[i]<<16);
+	} else {
+		for (; i<num_bytes; i++)
+			pio_sm_put_blocking (bus->pio, bus->sm, (uint32_t)byte_arr[i]<<24);
+	}
+
+	return true;
+}
+
+_Bool
+_osal_i80_write_async (
+	struct _osal_i80_bus * bus,
+	int dma_chan,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	_Bool wide,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg )
+{
+	const _Bool b_wide=(wide && bus->bus_width==16);
+	dma_channel_config cfg;
+
+	if (dma_chan<0 || dma_channel_is_busy ((uint)dma_chan))
+		return false;
+	// A narrow transfer on the 16-bit bus needs each byte moved to D[7:0].
+	if (!wide && bus->bus_width==16)
+		return false;
+
+	dma_channel_set_irq0_enabled ((uint)dma_chan, true);
+	_DMA_XFER[dma_chan].spi=NULL;
+	_DMA_XFER[dma_chan].i80=bus;
+	_DMA_XFER[dma_chan].qspi=NULL;
+	_DMA_XFER[dma_chan].cb_arg=cb_arg;
+	_DMA_XFER[dma_chan].done_cb=done_cb;
+
+	cfg=dma_channel_get_default_config ((uint)dma_chan);
+	channel_config_set_transfer_data_size (
+		&cfg,
+		b_wide ? DMA_SIZE_16 : DMA_SIZE_8
+	);
+	// Pixel data is big-endian in memory; the halfword read is not.
+	channel_config_set_bswap (&cfg, b_wide);
+	channel_config_set_read_increment (&cfg, true);
+	channel_config_set_write_increment (&cfg, false);
+	channel_config_set_dreq (&cfg, pio_get_dreq (bus->pio, bus->sm, true));
+
+	dma_channel_configure (
+		(uint)dma_chan,
+		&cfg,
+		&bus->pio->txf[bus->sm],
+		byte_arr,
+		(uint)(b_wide ? num_bytes/2 : num_bytes),
+		true
+	);
+
+	return true;
+}
+
+_Bool
+_osal_i80_read_block (
+	struct _osal_i80_bus * bus,
+	uint8_t byte_arr[],
+	size_t num_bytes,
+	uint32_t rd_cycle_ns )
+{
+	const uint32_t t_half=_osal_ns_to_cycles (rd_cycle_ns/2);
+
+	_osal_i80_wait_idle (bus);
+	pio_sm_set_enabled (bus->pio, bus->sm, false);
+	for (uint i=0; i<bus->bus_width; i++) {
+		gpio_init (bus->data_base+i);
+		gpio_set_dir (bus->data_base+i, GPIO_IN);
+	}
+
+	for (size_t i=0; i<num_bytes; i++) {
+		gpio_put (bus->rd, 0);
+		busy_wait_at_least_cycles (t_half);
+		byte_arr[i]=(uint8_t)(gpio_get_all ()>>bus->data_base);
+		gpio_put (bus->rd, 1);
+		busy_wait_at_least_cycles (t_half);
+	}
+
+	for (uint i=0; i<bus->bus_width; i++)
+		pio_gpio_init (bus->pio, bus->data_base+i);
+	pio_sm_set_consecutive_pindirs (
+		bus->pio,
+		bus->sm,
+		bus->data_base,
+		bus->bus_width,
+		true
+	);
+	pio_sm_set_enabled (bus->pio, bus->sm, true);
+
+	return true;
+}
+
+/**
+ * <<QSPI>>
+ *
+ * Bits are clocked out by a PIO state machine (see `mipi_qspi.pio`), fed by
+ * DMA or by the CPU. The single-line program and that for the full width of
+ * the bus are both loaded, and the state machine is reinitialised with the
+ * other when a write needs a different number of lines. Reads, which are
+ * single-line and rare, are clocked by the CPU.
+ */
+#define NUM_QSPI_BUS NUM_PIOS
+
+struct _osal_qspi_bus {
+	PIO pio;
+	uint sm;
+	uint offset_x1, offset_xn;
+	const pio_program_t * prog_xn;
+	pio_sm_config cfg_x1, cfg_xn;
+	uint8_t max_lanes, cur_lanes;
+	_osal_gpio_pin_T data_base, sck;
+};
+
+static struct _osal_qspi_bus _QSPI_BUS[NUM_QSPI_BUS];
+
+struct _osal_qspi_bus *
+_osal_qspi_bus_init (
+	_osal_gpio_pin_T data_base,
+	uint8_t max_lanes,
+	_osal_gpio_pin_T sck,
+	uint32_t sck_hz )
+{
+	const pio_program_t * prog_xn=(max_lanes==4)
+		? &mipi_qspi_x4_program
+		: &mipi_qspi_x2_program;
+	struct _osal_qspi_bus * bus=NULL;
+	PIO pio;
+	int sm;
+	float clk_div;
+
+	if (max_lanes!=2 && max_lanes!=4)
+		return NULL;
+	for (uint i=0; i<NUM_QSPI_BUS; i++) {
+		if (!_QSPI_BUS[i].pio) {
+			bus=&_QSPI_BUS[i];
+			break;
+		}
+	}
+	if (!bus)
+		return NULL;
+
+	pio=pio0;
+	if (!pio_can_add_program (pio, &mipi_qspi_x1_program)
+			|| !pio_can_add_program (pio, prog_xn))
+		pio=pio1;
+	if (!pio_can_add_program (pio, &mipi_qspi_x1_program))
+		return NULL;
+	sm=pio_claim_unused_sm (pio, false);
+	if (sm<0)
+		return NULL;
+
+	*bus=(struct _osal_qspi_bus)
+	{
+		.pio=pio,
+		.sm=(uint)sm,
+		.offset_x1=pio_add_program (pio, &mipi_qspi_x1_program),
+		.prog_xn=prog_xn,
+		.max_lanes=max_lanes,
+		.cur_lanes=1,
+		.data_base=data_base,
+		.sck=sck
+	};
+	if (!pio_can_add_program (pio, prog_xn)) {
+		pio_remove_program (pio, &mipi_qspi_x1_program, bus->offset_x1);
+		pio_sm_unclaim (pio, bus->sm);
+		bus->pio=NULL;
+		return NULL;
+	}
+	bus->offset_xn=pio_add_program (pio, prog_xn);
+
+	// Each SCK period takes two state machine cycles.
+	clk_div=(float)clock_get_hz (clk_sys)/(2.0f*(float)sck_hz);
+	if (clk_div<1.0f)
+		clk_div=1.0f;
+	bus->cfg_x1=mipi_qspi_program_get_config (
+		bus->offset_x1,
+		1,
+		data_base,
+		sck,
+		clk_div
+	);
+	bus->cfg_xn=mipi_qspi_program_get_config (
+		bus->offset_xn,
+		max_lanes,
+		data_base,
+		sck,
+		clk_div
+	);
+
+	mipi_qspi_program_init_pins (pio, bus->sm, data_base, max_lanes, sck);
+	pio_sm_init (pio, bus->sm, bus->offset_x1, &bus->cfg_x1);
+	pio_sm_set_enabled (pio, bus->sm, true);
+
+	return bus;
+}
+
+void
+_osal_qspi_bus_deinit (struct _osal_qspi_bus * bus)
+{
+	pio_sm_set_enabled (bus->pio, bus->sm, false);
+	pio_remove_program (bus->pio, &mipi_qspi_x1_program, bus->offset_x1);
+	pio_remove_program (bus->pio, bus->prog_xn, bus->offset_xn);
+	pio_sm_unclaim (bus->pio, bus->sm);
+	bus->pio=NULL;
+}
+
+void
+_osal_qspi_wait_idle (struct _osal_qspi_bus * bus)
+{
+	const uint32_t stall_mask=1u<<(PIO_FDEBUG_TXSTALL_LSB+bus->sm);
+
+	bus->pio->fdebug=stall_mask;
+	while (!(bus->pio->fdebug & stall_mask))
+		tight_loop_contents ();
+}
+
+static _Bool
+_osal_qspi_set_lanes (
+	struct _osal_qspi_bus * bus,
+	uint8_t num_lanes )
+{
+	if (num_lanes==bus->cur_lanes)
+		return true;
+	if (num_lanes!=1 && num_lanes!=bus->max_lanes)
+		return false;
+
+	_osal_qspi_wait_idle (bus);
+	pio_sm_set_enabled (bus->pio, bus->sm, false);
+	pio_sm_init (
+		bus->pio,
+		bus->sm,
+		num_lanes==1 ? bus->offset_x1 : bus->offset_xn,
+		num_lanes==1 ? &bus->cfg_x1 : &bus->cfg_xn
+	);
+	pio_sm_set_enabled (bus->pio, bus->sm, true);
+	bus->cur_lanes=num_lanes;
+
+	return true;
+}
+
+_Bool
+_osal_qspi_write_block (
+	struct _osal_qspi_bus * bus,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	uint8_t num_lanes )
+{
+	if (!_osal_qspi_set_lanes (bus, num_lanes))
+		return false;
+	for (size_t i=0; i<num_bytes; i++)
+		pio_sm_put_blocking (bus->pio, bus->sm, (uint32_t)byte_arr[i]<<24);
+
+	return true;
+}
+
+_Bool
+_osal_qspi_write_async (
+	struct _osal_qspi_bus * bus,
+	int dma_chan,
+	const uint8_t byte_arr[],
+	size_t num_bytes,
+	uint8_t num_lanes,
+	_osal_dma_done_cb done_cb,
+	void * cb_arg )
+{
+	dma_channel_config cfg;
+
+	if (dma_chan<0 || dma_channel_is_busy ((uint)dma_chan))
+		return false;
+	if (!_osal_qspi_set_lanes (bus, num_lanes))
+		return false;
+
+	dma_channel_set_irq0_enabled ((uint)dma_chan, true);
+	_DMA_XFER[dma_chan].spi=NULL;
+	_DMA_XFER[dma_chan].i80=NULL;
+	_DMA_XFER[dma_chan].qspi=bus;
+	_DMA_XFER[dma_chan].cb_arg=cb_arg;
+	_DMA_XFER[dma_chan].done_cb=done_cb;
+
+	cfg=dma_channel_get_default_config ((uint)dma_chan);
+	channel_config_set_transfer_data_size (&cfg, DMA_SIZE_8);
+	channel_config_set_read_increment (&cfg, true);
+	channel_config_set_write_increment (&cfg, false);
+	channel_config_set_dreq (&cfg, pio_get_dreq (bus->pio, bus->sm, true));
+
+	dma_channel_configure (
+		(uint)dma_chan,
+		&cfg,
+		&bus->pio->txf[bus->sm],
+		byte_arr,
+		(uint)num_bytes,
+		true
+	);
+
+	return true;
+}
+
+/**
+ * The panel shifts each bit out on the falling edge of SCK, so it is sampled
+ * just before the next rising edge.
+ */
+_Bool
+_osal_qspi_read_block (
+	struct _osal_qspi_bus * bus,
+	uint8_t byte_arr[],
+	size_t num_bytes,
+	uint32_t rd_cycle_ns )
+{
+	const uint32_t t_half=_osal_ns_to_cycles (rd_cycle_ns/2);
+	const _osal_gpio_pin_T d1=bus->data_base+1;
+
+	_osal_qspi_wait_idle (bus);
+	pio_sm_set_enabled (bus->pio, bus->sm, false);
+	gpio_init (bus->sck);
+	gpio_set_dir (bus->sck, GPIO_OUT);
+	gpio_put (bus->sck, 0);
+	gpio_init (d1);
+	gpio_set_dir (d1, GPIO_IN);
+
+	for (size_t i=0; i<num_bytes; i++) {
+		uint8_t b=0;
+		for (int bit=0; bit<8; bit++) {
+			busy_wait_at_least_cycles (t_half);
+			b=(uint8_t)(b<<1 | gpio_get (d1));
+			gpio_put (bus->sck, 1);
+			busy_wait_at_least_cycles (t_half);
+			gpio_put (bus->sck, 0);
+		}
+		byte_arr[i]=b;
+	}
+
+	mipi_qspi_program_init_pins (
+		bus->pio,
+		bus->sm,
+		bus->data_base,
+		bus->max_lanes,
+		bus->sck
+	);
+	pio_sm_set_enabled (bus->pio, bus->sm, true);
+
+	return true;
+}
+
+/**
+ * <<ASIO>>
+ *
+ * There is no scheduler to run a worker on; the async IO contexts are run by
+ * polling them, eg. from the event loop on core 1.
+ */
+
+struct _osal_asio_worker *
+_osal_asio_worker_start (
+	_osal_asio_work_fn work_fn,
+	void * arg )
+{
+	(void)work_fn;
+	(void)arg;
+	return NULL;
+}
+
+void
+_osal_asio_worker_wake (struct _osal_asio_worker * wkr)
+{
+	(void)wkr;
+}
+
+void
+_osal_asio_worker_stop (struct _osal_asio_worker * wkr)
+{
+	(void)wkr;
+}
+
+/**
+ * <<GPIO IRQ>>
+ *
+ * The SDK dispatches the GPIO interrupts of a core to a single callback, so
+ * keep the one registered for each pin and demultiplex them here.
+ */
+
+static struct {
+	_osal_gpio_irq_cb irq_cb;
+	void * cb_arg;
+} _GPIO_IRQ[NUM_BANK0_GPIOS];
+
+static void
+_osal_gpio_irq_hdlr (
+	uint gpio,
+	uint32_t events )
+{
+	(void)events;
+	if (gpio<NUM_BANK0_GPIOS && _GPIO_IRQ[gpio].irq_cb)
+		_GPIO_IRQ[gpio].irq_cb ((_osal_gpio_pin_T)gpio, _GPIO_IRQ[gpio].cb_arg);
+}
+
+_Bool
+_osal_set_gpio_irq (
+	_osal_gpio_pin_T pin,
+	_Bool rising,
+	_osal_gpio_irq_cb irq_cb,
+	void * cb_arg )
+{
+	const uint32_t events=rising ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+
+	if (pin>=NUM_BANK0_GPIOS)
+		return false;
+
+	if (!irq_cb) {
+		gpio_set_irq_enabled (pin, events, false);
+		_GPIO_IRQ[pin].irq_cb=NULL;
+		return true;
+	}
+
+	gpio_init (pin);
+	gpio_set_dir (pin, GPIO_IN);
+	_GPIO_IRQ[pin].cb_arg=cb_arg;
+	_GPIO_IRQ[pin].irq_cb=irq_cb;
+	gpio_set_irq_enabled_with_callback (pin, events, true, _osal_gpio_irq_hdlr);
+
+	return true;
+}
+
+uint32_t
+_osal_get_time_us (void)
+{
+	return time_us_32 ();
+}
+
+uint32_t
+_osal_get_time_ms (void)
+{
+	return to_ms_since_boot (get_absolute_time ());
+}
+
+void
+_osal_sleep_ms (uint32_t ms)
+{
+	sleep_ms (ms);
+}
+
+void
+_osal_yield (void)
+{
+	tight_loop_contents ();
+}
+
+/**
+ * The SDK passes a single pointer to the alarm callback, so the callback and
+ * argument of each pending alarm are kept in a slot of their own.
+ */
+#define NUM_ALARMS 8
+
+static struct _osal_alarm_slot {
+	_osal_alarm_cb alarm_cb; // << NULL while the slot is free
+	void * cb_arg;
+} _ALARM[NUM_ALARMS];
+
+static int64_t
+_osal_alarm_hdlr (
+	alarm_id_t id,
+	void * user_data )
+{
+	struct _osal_alarm_slot * slot=user_data;
+	_osal_alarm_cb alarm_cb=slot->alarm_cb;
+	void * cb_arg=slot->cb_arg;
+
+	(void)id;
+	slot->alarm_cb=NULL;
+	alarm_cb (cb_arg);
+	return 0; // << do not reschedule
+}
+
+_Bool
+_osal_set_alarm_ms (
+	uint32_t ms,
+	_osal_alarm_cb alarm_cb,
+	void * cb_arg )
+{
+	const uint32_t irq_state=save_and_disable_interrupts ();
+	int i;
+
+	for (i=0; i<NUM_ALARMS && _ALARM[i].alarm_cb; i++)
+		;
+	if (i==NUM_ALARMS || !alarm_cb) {
+		restore_interrupts (irq_state);
+		return false;
+	}
+	_ALARM[i].cb_arg=cb_arg;
+	_ALARM[i].alarm_cb=alarm_cb;
+	restore_interrupts (irq_state);
+
+	// An alarm already in the past is fired before this returns (id 0).
+	if (add_alarm_in_ms (ms, _osal_alarm_hdlr, &_ALARM[i], true)<0) {
+		_ALARM[i].alarm_cb=NULL;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * The watchdog scratch registers are kept across a reset by the watchdog, or
+ * of the core alone; 4 to 7 are used by the boot ROM on reboot, so this
+ * takes one of the lower four.
+ */
+#define PERSIST_SCRATCH_REG 3
+
+_Bool
+_osal_persist_load (uint32_t * word)
+{
+	*word=watchdog_hw->scratch[PERSIST_SCRATCH_REG];
+	return true;
+}
+
+_Bool
+_osal_persist_store (uint32_t word)
+{
+	watchdog_hw->scratch[PERSIST_SCRATCH_REG]=word;
+	return true;
+}
@@ -0,0 +1,312 @@
+/**
+ * ========================
+ *       test_asio.c
+ * ========================
+ *
+ * Stress of the async IO ring, run by the worker of the native OSAL: two
+ * threads submit 100000 writes between them while the main thread submits
+ * reads and dispatches the completions. Each producer's writes must run in
+ * the order it submitted them, every operation must complete exactly once,
+ * and each read must deliver the bytes the connector returned for it. The
+ * error a connector raises for an operation must reach its completion.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "asio.h"
+#include "mipi_dcs.h"
+#include "test_util.h"
+
+#define _TEST_NUM_PRODUCERS 2
+#define _TEST_NUM_WRITES    100000
+#define _TEST_NUM_READS     1000
+#define _TEST_RD_SZ         4
+
+struct _test_producer {
+	struct async_io_ctx * io_ctx;
+	struct mipi_io_ctr * io;
+	uint8_t id;
+	uint32_t next_run;        // << seq expected by the connector
+	atomic_uint num_done;     // << completions dispatched
+	atomic_uint num_retries;  // << submissions refused while the ring was full
+};
+
+static struct _test_producer _producers[_TEST_NUM_PRODUCERS];
+static uint32_t _num_reads_run;
+
+/**
+ * Runs on the worker. Each write carries its producer and sequence number.
+ */
+static void
+_test_write_reg (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T reg,
+	_IN const uint8_t params[],
+	size_t num_params )
+{
+	struct _test_producer * p;
+	uint32_t seq;
+
+	(void)self;
+	_TEST_CHECK (reg==RAMWR && num_params==5 && params[0]<_TEST_NUM_PRODUCERS);
+	p=&_producers[params[0]];
+	memcpy (&seq, params+1, sizeof(seq));
+	_TEST_CHECK (seq==p->next_run);
+	p->next_run++;
+}
+
+/**
+ * Returns the index of the read, which the main thread checks on dispatch.
+ */
+static ssize_t
+_test_read_reg (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T reg,
+	_OUT uint8_t params[],
+	size_t num_params )
+{
+	(void)self;
+	_TEST_CHECK (reg==RDDID && num_params==_TEST_RD_SZ);
+	memcpy (params, &_num_reads_run, sizeof(_num_reads_run));
+	_num_reads_run++;
+	return (ssize_t)num_params;
+}
+
+static void
+_test_write_done (
+	mipi_err_T err,
+	size_t bytes_written,
+	void * cb_arg )
+{
+	struct _test_producer * p=cb_arg;
+
+	_TEST_CHECK (!err && bytes_written==6);
+	atomic_fetch_add (&p->num_done, 1);
+}
+
+static void
+_test_read_done (
+	mipi_err_T err,
+	byte_buffer_T out_buff,
+	void * cb_arg )
+{
+	uint32_t * num_read=cb_arg, idx;
+
+	_TEST_CHECK (!err && out_buff.buff_sz==_TEST_RD_SZ);
+	memcpy (&idx, out_buff.buff, sizeof(idx));
+	_TEST_CHECK (idx==*num_read);
+	(*num_read)++;
+}
+
+static int
+_test_produce (void * arg)
+{
+	struct _test_producer * p=arg;
+	uint8_t buff[6]={ RAMWR, p->id };
+
+	for (uint32_t seq=0; seq<_TEST_NUM_WRITES/_TEST_NUM_PRODUCERS;) {
+		mipi_err_T err;
+
+		memcpy (buff+2, &seq, sizeof(seq));
+		err=async_io_write_some (
+			p->io_ctx,
+			p->io,
+			byte_buffer (buff, sizeof(buff)),
+			_test_write_done,
+			p
+		);
+		if (err==MIPI_ERR_NO_MEM) {
+			atomic_fetch_add (&p->num_retries, 1);
+			thrd_yield ();
+			continue;
+		}
+		_TEST_CHECK (!err);
+		seq++;
+	}
+	return 0;
+}
+
+static mipi_err_T _raised; // << returned once by `_test_take_err`
+
+static mipi_err_T
+_test_take_err (struct mipi_io_ctr * self)
+{
+	const mipi_err_T err=_raised;
+
+	(void)self;
+	_raised=0;
+	return err;
+}
+
+static void
+_test_raise_on_write (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T reg,
+	_IN const uint8_t params[],
+	size_t num_params )
+{
+	(void)self;
+	(void)reg;
+	(void)params;
+	(void)num_params;
+	_raised|=MIPI_ERR_IO;
+}
+
+static ssize_t
+_test_raise_on_read (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T reg,
+	_OUT uint8_t params[],
+	size_t num_params )
+{
+	(void)self;
+	(void)reg;
+	memset (params, 0, num_params);
+	_raised|=MIPI_ERR_RES_LOCKED;
+	return (ssize_t)num_params;
+}
+
+static void
+_test_failed_write_done (
+	mipi_err_T err,
+	size_t bytes_written,
+	void * cb_arg )
+{
+	(void)bytes_written;
+	*(mipi_err_T *) cb_arg=err;
+}
+
+static unsigned
+_test_num_writes_done (void)
+{
+	unsigned n=0;
+
+	for (int i=0; i<_TEST_NUM_PRODUCERS; i++)
+		n+=atomic_load (&_producers[i].num_done);
+	return n;
+}
+
+int
+main (void)
+{
+	static struct async_io_ctx io_ctx;
+	struct mipi_io_ctr io={
+		.can_rd=1,
+		.can_wt=1,
+		.write_panel_reg=_test_write_reg,
+		.read_panel_reg=_test_read_reg
+	};
+	thrd_t thrs[_TEST_NUM_PRODUCERS];
+	uint8_t rd_buff[_TEST_RD_SZ];
+	uint32_t num_reads=0, num_read=0;
+	unsigned num_retries=0;
+	const uint32_t t0=_osal_get_time_ms ();
+
+	_TEST_CHECK (!async_io_ctx_init (&io_ctx, true));
+	_TEST_CHECK (io_ctx.wkr);
+
+	for (int i=0; i<_TEST_NUM_PRODUCERS; i++) {
+		_producers[i].io_ctx=&io_ctx;
+		_producers[i].io=&io;
+		_producers[i].id=(uint8_t)i;
+		_TEST_CHECK (thrd_create (&thrs[i], _test_produce, &_producers[i])
+			==thrd_success);
+	}
+
+	/**
+	 * Reads go into the same buffer, which is only filled on dispatch, so
+	 * only one is outstanding at a time.
+	 */
+	while (_test_num_writes_done ()<_TEST_NUM_WRITES
+			|| num_read<_TEST_NUM_READS) {
+		if (num_reads==num_read && num_reads<_TEST_NUM_READS) {
+			const mipi_err_T err=async_io_read_some (
+				&io_ctx,
+				&io,
+				RDDID,
+				byte_buffer (rd_buff, sizeof(rd_buff)),
+				_test_read_done,
+				&num_read
+			);
+
+			_TEST_CHECK (!err || err==MIPI_ERR_NO_MEM);
+			if (err)
+				num_retries++;
+			else
+				num_reads++;
+		}
+		if (!async_io_poll (&io_ctx))
+			thrd_yield ();
+		_TEST_CHECK (_osal_get_time_ms ()-t0<30*1000);
+	}
+
+	for (int i=0; i<_TEST_NUM_PRODUCERS; i++) {
+		_TEST_CHECK (thrd_join (thrs[i], NULL)==thrd_success);
+		_TEST_CHECK (_producers[i].next_run
+			==_TEST_NUM_WRITES/_TEST_NUM_PRODUCERS);
+		num_retries+=atomic_load (&_producers[i].num_retries);
+	}
+
+	_TEST_CHECK (!async_io_poll (&io_ctx));
+	_TEST_CHECK (_test_num_writes_done ()==_TEST_NUM_WRITES);
+	_TEST_CHECK (_num_reads_run==_TEST_NUM_READS);
+	_TEST_CHECK (io_ctx.num_submitted==_TEST_NUM_WRITES+_TEST_NUM_READS);
+	_TEST_CHECK (io_ctx.num_completed==io_ctx.num_submitted);
+	_TEST_CHECK (io_ctx.num_rejected==num_retries);
+
+	printf (
+		"%u ops in %u ms, %u refused while the ring was full\n",
+		(unsigned)io_ctx.num_completed,
+		(unsigned)(_osal_get_time_ms ()-t0),
+		num_retries
+	);
+	/**
+	 * The error a connector raises for an operation reaches its callback,
+	 * and the result of an awaited read.
+	 */
+	{
+		struct mipi_io_ctr bad_io={
+			.can_rd=1,
+			.can_wt=1,
+			.write_panel_reg=_test_raise_on_write,
+			.read_panel_reg=_test_raise_on_read,
+			.take_err=_test_take_err
+		};
+		uint8_t wr_buff[]={ NOP };
+		struct async_awaitable_result result;
+		mipi_err_T wr_err=0;
+
+		_TEST_CHECK (!async_io_write_some (
+			&io_ctx,
+			&bad_io,
+			byte_buffer (wr_buff, sizeof(wr_buff)),
+			_test_failed_write_done,
+			&wr_err
+		));
+		while (!async_io_poll (&io_ctx))
+			thrd_yield ();
+		_TEST_CHECK (wr_err==MIPI_ERR_IO);
+
+		_TEST_CHECK (async_io_await_result (
+			&io_ctx,
+			&bad_io,
+			RDDID,
+			byte_buffer (rd_buff, sizeof(rd_buff)),
+			&result
+		)==MIPI_ERR_RES_LOCKED);
+		_TEST_CHECK (result.done && result.errno==MIPI_ERR_RES_LOCKED);
+	}
+
+	async_io_ctx_free (&io_ctx);
+	return 0;
+}
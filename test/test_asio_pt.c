@@ -0,0 +1,294 @@
+/**
+ * ========================
+ *     test_asio_pt.c
+ * ========================
+ *
+ * Protothreads over an async IO context run by polling. Routines writing
+ * through `ASYNC_PT_WRITE` must interleave, one operation each per pass, and
+ * resume after each wait where they left it, including from within a
+ * `switch`; a read must deliver its bytes, and a write the connector fails
+ * must report the error. More routines than the ring has slots must all
+ * complete, retrying while it is full. Sleeps and waits on TE must not
+ * resume before their condition holds.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "asio_pt.h"
+#include "mipi_dcs.h"
+#include "mipi_te.h"
+#include "test_util.h"
+
+#define _TEST_NUM_WRITES 8
+#define _TEST_MAX_LOG    256
+#define _TEST_NUM_MANY   (ASYNC_IO_MAX_OPS+8)
+#define _TEST_SLEEP_MS   5
+
+struct _test_job {
+	struct async_io_ctx * io_ctx;
+	struct mipi_io_ctr * io;
+	uint8_t id;
+	uint8_t buff[2];
+	unsigned i, state;
+	uint32_t t0;
+	mipi_err_T err;
+	_Bool done;
+};
+
+static uint8_t _log[_TEST_MAX_LOG];
+static size_t _log_len;
+static mipi_err_T _raised;
+
+static void
+_test_write_reg (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T reg,
+	_IN const uint8_t params[],
+	size_t num_params )
+{
+	(void)self;
+	_TEST_CHECK (_log_len<_TEST_MAX_LOG);
+	_log[_log_len++]=num_params ? params[0] : 0xFF;
+	if (reg==NOP)
+		_raised|=MIPI_ERR_IO;
+}
+
+static ssize_t
+_test_read_reg (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T reg,
+	_OUT uint8_t params[],
+	size_t num_params )
+{
+	(void)self;
+	_TEST_CHECK (reg==RDDID);
+	for (size_t i=0; i<num_params; i++)
+		params[i]=(uint8_t)(0x40+i);
+	return (ssize_t)num_params;
+}
+
+static mipi_err_T
+_test_take_err (struct mipi_io_ctr * self)
+{
+	const mipi_err_T err=_raised;
+
+	(void)self;
+	_raised=0;
+	return err;
+}
+
+/**
+ * Writes its id `_TEST_NUM_WRITES` times, one write per wait.
+ */
+static int
+_test_writer (
+	struct async_pt * pt,
+	void * arg )
+{
+	struct _test_job * job=arg;
+
+	ASYNC_PT_BEGIN (pt);
+	for (job->i=0; job->i<_TEST_NUM_WRITES; job->i++) {
+		job->buff[0]=RAMWR;
+		job->buff[1]=job->id;
+		ASYNC_PT_WRITE (
+			pt,
+			job->io_ctx,
+			job->io,
+			byte_buffer (job->buff, sizeof(job->buff))
+		);
+		_TEST_CHECK (!pt->io.errno && pt->io.num_bytes==sizeof(job->buff));
+	}
+	job->done=true;
+	ASYNC_PT_END (pt);
+}
+
+/**
+ * Steps through its states with a wait inside each case; each must resume
+ * in the case it was made from.
+ */
+static int
+_test_stepper (
+	struct async_pt * pt,
+	void * arg )
+{
+	struct _test_job * job=arg;
+
+	ASYNC_PT_BEGIN (pt);
+	for (job->state=0; job->state<3; job->state++) {
+		switch (job->state) {
+		case 0:
+			ASYNC_PT_YIELD (pt);
+			_TEST_CHECK (job->state==0);
+			job->i|=1;
+			break;
+		case 1:
+			ASYNC_PT_READ (
+				pt,
+				job->io_ctx,
+				job->io,
+				RDDID,
+				byte_buffer (job->buff, sizeof(job->buff))
+			);
+			_TEST_CHECK (job->state==1);
+			_TEST_CHECK (!pt->io.errno && pt->io.num_bytes==sizeof(job->buff));
+			_TEST_CHECK (job->buff[0]==0x40 && job->buff[1]==0x41);
+			job->i|=2;
+			break;
+		default:
+			job->buff[0]=NOP;
+			ASYNC_PT_WRITE (
+				pt,
+				job->io_ctx,
+				job->io,
+				byte_buffer (job->buff, 1)
+			);
+			_TEST_CHECK (job->state==2);
+			job->err=pt->io.errno;
+			job->i|=4;
+			break;
+		}
+	}
+	job->done=true;
+	ASYNC_PT_END (pt);
+}
+
+static int
+_test_sleeper (
+	struct async_pt * pt,
+	void * arg )
+{
+	struct _test_job * job=arg;
+
+	ASYNC_PT_BEGIN (pt);
+	job->t0=_osal_get_time_ms ();
+	ASYNC_PT_SLEEP_MS (pt, _TEST_SLEEP_MS);
+	_TEST_CHECK (_osal_get_time_ms ()-job->t0>=_TEST_SLEEP_MS);
+	job->done=true;
+	ASYNC_PT_END (pt);
+}
+
+static struct mipi_te_sched _te;
+
+static int
+_test_te_waiter (
+	struct async_pt * pt,
+	void * arg )
+{
+	struct _test_job * job=arg;
+
+	ASYNC_PT_BEGIN (pt);
+	for (job->i=0; job->i<2; job->i++) {
+		job->t0=_te.num_edges;
+		ASYNC_PT_WAIT_TE (pt, &_te);
+		_TEST_CHECK (_te.num_edges==job->t0+1);
+	}
+	job->done=true;
+	ASYNC_PT_END (pt);
+}
+
+/**
+ * Runs the scheduler until no routine is left, returning the number of
+ * passes; `on_pass` is called before each.
+ */
+static size_t
+_test_run (
+	struct async_pt_sched * sched,
+	void (*on_pass)(size_t) )
+{
+	const uint32_t t0=_osal_get_time_ms ();
+	size_t n=0;
+
+	do {
+		if (on_pass)
+			on_pass (n);
+		n++;
+		_TEST_CHECK (_osal_get_time_ms ()-t0<5000);
+	} while (async_pt_sched_run (sched));
+	return n;
+}
+
+static void
+_test_raise_te (size_t pass)
+{
+	if (pass%3==2)
+		_te.num_edges++;
+}
+
+int
+main (void)
+{
+	static struct async_io_ctx io_ctx;
+	static struct _test_job many[_TEST_NUM_MANY];
+	static struct async_pt pts[_TEST_NUM_MANY];
+	struct mipi_io_ctr io={
+		.can_rd=1,
+		.can_wt=1,
+		.write_panel_reg=_test_write_reg,
+		.read_panel_reg=_test_read_reg,
+		.take_err=_test_take_err
+	};
+	struct async_pt_sched sched;
+	struct _test_job a={ &io_ctx, &io, 'a' }, b={ &io_ctx, &io, 'b' },
+		step={ &io_ctx, &io, 's' };
+	size_t passes;
+
+	_TEST_CHECK (!async_io_ctx_init (&io_ctx, false));
+	_TEST_CHECK (!io_ctx.wkr);
+	async_pt_sched_init (&sched, &io_ctx);
+
+	/**
+	 * Each pass runs the writes submitted on the one before it, so the two
+	 * take turns, and one pass more is needed to see the last complete.
+	 */
+	async_pt_spawn (&sched, &pts[0], _test_writer, &a);
+	async_pt_spawn (&sched, &pts[1], _test_writer, &b);
+	passes=_test_run (&sched, NULL);
+	_TEST_CHECK (a.done && b.done);
+	_TEST_CHECK (passes==_TEST_NUM_WRITES+1);
+	_TEST_CHECK (_log_len==2*_TEST_NUM_WRITES);
+	for (size_t i=0; i<_log_len; i++)
+		_TEST_CHECK (_log[i]==(i & 1 ? 'b' : 'a'));
+
+	// Waits made from within a `switch`; the last write fails.
+	async_pt_spawn (&sched, &pts[0], _test_stepper, &step);
+	_test_run (&sched, NULL);
+	_TEST_CHECK (step.done && step.i==7 && step.err==MIPI_ERR_IO);
+
+	// More routines than slots; those refused retry on the next pass.
+	_log_len=0;
+	for (size_t i=0; i<_TEST_NUM_MANY; i++) {
+		many[i]=(struct _test_job){ &io_ctx, &io, (uint8_t)i };
+		async_pt_spawn (&sched, &pts[i], _test_writer, &many[i]);
+	}
+	_test_run (&sched, NULL);
+	for (size_t i=0; i<_TEST_NUM_MANY; i++)
+		_TEST_CHECK (many[i].done);
+	_TEST_CHECK (_log_len==_TEST_NUM_MANY*_TEST_NUM_WRITES);
+	_TEST_CHECK (io_ctx.num_rejected>0);
+
+	// A sleep alongside waits on TE, which is raised every third pass.
+	memset (&many[0], 0, 2*sizeof(many[0]));
+	async_pt_spawn (&sched, &pts[0], _test_sleeper, &many[0]);
+	async_pt_spawn (&sched, &pts[1], _test_te_waiter, &many[1]);
+	_test_run (&sched, _test_raise_te);
+	_TEST_CHECK (many[0].done && many[1].done);
+
+	printf (
+		"%zu resumes, %zu ops, %zu refused while the ring was full\n",
+		sched.num_resumes,
+		io_ctx.num_completed,
+		io_ctx.num_rejected
+	);
+	_TEST_CHECK (io_ctx.num_completed==io_ctx.num_submitted);
+
+	async_io_ctx_free (&io_ctx);
+	return 0;
+}
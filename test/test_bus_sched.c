@@ -0,0 +1,255 @@
+/**
+ * ========================
+ *    test_bus_sched.c
+ * ========================
+ *
+ * Three simulated panels on one bus, fed through the scheduler: two sending
+ * full frames and one sending commands and a small window. Each turn must go
+ * to the next port round robin which has work, every window must arrive
+ * whole in the GRAM of its panel, and a quantum which the connector fails
+ * must end its window with the error rather than go on with RAMWRC. Ends
+ * with the share of the bus each panel had, which is printed rather than
+ * checked.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mipi.h"
+#include "mipi_bus_sched.h"
+#include "mipi_dcs.h"
+#include "mipi_sim_ctr.h"
+#include "test_util.h"
+
+#define _TEST_NUM_PORTS 3
+#define _TEST_W         32
+#define _TEST_H         24
+#define _TEST_FRAME_SZ  (_TEST_W*_TEST_H*2)
+#define _TEST_FRAMES    4
+#define _TEST_QUANTUM   256
+#define _TEST_SLOTS     8
+#define _TEST_SMALL     8 // << side of the window of the last port
+
+struct _test_done {
+	size_t num_done, num_errs;
+	mipi_err_T last_err;
+};
+
+static struct _test_done _done[_TEST_NUM_PORTS];
+static unsigned _fail_ramwrc_in; // << fail the nth RAMWRC from now, if set
+
+static void
+_test_on_done (
+	struct mipi_io_ctr * io,
+	mipi_err_T err,
+	void * cb_arg )
+{
+	struct _test_done * done=cb_arg;
+
+	(void)io;
+	done->num_done++;
+	if (err)
+		done->num_errs++;
+	done->last_err=err;
+}
+
+static void
+_test_failing_txn (
+	struct mipi_io_ctr * self,
+	_IN const struct mipi_io_txn_seg segs[],
+	size_t num_segs,
+	_IN const uint8_t px_data[],
+	size_t px_sz )
+{
+	mipi_sim_write_txn (self, segs, num_segs, px_data, px_sz);
+	if (segs[0].cmd==RAMWRC && _fail_ramwrc_in && !--_fail_ramwrc_in)
+		((struct mipi_sim_ctr *) self)->errno|=MIPI_ERR_IO;
+}
+
+static _Bool
+_test_has_work (struct mipi_bus_port * port)
+{
+	return port->has_cur || mipi_txq_peek (port->txq);
+}
+
+/**
+ * Runs the scheduler a turn at a time until it has nothing left, checking
+ * that each turn goes to the first port with work, counting from the one
+ * after the last to have had a turn. Returns the number of turns.
+ */
+static size_t
+_test_run_checked (struct mipi_bus_sched * sched)
+{
+	size_t n=0;
+
+	for (;;) {
+		uint8_t expect=sched->next_port;
+		_Bool any=false;
+
+		for (uint8_t i=0; i<sched->num_ports; i++) {
+			const uint8_t idx=(uint8_t)((sched->next_port+i)%sched->num_ports);
+
+			if (_test_has_work (&sched->ports[idx])) {
+				expect=idx;
+				any=true;
+				break;
+			}
+		}
+		if (!mipi_bus_sched_run (sched, 1)) {
+			_TEST_CHECK (!any);
+			return n;
+		}
+		_TEST_CHECK (any && sched->last_port==expect);
+		n++;
+	}
+}
+
+static void
+_test_fill (
+	uint8_t buff[],
+	size_t sz,
+	unsigned seed )
+{
+	for (size_t i=0; i<sz; i++)
+		buff[i]=(uint8_t)(i*3+seed*37);
+}
+
+int
+main (void)
+{
+	static uint8_t frames[2][_TEST_FRAMES][_TEST_FRAME_SZ],
+		small[_TEST_FRAMES][_TEST_SMALL*_TEST_SMALL*2];
+	const struct mipi_area full={ 0, 0, _TEST_W, _TEST_H },
+		win={ 4, 4, _TEST_SMALL, _TEST_SMALL };
+	struct mipi_sim_ctr sims[_TEST_NUM_PORTS];
+	struct mipi_txq txqs[_TEST_NUM_PORTS];
+	struct mipi_sim_bus bus={ 0 };
+	struct mipi_bus_sched sched;
+	size_t num_turns, px_bytes=0;
+
+	mipi_bus_sched_init (&sched, _TEST_QUANTUM);
+	for (int p=0; p<_TEST_NUM_PORTS; p++) {
+		sims[p]=mipi_create_sim_ctr (_TEST_W, _TEST_H, 2);
+		_TEST_CHECK (sims[p].gram);
+		mipi_sim_attach_bus (&sims[p], &bus);
+		mipi_sim_set_cost (&sims[p], (struct mipi_sim_cost){ 200, 50 });
+		_TEST_CHECK (!mipi_txq_init (&txqs[p], &sims[p].io, _TEST_SLOTS));
+		_TEST_CHECK (mipi_bus_sched_add (&sched, &txqs[p])==p);
+	}
+
+	for (unsigned f=0; f<_TEST_FRAMES; f++) {
+		for (int p=0; p<2; p++) {
+			_test_fill (frames[p][f], _TEST_FRAME_SZ, f*2+(unsigned)p);
+			_TEST_CHECK (!mipi_txq_submit_area (
+				&txqs[p],
+				full,
+				frames[p][f],
+				_TEST_FRAME_SZ,
+				_test_on_done,
+				&_done[p]
+			));
+		}
+		_test_fill (small[f], sizeof(small[f]), 100+f);
+		_TEST_CHECK (!mipi_txq_submit_cmd (&txqs[2], NOP, NULL, 0));
+		_TEST_CHECK (!mipi_txq_submit_area (
+			&txqs[2],
+			win,
+			small[f],
+			sizeof(small[f]),
+			_test_on_done,
+			&_done[2]
+		));
+	}
+
+	num_turns=_test_run_checked (&sched);
+	_TEST_CHECK (num_turns==sched.num_turns);
+	_TEST_CHECK (sched.num_switches==bus.num_switches);
+	for (int p=0; p<_TEST_NUM_PORTS; p++) {
+		_TEST_CHECK (_done[p].num_done==_TEST_FRAMES && !_done[p].num_errs);
+		_TEST_CHECK (!mipi_sim_take_err (&sims[p].io));
+		px_bytes+=sched.ports[p].num_px_bytes;
+	}
+
+	// Each window arrived whole, though it was sent in several turns.
+	for (int p=0; p<2; p++) {
+		_TEST_CHECK (sched.ports[p].num_turns
+			==_TEST_FRAMES*((_TEST_FRAME_SZ+_TEST_QUANTUM-1)/_TEST_QUANTUM));
+		_TEST_CHECK (!memcmp (
+			sims[p].gram,
+			frames[p][_TEST_FRAMES-1],
+			_TEST_FRAME_SZ
+		));
+	}
+	for (int y=0; y<_TEST_SMALL; y++) {
+		_TEST_CHECK (!memcmp (
+			sims[2].gram+((size_t)(win.y+y)*_TEST_W+win.x)*2,
+			small[_TEST_FRAMES-1]+(size_t)y*_TEST_SMALL*2,
+			_TEST_SMALL*2
+		));
+	}
+
+	printf (
+		"%zu turns, %zu switches, %.2f ms of bus time for %zu pixel bytes "
+		"(%.2f MB/s)\n",
+		num_turns,
+		sched.num_switches,
+		(double)bus.t_ns/1e6,
+		px_bytes,
+		(double)px_bytes*1e3/(double)bus.t_ns
+	);
+	for (int p=0; p<_TEST_NUM_PORTS; p++) {
+		printf (
+			"port %d: %zu turns, %4.1f%% of the bus\n",
+			p,
+			sched.ports[p].num_turns,
+			100.0*(double)sims[p].wire_ns/(double)bus.t_ns
+		);
+	}
+
+	/**
+	 * The second quantum to continue the window fails; the window ends there,
+	 * with the error, and the next is framed from CASET as usual.
+	 */
+	sims[0].io.write_panel_txn=_test_failing_txn;
+	_fail_ramwrc_in=2;
+	memset (&_done[0], 0, sizeof(_done[0]));
+	mipi_sim_set_log (&sims[0], 64);
+	_TEST_CHECK (!mipi_txq_submit_area (
+		&txqs[0],
+		full,
+		frames[0][0],
+		_TEST_FRAME_SZ,
+		_test_on_done,
+		&_done[0]
+	));
+	_TEST_CHECK (!mipi_txq_submit_area (
+		&txqs[0],
+		full,
+		frames[0][1],
+		_TEST_FRAME_SZ,
+		_test_on_done,
+		&_done[0]
+	));
+	_test_run_checked (&sched);
+	_TEST_CHECK (_done[0].num_done==2 && _done[0].num_errs==1);
+	_TEST_CHECK (!_done[0].last_err && !mipi_err_code);
+
+	// RAMWR, RAMWRC and the failed RAMWRC, then the next window in full.
+	_TEST_CHECK (mipi_sim_log_at (&sims[0], 2)->cmd==RAMWR);
+	_TEST_CHECK (mipi_sim_log_at (&sims[0], 3)->cmd==RAMWRC);
+	_TEST_CHECK (mipi_sim_log_at (&sims[0], 4)->cmd==RAMWRC);
+	_TEST_CHECK (mipi_sim_log_at (&sims[0], 5)->cmd==CASET);
+	_TEST_CHECK (!memcmp (sims[0].gram, frames[0][1], _TEST_FRAME_SZ));
+
+	for (int p=0; p<_TEST_NUM_PORTS; p++) {
+		mipi_txq_free (&txqs[p]);
+		mipi_free_sim_ctr (&sims[p]);
+	}
+	return 0;
+}
@@ -0,0 +1,71 @@
+/**
+ * ========================
+ *     test_clk_cal.c
+ * ========================
+ *
+ * Pixel clock calibration against the simulated connector, made to corrupt
+ * its writes above a known rate: the highest rate found to pass must be that
+ * rate, and the one set must be backed off from it by the margin. A
+ * connector which cannot read from the panel is not calibrated.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-24
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mipi.h"
+#include "mipi_sim_ctr.h"
+#include "test_util.h"
+
+#define _TEST_MHZ(n) ((uint32_t)(n)*1000000u)
+
+int
+main (void)
+{
+	struct mipi_sim_ctr sim=mipi_create_sim_ctr (32, 32, 2);
+	const struct mipi_clk_cal_cfg cfg=
+	{
+		.start_hz=_TEST_MHZ (10),
+		.max_hz=_TEST_MHZ (80),
+		.step_hz=_TEST_MHZ (5),
+		.num_trials=3,
+		.margin_steps=1,
+		.win={ .x=4, .y=4, .w=4, .h=4 },
+		.wr_bytes_per_px=2,
+		.rd_bytes_per_px=2
+	};
+	struct mipi_clk_cal_result res;
+
+	_TEST_CHECK (sim.gram);
+	sim.id[0]=0x7C;
+	sim.id[1]=0x89;
+	sim.id[2]=0xF0;
+	mipi_sim_set_err_threshold (&sim, _TEST_MHZ (40), 0, 4);
+
+	_TEST_CHECK (!mipi_calibrate_px_clk (&sim.io, &cfg, &res));
+	_TEST_CHECK (res.id[0]==0x7C && res.id[1]==0x89 && res.id[2]==0xF0);
+	_TEST_CHECK (res.max_pass_hz==_TEST_MHZ (40));
+	_TEST_CHECK (res.fail_hz==_TEST_MHZ (45));
+	_TEST_CHECK (res.px_hz==_TEST_MHZ (35));
+	_TEST_CHECK (sim.phase_hz[MIPI_IO_PHASE_PX]==_TEST_MHZ (35));
+	_TEST_CHECK (res.num_rates==8);
+
+	// Nothing passes when even the first rate corrupts the data.
+	mipi_sim_set_err_threshold (&sim, _TEST_MHZ (5), 0, 4);
+	_TEST_CHECK (mipi_calibrate_px_clk (&sim.io, &cfg, &res)==MIPI_ERR_IO);
+	_TEST_CHECK (!res.px_hz && res.fail_hz==_TEST_MHZ (10));
+
+	sim.io.can_rd=0;
+	_TEST_CHECK (
+		mipi_calibrate_px_clk (&sim.io, &cfg, &res)==MIPI_ERR_OP_NOT_IMPL
+	);
+	_TEST_CHECK (!res.num_rates);
+
+	mipi_free_sim_ctr (&sim);
+	return 0;
+}
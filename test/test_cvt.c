@@ -0,0 +1,155 @@
+/**
+ * ========================
+ *       test_cvt.c
+ * ========================
+ *
+ * Each conversion kernel built for the host, against the scalar reference
+ * `_ifpf_cvt_rgb565`: every length through the main loop and its tails,
+ * outputs too short for the input (by whole and half pixels), and buffers
+ * off their natural alignment, with the bytes around the output left alone.
+ * Ends with the throughput of each, which is printed rather than checked.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mipi.h"
+#include "mipi_cvt.h"
+#include "test_util.h"
+
+#define _TEST_MAX_PX   131
+#define _TEST_GUARD    8
+#define _TEST_BENCH_PX (1u<<20)
+#define _TEST_BENCH_REPS 16
+
+static uint32_t _rng=0x2545F491u;
+
+static uint32_t
+_test_rand (void)
+{
+	_rng^=_rng<<13;
+	_rng^=_rng>>17;
+	_rng^=_rng<<5;
+	return _rng;
+}
+
+static void
+_test_fill (
+	struct mipi_color in[],
+	size_t num_px )
+{
+	for (size_t i=0; i<num_px; i++) {
+		const uint32_t x=_test_rand ();
+
+		in[i]=(struct mipi_color){ .r=(uint8_t)x, .g=(uint8_t)(x>>8), .b=(uint8_t)(x>>16) };
+	}
+}
+
+/**
+ * Converts `num_px` pixels from `in` into `out_sz` bytes at `out_off` into
+ * the output, with both kernels, and compares everything around it too.
+ */
+static void
+_test_cmp (
+	const struct mipi_cvt_kernel * k,
+	_IN const struct mipi_color in[],
+	size_t num_px,
+	size_t out_off,
+	size_t out_sz )
+{
+	static uint8_t ref[2*_TEST_MAX_PX+2*_TEST_GUARD],
+		out[2*_TEST_MAX_PX+2*_TEST_GUARD];
+	size_t ref_n, out_n;
+
+	memset (ref, 0xA5, sizeof(ref));
+	memset (out, 0xA5, sizeof(out));
+	ref_n=_ifpf_cvt_rgb565 (NULL, in, num_px, ref+out_off, out_sz);
+	out_n=k->cvt_rgb565 (NULL, in, num_px, out+out_off, out_sz);
+
+	if (ref_n!=out_n || memcmp (ref, out, sizeof(out))) {
+		fprintf (
+			stderr,
+			"%s: %zu px into %zu bytes at +%zu differ from scalar\n",
+			k->name,
+			num_px,
+			out_sz,
+			out_off
+		);
+		exit (1);
+	}
+	_TEST_CHECK (out_n==2*(num_px<out_sz/2 ? num_px : out_sz/2));
+}
+
+static void
+_test_kernel (const struct mipi_cvt_kernel * k)
+{
+	static struct mipi_color in[_TEST_MAX_PX+1];
+
+	_test_fill (in, _TEST_MAX_PX+1);
+	for (size_t n=0; n<=_TEST_MAX_PX; n++) {
+		_test_cmp (k, in, n, _TEST_GUARD, 2*n);
+		_test_cmp (k, in+1, n, _TEST_GUARD+1, 2*n);
+		if (n) {
+			_test_cmp (k, in, n, _TEST_GUARD, 2*n-1);
+			_test_cmp (k, in, n, _TEST_GUARD, 2*(n/2));
+		}
+	}
+}
+
+static void
+_test_bench (const struct mipi_cvt_kernel * k)
+{
+	struct mipi_color * in=malloc (_TEST_BENCH_PX*sizeof(*in));
+	uint8_t * out=malloc (2*_TEST_BENCH_PX);
+	uint32_t t0, dt;
+
+	_TEST_CHECK (in && out);
+	_test_fill (in, _TEST_BENCH_PX);
+
+	t0=_osal_get_time_us ();
+	for (int r=0; r<_TEST_BENCH_REPS; r++)
+		_TEST_CHECK (k->cvt_rgb565 (NULL, in, _TEST_BENCH_PX, out, 2*_TEST_BENCH_PX)
+			==2*_TEST_BENCH_PX);
+	dt=_osal_get_time_us ()-t0;
+
+	printf (
+		"%-8s %8.1f Mpx/s\n",
+		k->name,
+		(double)_TEST_BENCH_PX*_TEST_BENCH_REPS/(dt ? dt : 1)
+	);
+	free (in);
+	free (out);
+}
+
+int
+main (void)
+{
+	const struct mipi_cvt_kernel * chosen=mipi_cvt_init (), * first=NULL;
+
+	_TEST_CHECK (MIPI_NUM_CVT_KERNELS);
+	_TEST_CHECK (!strcmp (MIPI_CVT_KERNELS[MIPI_NUM_CVT_KERNELS-1].name, "scalar"));
+
+	for (size_t i=0; i<MIPI_NUM_CVT_KERNELS; i++) {
+		const struct mipi_cvt_kernel * k=&MIPI_CVT_KERNELS[i];
+
+		if (k->is_supported && !k->is_supported ()) {
+			printf ("%-8s not supported\n", k->name);
+			continue;
+		}
+		if (!first)
+			first=k;
+		_test_kernel (k);
+		_test_bench (k);
+	}
+
+	// The fastest which the CPU supports is chosen.
+	_TEST_CHECK (chosen==first);
+	return 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * ========================
+ *      test_dither.c
+ * ========================
+ *
+ * Dithering of each mode, to RGB565 and RGB666: the size of a pixel is taken
+ * from the IFPF given when an area is begun, error diffusion carries over
+ * bands of rows as though the frame were converted in one piece, and a flat
+ * color keeps its mean. Ends with the time taken per megapixel by each mode,
+ * which is printed rather than checked.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mipi.h"
+#include "test_util.h"
+
+#define _TEST_W     64
+#define _TEST_H     32
+#define _TEST_BAND  8
+#define _TEST_BENCH_W 1024 // << a megapixel, square
+#define _TEST_BENCH_REPS 4
+
+static const char * const _MODE_NAMES[]={ "none", "bayer", "fs" };
+
+static int16_t _err_row[3*(_TEST_BENCH_W+2)];
+
+static struct mipi_dither
+_test_dither (enum mipi_dither_mode mode)
+{
+	return (struct mipi_dither){
+		.mode=mode,
+		.err_row=_err_row,
+		.err_row_len=sizeof(_err_row)/sizeof(*_err_row)
+	};
+}
+
+/**
+ * The area converted as one, and as bands of rows, gives the same bytes.
+ */
+static void
+_test_bands (
+	enum mipi_dither_mode mode,
+	const struct mipi_ifpf * ifpf,
+	_IN const struct mipi_color in[] )
+{
+	static uint8_t whole[_TEST_W*_TEST_H*3], banded[_TEST_W*_TEST_H*3];
+	const struct mipi_area bds={ 0, 0, _TEST_W, _TEST_H };
+	struct mipi_dither d=_test_dither (mode);
+	size_t sz, off=0;
+
+	_TEST_CHECK (!mipi_dither_begin (&d, ifpf, bds));
+	_TEST_CHECK (d.bytes_per_px==(ifpf->cvt_to_ifpf ? 2 : 3));
+	sz=mipi_dither_cvt (&d, in, _TEST_W*_TEST_H, whole, sizeof(whole));
+	_TEST_CHECK (sz==(size_t)_TEST_W*_TEST_H*d.bytes_per_px);
+
+	d=_test_dither (mode);
+	for (uint16_t y=0; y<_TEST_H; y+=_TEST_BAND) {
+		const struct mipi_area band={ 0, y, _TEST_W, _TEST_BAND };
+
+		_TEST_CHECK (!mipi_dither_begin (&d, ifpf, band));
+		off+=mipi_dither_cvt (
+			&d,
+			in+(size_t)y*_TEST_W,
+			(size_t)_TEST_W*_TEST_BAND,
+			banded+off,
+			sizeof(banded)-off
+		);
+	}
+	_TEST_CHECK (off==sz && !memcmp (whole, banded, sz));
+}
+
+/**
+ * The mean of the green channel of a flat area, which lies between two
+ * levels of RGB565 and of RGB666, stays within a level of the input.
+ */
+static void
+_test_mean (
+	enum mipi_dither_mode mode,
+	const struct mipi_ifpf * ifpf )
+{
+	static struct mipi_color in[_TEST_W*_TEST_H];
+	static uint8_t out[_TEST_W*_TEST_H*3];
+	const struct mipi_area bds={ 0, 0, _TEST_W, _TEST_H };
+	struct mipi_dither d=_test_dither (mode);
+	unsigned long sum=0;
+	double mean;
+
+	for (size_t i=0; i<_TEST_W*_TEST_H; i++)
+		in[i]=(struct mipi_color){ .r=0x80, .g=0x82, .b=0x80 };
+	_TEST_CHECK (!mipi_dither_begin (&d, ifpf, bds));
+	mipi_dither_cvt (&d, in, _TEST_W*_TEST_H, out, sizeof(out));
+
+	for (size_t i=0; i<_TEST_W*_TEST_H; i++) {
+		const uint8_t * p=out+i*d.bytes_per_px;
+
+		// Green is split across the bytes of RGB565 (see `_mipi_dither_put`).
+		sum+=d.bytes_per_px==2
+			? (unsigned)((p[0] & 0x07)<<5 | (p[1] & 0xE0)>>3)
+			: p[1];
+	}
+	mean=(double)sum/(_TEST_W*_TEST_H);
+	_TEST_CHECK (mean>0x82-2.0 && mean<0x82+2.0);
+}
+
+static void
+_test_bench (
+	enum mipi_dither_mode mode,
+	const struct mipi_ifpf * ifpf )
+{
+	const size_t num_px=(size_t)_TEST_BENCH_W*_TEST_BENCH_W;
+	const struct mipi_area bds={ 0, 0, _TEST_BENCH_W, _TEST_BENCH_W };
+	struct mipi_color * in=malloc (num_px*sizeof(*in));
+	uint8_t * out=malloc (num_px*3);
+	struct mipi_dither d=_test_dither (mode);
+	uint32_t t0, dt;
+	size_t sz=0;
+
+	_TEST_CHECK (in && out);
+	for (size_t i=0; i<num_px; i++)
+		in[i]=(struct mipi_color){ .r=(uint8_t)i, .g=(uint8_t)(i>>3), .b=(uint8_t)(i>>10) };
+
+	t0=_osal_get_time_us ();
+	for (int r=0; r<_TEST_BENCH_REPS; r++) {
+		if (mode==MIPI_DITHER_NONE) {
+			sz=ifpf->cvt_to_ifpf
+				? ifpf->cvt_to_ifpf (ifpf, in, num_px, out, num_px*3)
+				: (memcpy (out, in, num_px*3), num_px*3);
+			continue;
+		}
+		_TEST_CHECK (!mipi_dither_begin (&d, ifpf, bds));
+		sz=mipi_dither_cvt (&d, in, num_px, out, num_px*3);
+	}
+	dt=_osal_get_time_us ()-t0;
+	_TEST_CHECK (sz==num_px*(ifpf->cvt_to_ifpf ? 2 : 3));
+
+	printf (
+		"%-6s to %s: %7.2f ms/Mpx\n",
+		_MODE_NAMES[mode],
+		ifpf->cvt_to_ifpf ? "RGB565" : "RGB666",
+		(double)dt/1000/_TEST_BENCH_REPS*(1<<20)/num_px
+	);
+	free (in);
+	free (out);
+}
+
+int
+main (void)
+{
+	static const enum mipi_color_fmt fmts[]={
+		MIPI_CLR_FMT_RGB_565,
+		MIPI_CLR_FMT_RGB_888 // << sent as RGB666
+	};
+	static struct mipi_color in[_TEST_W*_TEST_H];
+	struct mipi_dither d=_test_dither (MIPI_DITHER_BAYER);
+	uint8_t out[3];
+
+	for (size_t i=0; i<_TEST_W*_TEST_H; i++)
+		in[i]=(struct mipi_color){ .r=(uint8_t)(i*7), .g=(uint8_t)(i>>2), .b=(uint8_t)(i*3) };
+
+	// Nothing is converted before an area has been begun.
+	_TEST_CHECK (!mipi_dither_cvt (&d, in, 1, out, sizeof(out)));
+
+	for (size_t f=0; f<sizeof(fmts)/sizeof(*fmts); f++) {
+		const struct mipi_ifpf * ifpf=&MIPI_PANEL_FMT[fmts[f]];
+
+		for (int m=MIPI_DITHER_BAYER; m<=MIPI_DITHER_FS; m++) {
+			_test_bands ((enum mipi_dither_mode)m, ifpf, in);
+			_test_mean ((enum mipi_dither_mode)m, ifpf);
+		}
+		for (int m=MIPI_DITHER_NONE; m<=MIPI_DITHER_FS; m++)
+			_test_bench ((enum mipi_dither_mode)m, ifpf);
+	}
+	return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * ========================
+ *       test_heap.c
+ * ========================
+ *
+ * Flushes in steady state must not touch the heap: once the device is up,
+ * streaming frames (whole, in part, and dithered) and writing areas through
+ * the simulated connector must leave `mipi_num_heap_ops` where it was. The
+ * pixels must still arrive in the IFPF of the panel.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+#include "mipi_sim_ctr.h"
+#include "test_util.h"
+
+#define _TEST_W      64
+#define _TEST_H      48
+#define _TEST_FRAMES 60
+
+static const uint8_t _TEST_INIT_SEQ[]=
+{
+	SLPOUT, 0,
+	DISPON, 0,
+	END_DCS_SEQ
+};
+
+int
+main (void)
+{
+	static struct mipi_color fmbf[_TEST_W*_TEST_H];
+	static uint8_t px[_TEST_W*_TEST_H*2];
+	const struct mipi_area full={ 0, 0, _TEST_W, _TEST_H },
+		dirty={ 8, 4, 24, 16 };
+	struct mipi_sim_ctr sim=mipi_create_sim_ctr (_TEST_W, _TEST_H, 2);
+	struct mipi_dbi_dev dev=mipi_dbi_dev_create (
+		"sim",
+		_TEST_W,
+		_TEST_H,
+		MIPI_CLR_FMT_RGB_565,
+		_TEST_INIT_SEQ
+	);
+	uint8_t expect[2];
+	size_t num_ops;
+
+	// The simulated panel allocates its GRAM, so the count is live.
+	_TEST_CHECK (sim.gram && mipi_num_heap_ops);
+
+	mipi_dbi_dev_init (&dev, &sim.io);
+	for (size_t i=0; i<_TEST_W*_TEST_H; i++)
+		fmbf[i]=(struct mipi_color){ .r=(uint8_t)i, .g=(uint8_t)(i>>4), .b=0xA5 };
+	memset (px, 0x5A, sizeof(px));
+
+	num_ops=mipi_num_heap_ops;
+	mipi_err_code=0;
+	for (int i=0; i<_TEST_FRAMES; i++) {
+		_TEST_CHECK (!mipi_stream_fmbf (&dev, fmbf, full));
+		_TEST_CHECK (!mipi_stream_fmbf (&dev, fmbf, dirty));
+		mipi_dbi_write_area (&dev, dirty, px, (size_t)dirty.w*dirty.h*2);
+	}
+
+	_TEST_CHECK (!mipi_dbi_set_dither (&dev, MIPI_DITHER_BAYER, NULL, 0));
+	for (int i=0; i<_TEST_FRAMES; i++)
+		_TEST_CHECK (!mipi_stream_fmbf (&dev, fmbf, full));
+	_TEST_CHECK (!mipi_dbi_set_dither (&dev, MIPI_DITHER_NONE, NULL, 0));
+
+	_TEST_CHECK (!mipi_err_code && !sim.errno);
+	_TEST_CHECK (mipi_num_heap_ops==num_ops);
+
+	// The last frame was sent whole, without dithering.
+	_TEST_CHECK (!mipi_stream_fmbf (&dev, fmbf, full));
+	for (size_t i=0; i<_TEST_W*_TEST_H; i++) {
+		_TEST_CHECK (
+			dev.dst_ifpf.cvt_to_ifpf (&dev.dst_ifpf, &fmbf[i], 1, expect, 2)==2
+		);
+		_TEST_CHECK (!memcmp (sim.gram+2*i, expect, 2));
+	}
+
+	mipi_free_sim_ctr (&sim);
+	return 0;
+}
@@ -0,0 +1,186 @@
+/**
+ * ========================
+ *       test_i80.c
+ * ========================
+ *
+ * The 8080 connector on a 16-bit bus, against the panel-side model of the
+ * bus, which decodes the WR and RD cycles back into DCS transactions. A
+ * window must arrive as CASET, RASET and RAMWR, with the parameters on
+ * D[7:0] and the pixel data two bytes a cycle; a read must discard the dummy
+ * cycle; and pixel data of an odd length, whole or split across the chunks
+ * of a stream, must keep each byte in its place. WR cycles shorter than the
+ * panel accepts are counted against the connector.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mipi.h"
+#include "mipi_dbi_i80.h"
+#include "mipi_dcs.h"
+#include "mipi_i80_bus_sim.h"
+#include "test_util.h"
+
+#define _TEST_DATA_BASE 0
+#define _TEST_WR        16
+#define _TEST_RD        17
+#define _TEST_CS        18
+#define _TEST_DCX       19
+#define _TEST_MIN_WR_NS 15 // << of either half of a WR cycle
+#define _TEST_MAX_TXNS  16
+#define _TEST_DUMMY     0xEE
+
+static struct mipi_i80_sim_txn _txns[_TEST_MAX_TXNS];
+static size_t _num_txns;
+
+static void
+_test_on_txn (
+	void * usr_ctx,
+	const struct mipi_i80_sim_txn * txn )
+{
+	(void)usr_ctx;
+	_TEST_CHECK (_num_txns<_TEST_MAX_TXNS);
+	_txns[_num_txns++]=*txn;
+}
+
+/**
+ * The panel drives `_TEST_DUMMY` for the dummy read, then `0x10+idx`.
+ */
+static uint8_t
+_test_on_rd (
+	void * usr_ctx,
+	mipi_dcs_cmd_T cmd,
+	size_t idx )
+{
+	(void)usr_ctx;
+	_TEST_CHECK (cmd==RDDID);
+	return idx ? (uint8_t)(0x10+idx) : _TEST_DUMMY;
+}
+
+static void
+_test_open (
+	struct mipi_i80_ctr * i80,
+	struct mipi_i80_bus_sim * sim,
+	uint32_t wr_cycle_ns )
+{
+	*i80=mipi_create_i80_ctr (
+		MIPI_I80_BUS_16_BIT,
+		_TEST_DATA_BASE,
+		_TEST_WR,
+		_TEST_RD,
+		_TEST_CS,
+		_TEST_DCX
+	);
+	mipi_i80_set_timing_ns (i80, wr_cycle_ns, _I80_DEF_RD_CYCLE_NS);
+	mipi_init_i80_ctr (i80);
+	_TEST_CHECK (i80->bus && !mipi_i80_take_err (&i80->io));
+
+	mipi_i80_sim_init (sim, 16, _TEST_MIN_WR_NS, _TEST_MIN_WR_NS);
+	sim->on_txn=_test_on_txn;
+	sim->on_rd=_test_on_rd;
+	_native_i80_attach_sim (i80->bus, sim, _TEST_DCX, _TEST_CS);
+	_num_txns=0;
+}
+
+/**
+ * The `i`th decoded transaction is `cmd`, carrying exactly `data`.
+ */
+static void
+_test_check_txn (
+	size_t i,
+	mipi_dcs_cmd_T cmd,
+	const uint8_t data[],
+	size_t sz )
+{
+	_TEST_CHECK (i<_num_txns);
+	_TEST_CHECK (_txns[i].cmd==cmd && _txns[i].num_bytes==sz);
+	_TEST_CHECK (sz<=MIPI_I80_SIM_PARAM_CAP);
+	_TEST_CHECK (!sz || !memcmp (_txns[i].params, data, sz));
+}
+
+int
+main (void)
+{
+	static const uint8_t px[12]={
+		0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+		0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C
+	};
+	const uint8_t ca[4]={ 0, 2, 0, 5 }, ra[4]={ 0, 1, 0, 1 };
+	const struct mipi_area bds={ 2, 1, 4, 1 };
+	struct mipi_i80_ctr i80;
+	struct mipi_i80_bus_sim sim;
+	uint8_t id[3], odd[6];
+	size_t wr_cycles;
+
+	_test_open (&i80, &sim, _I80_DEF_WR_CYCLE_NS);
+
+	// Four RGB565 pixels: a WR cycle for each parameter, and for each pixel.
+	mipi_i80_flush_fmbf (&i80.io, px, bds, 8);
+	_TEST_CHECK (!mipi_i80_take_err (&i80.io));
+	_TEST_CHECK (_num_txns==3);
+	_test_check_txn (0, CASET, ca, sizeof(ca));
+	_test_check_txn (1, RASET, ra, sizeof(ra));
+	_test_check_txn (2, RAMWR, px, 8);
+	_TEST_CHECK (sim.num_wr_cycles==3+4+4+4);
+
+	// The dummy cycle is read, and discarded.
+	_num_txns=0;
+	_TEST_CHECK (mipi_i80_recv_params (&i80.io, RDDID, id, sizeof(id))==3);
+	_TEST_CHECK (id[0]==0x11 && id[1]==0x12 && id[2]==0x13);
+	_TEST_CHECK (sim.num_rd_cycles==1+sizeof(id));
+	_TEST_CHECK (_num_txns==1 && _txns[0].cmd==RDDID);
+
+	/**
+	 * Five bytes take three cycles; the last byte goes out on D[15:8], with
+	 * D[7:0] left as padding after it.
+	 */
+	_num_txns=0;
+	wr_cycles=sim.num_wr_cycles;
+	mipi_i80_write_txn (
+		&i80.io,
+		&(struct mipi_io_txn_seg){ .cmd=RAMWR },
+		1,
+		px,
+		5
+	);
+	memcpy (odd, px, 5);
+	odd[5]=0;
+	_TEST_CHECK (!mipi_i80_take_err (&i80.io));
+	_test_check_txn (0, RAMWR, odd, sizeof(odd));
+	_TEST_CHECK (sim.num_wr_cycles-wr_cycles==1+3);
+
+	// RGB666 pixels a chunk at a time; no byte is padded until the stream ends.
+	_num_txns=0;
+	wr_cycles=sim.num_wr_cycles;
+	_TEST_CHECK (!mipi_i80_begin_fmbf_stream (&i80.io, bds));
+	for (size_t off=0; off<sizeof(px); off+=3)
+		_TEST_CHECK (!mipi_i80_write_fmbf_chunk (&i80.io, px+off, 3));
+	mipi_i80_end_fmbf_stream (&i80.io);
+	_TEST_CHECK (!mipi_i80_take_err (&i80.io));
+	_test_check_txn (2, RAMWR, px, sizeof(px));
+	_TEST_CHECK (sim.num_wr_cycles-wr_cycles==3+4+4+sizeof(px)/2);
+	_TEST_CHECK (!sim.num_timing_errs);
+
+	printf (
+		"%zu WR cycles, %zu RD cycles in %.2f us\n",
+		sim.num_wr_cycles,
+		sim.num_rd_cycles,
+		(double)i80.bus->t_ns/1e3
+	);
+	mipi_free_i80_ctr (&i80);
+
+	// A WR cycle shorter than the panel accepts is caught on each half.
+	_test_open (&i80, &sim, _TEST_MIN_WR_NS);
+	mipi_i80_flush_fmbf (&i80.io, px, bds, 8);
+	_test_check_txn (2, RAMWR, px, 8);
+	_TEST_CHECK (sim.num_timing_errs==2*sim.num_wr_cycles-1);
+	mipi_free_i80_ctr (&i80);
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * ========================
+ *     test_init_seq.c
+ * ========================
+ *
+ * An init sequence written to the simulated panel, in both of its forms: as
+ * segments with `mipi_init_seq_write`, and byte-coded with
+ * `_mipi_dcs_write_seq`. Each must sleep through its delays, and stop at the
+ * first command the connector fails, reporting the error rather than the
+ * panel as initialised.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+#include "mipi_init_seq.h"
+#include "mipi_sim_ctr.h"
+#include "test_util.h"
+
+#define _TEST_INIT(CMD, CMD_D)   \
+	CMD_D (SWRST, 20)              \
+	CMD (COLMOD, 0x55)             \
+	CMD (MADCTL, 0x00)             \
+	CMD_D (SLPOUT, 20)             \
+	CMD (DISPON)
+
+MIPI_INIT_SEQ_DEFINE (_TEST_SEQ, _TEST_INIT);
+MIPI_INIT_SEQ_DEFINE_BYTES (_TEST_SEQ_BYTES, _TEST_INIT);
+
+static const mipi_dcs_cmd_T _TEST_CMDS[]={ SWRST, COLMOD, MADCTL, SLPOUT, DISPON };
+
+static mipi_dcs_cmd_T _fail_cmd=NOP; // << raises an error once sent, if set
+
+static void
+_test_check_fail (
+	struct mipi_io_ctr * io,
+	mipi_dcs_cmd_T cmd )
+{
+	if (_fail_cmd!=NOP && cmd==_fail_cmd)
+		((struct mipi_sim_ctr *) io)->errno|=MIPI_ERR_IO;
+}
+
+static void
+_test_send_cmd (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T cmd,
+	_IN const uint8_t params[],
+	size_t len )
+{
+	mipi_sim_send_cmd (self, cmd, params, len);
+	_test_check_fail (self, cmd);
+}
+
+static void
+_test_write_txn (
+	struct mipi_io_ctr * self,
+	_IN const struct mipi_io_txn_seg segs[],
+	size_t num_segs,
+	_IN const uint8_t px_data[],
+	size_t px_sz )
+{
+	mipi_sim_write_txn (self, segs, num_segs, px_data, px_sz);
+	for (size_t i=0; i<num_segs; i++)
+		_test_check_fail (self, segs[i].cmd);
+}
+
+/**
+ * Whether the log holds exactly the first `n` commands of the sequence.
+ */
+static _Bool
+_test_sent (
+	const struct mipi_sim_ctr * sim,
+	size_t n )
+{
+	if (mipi_sim_log_len (sim)!=n)
+		return false;
+	for (size_t i=0; i<n; i++) {
+		if (mipi_sim_log_at (sim, i)->cmd!=_TEST_CMDS[i])
+			return false;
+	}
+	return true;
+}
+
+int
+main (void)
+{
+	struct mipi_sim_ctr sim=mipi_create_sim_ctr (8, 8, 2);
+	struct mipi_init_stats st;
+	uint32_t t0;
+
+	_TEST_CHECK (sim.gram);
+	sim.io.write_panel_reg=_test_send_cmd;
+	sim.io.write_panel_txn=_test_write_txn;
+	_TEST_CHECK (!mipi_sim_set_log (&sim, 16));
+
+	// One transaction per run, and both delays slept through.
+	t0=_osal_get_time_ms ();
+	_TEST_CHECK (!mipi_init_seq_write (&sim.io, &_TEST_SEQ, &st));
+	_TEST_CHECK (_osal_get_time_ms ()-t0>=40);
+	_TEST_CHECK (st.num_txns==3 && st.delay_ms==40);
+	_TEST_CHECK (_test_sent (&sim, 5) && sim.madctl==0x00);
+
+	// A failed run ends the sequence; the runs after it are never sent.
+	mipi_sim_set_log (&sim, 16);
+	_fail_cmd=MADCTL;
+	_TEST_CHECK (mipi_init_seq_write (&sim.io, &_TEST_SEQ, &st)==MIPI_ERR_IO);
+	_TEST_CHECK (_test_sent (&sim, 4));
+	_TEST_CHECK (!mipi_sim_take_err (&sim.io));
+
+	// And likewise without transactions, a command at a time.
+	mipi_sim_set_log (&sim, 16);
+	sim.io.write_panel_txn=NULL;
+	_TEST_CHECK (mipi_init_seq_write (&sim.io, &_TEST_SEQ, &st)==MIPI_ERR_IO);
+	_TEST_CHECK (_test_sent (&sim, 4));
+
+	// The byte-coded form.
+	mipi_sim_set_log (&sim, 16);
+	_fail_cmd=NOP;
+	t0=_osal_get_time_ms ();
+	_TEST_CHECK (_mipi_dcs_write_seq (&sim.io, _TEST_SEQ_BYTES)
+		==(ssize_t)sizeof(_TEST_SEQ_BYTES)-1);
+	_TEST_CHECK (_osal_get_time_ms ()-t0>=40);
+	_TEST_CHECK (_test_sent (&sim, 5));
+
+	mipi_sim_set_log (&sim, 16);
+	_fail_cmd=COLMOD;
+	mipi_err_code=0;
+	_TEST_CHECK (_mipi_dcs_write_seq (&sim.io, _TEST_SEQ_BYTES)==-1);
+	_TEST_CHECK (mipi_err_code & MIPI_ERR_IO);
+	_TEST_CHECK (_test_sent (&sim, 2));
+
+	mipi_free_sim_ctr (&sim);
+	return 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * ========================
+ *    test_panel_drv.c
+ * ========================
+ *
+ * Driver selection against the simulated panel. A cold boot must read the
+ * ID, once per register, and remember the driver it matched; the next boot
+ * must take it from the persistent word without sending anything. A word
+ * whose check no longer fits the table, because it was changed or the table
+ * was, must be probed again rather than trusted. An ID which cannot be read,
+ * or which the connector raised an error for, must select nothing and clear
+ * the word.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+#include "mipi_panel_drv.h"
+#include "mipi_sim_ctr.h"
+#include "test_util.h"
+
+/**
+ * How the panel answers a read: as the model does, with the part number of
+ * an ILI9341 for RDID4, by failing the read, or with an error raised.
+ */
+enum _test_rd_mode {
+	_TEST_RD_SIM,
+	_TEST_RD_ILI9341,
+	_TEST_RD_FAIL,
+	_TEST_RD_RAISE
+};
+
+static enum _test_rd_mode _rd_mode;
+
+static ssize_t
+_test_recv_params (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T cmd,
+	_OUT uint8_t params[],
+	size_t len )
+{
+	static const uint8_t ili9341[3]={ 0x00, 0x93, 0x41 };
+	const ssize_t n=mipi_sim_recv_params (self, cmd, params, len);
+
+	switch (_rd_mode) {
+	case _TEST_RD_ILI9341:
+		if (cmd==RDID4 && len==sizeof(ili9341))
+			memcpy (params, ili9341, len);
+		return n;
+	case _TEST_RD_FAIL:
+		return -1;
+	case _TEST_RD_RAISE:
+		((struct mipi_sim_ctr *) self)->errno|=MIPI_ERR_IO;
+		return n;
+	default:
+		return n;
+	}
+}
+
+/**
+ * Selects with `drvs` and checks what was read from the panel to do so.
+ */
+static const struct mipi_panel_drv *
+_test_select (
+	struct mipi_sim_ctr * sim,
+	_IN const struct mipi_panel_drv drvs[],
+	size_t num_drvs,
+	size_t num_reads,
+	_Bool cache_hit )
+{
+	struct mipi_panel_probe_stats st;
+	const struct mipi_panel_drv * drv;
+	const size_t num_cmds=sim->num_cmds;
+
+	drv=mipi_panel_drv_select (&sim->io, drvs, num_drvs, &st);
+	_TEST_CHECK (st.num_reads==num_reads && st.cache_hit==cache_hit);
+	_TEST_CHECK (sim->num_cmds-num_cmds==num_reads);
+	return drv;
+}
+
+static uint32_t
+_test_persisted (void)
+{
+	uint32_t word;
+
+	_TEST_CHECK (_osal_persist_load (&word));
+	return word;
+}
+
+int
+main (void)
+{
+	const struct mipi_panel_drv * st7735=&MIPI_PANEL_DRVS[0],
+		* ili9341=&MIPI_PANEL_DRVS[1];
+	// The same drivers, the other way round, as after a firmware update.
+	const struct mipi_panel_drv swapped[]={ *ili9341, *st7735 };
+	struct mipi_sim_ctr sim=mipi_create_sim_ctr (8, 8, 2);
+	uint32_t word;
+
+	_TEST_CHECK (!strcmp (st7735->name, "ST7735"));
+	_TEST_CHECK (!strcmp (ili9341->name, "ILI9341"));
+	sim.io.read_panel_reg=_test_recv_params;
+
+	// Cold boot; the middle byte differs from the table, and is masked out.
+	memcpy (sim.id, (uint8_t[]){ 0x7C, 0x42, 0xF0 }, sizeof(sim.id));
+	mipi_panel_drv_forget ();
+	_TEST_CHECK (_test_select (&sim, NULL, 0, 1, false)==st7735);
+	_TEST_CHECK ((word=_test_persisted ()));
+
+	// Warm boot.
+	_TEST_CHECK (_test_select (&sim, NULL, 0, 0, true)==st7735);
+	_TEST_CHECK (_test_persisted ()==word);
+
+	// The check word no longer matches; the panel is probed again.
+	_osal_persist_store (word^1);
+	_TEST_CHECK (_test_select (&sim, NULL, 0, 1, false)==st7735);
+	_TEST_CHECK (_test_persisted ()==word);
+
+	/**
+	 * The table has changed since the word was stored; the driver now at
+	 * its index is not taken for the panel.
+	 */
+	_TEST_CHECK (_test_select (&sim, swapped, 2, 2, false)==&swapped[1]);
+	_TEST_CHECK (_test_persisted ()!=word);
+	_TEST_CHECK (_test_select (&sim, swapped, 2, 0, true)==&swapped[1]);
+
+	// A panel answering only RDID4 is matched once RDDID has been read.
+	mipi_panel_drv_forget ();
+	memset (sim.id, 0, sizeof(sim.id));
+	_rd_mode=_TEST_RD_ILI9341;
+	_TEST_CHECK (_test_select (&sim, NULL, 0, 2, false)==ili9341);
+
+	// Failed reads select nothing, and the stale word is cleared.
+	_rd_mode=_TEST_RD_FAIL;
+	_osal_persist_store (word^1);
+	_TEST_CHECK (!_test_select (&sim, NULL, 0, 2, false));
+	_TEST_CHECK (!_test_persisted ());
+
+	memcpy (sim.id, (uint8_t[]){ 0x7C, 0x89, 0xF0 }, sizeof(sim.id));
+	_rd_mode=_TEST_RD_RAISE;
+	_osal_persist_store (word^1);
+	mipi_err_code=0;
+	_TEST_CHECK (!_test_select (&sim, NULL, 0, 2, false));
+	_TEST_CHECK (mipi_err_code & MIPI_ERR_IO);
+	_TEST_CHECK (!_test_persisted () && !mipi_sim_take_err (&sim.io));
+
+	// Nor does an ID no driver has.
+	_rd_mode=_TEST_RD_SIM;
+	memcpy (sim.id, (uint8_t[]){ 0x12, 0x34, 0x56 }, sizeof(sim.id));
+	_TEST_CHECK (!_test_select (&sim, NULL, 0, 2, false));
+
+	mipi_free_sim_ctr (&sim);
+	return 0;
+}
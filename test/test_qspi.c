@@ -0,0 +1,189 @@
+/**
+ * ========================
+ *       test_qspi.c
+ * ========================
+ *
+ * The quad-SPI connector against the panel-side model of the bus, which
+ * decodes each CS frame back into its instruction, command and data. Every
+ * command must be a frame of its own with the header on D0; CASET and RASET
+ * must carry their parameters on D0 as well, and RAMWR its pixel data on all
+ * four lines (1-1-4), across every chunk of a stream. A read must return the
+ * bytes the panel shifts out on D1. A frame opened with an instruction the
+ * panel does not know is counted as a framing error and dropped.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mipi.h"
+#include "mipi_dbi_qspi.h"
+#include "mipi_dcs.h"
+#include "mipi_qspi_bus_sim.h"
+#include "test_util.h"
+
+#define _TEST_DATA_BASE 0
+#define _TEST_SCK       4
+#define _TEST_CS        5
+#define _TEST_HDR_CLKS  32 // << instruction and address, one bit a clock
+#define _TEST_MAX_TXNS  16
+
+static struct mipi_qspi_sim_txn _txns[_TEST_MAX_TXNS];
+static size_t _num_txns;
+
+static void
+_test_on_txn (
+	void * usr_ctx,
+	const struct mipi_qspi_sim_txn * txn )
+{
+	(void)usr_ctx;
+	_TEST_CHECK (_num_txns<_TEST_MAX_TXNS);
+	_txns[_num_txns++]=*txn;
+}
+
+static uint8_t
+_test_on_rd (
+	void * usr_ctx,
+	mipi_dcs_cmd_T cmd,
+	size_t idx )
+{
+	(void)usr_ctx;
+	_TEST_CHECK (cmd==RDDID);
+	return (uint8_t)(0xA0+idx);
+}
+
+/**
+ * The `i`th decoded frame is `cmd` under `instr`, with a data phase of
+ * exactly `data` on `num_lanes` lines.
+ */
+static void
+_test_check_txn (
+	size_t i,
+	uint8_t instr,
+	mipi_dcs_cmd_T cmd,
+	uint8_t num_lanes,
+	const uint8_t data[],
+	size_t sz )
+{
+	_TEST_CHECK (i<_num_txns);
+	_TEST_CHECK (_txns[i].instr==instr && _txns[i].cmd==cmd);
+	_TEST_CHECK (_txns[i].num_lanes==num_lanes && _txns[i].num_bytes==sz);
+	_TEST_CHECK (sz<=MIPI_QSPI_SIM_PARAM_CAP);
+	_TEST_CHECK (!memcmp (_txns[i].params, data, sz));
+}
+
+/**
+ * Checks a window written from CASET: the address on D0, then the pixels on
+ * four lines.
+ */
+static void
+_test_check_win (
+	const uint8_t ca[4],
+	const uint8_t ra[4],
+	const uint8_t px[],
+	size_t px_sz )
+{
+	_TEST_CHECK (_num_txns==3);
+	_test_check_txn (0, MIPI_QSPI_WR_INSTR, CASET, 1, ca, 4);
+	_test_check_txn (1, MIPI_QSPI_WR_INSTR, RASET, 1, ra, 4);
+	_test_check_txn (2, MIPI_QSPI_PX_INSTR, RAMWR, 4, px, px_sz);
+}
+
+int
+main (void)
+{
+	static const uint8_t px[12]={
+		0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC,
+		0xDE, 0xF0, 0x0F, 0xED, 0xCB, 0xA9
+	};
+	const uint8_t ca[4]={ 0, 2, 0, 5 }, ra[4]={ 0, 1, 0, 1 };
+	const struct mipi_area bds={ 2, 1, 4, 1 };
+	const struct mipi_io_txn_seg segs[]={
+		{ .cmd=CASET, .params=ca, .num_params=sizeof(ca) },
+		{ .cmd=RASET, .params=ra, .num_params=sizeof(ra) },
+		{ .cmd=RAMWR }
+	};
+	struct mipi_qspi_ctr qspi=mipi_create_qspi_ctr (
+		MIPI_QSPI_QUAD,
+		_TEST_DATA_BASE,
+		_TEST_SCK,
+		_TEST_CS
+	);
+	struct mipi_qspi_bus_sim sim;
+	uint8_t id[3];
+	size_t clks;
+
+	mipi_init_qspi_ctr (&qspi);
+	_TEST_CHECK (qspi.bus && !mipi_qspi_take_err (&qspi.io));
+	mipi_qspi_sim_init (
+		&sim,
+		MIPI_QSPI_WR_INSTR,
+		MIPI_QSPI_RD_INSTR,
+		MIPI_QSPI_PX_INSTR,
+		4
+	);
+	sim.on_txn=_test_on_txn;
+	sim.on_rd=_test_on_rd;
+	_native_qspi_attach_sim (qspi.bus, &sim, _TEST_CS);
+
+	/**
+	 * Four RGB565 pixels: a bit a clock for the parameters of CASET and
+	 * RASET, and four for the pixels.
+	 */
+	mipi_qspi_flush_fmbf (&qspi.io, px, bds, 8);
+	_TEST_CHECK (!mipi_qspi_take_err (&qspi.io));
+	_test_check_win (ca, ra, px, 8);
+	_TEST_CHECK (sim.num_clks==3*_TEST_HDR_CLKS+2*4*8+8*2);
+
+	// The same window as a transaction.
+	_num_txns=0;
+	mipi_qspi_write_txn (&qspi.io, segs, 3, px, 8);
+	_TEST_CHECK (!mipi_qspi_take_err (&qspi.io));
+	_test_check_win (ca, ra, px, 8);
+
+	// RGB666 pixels a chunk at a time, all in the data phase of one frame.
+	_num_txns=0;
+	clks=sim.num_clks;
+	_TEST_CHECK (!mipi_qspi_begin_fmbf_stream (&qspi.io, bds));
+	for (size_t off=0; off<sizeof(px); off+=3)
+		_TEST_CHECK (!mipi_qspi_write_fmbf_chunk (&qspi.io, px+off, 3));
+	mipi_qspi_end_fmbf_stream (&qspi.io);
+	_TEST_CHECK (!mipi_qspi_take_err (&qspi.io));
+	_test_check_win (ca, ra, px, sizeof(px));
+	_TEST_CHECK (sim.num_clks-clks
+		==3*_TEST_HDR_CLKS+2*4*8+sizeof(px)*2);
+
+	// Parameters read back from D1, with no dummy cycle.
+	_num_txns=0;
+	_TEST_CHECK (mipi_qspi_recv_params (&qspi.io, RDDID, id, sizeof(id))==3);
+	_TEST_CHECK (id[0]==0xA0 && id[1]==0xA1 && id[2]==0xA2);
+	_test_check_txn (0, MIPI_QSPI_RD_INSTR, RDDID, 1, id, sizeof(id));
+	_TEST_CHECK (!sim.num_framing_errs);
+
+	printf (
+		"%zu frames, %zu clocks in %.2f us\n",
+		sim.num_txns,
+		sim.num_clks,
+		(double)qspi.bus->t_ns/1e3
+	);
+
+	// A pixel instruction the panel does not know; only RAMWR is lost.
+	_num_txns=0;
+	mipi_qspi_set_instr (
+		&qspi,
+		MIPI_QSPI_WR_INSTR,
+		MIPI_QSPI_RD_INSTR,
+		0x38
+	);
+	mipi_qspi_flush_fmbf (&qspi.io, px, bds, 8);
+	_TEST_CHECK (sim.num_framing_errs==1);
+	_TEST_CHECK (_num_txns==2 && _txns[1].cmd==RASET);
+
+	mipi_free_qspi_ctr (&qspi);
+	return 0;
+}
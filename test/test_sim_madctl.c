@@ -0,0 +1,146 @@
+/**
+ * ========================
+ *   test_sim_madctl.c
+ * ========================
+ *
+ * The mapping of the simulated panel from the window set by CASET and RASET,
+ * in the coordinates MADCTL selects, to GRAM, which is kept in those of the
+ * panel. A full window must cover every pixel of GRAM once under each of the
+ * eight combinations of MV, MX and MY; single pixels must land where the
+ * controller would put them; a window reaching past the panel must drop what
+ * falls outside it; and RAMRD must read back through the same mapping.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+#include "mipi_sim_ctr.h"
+#include "test_util.h"
+
+#define _TEST_W  5 // << of the panel, which is not square
+#define _TEST_H  3
+#define _TEST_PX (_TEST_W*_TEST_H)
+
+/**
+ * Logical pixel `(x, y)` and the physical pixel it is expected at.
+ */
+struct _test_corner {
+	uint8_t madctl;
+	uint16_t x, y, px, py;
+};
+
+static const struct _test_corner _CORNERS[]={
+	{ 0,                    0, 0, 0,          0          },
+	{ MIRROR_X,             0, 0, _TEST_W-1,  0          },
+	{ MIRROR_Y,             0, 0, 0,          _TEST_H-1  },
+	{ MIRROR_X|MIRROR_Y,    1, 0, _TEST_W-2,  _TEST_H-1  },
+	{ SWAP_XY,              1, 0, 0,          1          },
+	{ SWAP_XY,              0, 3, 3,          0          },
+	{ SWAP_XY|MIRROR_X,     0, 0, _TEST_W-1,  0          },
+	{ SWAP_XY|MIRROR_Y,     2, 0, 0,          _TEST_H-3  },
+};
+
+static void
+_test_set_madctl (
+	struct mipi_sim_ctr * sim,
+	uint8_t madctl )
+{
+	mipi_sim_send_cmd (&sim->io, MADCTL, &madctl, 1);
+	_TEST_CHECK (sim->madctl==madctl);
+}
+
+/**
+ * Writes `px` to the logical window `bds`, one byte a pixel.
+ */
+static void
+_test_write (
+	struct mipi_sim_ctr * sim,
+	const struct mipi_area bds,
+	const uint8_t px[] )
+{
+	mipi_sim_flush_fmbf (&sim->io, px, bds, (size_t)bds.w*bds.h);
+	_TEST_CHECK (!mipi_sim_take_err (&sim->io));
+}
+
+int
+main (void)
+{
+	struct mipi_sim_ctr sim=mipi_create_sim_ctr (_TEST_W, _TEST_H, 1);
+	uint8_t px[_TEST_PX], back[_TEST_PX];
+
+	_TEST_CHECK (sim.gram);
+	for (size_t i=0; i<_TEST_PX; i++)
+		px[i]=(uint8_t)(i+1);
+
+	// A full window is a permutation of GRAM, whichever way it is addressed.
+	for (unsigned m=0; m<8; m++) {
+		const uint8_t madctl=(uint8_t)((m & 1 ? MIRROR_X : 0)
+			| (m & 2 ? MIRROR_Y : 0)
+			| (m & 4 ? SWAP_XY : 0));
+		const _Bool mv=madctl & SWAP_XY;
+		const struct mipi_area full={
+			0,
+			0,
+			mv ? _TEST_H : _TEST_W,
+			mv ? _TEST_W : _TEST_H
+		};
+		unsigned seen[_TEST_PX+1]={ 0 };
+
+		memset (sim.gram, 0, _TEST_PX);
+		_test_set_madctl (&sim, madctl);
+		_test_write (&sim, full, px);
+		for (size_t i=0; i<_TEST_PX; i++)
+			seen[sim.gram[i]]++;
+		_TEST_CHECK (!seen[0]);
+		for (size_t i=1; i<=_TEST_PX; i++)
+			_TEST_CHECK (seen[i]==1);
+
+		// And reads back as it was written.
+		_TEST_CHECK (mipi_sim_recv_params (&sim.io, RAMRD, back, _TEST_PX)
+			==_TEST_PX);
+		_TEST_CHECK (!memcmp (back, px, _TEST_PX));
+	}
+
+	for (size_t i=0; i<sizeof(_CORNERS)/sizeof(_CORNERS[0]); i++) {
+		const struct _test_corner * c=&_CORNERS[i];
+		const uint8_t v=0xA5;
+
+		memset (sim.gram, 0, _TEST_PX);
+		_test_set_madctl (&sim, c->madctl);
+		_test_write (&sim, (struct mipi_area){ c->x, c->y, 1, 1 }, &v);
+		if (sim.gram[c->py*_TEST_W+c->px]!=v) {
+			fprintf (
+				stderr,
+				"MADCTL %02x: (%u, %u) not at (%u, %u)\n",
+				(unsigned)c->madctl,
+				(unsigned)c->x,
+				(unsigned)c->y,
+				(unsigned)c->px,
+				(unsigned)c->py
+			);
+			return 1;
+		}
+	}
+
+	/**
+	 * A window two columns past the right edge; those columns are dropped,
+	 * and nothing wraps onto the next row.
+	 */
+	memset (sim.gram, 0, _TEST_PX);
+	_test_set_madctl (&sim, 0);
+	_test_write (&sim, (struct mipi_area){ _TEST_W-2, 0, 4, 1 }, px);
+	_TEST_CHECK (sim.gram[_TEST_W-2]==px[0] && sim.gram[_TEST_W-1]==px[1]);
+	for (size_t i=_TEST_W; i<_TEST_PX; i++)
+		_TEST_CHECK (!sim.gram[i]);
+
+	mipi_free_sim_ctr (&sim);
+	return 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * ========================
+ *       test_spi9.c
+ * ========================
+ *
+ * Packing of 9-bit words for the 3-wire interface: the encoder against a
+ * bit-at-a-time reference, for every alignment of the bits held over and
+ * for slices of any size, and the decoder against the encoder. Ends with
+ * the throughput of both, which is printed rather than checked.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mipi.h"
+#include "mipi_spi9.h"
+#include "test_util.h"
+
+#define _TEST_LEN      517 // << not a multiple of 8, so each tail is hit
+#define _TEST_BENCH_SZ (1u<<20)
+#define _TEST_BENCH_REPS 16
+
+static uint32_t _rng=0x9E3779B9u;
+
+static uint32_t
+_test_rand (void)
+{
+	_rng^=_rng<<13;
+	_rng^=_rng>>17;
+	_rng^=_rng<<5;
+	return _rng;
+}
+
+static size_t
+_test_slice_len (
+	size_t max_slice,
+	size_t left )
+{
+	const size_t len=1+_test_rand ()%max_slice;
+
+	return len<left ? len : left;
+}
+
+/**
+ * Packs `num_words` words, MSB first, a bit at a time, and pads the last
+ * byte with zeros. Returns the number of bytes written.
+ */
+static size_t
+_test_ref_encode (
+	const uint16_t words[],
+	size_t num_words,
+	uint8_t out[] )
+{
+	size_t num_bits=0;
+
+	memset (out, 0, (num_words*9+7)/8);
+	for (size_t i=0; i<num_words; i++) {
+		for (int b=8; b>=0; b--, num_bits++) {
+			if (words[i]>>b & 1)
+				out[num_bits/8]|=(uint8_t)(0x80u>>num_bits%8);
+		}
+	}
+	return (num_bits+7)/8;
+}
+
+/**
+ * A command byte, then `_TEST_LEN` bytes of data, encoded in slices of at
+ * most `max_slice` bytes, starting `lead` data words into the stream so that
+ * the groups of eight start at each alignment of the bits held over.
+ */
+static void
+_test_round_trip (
+	size_t lead,
+	size_t max_slice )
+{
+	static uint8_t data[_TEST_LEN], out[MIPI_SPI9_ENC_SZ(_TEST_LEN+8)+8],
+		ref[MIPI_SPI9_ENC_SZ(_TEST_LEN+8)];
+	static uint16_t words[_TEST_LEN+9], dec_words[MIPI_SPI9_DEC_SZ(sizeof(out))];
+	const uint8_t cmd=(uint8_t)_test_rand ();
+	struct mipi_spi9_enc enc;
+	struct mipi_spi9_dec dec;
+	size_t num_words=0, o=0, n=0, ref_sz;
+
+	for (size_t i=0; i<_TEST_LEN; i++)
+		data[i]=(uint8_t)_test_rand ();
+
+	mipi_spi9_enc_reset (&enc);
+	for (size_t i=0; i<lead; i++) {
+		words[num_words++]=MIPI_SPI9_DCX_BIT | data[i];
+		o+=mipi_spi9_encode (&enc, true, &data[i], 1, out+o);
+	}
+	words[num_words++]=cmd;
+	o+=mipi_spi9_encode (&enc, false, &cmd, 1, out+o);
+
+	for (size_t i=0; i<_TEST_LEN;) {
+		const size_t len=_test_slice_len (max_slice, _TEST_LEN-i);
+
+		for (size_t k=0; k<len; k++)
+			words[num_words++]=MIPI_SPI9_DCX_BIT | data[i+k];
+		o+=mipi_spi9_encode (&enc, true, data+i, len, out+o);
+		i+=len;
+	}
+	o+=mipi_spi9_enc_flush (&enc, out+o);
+	_TEST_CHECK (!enc.num_bits);
+
+	ref_sz=_test_ref_encode (words, num_words, ref);
+	_TEST_CHECK (o==ref_sz);
+	_TEST_CHECK (!memcmp (out, ref, o));
+
+	// Decode in slices too; the padding never makes up a whole word.
+	mipi_spi9_dec_reset (&dec);
+	for (size_t i=0; i<o;) {
+		const size_t len=_test_slice_len (max_slice, o-i);
+
+		n+=mipi_spi9_decode (&dec, out+i, len, dec_words+n);
+		i+=len;
+	}
+	_TEST_CHECK (n==num_words);
+	_TEST_CHECK (!memcmp (dec_words, words, n*sizeof(*words)));
+}
+
+static void
+_test_bench (void)
+{
+	uint8_t * in=malloc (_TEST_BENCH_SZ),
+		* out=malloc (MIPI_SPI9_ENC_SZ(_TEST_BENCH_SZ));
+	uint16_t * words=malloc (MIPI_SPI9_DEC_SZ(MIPI_SPI9_ENC_SZ(_TEST_BENCH_SZ))
+		*sizeof(uint16_t));
+	struct mipi_spi9_enc enc;
+	struct mipi_spi9_dec dec;
+	uint32_t t0, enc_us, dec_us;
+	size_t o=0, n=0;
+
+	_TEST_CHECK (in && out && words);
+	for (size_t i=0; i<_TEST_BENCH_SZ; i++)
+		in[i]=(uint8_t)_test_rand ();
+
+	t0=_osal_get_time_us ();
+	for (int r=0; r<_TEST_BENCH_REPS; r++) {
+		mipi_spi9_enc_reset (&enc);
+		o=mipi_spi9_encode (&enc, true, in, _TEST_BENCH_SZ, out);
+		o+=mipi_spi9_enc_flush (&enc, out+o);
+	}
+	enc_us=_osal_get_time_us ()-t0;
+
+	t0=_osal_get_time_us ();
+	for (int r=0; r<_TEST_BENCH_REPS; r++) {
+		mipi_spi9_dec_reset (&dec);
+		n=mipi_spi9_decode (&dec, out, o, words);
+	}
+	dec_us=_osal_get_time_us ()-t0;
+	_TEST_CHECK (n==_TEST_BENCH_SZ && words[n-1]==(MIPI_SPI9_DCX_BIT | in[n-1]));
+
+	printf (
+		"encode: %.1f MB/s, decode: %.1f MB/s (of data bytes)\n",
+		(double)_TEST_BENCH_SZ*_TEST_BENCH_REPS/(enc_us ? enc_us : 1),
+		(double)_TEST_BENCH_SZ*_TEST_BENCH_REPS/(dec_us ? dec_us : 1)
+	);
+	free (in);
+	free (out);
+	free (words);
+}
+
+int
+main (void)
+{
+	static const size_t max_slices[]={ 1, 3, 8, 9, 64, _TEST_LEN };
+
+	for (size_t lead=0; lead<8; lead++) {
+		for (size_t i=0; i<sizeof(max_slices)/sizeof(*max_slices); i++)
+			_test_round_trip (lead, max_slices[i]);
+	}
+
+	_test_bench ();
+	return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * ========================
+ *     test_spi_dma.c
+ * ========================
+ *
+ * DMA flushes of the SPI connector against the emulated peripheral of the
+ * native OSAL: back-to-back flushes from one thread, and a command sent from
+ * another while a flush is on the bus. Each must wait for the transfer
+ * before it, nothing may be written with CS released, and the completion
+ * callback must see the error state of the connector.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-24
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "mipi.h"
+#include "mipi_dbi_spi.h"
+#include "mipi_dcs.h"
+#include "test_util.h"
+
+#define _TEST_CS  5
+#define _TEST_DCX 6
+#define _TEST_PX  64
+#define _TEST_WIRE_SZ 1024
+#define _TEST_FRAME_SZ (11+_TEST_PX) // << CASET, RASET and RAMWR, then pixels
+#define _TEST_FAST_PX 4 // << sent at once, so the transfer may beat its caller
+#define _TEST_FAST_REPS 2000
+
+static uint8_t _wire[_TEST_WIRE_SZ];
+static size_t _wire_len;
+static int _writes_without_cs;
+static size_t _num_bytes_out;
+static _Bool _keep_wire;
+static atomic_int _num_done;
+static mipi_err_T _last_err;
+
+static void
+_test_on_write (
+	struct _osal_spi_dev * spi_dev,
+	const uint8_t byte_arr[],
+	size_t num_bytes )
+{
+	(void)spi_dev;
+	if (_native_get_gpio_pin (_TEST_CS)!=_SPI_ACTIVE_STATE)
+		_writes_without_cs++;
+
+	// Slow the pixel data down, so that the others have to wait for it.
+	if (num_bytes==_TEST_PX)
+		thrd_sleep (&(struct timespec){ .tv_nsec=20*1000*1000 }, NULL);
+
+	_num_bytes_out+=num_bytes;
+	if (!_keep_wire)
+		return;
+	_TEST_CHECK (_wire_len+num_bytes<=_TEST_WIRE_SZ);
+	memcpy (_wire+_wire_len, byte_arr, num_bytes);
+	_wire_len+=num_bytes;
+}
+
+static void
+_test_flush_done (
+	struct mipi_io_ctr * io,
+	mipi_err_T err,
+	void * cb_arg )
+{
+	(void)io;
+	_TEST_CHECK (_native_get_gpio_pin (_TEST_CS)!=_SPI_ACTIVE_STATE);
+	_last_err=err;
+	atomic_fetch_add ((atomic_int *) cb_arg, 1);
+}
+
+/**
+ * `io.wt_in_prog` is cleared just before the callback is invoked, so wait
+ * for the callback itself.
+ */
+static _Bool
+_test_wait_done (int n)
+{
+	const uint32_t t0=_osal_get_time_ms ();
+
+	while (atomic_load (&_num_done)<n) {
+		if (_osal_get_time_ms ()-t0>=1000)
+			return false;
+		thrd_yield ();
+	}
+	return true;
+}
+
+static int
+_test_send_nop (void * arg)
+{
+	struct mipi_spi_ctr * spi_conn=arg;
+
+	mipi_spi_send_cmd (&spi_conn->io, NOP, NULL, 0);
+	return 0;
+}
+
+/**
+ * Whether the frame at `off` in `_wire` is whole: CASET, RASET and RAMWR,
+ * with their parameters, then all of the pixel data.
+ */
+static _Bool
+_test_frame_at (size_t off)
+{
+	if (off+_TEST_FRAME_SZ>_wire_len)
+		return false;
+	if (_wire[off]!=CASET || _wire[off+5]!=RASET || _wire[off+10]!=RAMWR)
+		return false;
+	for (size_t i=off+11; i<off+_TEST_FRAME_SZ; i++) {
+		if (_wire[i]!=0xA5)
+			return false;
+	}
+	return true;
+}
+
+int
+main (void)
+{
+	static struct _osal_spi_dev spi;
+	static mipi_dcs_cmd_T px[_TEST_PX];
+	const struct mipi_area bds={ .x=0, .y=0, .w=_TEST_PX/2, .h=1 };
+	struct mipi_spi_ctr spi_conn;
+	thrd_t thr;
+
+	spi.on_write=_test_on_write;
+	_keep_wire=true;
+	memset (px, 0xA5, sizeof(px));
+
+	spi_conn=mipi_create_spi_ctr (&spi, 2, 3, 4, _TEST_CS, _TEST_DCX);
+	_TEST_CHECK (spi_conn.spi_dev);
+	mipi_init_spi_ctr (&spi_conn);
+	mipi_spi_set_flush_mode (
+		&spi_conn,
+		MIPI_SPI_FLUSH_DMA,
+		_test_flush_done,
+		&_num_done
+	);
+	_TEST_CHECK (spi_conn.flush_mode==MIPI_SPI_FLUSH_DMA);
+
+	/**
+	 * The second flush is started by the thread which started the first, and
+	 * while it is still on the bus; it must wait for it rather than relock the
+	 * bus (or deadlock on it).
+	 */
+	mipi_spi_flush_fmbf (&spi_conn.io, px, bds, sizeof(px));
+	mipi_spi_flush_fmbf (&spi_conn.io, px, bds, sizeof(px));
+	_TEST_CHECK (_test_wait_done (2));
+	_TEST_CHECK (!spi_conn.errno && !_last_err);
+	_TEST_CHECK (_wire_len==2*_TEST_FRAME_SZ);
+	_TEST_CHECK (_test_frame_at (0) && _test_frame_at (_TEST_FRAME_SZ));
+
+	// A command from another thread waits for the flush to leave the bus.
+	_wire_len=0;
+	mipi_spi_flush_fmbf (&spi_conn.io, px, bds, sizeof(px));
+	_TEST_CHECK (thrd_create (&thr, _test_send_nop, &spi_conn)==thrd_success);
+	_TEST_CHECK (thrd_join (thr, NULL)==thrd_success);
+	_TEST_CHECK (_test_wait_done (3));
+	_TEST_CHECK (_wire_len==_TEST_FRAME_SZ+1);
+	_TEST_CHECK (_test_frame_at (0) && _wire[_TEST_FRAME_SZ]==NOP);
+
+	// The callback reports the error state of the connector.
+	spi_conn.errno|=MIPI_ERR_IO;
+	mipi_spi_flush_fmbf (&spi_conn.io, px, bds, sizeof(px));
+	_TEST_CHECK (_test_wait_done (4));
+	_TEST_CHECK (_last_err & MIPI_ERR_IO);
+
+	/**
+	 * Flushes small enough to complete before `mipi_spi_write_txn` has
+	 * returned; the bus must still be handed back after each.
+	 */
+	_keep_wire=false;
+	_num_bytes_out=0;
+	mipi_spi_take_err (&spi_conn.io);
+	for (int i=0; i<_TEST_FAST_REPS; i++) {
+		mipi_spi_flush_fmbf (&spi_conn.io, px, bds, _TEST_FAST_PX);
+		_TEST_CHECK (!mipi_spi_take_err (&spi_conn.io));
+	}
+	_TEST_CHECK (_test_wait_done (4+_TEST_FAST_REPS));
+	_TEST_CHECK (_num_bytes_out==(size_t)_TEST_FAST_REPS*(11+_TEST_FAST_PX));
+
+	_TEST_CHECK (!_writes_without_cs);
+	mipi_free_spi_ctr (&spi_conn);
+	return 0;
+}
@@ -0,0 +1,262 @@
+/**
+ * ========================
+ *        test_te.c
+ * ========================
+ *
+ * Band writes of the TE scheduler, against a TE signal driven at a fixed
+ * rate from another thread, as the panel would drive it. Each band must be
+ * written after the scan of some refresh has passed its last row, and before
+ * the scan of the next reaches its first; and the bands of a frame must be
+ * written in order, each once. An error raised for a band is returned with
+ * its frame.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#include "mipi.h"
+#include "mipi_dcs.h"
+#include "mipi_te.h"
+#include "test_util.h"
+
+#define _TEST_TE_PIN   7
+#define _TEST_ROWS     64
+#define _TEST_BAND     16
+#define _TEST_COLS     4
+#define _TEST_PERIOD   4000 // << us
+#define _TEST_VBLANK   400  // << us
+#define _TEST_FRAMES   6
+#define _TEST_MAX_EDGES 256
+#define _TEST_MAX_BANDS 64
+
+/**
+ * The scheduler places the scan by its estimate of the period, which may be
+ * a few microseconds out from the period driven; allow it a row.
+ */
+#define _TEST_SLACK_US ((_TEST_PERIOD-_TEST_VBLANK)/_TEST_ROWS)
+
+struct _test_band {
+	uint32_t t_us;
+	uint16_t r0, r1;
+};
+
+static uint32_t _edges[_TEST_MAX_EDGES];
+static atomic_size_t _num_edges;
+static atomic_bool _stop;
+
+static struct _test_band _bands[_TEST_MAX_BANDS];
+static size_t _num_bands;
+static size_t _fail_band=SIZE_MAX; // << raises an error once written
+static mipi_err_T _io_err;
+
+static void
+_test_write_reg (
+	struct mipi_io_ctr * self,
+	mipi_dcs_cmd_T reg,
+	_IN const uint8_t params[],
+	size_t num_params )
+{
+	(void)self;
+	(void)reg;
+	(void)params;
+	(void)num_params;
+}
+
+static void
+_test_write_txn (
+	struct mipi_io_ctr * self,
+	_IN const struct mipi_io_txn_seg segs[],
+	size_t num_segs,
+	_IN const uint8_t px_data[],
+	size_t px_sz )
+{
+	const uint32_t now=_osal_get_time_us ();
+
+	(void)self;
+	_TEST_CHECK (num_segs==3 && segs[1].cmd==RASET && segs[2].cmd==RAMWR);
+	_TEST_CHECK (px_data && _num_bands<_TEST_MAX_BANDS);
+
+	_bands[_num_bands++]=(struct _test_band){
+		.t_us=now,
+		.r0=(uint16_t)(segs[1].params[0]<<8 | segs[1].params[1]),
+		.r1=(uint16_t)((segs[1].params[2]<<8 | segs[1].params[3])+1)
+	};
+	_TEST_CHECK (px_sz==(size_t)(_bands[_num_bands-1].r1
+		-_bands[_num_bands-1].r0)*_TEST_COLS*2);
+	if (_num_bands-1==_fail_band)
+		_io_err|=MIPI_ERR_IO;
+}
+
+static mipi_err_T
+_test_take_err (struct mipi_io_ctr * self)
+{
+	const mipi_err_T err=_io_err;
+
+	(void)self;
+	_io_err=0;
+	return err;
+}
+
+/**
+ * Raises TE every `_TEST_PERIOD`, on a fixed schedule so that the jitter of
+ * one edge does not carry over to the next. Each edge is logged before it is
+ * driven, so that the log is never later than the scheduler's own stamp.
+ */
+static int
+_test_drive_te (void * arg)
+{
+	uint32_t next=_osal_get_time_us ();
+
+	(void)arg;
+	while (!atomic_load (&_stop)
+			&& atomic_load (&_num_edges)<_TEST_MAX_EDGES) {
+		const uint32_t now=_osal_get_time_us ();
+
+		if ((int32_t)(next-now)>0) {
+			thrd_sleep (&(struct timespec){ .tv_nsec=(long)(next-now)*1000 }, NULL);
+			continue;
+		}
+		_edges[atomic_load (&_num_edges)]=_osal_get_time_us ();
+		atomic_fetch_add (&_num_edges, 1);
+		_native_drive_gpio_pin (_TEST_TE_PIN, true);
+		_native_drive_gpio_pin (_TEST_TE_PIN, false);
+		next+=_TEST_PERIOD;
+	}
+	return 0;
+}
+
+static uint32_t
+_test_row_us (uint16_t row)
+{
+	return _TEST_VBLANK
+		+(uint32_t)((uint64_t)(_TEST_PERIOD-_TEST_VBLANK)*row/_TEST_ROWS);
+}
+
+/**
+ * Whether the band was written behind the scan of one of the logged
+ * refreshes and ahead of the next.
+ */
+static _Bool
+_test_is_tear_free (
+	const struct _test_band * band,
+	size_t num_edges )
+{
+	for (size_t i=0; i<num_edges; i++) {
+		const uint32_t t=band->t_us+_TEST_SLACK_US;
+
+		if ((int32_t)(t-(_edges[i]+_test_row_us (band->r1)))<0)
+			continue;
+		if (i+1<num_edges && (int32_t)(band->t_us-_TEST_SLACK_US
+				-(_edges[i+1]+_test_row_us (band->r0)))>=0)
+			continue;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * The bands from `first` on make up the frame of `bds`: in order, without
+ * gaps or overlaps.
+ */
+static void
+_test_check_frame (
+	size_t first,
+	const struct mipi_area bds )
+{
+	uint16_t row=bds.y;
+
+	for (size_t i=first; i<_num_bands; i++) {
+		_TEST_CHECK (_bands[i].r0==row);
+		_TEST_CHECK (_bands[i].r1>row && _bands[i].r1-row<=_TEST_BAND);
+		row=_bands[i].r1;
+	}
+	_TEST_CHECK (row==bds.y+bds.h);
+}
+
+int
+main (void)
+{
+	static uint8_t px[_TEST_ROWS*_TEST_COLS*2];
+	const struct mipi_area full={ 0, 0, _TEST_COLS, _TEST_ROWS },
+		ptl={ 0, 20, _TEST_COLS, 30 };
+	struct mipi_io_ctr io={
+		.can_wt=1,
+		.write_panel_reg=_test_write_reg,
+		.write_panel_txn=_test_write_txn,
+		.take_err=_test_take_err
+	};
+	struct mipi_te_sched sched;
+	size_t num_edges;
+	thrd_t thr;
+
+	_TEST_CHECK (!mipi_te_sched_init (
+		&sched,
+		&io,
+		_TEST_TE_PIN,
+		_TEST_ROWS,
+		_TEST_BAND,
+		_TEST_PERIOD,
+		_TEST_VBLANK
+	));
+	_TEST_CHECK (thrd_create (&thr, _test_drive_te, NULL)==thrd_success);
+
+	// Wait for the scheduler to have seen the signal, rather than its guess.
+	while (sched.num_edges<2)
+		thrd_yield ();
+
+	for (int i=0; i<_TEST_FRAMES; i++) {
+		const struct mipi_area bds=i & 1 ? ptl : full;
+		const size_t first=_num_bands;
+		const _Bool fail=i==_TEST_FRAMES-1;
+
+		/**
+		 * The second band of the last frame fails; the rest are still
+		 * written, and the frame is reported with the error.
+		 */
+		if (fail)
+			_fail_band=first+1;
+
+		// Submit at a different point of the scan each time.
+		_osal_sleep_ms (1+(uint32_t)i*_TEST_PERIOD*3/8/1000);
+		_TEST_CHECK (mipi_te_sched_flush (
+			&sched,
+			bds,
+			px+(size_t)bds.y*_TEST_COLS*2,
+			(size_t)bds.w*bds.h*2
+		)==(fail ? MIPI_ERR_IO : 0));
+		_test_check_frame (first, bds);
+	}
+
+	atomic_store (&_stop, true);
+	_TEST_CHECK (thrd_join (thr, NULL)==thrd_success);
+	num_edges=atomic_load (&_num_edges);
+
+	for (size_t i=0; i<_num_bands; i++) {
+		if (!_test_is_tear_free (&_bands[i], num_edges)) {
+			fprintf (
+				stderr,
+				"rows %u-%u written across a scan, at %u us\n",
+				(unsigned)_bands[i].r0,
+				(unsigned)_bands[i].r1,
+				(unsigned)_bands[i].t_us
+			);
+			return 1;
+		}
+	}
+
+	_TEST_CHECK (sched.num_frames==_TEST_FRAMES);
+	_TEST_CHECK (sched.num_bands==_num_bands);
+	_TEST_CHECK (sched.period_us>_TEST_PERIOD*3/4
+		&& sched.period_us<_TEST_PERIOD*5/4);
+
+	mipi_te_sched_deinit (&sched);
+	return 0;
+}
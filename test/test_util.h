@@ -0,0 +1,30 @@
+/**
+ * ========================
+ *       test_util.h
+ * ========================
+ *
+ * Shared by the host tests. A failed check prints where it was made and the
+ * condition which did not hold, then exits, failing the test.
+ *
+ * Author(s): Lane W Surface
+ * Created:   2025-03-25
+ * License:   MIT
+ *
+ * Copyright Surface EP, LLC 2025.
+ */
+
+#ifndef __MIPI_TEST_UTIL__
+#define __MIPI_TEST_UTIL__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define _TEST_CHECK(cond)                                    \
+	do {                                                       \
+		if (!(cond)) {                                           \
+			fprintf (stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			exit (1);                                              \
+		}                                                        \
+	} while (0)
+
+#endif // __MIPI_TEST_UTIL__